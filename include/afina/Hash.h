@@ -0,0 +1,87 @@
+#ifndef AFINA_HASH_H
+#define AFINA_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace Afina {
+
+namespace Detail {
+
+// 64x64->128 multiplication folded back into 64 bits, the only mixing primitive of the hash
+inline uint64_t HashMix(uint64_t a, uint64_t b) {
+    __uint128_t r = static_cast<__uint128_t>(a) * b;
+    return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+}
+
+inline uint64_t HashRead8(const char *p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t HashRead4(const char *p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+} // namespace Detail
+
+/**
+ * # Key hash
+ * Fast non-cryptographic 64-bit hash of wyhash family. Short keys are read by a couple of overlapping loads,
+ * longer ones are consumed 16 bytes per multiplication.
+ *
+ * Parser computes it once per key. Set and get/gets pass it along with the key, so storage doesn't hash key bytes
+ * again on these paths; other commands leave hashing to the storage.
+ * Value is stable within the process only, it must not be persisted.
+ */
+inline uint64_t Hash(const char *data, size_t size, uint64_t seed = 0) {
+    const uint64_t s0 = 0xa0761d6478bd642fULL;
+    const uint64_t s1 = 0xe7037ed1a0b428dbULL;
+    const uint64_t s2 = 0x8ebc6af09c88c6e3ULL;
+
+    seed ^= Detail::HashMix(seed ^ s0, s1);
+
+    uint64_t a, b;
+    if (size <= 16) {
+        if (size >= 4) {
+            size_t shift = (size >> 3) << 2;
+            a = (Detail::HashRead4(data) << 32) | Detail::HashRead4(data + shift);
+            b = (Detail::HashRead4(data + size - 4) << 32) | Detail::HashRead4(data + size - 4 - shift);
+        } else if (size > 0) {
+            a = (static_cast<uint64_t>(static_cast<uint8_t>(data[0])) << 16) |
+                (static_cast<uint64_t>(static_cast<uint8_t>(data[size >> 1])) << 8) |
+                static_cast<uint8_t>(data[size - 1]);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t left = size;
+        const char *p = data;
+        while (left > 16) {
+            seed = Detail::HashMix(Detail::HashRead8(p) ^ s1, Detail::HashRead8(p + 8) ^ seed);
+            p += 16;
+            left -= 16;
+        }
+        a = Detail::HashRead8(p + left - 16);
+        b = Detail::HashRead8(p + left - 8);
+    }
+
+    a ^= s1;
+    b ^= seed;
+    __uint128_t r = static_cast<__uint128_t>(a) * b;
+    a = static_cast<uint64_t>(r);
+    b = static_cast<uint64_t>(r >> 64);
+    return Detail::HashMix(a ^ s0 ^ size, b ^ s2);
+}
+
+inline uint64_t Hash(const std::string &key) { return Hash(key.data(), key.size()); }
+
+} // namespace Afina
+
+#endif // AFINA_HASH_H
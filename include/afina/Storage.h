@@ -1,7 +1,12 @@
 #ifndef AFINA_STORAGE_H
 #define AFINA_STORAGE_H
 
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace Afina {
 
@@ -10,6 +15,50 @@ namespace Afina {
  */
 class Storage {
 public:
+    /**
+     * Outcome of CompareAndSet operation
+     */
+    enum class CasResult {
+        // Value has been replaced
+        kStored,
+
+        // Item has been modified since client fetched its cas unique
+        kExists,
+
+        // Item doesn't exist
+        kNotFound,
+
+        // Value can't be stored, for example it will never fit into the storage
+        kNotStored
+    };
+
+    /**
+     * When mutation log is synced to disk
+     */
+    enum class LogSync {
+        // Before reply to the client, writes coming at the same time share one sync
+        kAlways,
+
+        // Periodically, crash loses at most the last period
+        kInterval,
+
+        // Whenever OS decides to
+        kNever
+    };
+
+    /**
+     * Item as returned by MultiGet
+     */
+    struct Item {
+        // Whenever key is present in storage, rest of fields are valid only if it is
+        bool found;
+
+        // Slice of the value, see Get
+        std::shared_ptr<const std::string> value;
+        uint32_t flags;
+        uint64_t cas;
+    };
+
     Storage() {}
     virtual ~Storage() {}
 
@@ -30,6 +79,41 @@ public:
      */
     virtual bool Put(const std::string &key, const std::string &value) = 0;
 
+    /**
+     * Same as above, but value buffer gets moved into the storage instead of being copied. Together with
+     * Reserve that allows network layer to receive data block straight into its final location.
+     *
+     * Item carries opaque client flags, which are stored along with the value and returned back by Get.
+     *
+     * Item could be given expiration time, after which it is no longer visible and gets freed eventually.
+     * Expiration time uses memcached semantics: 0 means never, values up to 30 days are relative to now, bigger
+     * values are unix timestamps and negative values expire item immediately.
+     *
+     * @param key to be associated with value
+     * @param value to be moved into the storage
+     * @param flags opaque client flags
+     * @param expire item expiration time
+     */
+    virtual bool Put(const std::string &key, std::string &&value, uint32_t flags = 0, int32_t expire = 0) = 0;
+
+    /**
+     * Same as above, but key comes with its hash already computed by Afina::Hash, so implementation
+     * doesn't need to hash key again. Default implementation ignores the hash
+     *
+     * Only Put, Get and MultiGet, the hot paths of set and get/gets, take precomputed hash. Other operations
+     * hash the key on their own
+     *
+     * @param key to be associated with value
+     * @param hash of the key, see Afina::Hash
+     * @param value to be moved into the storage
+     * @param flags opaque client flags
+     * @param expire item expiration time
+     */
+    virtual bool Put(const std::string &key, uint64_t hash, std::string &&value, uint32_t flags = 0,
+                     int32_t expire = 0) {
+        return Put(key, std::move(value), flags, expire);
+    }
+
     /**
      * Stores association between given key/value pair if key isn't present in
      * storage.
@@ -43,6 +127,17 @@ public:
      */
     virtual bool PutIfAbsent(const std::string &key, const std::string &value) = 0;
 
+    /**
+     * Same as above, but value buffer gets moved into the storage. If method returns false the value
+     * is left untouched
+     *
+     * @param key to be associated with value
+     * @param value to be moved into the storage
+     * @param flags opaque client flags
+     * @param expire item expiration time, see Put
+     */
+    virtual bool PutIfAbsent(const std::string &key, std::string &&value, uint32_t flags = 0, int32_t expire = 0) = 0;
+
     /**
      * Updates existing association between given key/value pair
      * If requested key doesn't present in storage method returns false and
@@ -56,6 +151,84 @@ public:
      */
     virtual bool Set(const std::string &key, const std::string &value) = 0;
 
+    /**
+     * Same as above, but value buffer gets moved into the storage. If method returns false the value
+     * is left untouched
+     *
+     * @param key to be associated with value
+     * @param value to be moved into the storage
+     * @param flags opaque client flags
+     * @param expire item expiration time, see Put
+     */
+    virtual bool Set(const std::string &key, std::string &&value, uint32_t flags = 0, int32_t expire = 0) = 0;
+
+    /**
+     * Replaces value for the given key only if the item hasn't been modified since client fetched it, i.e
+     * item version stamp is still equal to cas. Check and update happen atomically.
+     *
+     * Each successful mutation of an item assigns it new unique 64-bit version stamp, see Get.
+     *
+     * @param key to be associated with value
+     * @param cas version stamp returned by Get earlier
+     * @param value to be moved into the storage, left untouched unless kStored returned
+     * @param flags opaque client flags
+     * @param expire item expiration time, see Put
+     */
+    virtual CasResult CompareAndSet(const std::string &key, uint64_t cas, std::string &&value, uint32_t flags = 0,
+                                    int32_t expire = 0) = 0;
+
+    /**
+     * Updates expiration time of existing item without touching its value. Returns false if key
+     * isn't present in storage
+     *
+     * @param key to update expiration time for
+     * @param expire new expiration time, see Put
+     */
+    virtual bool Touch(const std::string &key, int32_t expire) = 0;
+
+    /**
+     * Appends data to the end of existing value for the given key. Update happens in place under a single
+     * storage lock, so concurrent appends never lose each other. Item flags stay the same.
+     *
+     * If requested key doesn't present in storage or resulting value can't fit into storage method returns
+     * false and doesn't change anything.
+     *
+     * @param key to update value for
+     * @param value data to be added after existing value
+     */
+    virtual bool Append(const std::string &key, const std::string &value) = 0;
+
+    /**
+     * Same as Append, but data is added before existing value
+     *
+     * @param key to update value for
+     * @param value data to be added before existing value
+     */
+    virtual bool Prepend(const std::string &key, const std::string &value) = 0;
+
+    /**
+     * Increments numeric value for the given key. Value must be a decimal representation of unsigned
+     * 64-bit integer, once incremented it is kept as a native number. Overflow wraps around.
+     *
+     * If requested key doesn't present in storage method returns false and doesn't change anything. If
+     * existing value isn't a number method throws std::runtime_error.
+     *
+     * @param key to update value for
+     * @param delta amount to be added to the value
+     * @param value output parameter, value after increment
+     */
+    virtual bool Increment(const std::string &key, uint64_t delta, uint64_t &value) = 0;
+
+    /**
+     * Same as Increment but subtracts delta from the value. Value never goes below zero, it stays
+     * zero instead.
+     *
+     * @param key to update value for
+     * @param delta amount to be subtracted from the value
+     * @param value output parameter, value after decrement
+     */
+    virtual bool Decrement(const std::string &key, uint64_t delta, uint64_t &value) = 0;
+
     /**
      * Removes association for the given key
      * If requested key doesn't present in storage method returns false and
@@ -84,6 +257,255 @@ public:
      * @param value output parameter to copy value to
      */
     virtual bool Get(const std::string &key, std::string &value) const = 0;
+
+    /**
+     * Same as above, but also returns client flags of the item and its current version stamp to be
+     * used later by CompareAndSet
+     *
+     * @param key to retrive value for
+     * @param value output parameter to copy value to
+     * @param flags output parameter, client flags given to the item on store
+     * @param cas output parameter, unique 64-bit version stamp of the item
+     */
+    virtual bool Get(const std::string &key, std::string &value, uint32_t &flags, uint64_t &cas) const = 0;
+
+    /**
+     * Same as above, but instead of copying the value hands out immutable refcounted slice of it, so the
+     * value could be sent to the client straight from the storage memory. Slice stays valid and unchanged
+     * even if the item gets updated or deleted afterwards.
+     *
+     * Default implementation copies the value into a new slice
+     *
+     * @param key to retrive value for
+     * @param value output parameter, slice of the value
+     * @param flags output parameter, client flags given to the item on store
+     * @param cas output parameter, unique 64-bit version stamp of the item
+     */
+    virtual bool Get(const std::string &key, std::shared_ptr<const std::string> &value, uint32_t &flags,
+                     uint64_t &cas) const {
+        std::shared_ptr<std::string> copy = std::make_shared<std::string>();
+        if (!Get(key, *copy, flags, cas)) {
+            return false;
+        }
+        value = std::move(copy);
+        return true;
+    }
+
+    /**
+     * Same as above, but key comes with its hash already computed by Afina::Hash. Default implementation
+     * ignores the hash
+     *
+     * @param key to retrive value for
+     * @param hash of the key, see Afina::Hash
+     * @param value output parameter, slice of the value
+     * @param flags output parameter, client flags given to the item on store
+     * @param cas output parameter, unique 64-bit version stamp of the item
+     */
+    virtual bool Get(const std::string &key, uint64_t hash, std::shared_ptr<const std::string> &value,
+                     uint32_t &flags, uint64_t &cas) const {
+        return Get(key, value, flags, cas);
+    }
+
+    /**
+     * Same as Get, but also updates expiration time of the item, so hot items could be kept alive
+     * without sending values back
+     *
+     * @param key to retrive value for
+     * @param expire new expiration time, see Put
+     * @param value output parameter to copy value to
+     * @param flags output parameter, client flags of the item
+     * @param cas output parameter, unique 64-bit version stamp of the item
+     */
+    virtual bool GetAndTouch(const std::string &key, int32_t expire, std::string &value, uint32_t &flags,
+                             uint64_t &cas) = 0;
+
+    /**
+     * Same as above, but value is returned as a refcounted slice, see Get
+     */
+    virtual bool GetAndTouch(const std::string &key, int32_t expire, std::shared_ptr<const std::string> &value,
+                             uint32_t &flags, uint64_t &cas) {
+        std::shared_ptr<std::string> copy = std::make_shared<std::string>();
+        if (!GetAndTouch(key, expire, *copy, flags, cas)) {
+            return false;
+        }
+        value = std::move(copy);
+        return true;
+    }
+
+    /**
+     * Looks up a batch of keys at once. Implementation should take its locks at most once per batch and
+     * overlap lookups, so batch is cheaper than the same number of Get calls
+     *
+     * Default implementation calls Get for each key
+     *
+     * @param keys to retrive values for
+     * @param items output parameter, resized to the number of keys, i-th item is the result for i-th key
+     */
+    virtual void MultiGet(const std::vector<std::string> &keys, std::vector<Item> &items) const {
+        items.resize(keys.size());
+        for (size_t i = 0; i < keys.size(); i++) {
+            items[i].found = Get(keys[i], items[i].value, items[i].flags, items[i].cas);
+        }
+    }
+
+    /**
+     * Same as above, but keys come with their hashes already computed by Afina::Hash. Default implementation
+     * ignores hashes
+     *
+     * @param keys to retrive values for
+     * @param hashes of the keys, i-th hash is for the i-th key
+     * @param items output parameter, see above
+     */
+    virtual void MultiGet(const std::vector<std::string> &keys, const std::vector<uint64_t> &hashes,
+                          std::vector<Item> &items) const {
+        MultiGet(keys, items);
+    }
+
+    /**
+     * Stores a batch of key/value pairs at once, same as Put called for each pair in order. Value buffers
+     * get moved into the storage
+     *
+     * Default implementation calls Put for each pair
+     *
+     * @param keys to be associated with values
+     * @param values to be moved into the storage, must have the same size as keys
+     * @param flags opaque client flags given to every item
+     * @param expire expiration time of every item, see Put
+     * @return number of pairs stored
+     */
+    virtual size_t MultiPut(const std::vector<std::string> &keys, std::vector<std::string> &values, uint32_t flags = 0,
+                            int32_t expire = 0) {
+        size_t stored = 0;
+        for (size_t i = 0; i < keys.size(); i++) {
+            stored += Put(keys[i], std::move(values[i]), flags, expire) ? 1 : 0;
+        }
+        return stored;
+    }
+
+    /**
+     * Collects live items which keys start with the given prefix, in key order. Not every storage keeps
+     * keys ordered, such ones don't support prefix queries at all
+     *
+     * @param prefix of the keys to look for, empty prefix matches every key
+     * @param limit maximum number of items to collect
+     * @param keys output parameter, keys of found items get appended
+     * @param items output parameter, found items get appended in the same order
+     * @return false if storage doesn't support prefix queries
+     */
+    virtual bool Scan(const std::string &prefix, size_t limit, std::vector<std::string> &keys,
+                      std::vector<Item> &items) const {
+        return false;
+    }
+
+    /**
+     * Removes all the associations which keys start with the given prefix, so the whole key namespace
+     * could be invalidated at once
+     *
+     * @param prefix of the keys to be removed
+     * @param deleted output parameter, number of removed associations
+     * @return false if storage doesn't support prefix queries
+     */
+    virtual bool DeletePrefix(const std::string &prefix, size_t &deleted) { return false; }
+
+    /**
+     * Changes memory budget of running storage. Shrinking evicts entries down to the new budget before
+     * returning, without blocking other clients for the whole time
+     *
+     * @param max_size new budget in bytes
+     * @return false if storage has no adjustable budget or the new one is too small
+     */
+    virtual bool SetMaxSize(size_t max_size) { return false; }
+
+    /**
+     * Prepares storage to hold the given number of entries without growing its index
+     *
+     * @param count expected number of entries
+     * @return false if storage has no index capacity to adjust
+     */
+    virtual bool SetCapacity(size_t count) { return false; }
+
+    /**
+     * Starts writing all live items into snapshot file in background, clients are served meanwhile. Previous
+     * file stays intact until the new one is complete
+     *
+     * @param path of the snapshot file
+     * @return false if storage doesn't support snapshots or one is being written already
+     */
+    virtual bool Snapshot(const std::string &path) { return false; }
+
+    /**
+     * Restores items from snapshot file, must be done before clients are served. Items with the same keys
+     * get replaced
+     *
+     * @param path of the snapshot file
+     * @param threads number of threads decoding the file
+     * @return false if storage doesn't support snapshots, throws std::runtime_error if file can't be read
+     */
+    virtual bool LoadSnapshot(const std::string &path, size_t threads) { return false; }
+
+    /**
+     * Replays mutation log into the storage and starts appending every further change to it. Must be done
+     * before clients are served
+     *
+     * @param path of the log file, created if doesn't exist
+     * @param sync when log is synced to disk
+     * @param interval_ms sync period for LogSync::kInterval
+     * @return false if storage doesn't support logging, throws std::runtime_error if log can't be opened
+     */
+    virtual bool OpenLog(const std::string &path, LogSync sync, size_t interval_ms) { return false; }
+
+    /**
+     * Starts accepting replicas: each one gets all live items first and then every change as it happens.
+     * Replicas are fed from background threads, clients are served meanwhile
+     *
+     * @param port TCP port replicas connect to
+     * @return false if storage doesn't support replication, throws std::runtime_error if port can't be listened on
+     */
+    virtual bool ServeReplicas(uint16_t port) { return false; }
+
+    /**
+     * Makes storage a replica of the primary: storage is cleared, filled with primary items and then follows
+     * its changes. Lost connection is restored in background, with the full copy sent again
+     *
+     * @param host of the primary
+     * @param port primary accepts replicas on
+     * @return false if storage doesn't support replication
+     */
+    virtual bool ReplicateFrom(const std::string &host, uint16_t port) { return false; }
+
+    /**
+     * Calls done once all the changes made so far are as durable as log policy requires, that could happen
+     * right away or later from another thread. Reply to the client must be sent only after that
+     *
+     * @param done callback, must not block
+     */
+    virtual void WhenDurable(std::function<void()> done) const { done(); }
+
+    /**
+     * Reports storage counters, in the spirit of memcached "stats" command
+     *
+     * @param stats output parameter, name/value pairs get appended
+     */
+    virtual void GetStats(std::vector<std::pair<std::string, uint64_t>> &stats) const {}
+
+    /**
+     * Prepares destination buffer for the value of the given size. Network layer receives data block
+     * directly into the buffer and then commits it by one of rvalue Put/PutIfAbsent/Set calls, so the
+     * value bytes are written exactly once on the way from socket to storage.
+     *
+     * Previous content of the buffer is discarded. Size comes from the client, so storage checks it against
+     * its budget before anything is allocated
+     *
+     * @param size number of bytes in the value to be received
+     * @param value output parameter, resized to hold exactly size bytes
+     * @return false if value of that size could never be stored, buffer is left empty then and network
+     * layer must skip the data block
+     */
+    virtual bool Reserve(size_t size, std::string &value) const {
+        value.clear();
+        value.resize(size);
+        return true;
+    }
 };
 
 } // namespace Afina
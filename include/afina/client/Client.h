@@ -0,0 +1,145 @@
+#ifndef AFINA_CLIENT_CLIENT_H
+#define AFINA_CLIENT_CLIENT_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Afina {
+namespace Client {
+
+/**
+ * Item as client sees it
+ */
+struct Item {
+    std::string value;
+    uint32_t flags = 0;
+
+    // Cas unique, only filled by Gets and multi-key Get of binary protocol
+    uint64_t cas = 0;
+};
+
+/**
+ * Outcome of a command
+ */
+enum class Status {
+    // Stored, deleted, touched or found
+    kOk,
+
+    // No such key
+    kNotFound,
+
+    // add, replace, append or prepend conditions weren't met
+    kNotStored,
+
+    // Item has been modified since its cas unique was fetched
+    kExists,
+
+    // Server replied with error, is unavailable or hasn't replied in time
+    kError
+};
+
+/**
+ * Wire protocol spoken to servers
+ */
+enum class Encoding {
+    // memcached text protocol, afina speaks it
+    kText,
+
+    // memcached binary protocol
+    kBinary
+};
+
+struct Options {
+    // Servers keys are spread over, as <host>:<port>
+    std::vector<std::string> servers;
+
+    Encoding encoding = Encoding::kText;
+
+    // Connections kept to each server
+    size_t connections = 2;
+
+    // How long command waits for reply
+    std::chrono::milliseconds timeout{1000};
+
+    // Items kept in the process by near cache, 0 disables it
+    size_t near_cache_items = 0;
+
+    // How long item could be served from near cache. Changes made by other processes become visible once it
+    // passes, changes made through this client are seen right away
+    std::chrono::milliseconds near_cache_ttl{100};
+
+    // Unix socket of afina running on the same host, see its --local option. Once set, servers are ignored:
+    // every thread talks to that afina over shared memory rings of its own, text protocol only
+    std::string local;
+};
+
+/**
+ * # Memcached client
+ * Keys are spread over servers by the same consistent hash ring afina-proxy uses, so both route a key to the
+ * same server. Server which connection fails leaves the ring until it is reconnected.
+ *
+ * Client is thread safe and is meant to be shared. Commands of all threads are pipelined: each server has a
+ * small pool of connections, commands issued meanwhile are queued to them and written in batches, with one
+ * write per connection, by the client I/O thread. Multi-key get is split into one command per server, those
+ * run in parallel. Every call blocks until reply arrives or timeout passes.
+ *
+ * With local server given, there are no connections and no I/O thread: calling thread writes command straight
+ * into its shared memory channel and spins on it for the reply, which usually comes without any syscall.
+ */
+class Client {
+public:
+    /**
+     * Starts connecting to the servers, commands issued before connection is established wait for it
+     */
+    explicit Client(const Options &options);
+    ~Client();
+
+    Client(const Client &) = delete;
+    Client &operator=(const Client &) = delete;
+
+    /**
+     * Fetches single item, served from near cache if it is enabled
+     */
+    Status Get(const std::string &key, Item &item);
+
+    /**
+     * Fetches single item together with its cas unique, bypassing near cache
+     */
+    Status Gets(const std::string &key, Item &item);
+
+    /**
+     * Fetches several items with at most one command per server. Items found are put into the map. Returns
+     * kOk unless some server failed, items of the rest servers are there anyway
+     */
+    Status Get(const std::vector<std::string> &keys, std::unordered_map<std::string, Item> &items);
+
+    Status Set(const std::string &key, const std::string &value, uint32_t flags = 0, uint32_t exptime = 0);
+    Status Add(const std::string &key, const std::string &value, uint32_t flags = 0, uint32_t exptime = 0);
+    Status Replace(const std::string &key, const std::string &value, uint32_t flags = 0, uint32_t exptime = 0);
+    Status Append(const std::string &key, const std::string &value);
+    Status Prepend(const std::string &key, const std::string &value);
+    Status Cas(const std::string &key, const std::string &value, uint64_t cas, uint32_t flags = 0,
+               uint32_t exptime = 0);
+    Status Delete(const std::string &key);
+    Status Touch(const std::string &key, uint32_t exptime);
+
+    /**
+     * Changes counter, result is the new value
+     */
+    Status Incr(const std::string &key, uint64_t delta, uint64_t &result);
+    Status Decr(const std::string &key, uint64_t delta, uint64_t &result);
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> _impl;
+};
+
+} // namespace Client
+} // namespace Afina
+
+#endif // AFINA_CLIENT_CLIENT_H
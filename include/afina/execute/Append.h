@@ -24,7 +24,7 @@ public:
     Append(const std::string &key, uint32_t flags, int32_t expire) : InsertCommand(key, flags, expire) {}
     ~Append() {}
 
-    void Execute(Storage &storage, const std::string &args, std::string &out) override;
+    void Execute(Storage &storage, std::string &args, std::string &out) override;
 };
 
 } // namespace Execute
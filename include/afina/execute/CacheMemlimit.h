@@ -0,0 +1,37 @@
+#ifndef AFINA_EXECUTE_CACHE_MEMLIMIT_H
+#define AFINA_EXECUTE_CACHE_MEMLIMIT_H
+
+#include <cstdint>
+#include <string>
+
+#include "Command.h"
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Change memory budget of the running storage
+ * "cache_memlimit <megabytes>" as in memcached. Shrink evicts entries down to the new budget before reply,
+ * see Storage::SetMaxSize
+ *
+ * Command must write result to the output, which could be:
+ * - "OK" if budget has been changed
+ * - "SERVER_ERROR ..." if storage budget can't be changed to that value
+ */
+class CacheMemlimit : public Command {
+public:
+    CacheMemlimit(uint64_t megabytes) : _megabytes(megabytes) {}
+    ~CacheMemlimit() {}
+
+    inline uint64_t megabytes() const { return _megabytes; }
+
+    void Execute(Storage &storage, std::string &args, std::string &out) override;
+
+protected:
+    const uint64_t _megabytes;
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_CACHE_MEMLIMIT_H
@@ -0,0 +1,42 @@
+#ifndef AFINA_EXECUTE_CAS_H
+#define AFINA_EXECUTE_CAS_H
+
+#include <cstdint>
+#include <string>
+
+#include "InsertCommand.h"
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Check and set
+ * Store given value only if no one else has updated the item since client
+ * fetched it by "gets"
+ *
+ * Command must write result to the output, which could be:
+ * - "STORED", to indicate success.
+ * - "EXISTS" to indicate that the item has been modified since client
+ * fetched it
+ * - "NOT_FOUND" to indicate that the item does not exist or has been deleted
+ * - "NOT_STORED" to indicate the data was not stored, for example it is too
+ * big for the cache
+ */
+class Cas : public InsertCommand {
+public:
+    Cas(const std::string &key, uint32_t flags, int32_t expire, uint64_t cas)
+        : InsertCommand(key, flags, expire), _cas(cas) {}
+    ~Cas() {}
+
+    inline uint64_t cas() const { return _cas; }
+
+    void Execute(Storage &storage, std::string &args, std::string &out) override;
+
+protected:
+    const uint64_t _cas;
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_CAS_H
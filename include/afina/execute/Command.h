@@ -3,6 +3,8 @@
 
 #include <string>
 
+#include "Response.h"
+
 namespace Afina {
 
 class Storage;
@@ -15,10 +17,58 @@ namespace Execute {
  */
 class Command {
 public:
-    Command() {}
+    Command() : _noreply(false) {}
     virtual ~Command() {}
 
-    virtual void Execute(Storage &storage, const std::string &args, std::string &out) = 0;
+    /**
+     * Client asked server not to send any response back, network layer must drop command output
+     * unless execution fails
+     */
+    inline bool noreply() const { return _noreply; }
+    inline void SetNoreply(bool noreply) { _noreply = noreply; }
+
+    /**
+     * Runs command over the given storage and writes response into out.
+     *
+     * @param storage to execute command on
+     * @param args data block received for the command. Command may take ownership of the buffer
+     * content (move it into the storage), so caller must not rely on its value after the call
+     * @param out response to be sent back to the client
+     */
+    virtual void Execute(Storage &storage, std::string &args, std::string &out) = 0;
+
+    /**
+     * Same as above, but response is built out of fragments that could reference storage memory, so
+     * network layer could send them without copying. By default output of the method above is used
+     *
+     * @param storage to execute command on
+     * @param args data block received for the command, see above
+     * @param out response to be sent back to the client
+     */
+    virtual void Execute(Storage &storage, std::string &args, Response &out);
+
+    /**
+     * Command could produce its response in portions, so connection output stays within the budget, see
+     * Response::Full. Returns true if there is more output to be produced by Continue
+     */
+    virtual bool Pending() const { return false; }
+
+    /**
+     * Produces next portion of the response, network layer calls it once previous portion has been sent
+     *
+     * @param storage to execute command on
+     * @param out response to be sent back to the client
+     */
+    virtual void Continue(Storage &storage, Response &out) {}
+
+    /**
+     * Command could change the storage, so network layer holds its reply until changes are durable, see
+     * Storage::WhenDurable. Read only commands are replied right away
+     */
+    virtual bool Mutating() const { return true; }
+
+private:
+    bool _noreply;
 };
 
 } // namespace Execute
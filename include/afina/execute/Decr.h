@@ -0,0 +1,40 @@
+#ifndef AFINA_EXECUTE_DECR_H
+#define AFINA_EXECUTE_DECR_H
+
+#include <cstdint>
+#include <string>
+
+#include "Command.h"
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Decrement numeric value
+ * Subtracts given amount from the 64-bit unsigned integer value of the key.
+ * Value never goes below 0
+ *
+ * Command must write result to the output, which could be:
+ * - "<value>" new value of the item
+ * - "NOT_FOUND" to indicate that the item with this key was not found
+ * - "CLIENT_ERROR ..." in case if item value isn't a number
+ */
+class Decr : public Command {
+public:
+    Decr(const std::string &key, uint64_t value) : _key(key), _value(value) {}
+    ~Decr() {}
+
+    inline const std::string &key() const { return _key; }
+    inline uint64_t value() const { return _value; }
+
+    void Execute(Storage &storage, std::string &args, std::string &out) override;
+
+protected:
+    const std::string _key;
+    const uint64_t _value;
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_DECR_H
@@ -1,6 +1,8 @@
 #ifndef AFINA_EXECUTE_DELETE_H
 #define AFINA_EXECUTE_DELETE_H
 
+#include <string>
+
 #include "Command.h"
 
 namespace Afina {
@@ -17,10 +19,15 @@ namespace Execute {
  */
 class Delete : public Command {
 public:
-    Delete();
-    ~Delete();
+    Delete(const std::string &key) : _key(key) {}
+    ~Delete() {}
+
+    inline const std::string &key() const { return _key; }
+
+    void Execute(Storage &storage, std::string &args, std::string &out) override;
 
-    void Execute(Storage &storage, const std::string &args, std::string &out) override;
+protected:
+    const std::string _key;
 };
 
 } // namespace Execute
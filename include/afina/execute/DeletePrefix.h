@@ -0,0 +1,36 @@
+#ifndef AFINA_EXECUTE_DELETE_PREFIX_H
+#define AFINA_EXECUTE_DELETE_PREFIX_H
+
+#include <string>
+
+#include "Command.h"
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Remove all associations under the key prefix
+ * Drops every key starting with the given prefix at once, e.g. "delete_prefix user:123:" invalidates the
+ * whole user namespace. Requires storage with ordered keys, see Storage::DeletePrefix
+ *
+ * Command must write result to the output, which could be:
+ * - "DELETED <count>" where count is the number of removed keys, could be 0
+ * - "SERVER_ERROR ..." if storage doesn't support prefix operations
+ */
+class DeletePrefix : public Command {
+public:
+    DeletePrefix(const std::string &prefix) : _prefix(prefix) {}
+    ~DeletePrefix() {}
+
+    inline const std::string &prefix() const { return _prefix; }
+
+    void Execute(Storage &storage, std::string &args, std::string &out) override;
+
+protected:
+    const std::string _prefix;
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_DELETE_PREFIX_H
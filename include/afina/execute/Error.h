@@ -0,0 +1,31 @@
+#ifndef AFINA_EXECUTE_ERROR_H
+#define AFINA_EXECUTE_ERROR_H
+
+#include <string>
+
+#include "Command.h"
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Malformed command
+ * Complete line which doesn't make a command, e.g. one missing its arguments. Stream stays in sync,
+ * so the connection goes on.
+ *
+ * Command always writes "ERROR" to the output
+ */
+class Error : public Command {
+public:
+    Error() {}
+    ~Error() {}
+
+    void Execute(Storage &storage, std::string &args, std::string &out) override;
+
+    bool Mutating() const override { return false; }
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_ERROR_H
@@ -0,0 +1,40 @@
+#ifndef AFINA_EXECUTE_GAT_H
+#define AFINA_EXECUTE_GAT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Get.h"
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Retrive values and update their expiration time
+ * Works the same way as Get, but each found item gets new exptime
+ *
+ * "gat" responds as "get" and "gats" responds as "gets" does
+ */
+class Gat : public Get {
+public:
+    Gat(int32_t expire, const std::vector<std::string> &keys, bool with_cas = false)
+        : Get(keys, with_cas), _expire(expire) {}
+    ~Gat() {}
+
+    inline int32_t expire() const { return _expire; }
+
+    // New exptime goes to the mutation log as well
+    bool Mutating() const override { return true; }
+
+protected:
+    void Lookup(Storage &storage, size_t first, size_t count, std::vector<Storage::Item> &items) override;
+
+private:
+    const int32_t _expire;
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_GAT_H
@@ -1,9 +1,13 @@
 #ifndef AFINA_EXECUTE_GET_H
 #define AFINA_EXECUTE_GET_H
 
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include <afina/Storage.h>
+
 #include "Command.h"
 
 namespace Afina {
@@ -18,13 +22,18 @@ namespace Execute {
  * the items have been transmitted, the server sends the string
  *
  * Each item sent by the server looks like this:
- * VALUE <key> <bytes>\r\n
+ * VALUE <key> <flags> <bytes>\r\n
  * <data>\r\n
  * VALUE ....
  * END
  *
- * Where <key> is the key for the value, <bytes> is the number of bytes in the
- * value and <data> is the value text
+ * Where <key> is the key for the value, <flags> is the flags value set by the
+ * storage command, <bytes> is the number of bytes in the value and <data> is
+ * the value text
+ *
+ * For "gets" command each item header also carries unique version stamp of
+ * the item, that could be passed to "cas" later:
+ * VALUE <key> <flags> <bytes> <cas unique>\r\n
  *
  * If some of the keys appearing in a retrieval request are not sent back
  * by the server in the item list this means that the server does not
@@ -34,15 +43,52 @@ namespace Execute {
  */
 class Get : public Command {
 public:
-    Get(const std::vector<std::string> &keys) : _keys(keys) {}
+    Get(const std::vector<std::string> &keys, bool with_cas = false)
+        : _keys(keys), _with_cas(with_cas), _next(0), _looked_up(0), _pending(false) {}
+
+    /**
+     * @param hashes precomputed Afina::Hash of each key
+     */
+    Get(const std::vector<std::string> &keys, const std::vector<uint64_t> &hashes, bool with_cas = false)
+        : _keys(keys), _hashes(hashes), _with_cas(with_cas), _next(0), _looked_up(0), _pending(false) {}
     ~Get() {}
 
     inline const std::vector<std::string> &keys() const { return _keys; }
+    inline bool with_cas() const { return _with_cas; }
+
+    void Execute(Storage &storage, std::string &args, std::string &out) override;
+
+    void Execute(Storage &storage, std::string &args, Response &out) override;
+
+    bool Pending() const override { return _pending; }
 
-    void Execute(Storage &storage, const std::string &args, std::string &out) override;
+    void Continue(Storage &storage, Response &out) override;
+
+    bool Mutating() const override { return false; }
+
+    // Number of keys looked up at once
+    static const size_t kBatchSize = 16;
+
+protected:
+    // Fetches items for count keys starting from first out of the storage in one batch
+    virtual void Lookup(Storage &storage, size_t first, size_t count, std::vector<Storage::Item> &items);
 
 private:
     std::vector<std::string> _keys;
+
+    // Key hashes if parser has provided them, empty otherwise
+    std::vector<uint64_t> _hashes;
+
+    // Whenever item version stamps should be sent as well, i.e it is "gets"
+    bool _with_cas;
+
+    // Items are looked up by batches and written out while response budget allows, so big multi-get is
+    // streamed and holds at most one batch of values: items of the last batch, index of the next key to
+    // write, number of keys looked up so far and whenever END hasn't been written yet
+    std::vector<Storage::Item> _items;
+    size_t _next;
+    size_t _looked_up;
+    bool _pending;
 };
 
 } // namespace Execute
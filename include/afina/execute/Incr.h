@@ -0,0 +1,40 @@
+#ifndef AFINA_EXECUTE_INCR_H
+#define AFINA_EXECUTE_INCR_H
+
+#include <cstdint>
+#include <string>
+
+#include "Command.h"
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Increment numeric value
+ * Adds given amount to the 64-bit unsigned integer value of the key. Overflow
+ * wraps around
+ *
+ * Command must write result to the output, which could be:
+ * - "<value>" new value of the item
+ * - "NOT_FOUND" to indicate that the item with this key was not found
+ * - "CLIENT_ERROR ..." in case if item value isn't a number
+ */
+class Incr : public Command {
+public:
+    Incr(const std::string &key, uint64_t value) : _key(key), _value(value) {}
+    ~Incr() {}
+
+    inline const std::string &key() const { return _key; }
+    inline uint64_t value() const { return _value; }
+
+    void Execute(Storage &storage, std::string &args, std::string &out) override;
+
+protected:
+    const std::string _key;
+    const uint64_t _value;
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_INCR_H
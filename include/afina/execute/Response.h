@@ -0,0 +1,117 @@
+#ifndef AFINA_EXECUTE_RESPONSE_H
+#define AFINA_EXECUTE_RESPONSE_H
+
+#include <cstddef>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <string>
+
+#include <sys/uio.h>
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Command response
+ * Sequence of byte fragments to be sent back to the client. Fragment is either a piece of text owned by the
+ * response or an immutable value slice shared with the storage, so values are never copied on the way to the
+ * socket. Network layer takes fragments out by Gather and sends them with a single writev/sendmsg call.
+ *
+ * Response could have a budget: commands with a lot of output (i.e multi-get) stop producing once the budget
+ * is reached and continue after network layer drained the response, see Command::Continue.
+ */
+class Response {
+public:
+    Response(size_t budget = std::numeric_limits<size_t>::max()) : _offset(0), _size(0), _budget(budget) {}
+    ~Response() {}
+
+    /**
+     * Adds text to the end of response, text is copied. Consecutive text gets merged into one fragment
+     */
+    void Append(const std::string &text) { Append(text.data(), text.size()); }
+    void Append(const char *text, size_t size);
+
+    /**
+     * Adds value slice to the end of response, slice is referenced, not copied
+     */
+    void Append(std::shared_ptr<const std::string> slice);
+
+    /**
+     * Moves unsent fragments of other response to the end of this one, other gets empty
+     */
+    void Append(Response &&other);
+
+    /**
+     * Number of bytes still to be sent
+     */
+    inline size_t Size() const { return _size; }
+    inline bool Empty() const { return _size == 0; }
+
+    /**
+     * Whenever output budget has been reached, command should stop producing output until response
+     * gets drained
+     */
+    inline bool Full() const { return _size >= _budget; }
+
+    /**
+     * Number of unsent fragments
+     */
+    inline size_t Count() const { return _fragments.size(); }
+
+    /**
+     * Fills iovec array by unsent fragments
+     *
+     * @param iov array to be filled
+     * @param max size of the array
+     * @return number of filled entries
+     */
+    size_t Gather(struct iovec *iov, size_t max) const;
+
+    /**
+     * Same as above, slices array gets value slice each entry points into, null for text. Slice is immutable
+     * and lives as long as somebody holds it, so its memory could be handed to the kernel by reference
+     */
+    size_t Gather(struct iovec *iov, std::shared_ptr<const std::string> *slices, size_t max) const;
+
+    /**
+     * Marks first bytes of response as sent, fully sent fragments are released
+     *
+     * @param size number of bytes sent
+     */
+    void Consume(size_t size);
+
+    /**
+     * Drops all fragments, budget stays the same
+     */
+    void Clear();
+
+    /**
+     * Copies unsent bytes into a single string
+     */
+    std::string ToString() const;
+
+private:
+    struct Fragment {
+        // Owned text, used if slice is empty
+        std::string text;
+        std::shared_ptr<const std::string> slice;
+
+        const std::string &Data() const { return slice ? *slice : text; }
+    };
+
+    std::deque<Fragment> _fragments;
+
+    // Bytes of the first fragment that are already sent
+    size_t _offset;
+
+    size_t _size;
+
+    // Soft limit on number of bytes in response
+    size_t _budget;
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_RESPONSE_H
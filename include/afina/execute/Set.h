@@ -4,6 +4,8 @@
 #include <cstdint>
 #include <string>
 
+#include <afina/Hash.h>
+
 #include "InsertCommand.h"
 
 namespace Afina {
@@ -21,10 +23,20 @@ namespace Execute {
  */
 class Set : public InsertCommand {
 public:
-    Set(const std::string &key, uint32_t flags, int32_t expire) : InsertCommand(key, flags, expire) {}
+    Set(const std::string &key, uint32_t flags, int32_t expire)
+        : InsertCommand(key, flags, expire), _hash(Hash(key)) {}
+
+    /**
+     * @param hash precomputed Afina::Hash of the key
+     */
+    Set(const std::string &key, uint32_t flags, int32_t expire, uint64_t hash)
+        : InsertCommand(key, flags, expire), _hash(hash) {}
     ~Set() {}
 
-    void Execute(Storage &storage, const std::string &args, std::string &out) override;
+    void Execute(Storage &storage, std::string &args, std::string &out) override;
+
+private:
+    const uint64_t _hash;
 };
 
 } // namespace Execute
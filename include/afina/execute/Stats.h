@@ -12,7 +12,8 @@ class Stats : public Command {
 public:
     Stats() {}
     ~Stats() {}
-    void Execute(Storage &storage, const std::string &args, std::string &out) override;
+    void Execute(Storage &storage, std::string &args, std::string &out) override;
+    bool Mutating() const override { return false; }
 };
 
 } // namespace Execute
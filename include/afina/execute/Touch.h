@@ -0,0 +1,38 @@
+#ifndef AFINA_EXECUTE_TOUCH_H
+#define AFINA_EXECUTE_TOUCH_H
+
+#include <cstdint>
+#include <string>
+
+#include "Command.h"
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Update expiration time of the item
+ * Sets new exptime for the existing item without fetching it
+ *
+ * Command must write result to the output, which could be:
+ * - "TOUCHED" to indicate success
+ * - "NOT_FOUND" to indicate that the item with this key was not found
+ */
+class Touch : public Command {
+public:
+    Touch(const std::string &key, int32_t expire) : _key(key), _expire(expire) {}
+    ~Touch() {}
+
+    inline const std::string &key() const { return _key; }
+    inline int32_t expire() const { return _expire; }
+
+    void Execute(Storage &storage, std::string &args, std::string &out) override;
+
+protected:
+    const std::string _key;
+    const int32_t _expire;
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_TOUCH_H
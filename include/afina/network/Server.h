@@ -1,7 +1,9 @@
 #ifndef AFINA_NETWORK_SERVER_H
 #define AFINA_NETWORK_SERVER_H
 
+#include <cstdint>
 #include <memory>
+#include <stdexcept>
 #include <vector>
 
 namespace Afina {
@@ -24,6 +26,23 @@ public:
      */
     virtual void Start(uint32_t port, uint16_t workers = 1) = 0;
 
+    /**
+     * Starts network service on listening sockets taken over from another process, e.g. during binary
+     * upgrade, instead of binding new ones. Server owns sockets once method returns. There is at least
+     * one worker per socket, so none of them is left without accepting.
+     *
+     * Throws std::runtime_error if server can't do that
+     */
+    virtual void Start(const std::vector<int> &sockets, uint16_t workers = 1) {
+        throw std::runtime_error("Server can't take over listening sockets");
+    }
+
+    /**
+     * Listening sockets server accepts connections on, to be passed over to the new process. Empty if
+     * server can't hand them off. Sockets stay owned by the server
+     */
+    virtual std::vector<int> ListenSockets() const { return {}; }
+
     /**
      * Signal all worker threads that server is going to shutdown. After method returns
      * no more connections should be accept, existing connections should stop receive commands,
@@ -0,0 +1,219 @@
+#include "Codec.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace Afina {
+namespace Client {
+
+namespace {
+
+const uint8_t kRequest = 0x80;
+const uint8_t kResponse = 0x81;
+
+// Opcodes
+const uint8_t kSet = 0x01;
+const uint8_t kAdd = 0x02;
+const uint8_t kReplace = 0x03;
+const uint8_t kDelete = 0x04;
+const uint8_t kIncrement = 0x05;
+const uint8_t kDecrement = 0x06;
+const uint8_t kNoop = 0x0a;
+const uint8_t kGetKQ = 0x0d;
+const uint8_t kAppend = 0x0e;
+const uint8_t kPrepend = 0x0f;
+const uint8_t kTouch = 0x1c;
+
+// Response statuses
+const uint16_t kNoError = 0x0000;
+const uint16_t kKeyNotFound = 0x0001;
+const uint16_t kKeyExists = 0x0002;
+const uint16_t kItemNotStored = 0x0005;
+
+// Largest body accepted, memcached items are 1MB by default
+const uint32_t kMaxBody = 1 << 30;
+
+void Put(std::string &out, uint64_t value, size_t bytes) {
+    for (size_t i = bytes; i > 0; i--) {
+        out += char((value >> ((i - 1) * 8)) & 0xff);
+    }
+}
+
+uint64_t Take(const std::string &in, size_t position, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        value = (value << 8) | uint8_t(in[position + i]);
+    }
+    return value;
+}
+
+void Packet(std::string &out, uint8_t opcode, const std::string &key, const std::string &extras,
+            const std::string &value, uint64_t cas) {
+    out += char(kRequest);
+    out += char(opcode);
+    Put(out, key.size(), 2);
+    out += char(extras.size());
+    out += char(0);
+    Put(out, 0, 2);
+    Put(out, extras.size() + key.size() + value.size(), 4);
+    Put(out, 0, 4);
+    Put(out, cas, 8);
+    out += extras;
+    out += key;
+    out += value;
+}
+
+} // namespace
+
+const size_t BinaryCodec::kHeaderSize;
+
+// See Codec.h
+void BinaryCodec::Encode(const Call &call, std::string &out) const {
+    std::string extras;
+    switch (call.op) {
+    case Call::Op::kGet:
+    case Call::Op::kGets:
+        for (auto &key : call.keys) {
+            Packet(out, kGetKQ, key, extras, std::string(), 0);
+        }
+        Packet(out, kNoop, std::string(), extras, std::string(), 0);
+        break;
+
+    case Call::Op::kSet:
+    case Call::Op::kAdd:
+    case Call::Op::kReplace:
+    case Call::Op::kCas: {
+        Put(extras, call.flags, 4);
+        Put(extras, call.exptime, 4);
+        uint8_t opcode = call.op == Call::Op::kAdd ? kAdd : call.op == Call::Op::kReplace ? kReplace : kSet;
+        Packet(out, opcode, call.keys[0], extras, call.value, call.op == Call::Op::kCas ? call.number : 0);
+        break;
+    }
+
+    case Call::Op::kAppend:
+    case Call::Op::kPrepend:
+        Packet(out, call.op == Call::Op::kAppend ? kAppend : kPrepend, call.keys[0], extras, call.value, 0);
+        break;
+
+    case Call::Op::kDelete:
+        Packet(out, kDelete, call.keys[0], extras, std::string(), 0);
+        break;
+
+    case Call::Op::kIncr:
+    case Call::Op::kDecr:
+        // Expiration of all ones tells server not to create missing counter, as text protocol does
+        Put(extras, call.number, 8);
+        Put(extras, 0, 8);
+        Put(extras, 0xffffffff, 4);
+        Packet(out, call.op == Call::Op::kIncr ? kIncrement : kDecrement, call.keys[0], extras, std::string(), 0);
+        break;
+
+    case Call::Op::kTouch:
+        Put(extras, call.exptime, 4);
+        Packet(out, kTouch, call.keys[0], extras, std::string(), 0);
+        break;
+    }
+}
+
+// See Codec.h
+void BinaryCodec::Expect(Call *call) {
+    _call = call;
+    _packet.clear();
+
+    // Get stays successful unless some key gets an error other than a miss
+    call->status = Status::kOk;
+}
+
+// See Codec.h
+bool BinaryCodec::Decode(const char *input, size_t size, size_t &parsed) {
+    parsed = 0;
+    for (;;) {
+        size_t need = kHeaderSize;
+        if (_packet.size() >= kHeaderSize) {
+            if (uint8_t(_packet[0]) != kResponse) {
+                throw std::runtime_error("Bad response magic");
+            }
+            uint64_t body = Take(_packet, 8, 4);
+            if (body > kMaxBody) {
+                throw std::runtime_error("Response body is too large");
+            }
+            need += body;
+        }
+
+        if (_packet.size() < need) {
+            if (parsed == size) {
+                return false;
+            }
+            size_t take = std::min(need - _packet.size(), size - parsed);
+            _packet.append(input + parsed, take);
+            parsed += take;
+            continue;
+        }
+
+        bool complete = Interpret();
+        _packet.clear();
+        if (complete) {
+            return true;
+        }
+    }
+}
+
+bool BinaryCodec::Interpret() {
+    Call &call = *_call;
+    uint8_t opcode = _packet[1];
+    size_t key_size = Take(_packet, 2, 2);
+    size_t extras_size = uint8_t(_packet[4]);
+    uint16_t status = Take(_packet, 6, 2);
+    uint64_t cas = Take(_packet, 16, 8);
+    if (kHeaderSize + extras_size + key_size > _packet.size()) {
+        throw std::runtime_error("Malformed response");
+    }
+
+    if (call.op == Call::Op::kGet || call.op == Call::Op::kGets) {
+        if (opcode == kNoop) {
+            return true;
+        }
+        if (opcode != kGetKQ) {
+            throw std::runtime_error("Unexpected response opcode");
+        }
+        if (status == kNoError && extras_size >= 4) {
+            Item item;
+            item.flags = uint32_t(Take(_packet, kHeaderSize, 4));
+            item.cas = cas;
+            size_t value = kHeaderSize + extras_size + key_size;
+            item.value = _packet.substr(value);
+            call.items.emplace_back(_packet.substr(kHeaderSize + extras_size, key_size), std::move(item));
+        } else if (status != kKeyNotFound) {
+            call.status = Status::kError;
+        }
+        return false;
+    }
+
+    bool storage = call.op == Call::Op::kAdd || call.op == Call::Op::kReplace || call.op == Call::Op::kAppend ||
+                   call.op == Call::Op::kPrepend;
+    if (status == kNoError) {
+        call.status = Status::kOk;
+        if (call.op == Call::Op::kIncr || call.op == Call::Op::kDecr) {
+            size_t value = kHeaderSize + extras_size + key_size;
+            if (_packet.size() - value != 8) {
+                throw std::runtime_error("Malformed counter response");
+            }
+            call.counter = Take(_packet, value, 8);
+        }
+    } else if (storage && (status == kKeyNotFound || status == kKeyExists || status == kItemNotStored)) {
+        // Text protocol tells NOT_STORED for all of these
+        call.status = Status::kNotStored;
+    } else if (status == kKeyNotFound) {
+        call.status = Status::kNotFound;
+    } else if (status == kKeyExists) {
+        call.status = Status::kExists;
+    } else if (status == kItemNotStored) {
+        call.status = Status::kNotStored;
+    } else {
+        call.status = Status::kError;
+    }
+    return true;
+}
+
+} // namespace Client
+} // namespace Afina
@@ -0,0 +1,896 @@
+#include <afina/client/Client.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "network/shm/Channel.h"
+#include "protocol/Ring.h"
+
+#include "Codec.h"
+#include "NearCache.h"
+
+namespace Afina {
+namespace Client {
+
+/**
+ * Connections and the I/O thread serving them. Callers queue calls to connections and wait for them to be
+ * done; I/O thread writes everything queued since its last pass at once and decodes replies as they come.
+ *
+ * Local server is served by calling threads themselves, each over shared memory channel of its own
+ */
+class Client::Impl {
+public:
+    explicit Impl(const Options &options);
+    ~Impl();
+
+    /**
+     * Runs single-key call on the server owning its key, returns its outcome
+     */
+    Status Execute(const std::shared_ptr<Call> &call);
+
+    /**
+     * Runs one get per server owning some of the keys, found items are put into the map
+     */
+    Status MultiGet(const std::vector<std::string> &keys, std::unordered_map<std::string, Item> &items);
+
+    /**
+     * Runs call changing its key. Near cache copy is dropped before, so this thread doesn't see it anymore,
+     * and after, so concurrent fetch doesn't bring old value back
+     */
+    Status Change(const std::shared_ptr<Call> &call);
+
+    // Nullptr unless near cache is enabled
+    std::unique_ptr<NearCache> near;
+
+private:
+    // Pause before failed server is reconnected
+    static const size_t kRetryMs = 1000;
+
+    struct Connection {
+        size_t server;
+        std::unique_ptr<Codec> codec;
+
+        // Connected and could take calls, guarded by the lock
+        bool up;
+
+        // Calls not sent yet, guarded by the lock
+        std::deque<std::shared_ptr<Call>> queued;
+
+        // Everything below belongs to the I/O thread
+        int socket;
+        bool connecting;
+        uint32_t events;
+
+        // Calls sent and waiting for replies, in order
+        std::deque<std::shared_ptr<Call>> inflight;
+        std::string output;
+    };
+
+    struct Local {
+        std::unique_ptr<Network::Shm::Channel> channel;
+        TextCodec codec;
+    };
+
+    struct Server {
+        std::string name;
+
+        // Whenever server is on the ring, guarded by the lock
+        bool alive;
+
+        // Connection next call goes to, guarded by the lock
+        size_t next;
+
+        std::vector<Connection *> pool;
+        std::chrono::steady_clock::time_point retry;
+    };
+
+    // Queues call to one of the connections of the server, call is done at once if server is down
+    void Submit(size_t server, const std::shared_ptr<Call> &call);
+
+    // Blocks until all the calls are done or timeout passes, returns false in the latter case
+    bool Wait(const std::vector<std::shared_ptr<Call>> &calls);
+
+    void OnRun();
+    void OnEvent(Connection *connection, uint32_t events);
+
+    // Moves queued calls to their connections output
+    void Drain();
+    void Flush(Connection *connection);
+
+    // Marks calls done and wakes up waiters
+    void Finish(std::vector<std::shared_ptr<Call>> &calls);
+
+    void Connect(Connection *connection);
+    void Fail(Connection *connection);
+
+    // Lock must be held
+    void Rebuild();
+
+    void Watch(Connection *connection, uint32_t events);
+
+    // Runs call over channel of the calling thread, channel is attached on first use
+    Status RunLocal(Call &call);
+    Local *LocalChannel();
+    void DropLocal();
+
+    const Options _options;
+
+    std::mutex _mutex;
+    std::condition_variable _done;
+    Protocol::Ring _ring;
+    std::vector<std::unique_ptr<Server>> _servers;
+    std::vector<std::unique_ptr<Connection>> _connections;
+
+    // I/O thread has been woken up and hasn't drained queues yet, guarded by the lock
+    bool _wakeup_pending;
+
+    int _epoll_fd;
+    int _wakeup_fd;
+    std::atomic<bool> _running;
+    std::thread _thread;
+
+    // Channels of threads which have used local server, guarded by the lock. Thread finds its own one without
+    // locking by the cache, which is valid while it refers to this client
+    std::unordered_map<std::thread::id, std::unique_ptr<Local>> _locals;
+    const uint64_t _id;
+    static std::atomic<uint64_t> _last_id;
+    static thread_local uint64_t _cached_id;
+    static thread_local Local *_cached_local;
+};
+
+const size_t Client::Impl::kRetryMs;
+std::atomic<uint64_t> Client::Impl::_last_id{0};
+thread_local uint64_t Client::Impl::_cached_id = 0;
+thread_local Client::Impl::Local *Client::Impl::_cached_local = nullptr;
+
+Client::Impl::Impl(const Options &options)
+    : _options(options), _wakeup_pending(false), _epoll_fd(-1), _wakeup_fd(-1), _running(true), _id(++_last_id) {
+    if (_options.servers.empty() && _options.local.empty()) {
+        throw std::runtime_error("No servers given");
+    }
+    if (_options.near_cache_items > 0) {
+        near.reset(new NearCache(_options.near_cache_items, _options.near_cache_ttl));
+    }
+    if (!_options.local.empty()) {
+        return;
+    }
+
+    for (size_t server = 0; server < _options.servers.size(); server++) {
+        _servers.emplace_back(new Server{_options.servers[server], true, 0, {}, {}});
+        for (size_t i = 0; i < std::max<size_t>(_options.connections, 1); i++) {
+            Connection *connection = new Connection();
+            connection->server = server;
+            if (_options.encoding == Encoding::kBinary) {
+                connection->codec.reset(new BinaryCodec());
+            } else {
+                connection->codec.reset(new TextCodec());
+            }
+            connection->up = false;
+            connection->socket = -1;
+            connection->connecting = false;
+            connection->events = 0;
+            _connections.emplace_back(connection);
+            _servers.back()->pool.push_back(connection);
+        }
+    }
+    Rebuild();
+
+    _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (_epoll_fd < 0) {
+        throw std::runtime_error("Can't create epoll context");
+    }
+    _wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_wakeup_fd < 0) {
+        close(_epoll_fd);
+        throw std::runtime_error("Can't create wakeup eventfd");
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _wakeup_fd, &event);
+
+    _thread = std::thread(&Impl::OnRun, this);
+}
+
+Client::Impl::~Impl() {
+    if (!_thread.joinable()) {
+        return;
+    }
+
+    _running.store(false);
+    uint64_t wakeup = 1;
+    if (write(_wakeup_fd, &wakeup, sizeof(wakeup)) < 0) {
+        std::cerr << "Can't wake client I/O thread up" << std::endl;
+    }
+    _thread.join();
+
+    for (auto &connection : _connections) {
+        if (connection->socket >= 0) {
+            close(connection->socket);
+        }
+    }
+    close(_wakeup_fd);
+    close(_epoll_fd);
+}
+
+Status Client::Impl::Execute(const std::shared_ptr<Call> &call) {
+    if (!_options.local.empty()) {
+        return RunLocal(*call);
+    }
+
+    int server;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        server = _ring.Find(call->keys[0]);
+    }
+    if (server < 0) {
+        return Status::kError;
+    }
+
+    Submit(server, call);
+    if (!Wait({call})) {
+        return Status::kError;
+    }
+    return call->status;
+}
+
+Status Client::Impl::MultiGet(const std::vector<std::string> &keys, std::unordered_map<std::string, Item> &items) {
+    if (!_options.local.empty()) {
+        Call call;
+        call.op = Call::Op::kGet;
+        call.keys = keys;
+        Status status = RunLocal(call);
+        for (auto &item : call.items) {
+            items[item.first] = std::move(item.second);
+        }
+        return status;
+    }
+
+    std::vector<std::shared_ptr<Call>> calls(_servers.size());
+    bool routed = true;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        for (auto &key : keys) {
+            int server = _ring.Find(key);
+            if (server < 0) {
+                routed = false;
+                continue;
+            }
+            if (!calls[server]) {
+                calls[server] = std::make_shared<Call>();
+                calls[server]->op = Call::Op::kGet;
+            }
+            calls[server]->keys.push_back(key);
+        }
+    }
+
+    std::vector<std::shared_ptr<Call>> submitted;
+    for (size_t server = 0; server < calls.size(); server++) {
+        if (calls[server]) {
+            Submit(server, calls[server]);
+            submitted.push_back(calls[server]);
+        }
+    }
+    if (!Wait(submitted)) {
+        return Status::kError;
+    }
+
+    Status status = routed ? Status::kOk : Status::kError;
+    for (auto &call : submitted) {
+        if (call->status != Status::kOk) {
+            status = Status::kError;
+        }
+        for (auto &item : call->items) {
+            items[item.first] = std::move(item.second);
+        }
+    }
+    return status;
+}
+
+Status Client::Impl::Change(const std::shared_ptr<Call> &call) {
+    if (near) {
+        near->Erase(call->keys[0]);
+    }
+    Status status = Execute(call);
+    if (near) {
+        near->Erase(call->keys[0]);
+    }
+    return status;
+}
+
+void Client::Impl::Submit(size_t server, const std::shared_ptr<Call> &call) {
+    bool wakeup = false;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        Server &owner = *_servers[server];
+        if (!owner.alive) {
+            call->status = Status::kError;
+            call->done = true;
+            return;
+        }
+
+        // Until connections are up calls wait in their queues, then connections which are up are preferred
+        Connection *connection = owner.pool[owner.next++ % owner.pool.size()];
+        for (size_t i = 0; i < owner.pool.size() && !connection->up; i++) {
+            connection = owner.pool[owner.next++ % owner.pool.size()];
+        }
+        connection->queued.push_back(call);
+
+        // Calls coming while I/O thread is busy are picked up by its next pass together
+        if (!_wakeup_pending) {
+            _wakeup_pending = true;
+            wakeup = true;
+        }
+    }
+
+    uint64_t value = 1;
+    if (wakeup && write(_wakeup_fd, &value, sizeof(value)) < 0) {
+        std::cerr << "Can't wake client I/O thread up" << std::endl;
+    }
+}
+
+bool Client::Impl::Wait(const std::vector<std::shared_ptr<Call>> &calls) {
+    auto deadline = std::chrono::steady_clock::now() + _options.timeout;
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _done.wait_until(lock, deadline, [&calls] {
+        for (auto &call : calls) {
+            if (!call->done) {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+void Client::Impl::OnRun() {
+    for (auto &connection : _connections) {
+        Connect(connection.get());
+    }
+
+    const int max_events = 64;
+    struct epoll_event events[max_events];
+    while (_running.load()) {
+        int count = epoll_wait(_epoll_fd, events, max_events, kRetryMs / 10);
+        if (count < 0 && errno != EINTR) {
+            std::cerr << "Client epoll_wait failed: " << strerror(errno) << std::endl;
+            break;
+        }
+
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.ptr == nullptr) {
+                uint64_t value;
+                if (read(_wakeup_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+                    std::cerr << "Can't read client wakeup eventfd" << std::endl;
+                }
+            } else {
+                OnEvent(static_cast<Connection *>(events[i].data.ptr), events[i].events);
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        for (auto &connection : _connections) {
+            if (connection->socket < 0 && now >= _servers[connection->server]->retry) {
+                Connect(connection.get());
+            }
+        }
+
+        Drain();
+    }
+
+    // Nobody is going to get replies anymore
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (auto &connection : _connections) {
+        for (auto &call : connection->queued) {
+            call->done = true;
+        }
+        for (auto &call : connection->inflight) {
+            call->done = true;
+        }
+    }
+    _done.notify_all();
+}
+
+void Client::Impl::OnEvent(Connection *connection, uint32_t events) {
+    if (connection->socket < 0) {
+        return;
+    }
+
+    if (connection->connecting) {
+        int error = 0;
+        socklen_t size = sizeof(error);
+        if (getsockopt(connection->socket, SOL_SOCKET, SO_ERROR, &error, &size) != 0 || error != 0) {
+            Fail(connection);
+            return;
+        }
+        connection->connecting = false;
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        connection->up = true;
+        Server &server = *_servers[connection->server];
+        if (!server.alive) {
+            server.alive = true;
+            Rebuild();
+        }
+        lock.unlock();
+        Watch(connection, EPOLLIN);
+        return;
+    }
+
+    if (events & EPOLLOUT) {
+        Flush(connection);
+    }
+    if (connection->socket < 0 || (events & (EPOLLIN | EPOLLERR | EPOLLHUP)) == 0) {
+        return;
+    }
+
+    std::vector<std::shared_ptr<Call>> finished;
+    char chunk[64 << 10];
+    for (;;) {
+        ssize_t got = recv(connection->socket, chunk, sizeof(chunk), 0);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (got <= 0) {
+            Finish(finished);
+            Fail(connection);
+            return;
+        }
+
+        size_t position = 0;
+        while (position < size_t(got)) {
+            if (connection->inflight.empty()) {
+                std::cerr << "Unexpected reply from " << _servers[connection->server]->name << std::endl;
+                Finish(finished);
+                Fail(connection);
+                return;
+            }
+
+            size_t parsed;
+            bool complete;
+            try {
+                complete = connection->codec->Decode(chunk + position, got - position, parsed);
+            } catch (std::runtime_error &ex) {
+                std::cerr << "Bad reply from " << _servers[connection->server]->name << ": " << ex.what()
+                          << std::endl;
+                Finish(finished);
+                Fail(connection);
+                return;
+            }
+            position += parsed;
+            if (!complete) {
+                break;
+            }
+
+            finished.push_back(std::move(connection->inflight.front()));
+            connection->inflight.pop_front();
+            if (!connection->inflight.empty()) {
+                connection->codec->Expect(connection->inflight.front().get());
+            }
+        }
+
+        if (size_t(got) < sizeof(chunk)) {
+            break;
+        }
+    }
+    Finish(finished);
+}
+
+void Client::Impl::Drain() {
+    std::vector<std::pair<Connection *, std::deque<std::shared_ptr<Call>>>> batches;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _wakeup_pending = false;
+        for (auto &connection : _connections) {
+            if (connection->up && !connection->queued.empty()) {
+                batches.emplace_back(connection.get(), std::deque<std::shared_ptr<Call>>());
+                batches.back().second.swap(connection->queued);
+            }
+        }
+    }
+
+    for (auto &batch : batches) {
+        Connection *connection = batch.first;
+        bool idle = connection->inflight.empty();
+        for (auto &call : batch.second) {
+            connection->codec->Encode(*call, connection->output);
+            connection->inflight.push_back(std::move(call));
+        }
+        if (idle) {
+            connection->codec->Expect(connection->inflight.front().get());
+        }
+        Flush(connection);
+    }
+}
+
+void Client::Impl::Flush(Connection *connection) {
+    size_t written = 0;
+    while (written < connection->output.size()) {
+        ssize_t sent = send(connection->socket, connection->output.data() + written,
+                            connection->output.size() - written, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (sent <= 0) {
+            Fail(connection);
+            return;
+        }
+        written += sent;
+    }
+    connection->output.erase(0, written);
+    Watch(connection, EPOLLIN | (connection->output.empty() ? 0u : uint32_t(EPOLLOUT)));
+}
+
+void Client::Impl::Finish(std::vector<std::shared_ptr<Call>> &calls) {
+    if (calls.empty()) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (auto &call : calls) {
+        call->done = true;
+    }
+    _done.notify_all();
+    calls.clear();
+}
+
+void Client::Impl::Connect(Connection *connection) {
+    Server &server = *_servers[connection->server];
+    server.retry = std::chrono::steady_clock::now() + std::chrono::milliseconds(kRetryMs);
+
+    size_t colon = server.name.rfind(':');
+    std::string host = server.name.substr(0, colon);
+    std::string port = colon == std::string::npos ? "11211" : server.name.substr(colon + 1);
+
+    struct addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *address = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &address) != 0) {
+        Fail(connection);
+        return;
+    }
+
+    int socket = ::socket(address->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (socket < 0) {
+        freeaddrinfo(address);
+        Fail(connection);
+        return;
+    }
+    int on = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    int rc = connect(socket, address->ai_addr, address->ai_addrlen);
+    freeaddrinfo(address);
+    connection->socket = socket;
+    connection->events = 0;
+    if (rc != 0 && errno != EINPROGRESS) {
+        Fail(connection);
+        return;
+    }
+
+    connection->connecting = true;
+    Watch(connection, EPOLLOUT);
+}
+
+// Calls which could have reached the server fail as well, as nobody knows whenever they were applied
+void Client::Impl::Fail(Connection *connection) {
+    if (connection->socket >= 0) {
+        epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, connection->socket, nullptr);
+        close(connection->socket);
+        connection->socket = -1;
+    }
+    connection->connecting = false;
+    connection->output.clear();
+
+    Server &server = *_servers[connection->server];
+    server.retry = std::chrono::steady_clock::now() + std::chrono::milliseconds(kRetryMs);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (auto &call : connection->inflight) {
+        call->status = Status::kError;
+        call->done = true;
+    }
+    connection->inflight.clear();
+    for (auto &call : connection->queued) {
+        call->status = Status::kError;
+        call->done = true;
+    }
+    connection->queued.clear();
+
+    connection->up = false;
+    if (server.alive) {
+        std::cerr << "Server " << server.name << " is unavailable" << std::endl;
+        server.alive = false;
+        Rebuild();
+    }
+    _done.notify_all();
+}
+
+void Client::Impl::Rebuild() {
+    std::vector<bool> alive;
+    for (auto &server : _servers) {
+        alive.push_back(server->alive);
+    }
+    _ring.Build(_options.servers, alive);
+}
+
+void Client::Impl::Watch(Connection *connection, uint32_t events) {
+    if (connection->events == events) {
+        return;
+    }
+
+    struct epoll_event event;
+    event.events = events;
+    event.data.ptr = connection;
+    int op = connection->events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    if (epoll_ctl(_epoll_fd, op, connection->socket, &event) != 0) {
+        throw std::runtime_error(std::string("Can't poll socket: ") + strerror(errno));
+    }
+    connection->events = events;
+}
+
+Status Client::Impl::RunLocal(Call &call) {
+    Local *local = LocalChannel();
+    if (local == nullptr) {
+        return Status::kError;
+    }
+
+    std::string output;
+    local->codec.Encode(call, output);
+    local->codec.Expect(&call);
+
+    auto deadline = std::chrono::steady_clock::now() + _options.timeout;
+    size_t sent = 0;
+    char chunk[16 << 10];
+    for (;;) {
+        if (sent < output.size()) {
+            sent += local->channel->Send(output.data() + sent, output.size() - sent);
+        }
+
+        size_t got = local->channel->Receive(chunk, sizeof(chunk));
+        if (got > 0) {
+            size_t parsed;
+            bool complete;
+            try {
+                complete = local->codec.Decode(chunk, got, parsed);
+            } catch (std::runtime_error &ex) {
+                std::cerr << "Bad reply from " << _options.local << ": " << ex.what() << std::endl;
+                DropLocal();
+                return Status::kError;
+            }
+            if (complete && parsed == got) {
+                return call.status;
+            }
+            if (complete) {
+                std::cerr << "Unexpected reply from " << _options.local << std::endl;
+                DropLocal();
+                return Status::kError;
+            }
+            continue;
+        }
+
+        // Reply which comes late would be taken for the next one, so channel is dropped on timeout as well
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (left.count() <= 0 || !local->channel->Wait(sent < output.size(), left.count())) {
+            DropLocal();
+            return Status::kError;
+        }
+    }
+}
+
+Client::Impl::Local *Client::Impl::LocalChannel() {
+    if (_cached_id == _id) {
+        return _cached_local;
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto &local = _locals[std::this_thread::get_id()];
+    if (!local) {
+        try {
+            local.reset(new Local());
+            local->channel = Network::Shm::Channel::Attach(_options.local);
+        } catch (std::runtime_error &ex) {
+            std::cerr << "Local server is unavailable: " << ex.what() << std::endl;
+            _locals.erase(std::this_thread::get_id());
+            return nullptr;
+        }
+    }
+    _cached_id = _id;
+    _cached_local = local.get();
+    return _cached_local;
+}
+
+void Client::Impl::DropLocal() {
+    _cached_id = 0;
+    _cached_local = nullptr;
+    std::unique_lock<std::mutex> lock(_mutex);
+    _locals.erase(std::this_thread::get_id());
+}
+
+// See Client.h
+Client::Client(const Options &options) : _impl(new Impl(options)) {}
+
+// See Client.h
+Client::~Client() {}
+
+// See Client.h
+Status Client::Get(const std::string &key, Item &item) {
+    NearCache *near = _impl->near.get();
+    if (near != nullptr && near->Get(key, item)) {
+        return Status::kOk;
+    }
+    uint64_t version = near != nullptr ? near->Version() : 0;
+
+    auto call = std::make_shared<Call>();
+    call->op = Call::Op::kGet;
+    call->keys.push_back(key);
+    Status status = _impl->Execute(call);
+    if (status != Status::kOk) {
+        return status;
+    }
+    if (call->items.empty()) {
+        return Status::kNotFound;
+    }
+
+    item = std::move(call->items[0].second);
+    if (near != nullptr) {
+        near->Put(key, item, version);
+    }
+    return Status::kOk;
+}
+
+// See Client.h
+Status Client::Gets(const std::string &key, Item &item) {
+    auto call = std::make_shared<Call>();
+    call->op = Call::Op::kGets;
+    call->keys.push_back(key);
+    Status status = _impl->Execute(call);
+    if (status != Status::kOk) {
+        return status;
+    }
+    if (call->items.empty()) {
+        return Status::kNotFound;
+    }
+    item = std::move(call->items[0].second);
+    return Status::kOk;
+}
+
+// See Client.h
+Status Client::Get(const std::vector<std::string> &keys, std::unordered_map<std::string, Item> &items) {
+    NearCache *near = _impl->near.get();
+    if (near == nullptr) {
+        return _impl->MultiGet(keys, items);
+    }
+
+    std::vector<std::string> missing;
+    for (auto &key : keys) {
+        Item item;
+        if (near->Get(key, item)) {
+            items[key] = std::move(item);
+        } else {
+            missing.push_back(key);
+        }
+    }
+    if (missing.empty()) {
+        return Status::kOk;
+    }
+
+    uint64_t version = near->Version();
+    std::unordered_map<std::string, Item> fetched;
+    Status status = _impl->MultiGet(missing, fetched);
+    for (auto &item : fetched) {
+        near->Put(item.first, item.second, version);
+        items[item.first] = std::move(item.second);
+    }
+    return status;
+}
+
+namespace {
+
+std::shared_ptr<Call> Make(Call::Op op, const std::string &key) {
+    auto call = std::make_shared<Call>();
+    call->op = op;
+    call->keys.push_back(key);
+    return call;
+}
+
+std::shared_ptr<Call> Make(Call::Op op, const std::string &key, const std::string &value, uint32_t flags,
+                           uint32_t exptime) {
+    auto call = Make(op, key);
+    call->value = value;
+    call->flags = flags;
+    call->exptime = exptime;
+    return call;
+}
+
+} // namespace
+
+// See Client.h
+Status Client::Set(const std::string &key, const std::string &value, uint32_t flags, uint32_t exptime) {
+    return _impl->Change(Make(Call::Op::kSet, key, value, flags, exptime));
+}
+
+// See Client.h
+Status Client::Add(const std::string &key, const std::string &value, uint32_t flags, uint32_t exptime) {
+    return _impl->Change(Make(Call::Op::kAdd, key, value, flags, exptime));
+}
+
+// See Client.h
+Status Client::Replace(const std::string &key, const std::string &value, uint32_t flags, uint32_t exptime) {
+    return _impl->Change(Make(Call::Op::kReplace, key, value, flags, exptime));
+}
+
+// See Client.h
+Status Client::Append(const std::string &key, const std::string &value) {
+    return _impl->Change(Make(Call::Op::kAppend, key, value, 0, 0));
+}
+
+// See Client.h
+Status Client::Prepend(const std::string &key, const std::string &value) {
+    return _impl->Change(Make(Call::Op::kPrepend, key, value, 0, 0));
+}
+
+// See Client.h
+Status Client::Cas(const std::string &key, const std::string &value, uint64_t cas, uint32_t flags,
+                   uint32_t exptime) {
+    auto call = Make(Call::Op::kCas, key, value, flags, exptime);
+    call->number = cas;
+    return _impl->Change(call);
+}
+
+// See Client.h
+Status Client::Delete(const std::string &key) { return _impl->Change(Make(Call::Op::kDelete, key)); }
+
+// See Client.h
+Status Client::Touch(const std::string &key, uint32_t exptime) {
+    auto call = Make(Call::Op::kTouch, key);
+    call->exptime = exptime;
+    return _impl->Change(call);
+}
+
+// See Client.h
+Status Client::Incr(const std::string &key, uint64_t delta, uint64_t &result) {
+    auto call = Make(Call::Op::kIncr, key);
+    call->number = delta;
+    Status status = _impl->Change(call);
+    if (status == Status::kOk) {
+        result = call->counter;
+    }
+    return status;
+}
+
+// See Client.h
+Status Client::Decr(const std::string &key, uint64_t delta, uint64_t &result) {
+    auto call = Make(Call::Op::kDecr, key);
+    call->number = delta;
+    Status status = _impl->Change(call);
+    if (status == Status::kOk) {
+        result = call->counter;
+    }
+    return status;
+}
+
+} // namespace Client
+} // namespace Afina
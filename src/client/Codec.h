@@ -0,0 +1,125 @@
+#ifndef AFINA_CLIENT_CODEC_H
+#define AFINA_CLIENT_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <afina/client/Client.h>
+
+#include "protocol/ReplyParser.h"
+
+namespace Afina {
+namespace Client {
+
+/**
+ * Command issued to a single server together with its outcome
+ */
+struct Call {
+    enum class Op : uint8_t {
+        kGet,
+        kGets,
+        kSet,
+        kAdd,
+        kReplace,
+        kAppend,
+        kPrepend,
+        kCas,
+        kDelete,
+        kIncr,
+        kDecr,
+        kTouch
+    };
+
+    Op op;
+    std::vector<std::string> keys;
+    std::string value;
+    uint32_t flags = 0;
+    uint32_t exptime = 0;
+
+    // Cas unique of kCas, delta of kIncr and kDecr
+    uint64_t number = 0;
+
+    // Filled once reply is decoded: items found by get, new counter value
+    Status status = Status::kError;
+    std::vector<std::pair<std::string, Item>> items;
+    uint64_t counter = 0;
+
+    // Set under client lock once outcome is there
+    bool done = false;
+};
+
+/**
+ * Wire protocol of a connection. Commands are encoded in order they are sent, replies are decoded in the same
+ * order, each into the call it belongs to
+ */
+class Codec {
+public:
+    virtual ~Codec() {}
+
+    /**
+     * Appends command to the output
+     */
+    virtual void Encode(const Call &call, std::string &out) const = 0;
+
+    /**
+     * Starts decoding reply to the given call
+     */
+    virtual void Expect(Call *call) = 0;
+
+    /**
+     * Pushes received bytes, outcome is stored into the call once its reply is complete. Throws
+     * std::runtime_error if stream is broken
+     *
+     * @param parsed output parameter tells how many bytes belong to the current reply
+     * @return true once the whole reply is consumed
+     */
+    virtual bool Decode(const char *input, size_t size, size_t &parsed) = 0;
+};
+
+/**
+ * memcached text protocol
+ */
+class TextCodec : public Codec {
+public:
+    void Encode(const Call &call, std::string &out) const override;
+    void Expect(Call *call) override;
+    bool Decode(const char *input, size_t size, size_t &parsed) override;
+
+private:
+    // Turns complete reply into call outcome
+    void Interpret();
+
+    Call *_call = nullptr;
+    Protocol::ReplyParser _parser;
+    std::string _reply;
+};
+
+/**
+ * memcached binary protocol. Gets are sent as quiet GETKQ per key followed by NOOP, so misses cost nothing
+ * and NOOP response ends the reply
+ */
+class BinaryCodec : public Codec {
+public:
+    void Encode(const Call &call, std::string &out) const override;
+    void Expect(Call *call) override;
+    bool Decode(const char *input, size_t size, size_t &parsed) override;
+
+private:
+    static const size_t kHeaderSize = 24;
+
+    // Applies complete response packet to the call, returns true once call is complete
+    bool Interpret();
+
+    Call *_call = nullptr;
+
+    // Packet received so far
+    std::string _packet;
+};
+
+} // namespace Client
+} // namespace Afina
+
+#endif // AFINA_CLIENT_CODEC_H
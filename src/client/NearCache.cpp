@@ -0,0 +1,68 @@
+#include "NearCache.h"
+
+namespace Afina {
+namespace Client {
+
+// See NearCache.h
+NearCache::NearCache(size_t max_items, std::chrono::milliseconds ttl) : _max_items(max_items), _ttl(ttl), _version(0) {}
+
+// See NearCache.h
+bool NearCache::Get(const std::string &key, Item &item) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto entry = _entries.find(key);
+    if (entry == _entries.end()) {
+        return false;
+    }
+    if (std::chrono::steady_clock::now() >= entry->second.expires) {
+        _order.erase(entry->second.position);
+        _entries.erase(entry);
+        return false;
+    }
+
+    _order.splice(_order.begin(), _order, entry->second.position);
+    item = entry->second.item;
+    return true;
+}
+
+// See NearCache.h
+uint64_t NearCache::Version() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _version;
+}
+
+// See NearCache.h
+void NearCache::Put(const std::string &key, const Item &item, uint64_t version) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (version != _version || _max_items == 0) {
+        return;
+    }
+    auto expires = std::chrono::steady_clock::now() + _ttl;
+    auto entry = _entries.find(key);
+    if (entry != _entries.end()) {
+        entry->second.item = item;
+        entry->second.expires = expires;
+        _order.splice(_order.begin(), _order, entry->second.position);
+        return;
+    }
+
+    if (_entries.size() >= _max_items) {
+        _entries.erase(_order.back());
+        _order.pop_back();
+    }
+    _order.push_front(key);
+    _entries.emplace(key, Entry{item, expires, _order.begin()});
+}
+
+// See NearCache.h
+void NearCache::Erase(const std::string &key) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _version++;
+    auto entry = _entries.find(key);
+    if (entry != _entries.end()) {
+        _order.erase(entry->second.position);
+        _entries.erase(entry);
+    }
+}
+
+} // namespace Client
+} // namespace Afina
@@ -0,0 +1,63 @@
+#ifndef AFINA_CLIENT_NEAR_CACHE_H
+#define AFINA_CLIENT_NEAR_CACHE_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <afina/client/Client.h>
+
+namespace Afina {
+namespace Client {
+
+/**
+ * # In-process cache in front of servers
+ * Keeps recently fetched items for a short time, so hot keys are served without a round trip. Bounded by
+ * number of items, least recently used one is dropped first. Item expires after the given time, so changes
+ * made elsewhere are seen with at most that delay
+ */
+class NearCache {
+public:
+    NearCache(size_t max_items, std::chrono::milliseconds ttl);
+
+    /**
+     * Returns true if fresh copy of the item is there
+     */
+    bool Get(const std::string &key, Item &item);
+
+    /**
+     * Counter bumped by every Erase. Item fetched from server is put only if nothing was erased since fetch
+     * started, so a fetch racing with a change can't bring stale value back
+     */
+    uint64_t Version();
+
+    void Put(const std::string &key, const Item &item, uint64_t version);
+
+    void Erase(const std::string &key);
+
+private:
+    struct Entry {
+        Item item;
+        std::chrono::steady_clock::time_point expires;
+        std::list<std::string>::iterator position;
+    };
+
+    const size_t _max_items;
+    const std::chrono::milliseconds _ttl;
+
+    std::mutex _mutex;
+    uint64_t _version;
+    std::unordered_map<std::string, Entry> _entries;
+
+    // Keys from most to least recently used
+    std::list<std::string> _order;
+};
+
+} // namespace Client
+} // namespace Afina
+
+#endif // AFINA_CLIENT_NEAR_CACHE_H
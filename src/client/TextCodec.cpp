@@ -0,0 +1,163 @@
+#include "Codec.h"
+
+#include <cstdlib>
+#include <stdexcept>
+
+namespace Afina {
+namespace Client {
+
+namespace {
+
+const char *Name(Call::Op op) {
+    switch (op) {
+    case Call::Op::kGet:
+        return "get";
+    case Call::Op::kGets:
+        return "gets";
+    case Call::Op::kSet:
+        return "set";
+    case Call::Op::kAdd:
+        return "add";
+    case Call::Op::kReplace:
+        return "replace";
+    case Call::Op::kAppend:
+        return "append";
+    case Call::Op::kPrepend:
+        return "prepend";
+    case Call::Op::kCas:
+        return "cas";
+    case Call::Op::kDelete:
+        return "delete";
+    case Call::Op::kIncr:
+        return "incr";
+    case Call::Op::kDecr:
+        return "decr";
+    case Call::Op::kTouch:
+        return "touch";
+    }
+    return "";
+}
+
+// Parses decimal number at the position, moves position past it
+uint64_t Number(const std::string &line, size_t &position) {
+    size_t start = position;
+    uint64_t number = 0;
+    for (; position < line.size() && line[position] >= '0' && line[position] <= '9'; position++) {
+        number = number * 10 + (line[position] - '0');
+    }
+    if (position == start) {
+        throw std::runtime_error("Number expected in reply");
+    }
+    return number;
+}
+
+} // namespace
+
+// See Codec.h
+void TextCodec::Encode(const Call &call, std::string &out) const {
+    out += Name(call.op);
+    switch (call.op) {
+    case Call::Op::kGet:
+    case Call::Op::kGets:
+        for (auto &key : call.keys) {
+            out += ' ';
+            out += key;
+        }
+        out += "\r\n";
+        break;
+
+    case Call::Op::kSet:
+    case Call::Op::kAdd:
+    case Call::Op::kReplace:
+    case Call::Op::kAppend:
+    case Call::Op::kPrepend:
+    case Call::Op::kCas:
+        out += ' ' + call.keys[0] + ' ' + std::to_string(call.flags) + ' ' + std::to_string(call.exptime) + ' ' +
+               std::to_string(call.value.size());
+        if (call.op == Call::Op::kCas) {
+            out += ' ' + std::to_string(call.number);
+        }
+        out += "\r\n";
+        out += call.value;
+        out += "\r\n";
+        break;
+
+    case Call::Op::kDelete:
+        out += ' ' + call.keys[0] + "\r\n";
+        break;
+
+    case Call::Op::kIncr:
+    case Call::Op::kDecr:
+        out += ' ' + call.keys[0] + ' ' + std::to_string(call.number) + "\r\n";
+        break;
+
+    case Call::Op::kTouch:
+        out += ' ' + call.keys[0] + ' ' + std::to_string(call.exptime) + "\r\n";
+        break;
+    }
+}
+
+// See Codec.h
+void TextCodec::Expect(Call *call) {
+    _call = call;
+    _reply.clear();
+    bool values = call->op == Call::Op::kGet || call->op == Call::Op::kGets;
+    _parser.Reset(values ? Protocol::ReplyParser::Kind::kValues : Protocol::ReplyParser::Kind::kLine);
+}
+
+// See Codec.h
+bool TextCodec::Decode(const char *input, size_t size, size_t &parsed) {
+    bool complete = _parser.Parse(input, size, parsed);
+    _reply.append(input, parsed);
+    if (complete) {
+        Interpret();
+    }
+    return complete;
+}
+
+void TextCodec::Interpret() {
+    Call &call = *_call;
+    if (call.op == Call::Op::kGet || call.op == Call::Op::kGets) {
+        // Parser has already checked VALUE lines are well formed
+        size_t position = 0;
+        while (_reply.compare(position, 6, "VALUE ") == 0) {
+            size_t key_end = _reply.find(' ', position + 6);
+            std::string key = _reply.substr(position + 6, key_end - position - 6);
+
+            Item item;
+            position = key_end + 1;
+            item.flags = uint32_t(Number(_reply, position));
+            position++;
+            size_t bytes = Number(_reply, position);
+            if (_reply[position] == ' ') {
+                position++;
+                item.cas = Number(_reply, position);
+            }
+            position = _reply.find('\n', position) + 1;
+            item.value = _reply.substr(position, bytes);
+            position += bytes + 2;
+            call.items.emplace_back(std::move(key), std::move(item));
+        }
+        call.status = _reply.compare(position, 5, "END\r\n") == 0 ? Status::kOk : Status::kError;
+        return;
+    }
+
+    if (_reply == "STORED\r\n" || _reply == "DELETED\r\n" || _reply == "TOUCHED\r\n") {
+        call.status = Status::kOk;
+    } else if (_reply == "NOT_FOUND\r\n") {
+        call.status = Status::kNotFound;
+    } else if (_reply == "NOT_STORED\r\n") {
+        call.status = Status::kNotStored;
+    } else if (_reply == "EXISTS\r\n") {
+        call.status = Status::kExists;
+    } else if ((call.op == Call::Op::kIncr || call.op == Call::Op::kDecr) && _reply[0] >= '0' && _reply[0] <= '9') {
+        size_t position = 0;
+        call.counter = Number(_reply, position);
+        call.status = Status::kOk;
+    } else {
+        call.status = Status::kError;
+    }
+}
+
+} // namespace Client
+} // namespace Afina
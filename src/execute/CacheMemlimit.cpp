@@ -0,0 +1,30 @@
+#include <afina/Storage.h>
+#include <afina/execute/CacheMemlimit.h>
+
+#include <limits>
+
+namespace Afina {
+namespace Execute {
+
+/* memcached protocol:
+
+cache_memlimit <megabytes> [noreply]\r\n
+
+Server replies "OK\r\n"
+*/
+
+void CacheMemlimit::Execute(Storage &storage, std::string &args, std::string &out) {
+    // Limit in bytes must fit into size_t
+    if (_megabytes == 0 || _megabytes > (std::numeric_limits<size_t>::max() >> 20)) {
+        out = "CLIENT_ERROR invalid memory limit";
+        return;
+    }
+    if (!storage.SetMaxSize(size_t(_megabytes) << 20)) {
+        out = "SERVER_ERROR can't change memory limit";
+        return;
+    }
+    out = "OK";
+}
+
+} // namespace Execute
+} // namespace Afina
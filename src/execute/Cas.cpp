@@ -0,0 +1,27 @@
+#include <afina/Storage.h>
+#include <afina/execute/Cas.h>
+
+namespace Afina {
+namespace Execute {
+
+// memcached protocol: "cas" is a check and set operation which means "store this data but only if no one else has
+// updated since I last fetched it."
+void Cas::Execute(Storage &storage, std::string &args, std::string &out) {
+    switch (storage.CompareAndSet(_key, _cas, std::move(args), _flags, _expire)) {
+    case Storage::CasResult::kStored:
+        out = "STORED";
+        break;
+    case Storage::CasResult::kExists:
+        out = "EXISTS";
+        break;
+    case Storage::CasResult::kNotFound:
+        out = "NOT_FOUND";
+        break;
+    default:
+        out = "NOT_STORED";
+        break;
+    }
+}
+
+} // namespace Execute
+} // namespace Afina
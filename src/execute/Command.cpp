@@ -1 +1,14 @@
 #include <afina/execute/Command.h>
+
+namespace Afina {
+namespace Execute {
+
+// See Command.h
+void Command::Execute(Storage &storage, std::string &args, Response &out) {
+    std::string text;
+    Execute(storage, args, text);
+    out.Append(text);
+}
+
+} // namespace Execute
+} // namespace Afina
@@ -0,0 +1,26 @@
+#include <afina/Storage.h>
+#include <afina/execute/Decr.h>
+
+#include <stdexcept>
+
+namespace Afina {
+namespace Execute {
+
+// memcached protocol: "decr" means "subtract value from the 64-bit unsigned integer stored for the key".
+void Decr::Execute(Storage &storage, std::string &args, std::string &out) {
+    uint64_t result;
+    try {
+        if (!storage.Decrement(_key, _value, result)) {
+            out.assign("NOT_FOUND");
+            return;
+        }
+    } catch (std::runtime_error &ex) {
+        out.assign("CLIENT_ERROR ");
+        out.append(ex.what());
+        return;
+    }
+    out = std::to_string(result);
+}
+
+} // namespace Execute
+} // namespace Afina
@@ -0,0 +1,13 @@
+#include <afina/Storage.h>
+#include <afina/execute/Delete.h>
+
+namespace Afina {
+namespace Execute {
+
+// memcached protocol: "delete" allows for explicit deletion of items.
+void Delete::Execute(Storage &storage, std::string &args, std::string &out) {
+    out = storage.Delete(_key) ? "DELETED" : "NOT_FOUND";
+}
+
+} // namespace Execute
+} // namespace Afina
@@ -0,0 +1,18 @@
+#include <afina/Storage.h>
+#include <afina/execute/DeletePrefix.h>
+
+namespace Afina {
+namespace Execute {
+
+// Not a part of memcached protocol, namespace invalidation for ordered storages
+void DeletePrefix::Execute(Storage &storage, std::string &args, std::string &out) {
+    size_t deleted;
+    if (!storage.DeletePrefix(_prefix, deleted)) {
+        out = "SERVER_ERROR storage doesn't support prefix operations";
+        return;
+    }
+    out = "DELETED " + std::to_string(deleted);
+}
+
+} // namespace Execute
+} // namespace Afina
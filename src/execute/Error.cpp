@@ -0,0 +1,10 @@
+#include <afina/execute/Error.h>
+
+namespace Afina {
+namespace Execute {
+
+// memcached protocol: "ERROR" means the client sent a nonexistent or malformed command.
+void Error::Execute(Storage &storage, std::string &args, std::string &out) { out = "ERROR"; }
+
+} // namespace Execute
+} // namespace Afina
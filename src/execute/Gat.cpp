@@ -0,0 +1,17 @@
+#include <afina/Storage.h>
+#include <afina/execute/Gat.h>
+
+namespace Afina {
+namespace Execute {
+
+// memcached protocol: "gat" and "gats" are used to fetch items and update the expiration time of an existing items.
+void Gat::Lookup(Storage &storage, size_t first, size_t count, std::vector<Storage::Item> &items) {
+    items.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        const std::string &key = keys()[first + i];
+        items[i].found = storage.GetAndTouch(key, _expire, items[i].value, items[i].flags, items[i].cas);
+    }
+}
+
+} // namespace Execute
+} // namespace Afina
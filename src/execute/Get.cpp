@@ -1,18 +1,18 @@
 #include <afina/Storage.h>
 #include <afina/execute/Get.h>
 
-#include <iostream>
-#include <iterator>
-#include <sstream>
+#include <algorithm>
 
 namespace Afina {
 namespace Execute {
 
+const size_t Get::kBatchSize;
+
 /* memcached protocol:
 
 Each item sent by the server looks like this:
 
-VALUE <key> <flags> <bytes>\r\n
+VALUE <key> <flags> <bytes> [<cas unique>]\r\n
 <data block>\r\n
 
 After all the items have been transmitted, the server sends the string
@@ -21,23 +21,65 @@ to indicate the end of response.
 
 */
 
-void Get::Execute(Storage &storage, const std::string &args, std::string &out) {
-    std::stringstream keyStream;
-    copy(_keys.begin(), _keys.end(), std::ostream_iterator<std::string>(keyStream, " "));
-    std::cout << "Get(" << keyStream.str() << ")" << std::endl;
+void Get::Execute(Storage &storage, std::string &args, std::string &out) {
+    Response response;
+    Execute(storage, args, response);
+    while (Pending()) {
+        Continue(storage, response);
+    }
+    out = response.ToString();
+}
+
+// Values are not copied: response references storage slices and network layer sends them as is
+void Get::Execute(Storage &storage, std::string &args, Response &out) {
+    _items.clear();
+    _next = _looked_up = 0;
+    _pending = true;
+    Continue(storage, out);
+}
 
-    std::stringstream outStream;
+void Get::Continue(Storage &storage, Response &out) {
+    std::string header;
+    while (_next < _keys.size() && !out.Full()) {
+        // Next batch is looked up once the previous one is written out
+        if (_next == _looked_up) {
+            size_t count = std::min(kBatchSize, _keys.size() - _next);
+            _items.clear();
+            Lookup(storage, _next, count, _items);
+            _looked_up += count;
+        }
 
-    std::string value;
-    for (auto &key : _keys) {
-        if (!storage.Get(key, value))
+        const std::string &key = _keys[_next];
+        Storage::Item &item = _items[_items.size() - (_looked_up - _next)];
+        _next++;
+        if (!item.found)
             continue;
-        outStream << "VALUE " << key << " 0 " << value.size() << "\r\n";
-        outStream << value << "\r\n";
+        header = "VALUE " + key + " " + std::to_string(item.flags) + " " + std::to_string(item.value->size());
+        if (_with_cas) {
+            header += " " + std::to_string(item.cas);
+        }
+        header += "\r\n";
+
+        out.Append(header);
+        out.Append(std::move(item.value));
+        out.Append("\r\n", 2);
     }
-    outStream << "END"; // networking layer should add the last \r\n
 
-    out = outStream.str();
+    if (_next == _keys.size()) {
+        out.Append("END", 3); // networking layer should add the last \r\n
+        _pending = false;
+        _items.clear();
+    }
+}
+
+void Get::Lookup(Storage &storage, size_t first, size_t count, std::vector<Storage::Item> &items) {
+    std::vector<std::string> keys(_keys.begin() + first, _keys.begin() + first + count);
+    if (_hashes.size() == _keys.size()) {
+        std::vector<uint64_t> hashes(_hashes.begin() + first, _hashes.begin() + first + count);
+        storage.MultiGet(keys, hashes, items);
+    } else {
+        storage.MultiGet(keys, items);
+    }
 }
 
 } // namespace Execute
@@ -0,0 +1,26 @@
+#include <afina/Storage.h>
+#include <afina/execute/Incr.h>
+
+#include <stdexcept>
+
+namespace Afina {
+namespace Execute {
+
+// memcached protocol: "incr" means "add value to the 64-bit unsigned integer stored for the key".
+void Incr::Execute(Storage &storage, std::string &args, std::string &out) {
+    uint64_t result;
+    try {
+        if (!storage.Increment(_key, _value, result)) {
+            out.assign("NOT_FOUND");
+            return;
+        }
+    } catch (std::runtime_error &ex) {
+        out.assign("CLIENT_ERROR ");
+        out.append(ex.what());
+        return;
+    }
+    out = std::to_string(result);
+}
+
+} // namespace Execute
+} // namespace Afina
@@ -0,0 +1,13 @@
+#include <afina/Storage.h>
+#include <afina/execute/Prepend.h>
+
+namespace Afina {
+namespace Execute {
+
+// memcached protocol: "prepend" means "add this data to an existing key before existing data".
+void Prepend::Execute(Storage &storage, std::string &args, std::string &out) {
+    out.assign(storage.Prepend(_key, args) ? "STORED" : "NOT_STORED");
+}
+
+} // namespace Execute
+} // namespace Afina
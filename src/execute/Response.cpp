@@ -0,0 +1,99 @@
+#include <afina/execute/Response.h>
+
+namespace Afina {
+namespace Execute {
+
+// See Response.h
+void Response::Append(const char *text, size_t size) {
+    if (size == 0) {
+        return;
+    }
+
+    if (_fragments.empty() || _fragments.back().slice) {
+        _fragments.emplace_back();
+    }
+    _fragments.back().text.append(text, size);
+    _size += size;
+}
+
+// See Response.h
+void Response::Append(std::shared_ptr<const std::string> slice) {
+    if (!slice || slice->empty()) {
+        return;
+    }
+
+    _size += slice->size();
+    _fragments.emplace_back();
+    _fragments.back().slice = std::move(slice);
+}
+
+// See Response.h
+void Response::Append(Response &&other) {
+    if (other._offset > 0) {
+        Append(other._fragments.front().Data().data() + other._offset,
+               other._fragments.front().Data().size() - other._offset);
+        other._fragments.pop_front();
+    }
+    for (auto &fragment : other._fragments) {
+        if (fragment.slice) {
+            Append(std::move(fragment.slice));
+        } else {
+            Append(fragment.text);
+        }
+    }
+    other.Clear();
+}
+
+// See Response.h
+size_t Response::Gather(struct iovec *iov, size_t max) const { return Gather(iov, nullptr, max); }
+
+// See Response.h
+size_t Response::Gather(struct iovec *iov, std::shared_ptr<const std::string> *slices, size_t max) const {
+    size_t count = 0;
+    size_t offset = _offset;
+    for (auto it = _fragments.begin(); it != _fragments.end() && count < max; it++) {
+        const std::string &data = it->Data();
+        iov[count].iov_base = const_cast<char *>(data.data()) + offset;
+        iov[count].iov_len = data.size() - offset;
+        if (slices != nullptr) {
+            slices[count] = it->slice;
+        }
+        offset = 0;
+        count++;
+    }
+    return count;
+}
+
+// See Response.h
+void Response::Consume(size_t size) {
+    _size -= size;
+    size += _offset;
+    while (!_fragments.empty() && size >= _fragments.front().Data().size()) {
+        size -= _fragments.front().Data().size();
+        _fragments.pop_front();
+    }
+    _offset = size;
+}
+
+// See Response.h
+void Response::Clear() {
+    _fragments.clear();
+    _offset = 0;
+    _size = 0;
+}
+
+// See Response.h
+std::string Response::ToString() const {
+    std::string result;
+    result.reserve(_size);
+
+    size_t offset = _offset;
+    for (auto &fragment : _fragments) {
+        result.append(fragment.Data(), offset, std::string::npos);
+        offset = 0;
+    }
+    return result;
+}
+
+} // namespace Execute
+} // namespace Afina
@@ -1,15 +1,16 @@
 #include <afina/Storage.h>
 #include <afina/execute/Set.h>
 
-#include <iostream>
-
 namespace Afina {
 namespace Execute {
 
 // memcached protocol: "set" means "store this data".
-void Set::Execute(Storage &storage, const std::string &args, std::string &out) {
-    std::cout << "Set(" << _key << "): " << args << std::endl;
-    storage.Put(_key, args);
+void Set::Execute(Storage &storage, std::string &args, std::string &out) {
+    // Storage refuses value it can't make room for
+    if (!storage.Put(_key, _hash, std::move(args), _flags, _expire)) {
+        out = "SERVER_ERROR out of memory storing object";
+        return;
+    }
     out = "STORED";
 }
 
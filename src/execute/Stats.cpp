@@ -4,11 +4,29 @@
 #include <iostream>
 #include <iterator>
 #include <sstream>
+#include <utility>
+#include <vector>
 
 namespace Afina {
 namespace Execute {
 
-void Stats::Execute(Storage &storage, const std::string &args, std::string &out) { out.assign("END"); }
+/* memcached protocol:
+
+Server sends one line per counter, terminated by "END\r\n":
+
+STAT <name> <value>\r\n
+*/
+
+void Stats::Execute(Storage &storage, std::string &args, std::string &out) {
+    std::vector<std::pair<std::string, uint64_t>> stats;
+    storage.GetStats(stats);
+
+    out.clear();
+    for (auto &stat : stats) {
+        out += "STAT " + stat.first + " " + std::to_string(stat.second) + "\r\n";
+    }
+    out += "END";
+}
 
 } // namespace Execute
 } // namespace Afina
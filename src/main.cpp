@@ -1,6 +1,13 @@
 #include <chrono>
+#include <cstring>
+#include <fcntl.h>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
 #include <uv.h>
 
 #include <cxxopts.hpp>
@@ -9,16 +16,73 @@
 #include <afina/Version.h>
 #include <afina/network/Server.h>
 
+#include "network/Handoff.h"
+#include "network/Listen.h"
 #include "network/blocking/ServerImpl.h"
+#include "network/fifo/ServerImpl.h"
 #include "network/nonblocking/ServerImpl.h"
+#include "network/shm/ServerImpl.h"
 #include "network/uv/ServerImpl.h"
+#include "storage/ArtGlobalLockImpl.h"
 #include "storage/MapBasedGlobalLockImpl.h"
+#include "storage/ShmGlobalLockImpl.h"
 
 typedef struct {
     std::shared_ptr<Afina::Storage> storage;
     std::shared_ptr<Afina::Network::Server> server;
+
+    // Unix socket clients could connect to, empty if there is none. Its file is removed on exit unless socket
+    // has been handed off to the new binary
+    std::string unix_path;
+    bool handed_off;
+
+    // Shared memory transport for clients on the same host, null unless enabled. Its socket file is removed
+    // on exit unless socket has been handed off, as the one above
+    std::shared_ptr<Afina::Network::Shm::ServerImpl> local;
+    std::string local_path;
+
+    // Named pipe frontend, null unless enabled
+    std::shared_ptr<Afina::Network::Fifo::ServerImpl> fifo;
+
+    // Snapshot file for warm restart, empty if there is none
+    std::string snapshot;
+
+    // Mutation log, empty if there is none
+    std::string log;
+
+    // Command line new binary is started with on upgrade
+    char **argv;
+
+    // New binary and channel listening sockets were handed off over while upgrade is in progress
+    pid_t upgrade_pid;
+    int upgrade_channel;
+    uv_poll_t upgrade_poll;
 } Application;
 
+// Environment variable that tells new binary which descriptor is the channel to the old one
+const char kHandoffVariable[] = "AFINA_HANDOFF_FD";
+
+// Storage of the given kind with the named eviction policy
+template <template <typename> class Impl>
+std::shared_ptr<Afina::Storage> make_storage(const std::string &eviction, size_t max_size, size_t low_headroom,
+                                             size_t high_headroom) {
+    using namespace Afina::Backend;
+    if (eviction == "lru") {
+        return std::make_shared<Impl<LruPolicy>>(max_size, low_headroom, high_headroom);
+    } else if (eviction == "slru") {
+        return std::make_shared<Impl<SlruPolicy>>(max_size, low_headroom, high_headroom);
+    } else if (eviction == "2q") {
+        return std::make_shared<Impl<TwoQueuePolicy>>(max_size, low_headroom, high_headroom);
+    } else if (eviction == "arc") {
+        return std::make_shared<Impl<ArcPolicy>>(max_size, low_headroom, high_headroom);
+    } else if (eviction == "gdsf") {
+        return std::make_shared<Impl<GdsfPolicy>>(max_size, low_headroom, high_headroom);
+    } else if (eviction == "tinylfu") {
+        return std::make_shared<Impl<TinyLfuPolicy>>(max_size, low_headroom, high_headroom);
+    }
+    throw std::runtime_error("Unknown eviction policy");
+}
+
 // Handle all signals catched
 void signal_handler(uv_signal_t *handle, int signum) {
     Application *pApp = static_cast<Application *>(handle->data);
@@ -27,12 +91,146 @@ void signal_handler(uv_signal_t *handle, int signum) {
     uv_stop(handle->loop);
 }
 
+// Called once new binary either reports it is accepting or exits
+void upgrade_done_handler(uv_poll_t *handle, int status, int events) {
+    Application *pApp = static_cast<Application *>(handle->data);
+
+    char ready = 0;
+    ssize_t got;
+    do {
+        got = read(pApp->upgrade_channel, &ready, 1);
+    } while (got < 0 && errno == EINTR);
+
+    uv_poll_stop(handle);
+    uv_close((uv_handle_t *)handle, nullptr);
+
+    if (got == 1) {
+        // This one stops serving and writes the final snapshot. Channel stays open until exit, new binary waits
+        // for it to close before loading the snapshot and reading the FIFO
+        std::cout << "Process " << pApp->upgrade_pid << " has taken over, stopping" << std::endl;
+        pApp->handed_off = true;
+        uv_stop(handle->loop);
+        return;
+    }
+
+    close(pApp->upgrade_channel);
+    pApp->upgrade_channel = -1;
+
+    waitpid(pApp->upgrade_pid, nullptr, 0);
+    pApp->upgrade_pid = -1;
+    std::cerr << "Upgrade failed, new binary has exited" << std::endl;
+}
+
+// Called on SIGUSR2: new binary is started with the same arguments and listening sockets are handed off to
+// it. This process keeps serving until new one is accepting
+void upgrade_handler(uv_signal_t *handle, int signum) {
+    Application *pApp = static_cast<Application *>(handle->data);
+
+    std::cout << "Receive upgrade signal" << std::endl;
+    if (pApp->upgrade_pid > 0) {
+        std::cerr << "Upgrade is already in progress" << std::endl;
+        return;
+    }
+    if (!pApp->log.empty()) {
+        std::cerr << "Upgrade refused, mutation log can't be appended by two processes" << std::endl;
+        return;
+    }
+    std::vector<int> sockets = pApp->server->ListenSockets();
+    if (sockets.empty()) {
+        std::cerr << "Upgrade refused, network can't hand listening sockets off" << std::endl;
+        return;
+    }
+
+    // New binary is started with the same options, so it knows the last socket is the shared memory one
+    if (pApp->local) {
+        sockets.push_back(pApp->local->ListenSocket());
+    }
+
+    int channel[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, channel) != 0) {
+        std::cerr << "Upgrade failed, can't create channel: " << strerror(errno) << std::endl;
+        return;
+    }
+
+    // Forked child of a threaded process may only call async-signal-safe functions, everything it needs is
+    // prepared here
+    std::string variable = std::string(kHandoffVariable) + "=" + std::to_string(channel[1]);
+    std::vector<char *> environment{&variable[0]};
+    for (char **entry = environ; *entry != nullptr; entry++) {
+        if (strncmp(*entry, kHandoffVariable, sizeof(kHandoffVariable) - 1) != 0 ||
+            (*entry)[sizeof(kHandoffVariable) - 1] != '=') {
+            environment.push_back(*entry);
+        }
+    }
+    environment.push_back(nullptr);
+    long max_fd = sysconf(_SC_OPEN_MAX);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Nothing but the channel is inherited, otherwise client connections would outlive this process
+        for (long fd = 3; fd < max_fd; fd++) {
+            if (fd != channel[1]) {
+                close(fd);
+            }
+        }
+        fcntl(channel[1], F_SETFD, 0);
+        environ = environment.data();
+        execvp(pApp->argv[0], pApp->argv);
+        _exit(127);
+    }
+
+    close(channel[1]);
+    if (pid < 0) {
+        std::cerr << "Upgrade failed, can't fork: " << strerror(errno) << std::endl;
+        close(channel[0]);
+        return;
+    }
+
+    // If sockets can't be sent, closed channel makes new binary exit
+    try {
+        Afina::Network::SendSockets(channel[0], sockets);
+    } catch (std::exception &e) {
+        std::cerr << "Upgrade failed: " << e.what() << std::endl;
+        close(channel[0]);
+        waitpid(pid, nullptr, 0);
+        return;
+    }
+
+    std::cout << "Listening sockets handed off to process " << pid << std::endl;
+    pApp->upgrade_pid = pid;
+    pApp->upgrade_channel = channel[0];
+    uv_poll_init(handle->loop, &pApp->upgrade_poll, channel[0]);
+    pApp->upgrade_poll.data = pApp;
+    uv_poll_start(&pApp->upgrade_poll, UV_READABLE, upgrade_done_handler);
+}
+
 // Called when it is time to collect passive metrics from services
 void timer_handler(uv_timer_t *handle) {
     Application *pApp = static_cast<Application *>(handle->data);
     std::cout << "Start passive metrics collection" << std::endl;
 }
 
+// Called when it is time to write periodic snapshot
+void snapshot_handler(uv_timer_t *handle) {
+    Application *pApp = static_cast<Application *>(handle->data);
+    if (!pApp->storage->Snapshot(pApp->snapshot)) {
+        std::cerr << "Snapshot skipped, previous one is still being written" << std::endl;
+    }
+}
+
+// Restores items from snapshot file if there is one, must be done before any client could connect
+void load_snapshot(Application &app) {
+    if (access(app.snapshot.c_str(), F_OK) != 0) {
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    if (!app.storage->LoadSnapshot(app.snapshot, std::max(1u, std::thread::hardware_concurrency()))) {
+        throw std::runtime_error("Storage doesn't support snapshots");
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::cout << "Snapshot " << app.snapshot << " loaded in " << ms.count() << "ms" << std::endl;
+}
+
 int main(int argc, char **argv) {
     // Build version
     // TODO: move into Version.h as a function
@@ -48,7 +246,37 @@ int main(int argc, char **argv) {
         // TODO: use custom cxxopts::value to print options possible values in help message
         // and simplify validation below
         options.add_options()("s,storage", "Type of storage service to use", cxxopts::value<std::string>());
+        options.add_options()("e,eviction", "Eviction policy of the storage", cxxopts::value<std::string>());
+        options.add_options()("shm", "Region file of shm storage, items in it survive restart",
+                              cxxopts::value<std::string>());
+        options.add_options()("m,memory", "Memory budget of the storage in megabytes, 64 by default",
+                              cxxopts::value<size_t>());
+        options.add_options()("headroom", "Free bytes kept by background eviction, as <low>,<high>",
+                              cxxopts::value<std::string>());
+        options.add_options()("capacity", "Number of entries storage index is presized for", cxxopts::value<size_t>());
+        options.add_options()("snapshot", "Snapshot file storage is restored from and saved to on exit",
+                              cxxopts::value<std::string>());
+        options.add_options()("snapshot-interval", "Seconds between background snapshots, 0 disables them",
+                              cxxopts::value<size_t>());
+        options.add_options()("log", "Mutation log storage is restored from and appends every change to",
+                              cxxopts::value<std::string>());
+        options.add_options()("log-sync", "When mutation log is synced: always, never or every <ms> milliseconds",
+                              cxxopts::value<std::string>());
+        options.add_options()("replication-port", "Port replicas of this server connect to", cxxopts::value<uint16_t>());
+        options.add_options()("replica-of", "Primary this server replicates, as <host>:<port>",
+                              cxxopts::value<std::string>());
         options.add_options()("n,network", "Type of network service to use", cxxopts::value<std::string>());
+        options.add_options()("p,port", "Port clients connect to, 8080 by default", cxxopts::value<uint16_t>());
+        options.add_options()("unix", "Unix socket clients connect to, @<name> is in abstract namespace",
+                              cxxopts::value<std::string>());
+        options.add_options()("unix-mode", "Permissions of unix socket file, octal", cxxopts::value<std::string>());
+        options.add_options()("no-tcp", "Listen on unix socket only");
+        options.add_options()("local", "Unix socket clients on the same host get shared memory channels through",
+                              cxxopts::value<std::string>());
+        options.add_options()("r,rfifo", "FIFO commands are read from, created if there is none",
+                              cxxopts::value<std::string>());
+        options.add_options()("w,wfifo", "FIFO replies to --rfifo commands are written to, dropped if not given",
+                              cxxopts::value<std::string>());
         options.add_options()("h,help", "Print usage info");
         options.parse(argc, argv);
 
@@ -63,6 +291,10 @@ int main(int argc, char **argv) {
 
     // Start boot sequence
     Application app;
+    app.argv = argv;
+    app.upgrade_pid = -1;
+    app.handed_off = false;
+    app.upgrade_channel = -1;
     std::cout << "Starting " << app_string.str() << std::endl;
 
     // Build new storage instance
@@ -71,11 +303,93 @@ int main(int argc, char **argv) {
         storage_type = options["storage"].as<std::string>();
     }
 
+    std::string eviction = "lru";
+    if (options.count("eviction") > 0) {
+        eviction = options["eviction"].as<std::string>();
+    }
+
+    // Same unit as memcached -m and cache_memlimit
+    size_t megabytes = options.count("memory") > 0 ? options["memory"].as<size_t>() : 64;
+    if (megabytes == 0 || megabytes > (std::numeric_limits<size_t>::max() >> 20)) {
+        throw std::runtime_error("Invalid memory limit");
+    }
+    size_t max_size = megabytes << 20;
+
+    size_t low_headroom = 0, high_headroom = 0;
+    if (options.count("headroom") > 0) {
+        std::string headroom = options["headroom"].as<std::string>();
+        size_t comma = headroom.find(',');
+        low_headroom = std::stoul(headroom.substr(0, comma));
+        high_headroom = comma == std::string::npos ? low_headroom : std::stoul(headroom.substr(comma + 1));
+        if (low_headroom >= max_size || high_headroom >= max_size) {
+            throw std::runtime_error("Headroom must be below memory limit");
+        }
+    }
+
     if (storage_type == "map_global") {
-        app.storage = std::make_shared<Afina::Backend::MapBasedGlobalLockImpl>();
+        app.storage =
+            make_storage<Afina::Backend::MapBasedGlobalLockImpl>(eviction, max_size, low_headroom, high_headroom);
+    } else if (storage_type == "art_global") {
+        app.storage = make_storage<Afina::Backend::ArtGlobalLockImpl>(eviction, max_size, low_headroom, high_headroom);
+    } else if (storage_type == "shm") {
+        std::string region = options.count("shm") > 0 ? options["shm"].as<std::string>() : "/dev/shm/afina";
+        auto shm = std::make_shared<Afina::Backend::ShmGlobalLockImpl>(region, max_size);
+        if (shm->Attached()) {
+            std::cout << "Attached to existing items in " << region << std::endl;
+        }
+        app.storage = shm;
     } else {
         throw std::runtime_error("Unknown storage type");
     }
+    if (options.count("capacity") > 0 && !app.storage->SetCapacity(options["capacity"].as<size_t>())) {
+        std::cerr << "Storage index can't be presized, capacity ignored" << std::endl;
+    }
+
+    // Warm restart: items are restored before any client could connect. Log has every change, so snapshot
+    // isn't loaded if there is one. Binary started on upgrade loads it once the old one has written the final one
+    if (options.count("snapshot") > 0) {
+        app.snapshot = options["snapshot"].as<std::string>();
+        if (options.count("log") == 0 && getenv(kHandoffVariable) == nullptr) {
+            load_snapshot(app);
+        }
+    }
+
+    if (options.count("log") > 0) {
+        Afina::Storage::LogSync sync = Afina::Storage::LogSync::kInterval;
+        size_t interval_ms = 1000;
+        std::string policy = options.count("log-sync") > 0 ? options["log-sync"].as<std::string>() : "1000";
+        if (policy == "always") {
+            sync = Afina::Storage::LogSync::kAlways;
+        } else if (policy == "never") {
+            sync = Afina::Storage::LogSync::kNever;
+        } else {
+            interval_ms = std::stoul(policy);
+        }
+
+        app.log = options["log"].as<std::string>();
+        auto start = std::chrono::steady_clock::now();
+        if (!app.storage->OpenLog(app.log, sync, interval_ms)) {
+            throw std::runtime_error("Storage doesn't support mutation log");
+        }
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        std::cout << "Mutation log replayed in " << ms.count() << "ms" << std::endl;
+    }
+
+    // Replica is filled by primary in background, while already serving reads
+    if (options.count("replica-of") > 0) {
+        std::string primary = options["replica-of"].as<std::string>();
+        size_t colon = primary.rfind(':');
+        if (colon == std::string::npos) {
+            throw std::runtime_error("Primary must be given as <host>:<port>");
+        }
+        if (!app.storage->ReplicateFrom(primary.substr(0, colon), std::stoul(primary.substr(colon + 1)))) {
+            throw std::runtime_error("Storage doesn't support replication");
+        }
+    }
+    if (options.count("replication-port") > 0 &&
+        !app.storage->ServeReplicas(options["replication-port"].as<uint16_t>())) {
+        throw std::runtime_error("Storage doesn't support replication");
+    }
 
     // Build  & start network layer
     std::string network_type = "uv";
@@ -104,15 +418,104 @@ int main(int argc, char **argv) {
     uv_signal_start(&sig, signal_handler, SIGTERM | SIGKILL);
     sig.data = &app;
 
+    uv_signal_t upgrade;
+    uv_signal_init(&loop, &upgrade);
+    uv_signal_start(&upgrade, upgrade_handler, SIGUSR2);
+    upgrade.data = &app;
+
     uv_timer_t timer;
     uv_timer_init(&loop, &timer);
     timer.data = &app;
     uv_timer_start(&timer, timer_handler, 0, 5000);
 
+    uv_timer_t snapshot_timer;
+    uv_timer_init(&loop, &snapshot_timer);
+    snapshot_timer.data = &app;
+    if (!app.snapshot.empty() && options.count("snapshot-interval") > 0) {
+        uint64_t interval = options["snapshot-interval"].as<size_t>() * 1000;
+        if (interval > 0) {
+            uv_timer_start(&snapshot_timer, snapshot_handler, interval, interval);
+        }
+    }
+
     // Start services
     try {
         app.storage->Start();
-        app.server->Start(8080);
+
+        // Started by the old binary on upgrade: its listening sockets are taken over, so no connection is
+        // refused meanwhile, and it is told to stop once they are received
+        const char *handoff = getenv(kHandoffVariable);
+        if (handoff != nullptr) {
+            int channel = std::stoi(handoff);
+            unsetenv(kHandoffVariable);
+            fcntl(channel, F_SETFD, FD_CLOEXEC);
+
+            std::vector<int> sockets = Afina::Network::ReceiveSockets(channel);
+            pid_t old = getppid();
+            char ready = 1;
+            if (write(channel, &ready, 1) != 1) {
+                throw std::runtime_error("Can't report readiness to the old process");
+            }
+
+            // Old process stops serving once told, writes the final snapshot and exits, channel is closed then.
+            // Snapshot is loaded only after that and FIFO is never read by both of them, clients wait in the
+            // backlog of listening sockets meanwhile
+            if (!app.snapshot.empty() || options.count("rfifo") > 0) {
+                ssize_t got;
+                do {
+                    got = read(channel, &ready, 1);
+                } while (got > 0 || (got < 0 && errno == EINTR));
+                if (!app.snapshot.empty()) {
+                    load_snapshot(app);
+                }
+            }
+            close(channel);
+
+            if (options.count("local") > 0) {
+                if (sockets.size() < 2) {
+                    throw std::runtime_error("Old process hasn't handed shared memory socket off");
+                }
+                app.local = std::make_shared<Afina::Network::Shm::ServerImpl>(app.storage);
+                app.local->Start(sockets.back());
+                sockets.pop_back();
+            }
+            app.server->Start(sockets);
+            if (options.count("unix") > 0) {
+                app.unix_path = options["unix"].as<std::string>();
+            }
+            std::cout << "Listening sockets taken over from process " << old << std::endl;
+        } else if (options.count("unix") > 0) {
+            // Server accepts on both sockets, TCP one is bound the same way server does it itself
+            std::vector<int> sockets;
+            if (options.count("no-tcp") == 0) {
+                sockets.push_back(
+                    Afina::Network::ListenTcp(options.count("port") > 0 ? options["port"].as<uint16_t>() : 8080));
+            }
+            int mode = options.count("unix-mode") > 0 ? std::stoi(options["unix-mode"].as<std::string>(), nullptr, 8)
+                                                      : -1;
+            sockets.push_back(Afina::Network::ListenUnix(options["unix"].as<std::string>(), mode));
+            app.unix_path = options["unix"].as<std::string>();
+            app.server->Start(sockets);
+        } else if (options.count("no-tcp") > 0) {
+            throw std::runtime_error("Nothing to listen on, --no-tcp requires --unix");
+        } else {
+            app.server->Start(options.count("port") > 0 ? options["port"].as<uint16_t>() : 8080);
+        }
+
+        if (options.count("local") > 0) {
+            if (!app.local) {
+                app.local = std::make_shared<Afina::Network::Shm::ServerImpl>(app.storage);
+                app.local->Start(options["local"].as<std::string>());
+            }
+            app.local_path = options["local"].as<std::string>();
+        }
+        if (options.count("rfifo") > 0) {
+            app.fifo = std::make_shared<Afina::Network::Fifo::ServerImpl>(app.storage);
+            app.fifo->Start(options["rfifo"].as<std::string>(),
+                            options.count("wfifo") > 0 ? options["wfifo"].as<std::string>() : "");
+        } else if (options.count("wfifo") > 0) {
+            throw std::runtime_error("--wfifo requires --rfifo");
+        }
 
         // Freeze current thread and process events
         std::cout << "Application started" << std::endl;
@@ -120,7 +523,34 @@ int main(int argc, char **argv) {
 
         // Stop services
         app.server->Stop();
+        if (app.local) {
+            app.local->Stop();
+        }
+        if (app.fifo) {
+            app.fifo->Stop();
+        }
         app.server->Join();
+        if (app.local) {
+            app.local->Join();
+        }
+        if (app.fifo) {
+            app.fifo->Join();
+        }
+        if (!app.unix_path.empty() && !app.handed_off) {
+            Afina::Network::UnlinkUnix(app.unix_path);
+        }
+        if (!app.local_path.empty() && !app.handed_off) {
+            Afina::Network::UnlinkUnix(app.local_path);
+        }
+
+        // Final snapshot, Stop waits until it is written. Periodic one could be still running, then it is waited
+        // for first
+        if (!app.snapshot.empty() && !app.storage->Snapshot(app.snapshot)) {
+            app.storage->Stop();
+            if (!app.storage->Snapshot(app.snapshot)) {
+                std::cerr << "Final snapshot failed" << std::endl;
+            }
+        }
         app.storage->Stop();
 
         std::cout << "Application stopped" << std::endl;
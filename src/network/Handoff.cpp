@@ -0,0 +1,105 @@
+#include "Handoff.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace Afina {
+namespace Network {
+
+namespace {
+
+// Way more than any server listens on
+const size_t kMaxSockets = 64;
+
+} // namespace
+
+// See Handoff.h
+void SendSockets(int channel, const std::vector<int> &sockets) {
+    if (sockets.empty() || sockets.size() > kMaxSockets) {
+        throw std::runtime_error("Can't hand off " + std::to_string(sockets.size()) + " sockets");
+    }
+
+    uint32_t count = sockets.size();
+    struct iovec iov;
+    iov.iov_base = &count;
+    iov.iov_len = sizeof(count);
+
+    char control[CMSG_SPACE(kMaxSockets * sizeof(int))];
+    std::memset(control, 0, sizeof(control));
+
+    struct msghdr message;
+    std::memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = CMSG_SPACE(sockets.size() * sizeof(int));
+
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sockets.size() * sizeof(int));
+    std::memcpy(CMSG_DATA(header), sockets.data(), sockets.size() * sizeof(int));
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(channel, &message, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    if (sent != sizeof(count)) {
+        throw std::runtime_error(std::string("Can't send sockets: ") + strerror(errno));
+    }
+}
+
+// See Handoff.h
+std::vector<int> ReceiveSockets(int channel) {
+    uint32_t count = 0;
+    struct iovec iov;
+    iov.iov_base = &count;
+    iov.iov_len = sizeof(count);
+
+    char control[CMSG_SPACE(kMaxSockets * sizeof(int))];
+    struct msghdr message;
+    std::memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    ssize_t got;
+    do {
+        got = recvmsg(channel, &message, MSG_CMSG_CLOEXEC);
+    } while (got < 0 && errno == EINTR);
+    if (got < 0) {
+        throw std::runtime_error(std::string("Can't receive sockets: ") + strerror(errno));
+    }
+
+    std::vector<int> sockets;
+    for (struct cmsghdr *header = CMSG_FIRSTHDR(&message); header != nullptr;
+         header = CMSG_NXTHDR(&message, header)) {
+        if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS) {
+            size_t received = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            const char *data = reinterpret_cast<const char *>(CMSG_DATA(header));
+            for (size_t i = 0; i < received; i++) {
+                int socket;
+                std::memcpy(&socket, data + i * sizeof(int), sizeof(int));
+                sockets.push_back(socket);
+            }
+        }
+    }
+
+    if (got != sizeof(count) || sockets.size() != count || (message.msg_flags & MSG_CTRUNC) != 0) {
+        for (int socket : sockets) {
+            close(socket);
+        }
+        throw std::runtime_error("Incomplete sockets handoff");
+    }
+    return sockets;
+}
+
+} // namespace Network
+} // namespace Afina
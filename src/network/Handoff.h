@@ -0,0 +1,32 @@
+#ifndef AFINA_NETWORK_HANDOFF_H
+#define AFINA_NETWORK_HANDOFF_H
+
+#include <vector>
+
+namespace Afina {
+namespace Network {
+
+/**
+ * # Listening sockets handoff
+ * Passes descriptors between processes over a unix socket as SCM_RIGHTS ancillary data. Receiver gets its own
+ * descriptors referring to the same sockets, so connections queued on them aren't lost while the sender closes
+ * its copies.
+ *
+ * Message is a number of sockets followed by that many descriptors in one sendmsg.
+ */
+
+/**
+ * Sends sockets over the channel, throws std::runtime_error if that fails
+ */
+void SendSockets(int channel, const std::vector<int> &sockets);
+
+/**
+ * Receives sockets sent by SendSockets, throws std::runtime_error if that fails. Received descriptors are
+ * close-on-exec
+ */
+std::vector<int> ReceiveSockets(int channel);
+
+} // namespace Network
+} // namespace Afina
+
+#endif // AFINA_NETWORK_HANDOFF_H
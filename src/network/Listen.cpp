@@ -0,0 +1,121 @@
+#include "Listen.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace Afina {
+namespace Network {
+
+namespace {
+
+const int kBacklog = 511;
+
+// Fills address, returns its length. Abstract name starts with zero byte and isn't zero terminated
+socklen_t UnixAddress(const std::string &path, struct sockaddr_un &address) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path == "@" || path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Bad unix socket path: " + path);
+    }
+    std::memcpy(address.sun_path, path.data(), path.size());
+    if (path[0] != '@') {
+        return sizeof(address);
+    }
+    address.sun_path[0] = '\0';
+    return offsetof(struct sockaddr_un, sun_path) + path.size();
+}
+
+// Whenever somebody accepts on the socket file
+bool InUse(const struct sockaddr_un &address, socklen_t length) {
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe < 0) {
+        return true;
+    }
+    bool accepting = connect(probe, reinterpret_cast<const struct sockaddr *>(&address), length) == 0 ||
+                     errno != ECONNREFUSED;
+    close(probe);
+    return accepting;
+}
+
+} // namespace
+
+// See Listen.h
+int ListenTcp(uint16_t port) {
+    struct sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = INADDR_ANY;
+
+    int server_socket = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+    if (server_socket < 0) {
+        throw std::runtime_error(std::string("Failed to open socket: ") + strerror(errno));
+    }
+
+    int on = 1;
+    if (setsockopt(server_socket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0 ||
+        bind(server_socket, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0 ||
+        listen(server_socket, kBacklog) != 0) {
+        std::string error = strerror(errno);
+        close(server_socket);
+        throw std::runtime_error("Can't listen on port " + std::to_string(port) + ": " + error);
+    }
+    return server_socket;
+}
+
+// See Listen.h
+int ListenUnix(const std::string &path, int mode) {
+    struct sockaddr_un address;
+    socklen_t length = UnixAddress(path, address);
+    bool abstract = path[0] == '@';
+
+    if (!abstract) {
+        struct stat info;
+        if (lstat(path.c_str(), &info) == 0) {
+            if (!S_ISSOCK(info.st_mode)) {
+                throw std::runtime_error(path + " exists and isn't a socket");
+            }
+            if (InUse(address, length)) {
+                throw std::runtime_error(path + " is in use");
+            }
+            unlink(path.c_str());
+        }
+    }
+
+    int server_socket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (server_socket < 0) {
+        throw std::runtime_error(std::string("Failed to open socket: ") + strerror(errno));
+    }
+
+    // Nobody could connect before listen, so permissions are in place by the time anybody does
+    if (bind(server_socket, reinterpret_cast<struct sockaddr *>(&address), length) != 0) {
+        std::string error = strerror(errno);
+        close(server_socket);
+        throw std::runtime_error("Can't bind " + path + ": " + error);
+    }
+    if ((!abstract && mode >= 0 && chmod(path.c_str(), mode) != 0) || listen(server_socket, kBacklog) != 0) {
+        std::string error = strerror(errno);
+        close(server_socket);
+        UnlinkUnix(path);
+        throw std::runtime_error("Can't listen on " + path + ": " + error);
+    }
+    return server_socket;
+}
+
+// See Listen.h
+void UnlinkUnix(const std::string &path) {
+    if (!path.empty() && path[0] != '@') {
+        unlink(path.c_str());
+    }
+}
+
+} // namespace Network
+} // namespace Afina
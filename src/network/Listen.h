@@ -0,0 +1,38 @@
+#ifndef AFINA_NETWORK_LISTEN_H
+#define AFINA_NETWORK_LISTEN_H
+
+#include <cstdint>
+#include <string>
+
+namespace Afina {
+namespace Network {
+
+/**
+ * # Listening sockets
+ * Sockets to be passed to Server::Start, so any server could accept on several of them at once, e.g. TCP port
+ * for remote clients and unix socket for the ones on the same host, which skip TCP/IP stack altogether.
+ */
+
+/**
+ * Listens on TCP port of all interfaces, throws std::runtime_error if that fails
+ */
+int ListenTcp(uint16_t port);
+
+/**
+ * Listens on unix socket, throws std::runtime_error if that fails. Path starting with '@' names a socket in
+ * the abstract namespace, which has no file and goes away with the last process holding it.
+ *
+ * Socket file left by a process which has crashed is replaced, file of a socket somebody still accepts on is
+ * not. File gets given permissions before clients could connect, negative mode leaves them to umask
+ */
+int ListenUnix(const std::string &path, int mode = -1);
+
+/**
+ * Removes socket file, nothing to do for abstract namespace
+ */
+void UnlinkUnix(const std::string &path);
+
+} // namespace Network
+} // namespace Afina
+
+#endif // AFINA_NETWORK_LISTEN_H
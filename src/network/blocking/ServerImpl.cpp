@@ -1,7 +1,9 @@
 #include "ServerImpl.h"
 
 #include <cassert>
+#include <cerrno>
 #include <cstring>
+#include <future>
 #include <iostream>
 #include <memory>
 #include <stdexcept>
@@ -10,8 +12,10 @@
 #include <signal.h>
 
 #include <netdb.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
@@ -86,71 +90,6 @@ void ServerImpl::Start(uint32_t port, uint16_t n_workers) {
         throw std::runtime_error("Unable to mask SIGPIPE");
     }
 
-    // Setup server parameters BEFORE thread created, that will guarantee
-    // variable value visibility
-    max_workers = n_workers;
-    listen_port = port;
-
-    // The pthread_create function creates a new thread.
-    //
-    // The first parameter is a pointer to a pthread_t variable, which we can
-    // use
-    // in the remainder of the program to manage this thread.
-    //
-    // The second parameter is used to specify the attributes of this new thread
-    // (e.g., its stack size). We can leave it NULL here.
-    //
-    // The third parameter is the function this thread will run. This function
-    // *must*
-    // have the following prototype:
-    //    void *f(void *args);
-    //
-    // Note how the function expects a single parameter of type void*. We are
-    // using it to
-    // pass this pointer in order to proxy call to the class member function.
-    // The fourth
-    // parameter to pthread_create is used to specify this parameter value.
-    //
-    // The thread we are creating here is the "server thread", which will be
-    // responsible for listening on port 23300 for incoming connections. This
-    // thread,
-    // in turn, will spawn threads to service each incoming connection, allowing
-    // multiple clients to connect simultaneously.
-    // Note that, in this particular example, creating a "server thread" is
-    // redundant,
-    // since there will only be one server thread, and the program's main thread
-    // (the
-    // one running main()) could fulfill this purpose.
-    running.store(true);
-    if (pthread_create(&accept_thread, NULL, ServerImpl::RunAcceptorProxy,
-                       this) < 0) {
-        throw std::runtime_error("Could not create server thread");
-    }
-}
-
-// See Server.h
-//all workers are signalled to stop
-void ServerImpl::Stop() {
-    std::cout << "network debug: " << __PRETTY_FUNCTION__ << std::endl;
-    running.store(false);
-    Join();
-}
-
-// See Server.h
-//block thread until all threads stop
-void ServerImpl::Join() {
-    std::cout << "network debug: " << __PRETTY_FUNCTION__ << std::endl;
-    pthread_join(accept_thread, 0);
-    std::unique_lock<std::mutex> lock(connections_mutex);
-    while (!connections.empty()) {
-        connections_cv.wait(lock);
-    }
-}
-
-// See Server.h
-void ServerImpl::RunAcceptor() {
-    std::cout << "network debug: " << __PRETTY_FUNCTION__ << std::endl;
-
     // For IPv4 we use struct sockaddr_in:
     // struct sockaddr_in {
     //     short int          sin_family;  // Address family, AF_INET
@@ -164,7 +103,7 @@ void ServerImpl::RunAcceptor() {
     struct sockaddr_in server_addr;
     std::memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;           // IPv4
-    server_addr.sin_port = htons(listen_port);  // TCP port number
+    server_addr.sin_port = htons(port);         // TCP port number
     server_addr.sin_addr.s_addr = INADDR_ANY;   // Bind to any address
 
     // Arguments are:
@@ -217,19 +156,120 @@ void ServerImpl::RunAcceptor() {
         throw std::runtime_error("Socket listen() failed");
     }
 
+    max_workers = n_workers;
+    server_sockets.push_back(server_socket);
+    StartAcceptor();
+}
+
+// See Server.h
+void ServerImpl::Start(const std::vector<int> &sockets, uint16_t n_workers) {
+    std::cout << "network debug: " << __PRETTY_FUNCTION__ << std::endl;
+
+    sigset_t sig_mask;
+    sigemptyset(&sig_mask);
+    sigaddset(&sig_mask, SIGPIPE);
+    if (pthread_sigmask(SIG_BLOCK, &sig_mask, NULL) != 0) {
+        throw std::runtime_error("Unable to mask SIGPIPE");
+    }
+
+    max_workers = n_workers;
+    server_sockets = sockets;
+    StartAcceptor();
+}
+
+void ServerImpl::StartAcceptor() {
+    // Server parameters are set up BEFORE thread is created, that guarantees
+    // variable value visibility
+    //
+    // The pthread_create function creates a new thread.
+    //
+    // The first parameter is a pointer to a pthread_t variable, which we can
+    // use
+    // in the remainder of the program to manage this thread.
+    //
+    // The second parameter is used to specify the attributes of this new thread
+    // (e.g., its stack size). We can leave it NULL here.
+    //
+    // The third parameter is the function this thread will run. This function
+    // *must*
+    // have the following prototype:
+    //    void *f(void *args);
+    //
+    // Note how the function expects a single parameter of type void*. We are
+    // using it to
+    // pass this pointer in order to proxy call to the class member function.
+    // The fourth
+    // parameter to pthread_create is used to specify this parameter value.
+    //
+    // The thread we are creating here is the "server thread", which will be
+    // responsible for listening on port 23300 for incoming connections. This
+    // thread,
+    // in turn, will spawn threads to service each incoming connection, allowing
+    // multiple clients to connect simultaneously.
+    // Note that, in this particular example, creating a "server thread" is
+    // redundant,
+    // since there will only be one server thread, and the program's main thread
+    // (the
+    // one running main()) could fulfill this purpose.
+    running.store(true);
+    if (pthread_create(&accept_thread, NULL, ServerImpl::RunAcceptorProxy,
+                       this) < 0) {
+        throw std::runtime_error("Could not create server thread");
+    }
+}
+
+// See Server.h
+//all workers are signalled to stop
+void ServerImpl::Stop() {
+    std::cout << "network debug: " << __PRETTY_FUNCTION__ << std::endl;
+    running.store(false);
+    Join();
+}
+
+// See Server.h
+//block thread until all threads stop
+void ServerImpl::Join() {
+    std::cout << "network debug: " << __PRETTY_FUNCTION__ << std::endl;
+    pthread_join(accept_thread, 0);
+    std::unique_lock<std::mutex> lock(connections_mutex);
+    while (!connections.empty()) {
+        connections_cv.wait(lock);
+    }
+}
+
+// See Server.h
+void ServerImpl::RunAcceptor() {
+    std::cout << "network debug: " << __PRETTY_FUNCTION__ << std::endl;
+
+    // Server could listen on several sockets, e.g. TCP port and unix socket,
+    // poll tells which one has a connection waiting
+    std::vector<struct pollfd> fds(server_sockets.size());
+    for (size_t i = 0; i < server_sockets.size(); i++) {
+        fds[i].fd = server_sockets[i];
+        fds[i].events = POLLIN;
+    }
+
     int client_socket;
-    struct sockaddr_in client_addr;
-    socklen_t sinSize = sizeof(struct sockaddr_in);
     while (running.load()) {
         std::cout << "network debug: waiting for connection..." << std::endl;
 
-        // When an incoming connection arrives, accept it. The call to accept()
-        // blocks until
-        // the incoming connection arrives
-        if ((client_socket = accept(
-                 server_socket, (struct sockaddr *)&client_addr, &sinSize)) ==
-            -1) {
-            close(client_socket);
+        // Blocks until the incoming connection arrives
+        if (poll(fds.data(), fds.size(), -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("Socket poll() failed");
+        }
+        int server_socket = -1;
+        for (auto &fd : fds) {
+            if (fd.revents != 0) {
+                server_socket = fd.fd;
+                break;
+            }
+        }
+
+        // Peer address is of no use, and its type depends on the socket
+        if ((client_socket = accept(server_socket, nullptr, nullptr)) == -1) {
             throw std::runtime_error("Socket accept() failed");
         }
 
@@ -266,7 +306,9 @@ void ServerImpl::RunAcceptor() {
     }
 
     // Cleanup on exit...
-    close(server_socket);
+    for (int server_socket : server_sockets) {
+        close(server_socket);
+    }
 }
 
 // See Server.h
@@ -277,16 +319,17 @@ void ServerImpl::RunConnection(int client_socket) {
     ssize_t read_length = 0;
     ssize_t read_counter = 0;
     ssize_t sent_length = 0;
-    ssize_t sent_counter = 0;
     size_t parsed_length = 0;
-    ssize_t answer_size = 0;
     bool command_is_parsed = false;
     Protocol::Parser parser;
     uint32_t command_body_size;
     std::unique_ptr<Execute::Command> resulting_command;
     std::string arguments;
     std::string answer = "";
+    Execute::Response response(OUTPUT_BUDGET);
+    struct iovec iov[IOV_SIZE];
     bool no_errors = true;
+    bool pending = false;
 
     while (running.load() && no_errors) {
         try {
@@ -309,37 +352,62 @@ void ServerImpl::RunConnection(int client_socket) {
 
             answer = std::string("Problem when extracting arguments ");
 
+            // Size comes from the client, storage checks it before allocating
+            bool too_large = !pStorage->Reserve(command_body_size, arguments);
             if (!ExtractArguments(client_socket, chunk, read_counter,
-                                  command_body_size, arguments)) {
+                                  command_body_size, arguments, too_large)) {
                 Close(client_socket);
                 return;
             }
             answer = std::string("Problem when executing command ");
 
-            resulting_command->Execute(*pStorage, arguments, answer);
+            response.Clear();
+            if (too_large) {
+                response.Append("SERVER_ERROR object too large for cache");
+                pending = false;
+            } else {
+                resulting_command->Execute(*pStorage, arguments, response);
+
+                // Reply to mutation only once changes are durable, connection has a thread of its own to wait in
+                if (resulting_command->Mutating()) {
+                    std::promise<void> durable;
+                    pStorage->WhenDurable([&durable]() { durable.set_value(); });
+                    durable.get_future().wait();
+                }
+                if (resulting_command->noreply()) {
+                    continue;
+                }
+                pending = resulting_command->Pending();
+            }
         } catch (std::runtime_error &ex) {
-            answer = std::string("ERROR ") + answer + ex.what() +
-                     std::string("\r\n");
+            response.Clear();
+            response.Append(std::string("ERROR ") + answer + ex.what() +
+                            std::string("\r\n"));
             no_errors = false;
+            pending = false;
         }
 
-        answer += std::string("\r\n");
+        // send answer, value slices go straight from the storage. Big
+        // response is produced by portions, each once previous one is sent
+        while (true) {
+            if (!pending) {
+                response.Append("\r\n", 2);
+            }
 
-        // send answer
-        answer_size = answer.size();
-        if (answer.size() > 0) {
-            answer_size = answer.size();
-            sent_counter = 0;
-            while (answer_size > 0) {
-                sent_length = send(client_socket, answer.data() + sent_counter,
-                                   answer.size() - sent_counter, 0);
+            while (!response.Empty()) {
+                sent_length = writev(client_socket, iov, response.Gather(iov, IOV_SIZE));
                 if (sent_length <= 0) {
                     Close(client_socket);
                     return;
                 }
-                answer_size -= sent_length;
-                sent_counter += sent_length;
+                response.Consume(sent_length);
+            }
+
+            if (!pending) {
+                break;
             }
+            resulting_command->Continue(*pStorage, response);
+            pending = resulting_command->Pending();
         }
     }
 
@@ -350,6 +418,17 @@ bool ServerImpl::ReadCommand(int client_socket, char *chunk,
                              ssize_t &read_counter, ssize_t &read_length,
                              size_t &parsed_length, bool &command_is_parsed,
                              Protocol::Parser &parser) {
+    // Chunk could already hold the next command, which has been received
+    // along with the previous data block
+    if (read_counter > 0) {
+        command_is_parsed = parser.Parse(chunk, read_counter, parsed_length);
+        std::memmove(chunk, chunk + parsed_length, read_counter - parsed_length);
+        read_counter -= parsed_length;
+        if (command_is_parsed) {
+            return true;
+        }
+    }
+
     read_length =
         recv(client_socket, chunk + read_counter, CHUNK_SIZE - read_counter, 0);
     read_counter += read_length;
@@ -383,35 +462,59 @@ bool ServerImpl::ReadCommand(int client_socket, char *chunk,
     return true;
 }
 
+// Data block is received straight into the buffer reserved by storage, only bytes that came along with
+// the command header are copied from the chunk. Skipped data block goes through the chunk
 bool ServerImpl::ExtractArguments(int client_socket, char *chunk,
                                   ssize_t &read_counter,
                                   uint32_t &command_body_size,
-                                  std::string &arguments) {
-    if (command_body_size) {
-        command_body_size += 2;  // \r\n
+                                  std::string &arguments, bool skip) {
+    if (command_body_size == 0) {
+        arguments.clear();
+        return true;
+    }
+
+    size_t received = std::min<size_t>(read_counter, command_body_size);
+    if (!skip) {
+        std::memcpy(&arguments[0], chunk, received);
     }
-    while (command_body_size > read_counter) {
-        arguments.append(chunk, read_counter);
-        command_body_size -= read_counter;
-        read_counter = recv(client_socket, chunk, CHUNK_SIZE * sizeof(char), 0);
-        if (read_counter < 0) {
+    std::memmove(chunk, chunk + received, read_counter - received);
+    read_counter -= received;
+
+    while (received < command_body_size) {
+        ssize_t read_length =
+            skip ? recv(client_socket, chunk,
+                        std::min<size_t>(CHUNK_SIZE, command_body_size - received), 0)
+                 : recv(client_socket, &arguments[received],
+                        command_body_size - received, 0);
+        if (read_length < 0) {
             Close(client_socket);
             throw std::runtime_error("Socket recv() failed");
-
         }
-        if (read_counter == 0) {
+        if (read_length == 0) {
             // ok but message is empty
             return false;
         }
+        received += read_length;
     }
 
-    arguments.append(chunk, command_body_size);
-    std::memmove(chunk, chunk + command_body_size,
-                 read_counter - command_body_size);
-    read_counter -= command_body_size;
-    if (command_body_size > 2) {
-        arguments = arguments.substr(0, command_body_size - 2);  // \r\n
+    // Data block trailer \r\n
+    while (read_counter < 2) {
+        ssize_t read_length = recv(client_socket, chunk + read_counter,
+                                   CHUNK_SIZE - read_counter, 0);
+        if (read_length < 0) {
+            Close(client_socket);
+            throw std::runtime_error("Socket recv() failed");
+        }
+        if (read_length == 0) {
+            return false;
+        }
+        read_counter += read_length;
+    }
+    if (chunk[0] != '\r' || chunk[1] != '\n') {
+        throw std::runtime_error("Invalid data block trailer, \\r\\n expected");
     }
+    std::memmove(chunk, chunk + 2, read_counter - 2);
+    read_counter -= 2;
 
     return true;
 }
@@ -6,6 +6,7 @@
 #include <condition_variable>
 #include <mutex>
 #include <unordered_set>
+#include <vector>
 
 #include <afina/network/Server.h>
 #include "../../protocol/Parser.h"
@@ -26,6 +27,9 @@ class ServerImpl : public Server {
     // See Server.h
     void Start(uint32_t port, uint16_t workers) override;
 
+    // See Server.h
+    void Start(const std::vector<int> &sockets, uint16_t workers) override;
+
     // See Server.h
     void Stop() override;
 
@@ -45,12 +49,18 @@ class ServerImpl : public Server {
     bool ReadCommand(int client_socket, char *chunk, ssize_t &read_counter,
                      ssize_t &read_length, size_t &parsed_length,
                      bool &command_is_parsed, Protocol::Parser &parser);
+    // Receives data block into arguments, data block is read and dropped if
+    // skip is set
     bool ExtractArguments(int client_socket, char *chunk, ssize_t &read_counter,
-                          uint32_t &command_body_size, std::string &arguments);
+                          uint32_t &command_body_size, std::string &arguments,
+                          bool skip);
 
     void Close(int client_socket);
 
    private:
+    // Spawns acceptor thread once listening sockets are ready
+    void StartAcceptor();
+
     static void *RunAcceptorProxy(void *p);
     static void *RunConnectionProxy(void *p);
 
@@ -67,10 +77,10 @@ class ServerImpl : public Server {
     // Read-only
     uint16_t max_workers;
 
-    // Port to listen for new connections, permits access only from
+    // Sockets to accept new connections on, permits access only from
     // inside of accept_thread
     // Read-only
-    uint32_t listen_port;
+    std::vector<int> server_sockets;
 
     // Mutex used to access connections list
     std::mutex connections_mutex;
@@ -84,6 +94,12 @@ class ServerImpl : public Server {
     std::unordered_set<pthread_t> connections;
 
     const size_t CHUNK_SIZE = 2048;
+
+    // Max number of response fragments passed to a single writev
+    static const size_t IOV_SIZE = 64;
+
+    // Connection output budget, bigger responses are streamed
+    static const size_t OUTPUT_BUDGET = 256 * 1024;
     // needed for passing arguments in pthread_create like
     // http://man7.org/linux/man-pages/man3/pthread_create.3.html
     struct ConnectionThreadInfo {
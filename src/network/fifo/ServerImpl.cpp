@@ -0,0 +1,300 @@
+#include "ServerImpl.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <afina/Storage.h>
+
+namespace Afina {
+namespace Network {
+namespace Fifo {
+
+namespace {
+
+// Opens FIFO, creates it if there is no file. Reading and writing mode keeps open from waiting for the peer
+int OpenFifo(const std::string &path) {
+    if (mkfifo(path.c_str(), 0600) != 0 && errno != EEXIST) {
+        throw std::runtime_error("Can't create FIFO " + path + ": " + strerror(errno));
+    }
+    int fd = open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Can't open " + path + ": " + strerror(errno));
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISFIFO(info.st_mode)) {
+        close(fd);
+        throw std::runtime_error(path + " isn't a FIFO");
+    }
+
+    // Limit for unprivileged process is in /proc/sys/fs/pipe-max-size, pipe gets as much as it allows
+    for (size_t size = ServerImpl::kPipeSize; size > 4096 && fcntl(fd, F_SETPIPE_SZ, size) < 0; size /= 2) {
+    }
+    return fd;
+}
+
+} // namespace
+
+const size_t ServerImpl::kPipeSize;
+const size_t ServerImpl::kSpliceMin;
+const size_t ServerImpl::kMaxOutput;
+
+// See ServerImpl.h
+ServerImpl::ServerImpl(std::shared_ptr<Afina::Storage> storage)
+    : _storage(storage), _read_fd(-1), _write_fd(-1), _wakeup_fd(-1), _position(0), _body_size(0), _waiting(false),
+      _durable(false), _written(0), _running(false) {}
+
+// See ServerImpl.h
+ServerImpl::~ServerImpl() {}
+
+// See ServerImpl.h
+void ServerImpl::Start(const std::string &read_path, const std::string &write_path) {
+    _read_fd = OpenFifo(read_path);
+    try {
+        if (!write_path.empty()) {
+            _write_fd = OpenFifo(write_path);
+        }
+    } catch (std::runtime_error &) {
+        close(_read_fd);
+        _read_fd = -1;
+        throw;
+    }
+
+    _wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_wakeup_fd < 0) {
+        throw std::runtime_error("Can't create wakeup eventfd");
+    }
+
+    _chunk.reset(new char[kPipeSize]);
+    _running.store(true);
+    _thread = std::thread(&ServerImpl::OnRun, this);
+}
+
+// See ServerImpl.h
+void ServerImpl::Stop() {
+    _running.store(false);
+    uint64_t wakeup = 1;
+    if (write(_wakeup_fd, &wakeup, sizeof(wakeup)) < 0) {
+        std::cerr << "Can't wake FIFO frontend up" << std::endl;
+    }
+}
+
+// See ServerImpl.h
+void ServerImpl::Join() {
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+    if (_read_fd >= 0) {
+        close(_read_fd);
+        if (_write_fd >= 0) {
+            close(_write_fd);
+        }
+        close(_wakeup_fd);
+        _read_fd = _write_fd = _wakeup_fd = -1;
+    }
+}
+
+void ServerImpl::OnRun() {
+    _thread_id = std::this_thread::get_id();
+
+    while (_running.load()) {
+        if (_durable.exchange(false)) {
+            Release();
+        }
+        ReadInput();
+        WriteOutput();
+
+        // Input is readable till the end of time while replies don't fit, they are waited for instead
+        struct pollfd fds[3];
+        fds[0].fd = _wakeup_fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = _read_fd;
+        fds[1].events = Buffered() < kMaxOutput ? POLLIN : 0;
+        fds[2].fd = _write_fd;
+        fds[2].events = _output.Empty() ? 0 : POLLOUT;
+        if (poll(fds, 3, -1) < 0 && errno != EINTR) {
+            std::cerr << "FIFO frontend poll failed: " << strerror(errno) << std::endl;
+            break;
+        }
+        if (fds[0].revents != 0) {
+            uint64_t value;
+            if (read(_wakeup_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+                std::cerr << "Can't read eventfd: " << strerror(errno) << std::endl;
+            }
+        }
+    }
+
+    // Whatever fits into the pipe is left for the reader
+    WriteOutput();
+}
+
+bool ServerImpl::ReadInput() {
+    // Commands left unprocessed while replies didn't fit go first, nothing is going to be read after them
+    ProcessInput();
+    Hold();
+
+    while (Buffered() < kMaxOutput) {
+        ssize_t got = read(_read_fd, _chunk.get(), kPipeSize);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            if (got < 0 && errno != EAGAIN) {
+                std::cerr << "Can't read FIFO: " << strerror(errno) << std::endl;
+            }
+            return false;
+        }
+
+        _input.append(_chunk.get(), got);
+        ProcessInput();
+        Hold();
+    }
+    return true;
+}
+
+void ServerImpl::ProcessInput() {
+    while (Buffered() < kMaxOutput) {
+        try {
+            if (!_command) {
+                size_t parsed = 0;
+                bool complete = _position < _input.size() &&
+                                _parser.Parse(&_input[_position], _input.size() - _position, parsed);
+                _position += parsed;
+                if (!complete) {
+                    break;
+                }
+                _command = _parser.Build(_body_size);
+                _parser.Reset();
+            }
+
+            // Data block is followed by \r\n
+            std::string args;
+            if (_body_size > 0) {
+                if (_input.size() - _position < _body_size + 2) {
+                    break;
+                }
+                if (_input.compare(_position + _body_size, 2, "\r\n") != 0) {
+                    throw std::runtime_error("Invalid data block trailer, \\r\\n expected");
+                }
+                args.assign(_input, _position, _body_size);
+                _position += _body_size + 2;
+            }
+
+            std::unique_ptr<Execute::Command> command = std::move(_command);
+            Execute::Response response;
+            command->Execute(*_storage, args, response);
+            while (command->Pending()) {
+                command->Continue(*_storage, response);
+            }
+            if (!command->noreply() && _write_fd >= 0) {
+                _held.Append(std::move(response));
+                _held.Append("\r\n", 2);
+            }
+        } catch (std::runtime_error &ex) {
+            // Stream can't be resynchronized after garbage, whatever is received is dropped
+            if (_write_fd >= 0) {
+                _held.Append(std::string("SERVER_ERROR ") + ex.what() + "\r\n");
+            }
+            _command.reset();
+            _parser.Reset();
+            _input.clear();
+            _position = 0;
+            return;
+        }
+    }
+
+    _input.erase(0, _position);
+    _position = 0;
+}
+
+bool ServerImpl::WriteOutput() {
+    const size_t max_iov = 64;
+    struct iovec iov[max_iov];
+    std::shared_ptr<const std::string> slices[max_iov];
+
+    while (!_output.Empty()) {
+        // Short pieces before the first large value are copied by one call, the value goes by reference
+        size_t count = _output.Gather(iov, slices, max_iov);
+        size_t copied = 0;
+        while (copied < count && !(slices[copied] && iov[copied].iov_len >= kSpliceMin)) {
+            copied++;
+        }
+
+        ssize_t written;
+        if (copied > 0) {
+            written = writev(_write_fd, iov, copied);
+        } else {
+            written = vmsplice(_write_fd, iov, 1, SPLICE_F_NONBLOCK);
+            if (written > 0) {
+                _pinned.emplace_back(_written + written, slices[0]);
+            }
+        }
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN) {
+                std::cerr << "Can't write FIFO, replies are dropped: " << strerror(errno) << std::endl;
+                _output.Clear();
+            }
+            break;
+        }
+        _written += written;
+        _output.Consume(written);
+    }
+
+    Unpin();
+    return _output.Empty();
+}
+
+void ServerImpl::Unpin() {
+    int unread = 0;
+    if (_pinned.empty() || ioctl(_write_fd, FIONREAD, &unread) != 0) {
+        return;
+    }
+    while (!_pinned.empty() && _pinned.front().first + unread <= _written) {
+        _pinned.pop_front();
+    }
+}
+
+void ServerImpl::Hold() {
+    if (_waiting || _held.Empty()) {
+        return;
+    }
+    _waiting = true;
+    _holding.Append(std::move(_held));
+
+    // Storage could call back right away on this thread or later on its own one
+    _storage->WhenDurable([this]() {
+        if (std::this_thread::get_id() == _thread_id) {
+            Release();
+            return;
+        }
+        _durable.store(true);
+        uint64_t wakeup = 1;
+        if (write(_wakeup_fd, &wakeup, sizeof(wakeup)) < 0) {
+            std::cerr << "Can't wake FIFO frontend up" << std::endl;
+        }
+    });
+}
+
+void ServerImpl::Release() {
+    _waiting = false;
+    _output.Append(std::move(_holding));
+    Hold();
+}
+
+} // namespace Fifo
+} // namespace Network
+} // namespace Afina
@@ -0,0 +1,129 @@
+#ifndef AFINA_NETWORK_FIFO_SERVER_IMPL_H
+#define AFINA_NETWORK_FIFO_SERVER_IMPL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <afina/execute/Command.h>
+#include <afina/execute/Response.h>
+
+#include "protocol/Parser.h"
+
+namespace Afina {
+
+class Storage;
+
+namespace Network {
+namespace Fifo {
+
+/**
+ * # Named pipe frontend
+ * Reads commands from one FIFO and writes replies into another, for batch loaders on the same host streaming
+ * lots of commands without any connection to set up. Whatever is written into the FIFO is one endless
+ * stream: writers could come and go, commands are parsed and executed exactly as they are for sockets.
+ *
+ * Both FIFOs are opened for reading and writing, so opening neither blocks nor fails while the other side
+ * isn't there, and the last writer going away isn't EOF. Replies stay in the pipe until somebody reads them,
+ * nothing more is read from the input while they don't fit.
+ *
+ * Pipes are enlarged to kPipeSize if the system lets it, input is read in chunks of that size. Replies are
+ * written with a single writev as long as they consist of short pieces. Large values are vmspliced: pipe
+ * references pages of the stored value instead of copying them, the value is held until reader has consumed
+ * it (the pipe has less unread bytes than were written after it).
+ */
+class ServerImpl {
+public:
+    explicit ServerImpl(std::shared_ptr<Afina::Storage> storage);
+    ~ServerImpl();
+
+    ServerImpl(const ServerImpl &) = delete;
+    ServerImpl &operator=(const ServerImpl &) = delete;
+
+    /**
+     * Starts serving commands written into read_path, replies go to write_path. FIFO is created if there is
+     * no file, empty write_path means replies are dropped. Throws std::runtime_error if it can't
+     */
+    void Start(const std::string &read_path, const std::string &write_path);
+
+    /**
+     * Signals serving thread to stop, returns immediately
+     */
+    void Stop();
+
+    /**
+     * Blocks until serving thread is stopped
+     */
+    void Join();
+
+    // Size pipe buffers are set to, the largest one unprivileged process could get by default
+    static const size_t kPipeSize = 1 << 20;
+
+    // Values at least that large are vmspliced, shorter ones are cheaper to copy than to reference a page for
+    static const size_t kSpliceMin = 16 << 10;
+
+private:
+    // Nothing more is read while that many reply bytes wait to be written
+    static const size_t kMaxOutput = 4 * kPipeSize;
+
+    void OnRun();
+
+    // Reads and executes whatever is there while replies fit, returns false if input is exhausted
+    bool ReadInput();
+    void ProcessInput();
+
+    // Writes replies until pipe is full, returns false if something is left
+    bool WriteOutput();
+
+    // Releases values reader has consumed
+    void Unpin();
+
+    // Asks storage to tell once replies held so far could be written
+    void Hold();
+    void Release();
+
+    size_t Buffered() const { return _output.Size() + _held.Size() + _holding.Size(); }
+
+    std::shared_ptr<Afina::Storage> _storage;
+    std::thread::id _thread_id;
+
+    int _read_fd;
+    int _write_fd;
+    int _wakeup_fd;
+
+    // Buffer single read goes into, received bytes, how far they are parsed
+    std::unique_ptr<char[]> _chunk;
+    std::string _input;
+    size_t _position;
+
+    // Command which header is parsed, it waits for its data block
+    Protocol::Parser _parser;
+    std::unique_ptr<Execute::Command> _command;
+    uint32_t _body_size;
+
+    // Replies ready to be written, replies durability is requested for and ones produced meanwhile
+    Execute::Response _output;
+    Execute::Response _holding;
+    Execute::Response _held;
+    bool _waiting;
+
+    // Storage has called back from another thread
+    std::atomic<bool> _durable;
+
+    // Vmspliced values with number of bytes written into pipe by the end of each
+    std::deque<std::pair<uint64_t, std::shared_ptr<const std::string>>> _pinned;
+    uint64_t _written;
+
+    std::atomic<bool> _running;
+    std::thread _thread;
+};
+
+} // namespace Fifo
+} // namespace Network
+} // namespace Afina
+
+#endif // AFINA_NETWORK_FIFO_SERVER_IMPL_H
@@ -1,5 +1,6 @@
 #include "ServerImpl.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <iostream>
@@ -72,12 +73,39 @@ void ServerImpl::Start(uint32_t port, uint16_t n_workers) {
         throw std::runtime_error("Socket listen() failed");
     }
 
+    server_sockets.push_back(server_socket);
     for (int i = 0; i < n_workers; i++) {
         workers.emplace_back(new Worker(pStorage));
         workers.back()->Start(server_socket);
     }
 }
 
+// See Server.h
+void ServerImpl::Start(const std::vector<int> &sockets, uint16_t n_workers) {
+    std::cout << "network debug: " << __PRETTY_FUNCTION__ << std::endl;
+
+    sigset_t sig_mask;
+    sigemptyset(&sig_mask);
+    sigaddset(&sig_mask, SIGPIPE);
+    if (pthread_sigmask(SIG_BLOCK, &sig_mask, NULL) != 0) {
+        throw std::runtime_error("Unable to mask SIGPIPE");
+    }
+
+    server_sockets = sockets;
+    for (int server_socket : server_sockets) {
+        make_socket_non_blocking(server_socket);
+    }
+
+    size_t count = std::max<size_t>(n_workers, server_sockets.size());
+    for (size_t i = 0; i < count; i++) {
+        workers.emplace_back(new Worker(pStorage));
+        workers.back()->Start(server_sockets[i % server_sockets.size()]);
+    }
+}
+
+// See Server.h
+std::vector<int> ServerImpl::ListenSockets() const { return server_sockets; }
+
 // See Server.h
 void ServerImpl::Stop() {
     std::cout << "network debug: " << __PRETTY_FUNCTION__ << std::endl;
@@ -92,6 +120,12 @@ void ServerImpl::Join() {
     for (auto &worker : workers) {
         worker->Join();
     }
+
+    // Only this process copy is closed, socket handed off to another one keeps accepting
+    for (int server_socket : server_sockets) {
+        close(server_socket);
+    }
+    server_sockets.clear();
 }
 
 } // namespace NonBlocking
@@ -25,6 +25,10 @@ public:
     // See Server.h
     void Start(uint32_t port, uint16_t workers) override;
 
+    void Start(const std::vector<int> &sockets, uint16_t workers) override;
+
+    std::vector<int> ListenSockets() const override;
+
     // See Server.h
     void Stop() override;
 
@@ -37,6 +41,9 @@ private:
     // Read-only
     uint32_t listen_port;
 
+    // Listening sockets shared by workers, closed once all of them are joined
+    std::vector<int> server_sockets;
+
     // Thread that is accepting new connections
     std::vector<std::unique_ptr<Worker>> workers;
 };
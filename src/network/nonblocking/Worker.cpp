@@ -1,5 +1,6 @@
 #include "Worker.h"
 
+#include <algorithm>
 #include <memory>
 #include <stdexcept>
 #include <string>
@@ -8,6 +9,7 @@
 #include <fcntl.h>
 #include <signal.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/signalfd.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
@@ -17,6 +19,7 @@
 #include <iostream>
 #include <memory>
 
+#include <afina/Storage.h>
 #include <afina/execute/Command.h>
 #include "../../protocol/Parser.h"
 #include "Utils.h"
@@ -41,10 +44,13 @@ bool Connection::ReadStep(char *start, size_t size) {
 bool Connection::ReadCommandStep() {
     return ReadStep(chunk + read_counter, CHUNK_SIZE - read_counter);
 }
-bool Connection::ExtractArgumentsStep() { return ReadStep(chunk, CHUNK_SIZE); }
+bool Connection::ExtractArgumentsStep() {
+    return ReadStep(&command_body[body_received],
+                    command_body_size - body_received);
+}
 bool Connection::SendAnswerStep() {
-    sent_length = send(socket, answer.data() + sent_counter,
-                       answer.size() - sent_counter, 0);
+    struct iovec iov[IOV_SIZE];
+    sent_length = writev(socket, iov, answer.Gather(iov, IOV_SIZE));
     if (sent_length < 0) {
         if ((errno == EWOULDBLOCK || errno == EAGAIN) && running.load()) {
             result = true;
@@ -133,6 +139,11 @@ bool Connection::SendAnswerStep() {
     return false;
 }*/
 bool Worker::Process(Connection* conn, uint32_t events, epoll_event& event) {
+    // Event is shared by all connections of the worker, it could still point to the one accepted last
+    event.data.ptr = conn;
+    if (conn->state == State::WaitDurable) {
+        return true;
+    }
     while (conn->running.load()) {
         try {
             if (conn->state == State::ReadCommand) {
@@ -151,42 +162,90 @@ bool Worker::Process(Connection* conn, uint32_t events, epoll_event& event) {
                 conn->read_counter -= conn->parsed_length;
 
                 conn->resulting_command = conn->parser.Build(conn->command_body_size);
-                conn->command_body_size += 2;
                 conn->parser.Reset();
 
-                conn->command_body.clear();
+                conn->body_received = 0;
+                conn->too_large = !conn->storage_ptr->Reserve(conn->command_body_size, conn->command_body);
                 conn->state = State::ExtractArguments;
             }
 
             if (conn->state == State::ExtractArguments) {
-                if (conn->command_body_size > 2) {
-                    while (conn->command_body_size > conn->read_counter) {
-                        conn->command_body.append(conn->chunk, conn->read_counter);
-                        conn->command_body_size -= conn->read_counter;
-                        conn->read_counter = 0;
+                if (conn->command_body_size > 0 && conn->too_large) {
+                    // Nowhere to put the value, data block goes through the chunk and gets dropped
+                    while (true) {
+                        size_t skipped = std::min<size_t>(
+                            conn->read_counter, conn->command_body_size - conn->body_received);
+                        std::memmove(conn->chunk, conn->chunk + skipped, conn->read_counter - skipped);
+                        conn->read_counter -= skipped;
+                        conn->body_received += skipped;
+                        if (conn->body_received == conn->command_body_size) {
+                            break;
+                        }
 
+                        if (!conn->ReadCommandStep()) return conn->result;
+
+                        conn->read_counter += conn->read_length;
+                    }
+                } else if (conn->command_body_size > 0) {
+                    // Bytes that came along with the header are copied, the rest of data block is
+                    // received directly into the buffer reserved by storage
+                    if (conn->body_received < conn->command_body_size) {
+                        size_t from_chunk = std::min<size_t>(
+                            conn->read_counter, conn->command_body_size - conn->body_received);
+                        std::memcpy(&conn->command_body[conn->body_received], conn->chunk, from_chunk);
+                        std::memmove(conn->chunk, conn->chunk + from_chunk, conn->read_counter - from_chunk);
+                        conn->read_counter -= from_chunk;
+                        conn->body_received += from_chunk;
+                    }
+
+                    while (conn->body_received < conn->command_body_size) {
                         if (!conn->ExtractArgumentsStep()) return conn->result;
 
-                        conn->read_counter = conn->read_length;
+                        conn->body_received += conn->read_length;
                     }
+                }
 
-                    conn->command_body.append(conn->chunk, conn->command_body_size);
-                    std::memmove(conn->chunk, conn->chunk + conn->command_body_size,
-                                 conn->read_counter - conn->command_body_size);
-                    conn->read_counter -= conn->command_body_size;
+                if (conn->command_body_size > 0) {
+                    // Data block trailer \r\n
+                    while (conn->read_counter < 2) {
+                        if (!conn->ReadCommandStep()) return conn->result;
 
-                    conn->command_body =
-                        conn->command_body.substr(0, conn->command_body.length() - 2);
+                        conn->read_counter += conn->read_length;
+                    }
+                    if (conn->chunk[0] != '\r' || conn->chunk[1] != '\n') {
+                        throw std::runtime_error("Invalid data block trailer, \\r\\n expected");
+                    }
+                    std::memmove(conn->chunk, conn->chunk + 2, conn->read_counter - 2);
+                    conn->read_counter -= 2;
                 }
 
-                conn->resulting_command->Execute(*conn->storage_ptr, conn->command_body, conn->answer);
-                conn->answer.append("\r\n");
+                conn->answer.Clear();
+                if (conn->too_large) {
+                    conn->answer.Append("SERVER_ERROR object too large for cache\r\n");
+                    conn->resulting_command.reset();
+                } else {
+                    conn->resulting_command->Execute(*conn->storage_ptr, conn->command_body, conn->answer);
+                    if (conn->resulting_command->noreply()) {
+                        conn->answer.Clear();
+                        conn->state = State::ReadCommand;
+                        continue;
+                    }
+                    if (!conn->resulting_command->Pending()) {
+                        conn->answer.Append("\r\n", 2);
+                    }
+
+                    // Reply to mutation only once changes are durable
+                    if (conn->resulting_command->Mutating() && !Hold(conn, event)) {
+                        return true;
+                    }
+                }
                 conn->state = State::SendAnswer;
             }
 
         } catch (std::runtime_error &e) {
-            conn->answer =
-                std::string("SERVER_ERROR ") + e.what() + std::string("\r\n");
+            conn->answer.Clear();
+            conn->answer.Append(std::string("SERVER_ERROR ") + e.what() + std::string("\r\n"));
+            conn->resulting_command.reset();
 
             conn->read_counter = 0;
             conn->parser.Reset();
@@ -199,14 +258,22 @@ bool Worker::Process(Connection* conn, uint32_t events, epoll_event& event) {
                 if (epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, conn->socket, &event) == -1) {
                   throw std::runtime_error("Can't add EPOLL_OUT");
                 }
-                if (conn->answer.size() > 2) {
-                    while (conn->sent_counter < conn->answer.size()) {
+                while (true) {
+                    while (!conn->answer.Empty()) {
                         if (!conn->SendAnswerStep()) return conn->result;
 
-                        conn->sent_counter += conn->sent_length;
+                        conn->answer.Consume(conn->sent_length);
+                    }
+
+                    // Big response is produced by portions, each once previous one is sent
+                    if (!conn->resulting_command || !conn->resulting_command->Pending()) {
+                        break;
+                    }
+                    conn->resulting_command->Continue(*conn->storage_ptr, conn->answer);
+                    if (!conn->resulting_command->Pending()) {
+                        conn->answer.Append("\r\n", 2);
                     }
                 }
-                conn->sent_counter = 0;
                 event.events = EPOLLHUP | EPOLLERR | EPOLLIN;
                 if (epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, conn->socket, &event) == -1) {
                   throw std::runtime_error("Can't add EPOLL_OUT");
@@ -217,6 +284,57 @@ bool Worker::Process(Connection* conn, uint32_t events, epoll_event& event) {
     }
     return false;
 }
+bool Worker::Hold(Connection *conn, epoll_event &event) {
+    conn->state = State::WaitDurable;
+
+    // Storage could call back right away on this thread or later on its own one
+    std::weak_ptr<Connection> weak = conn->shared_from_this();
+    conn->storage_ptr->WhenDurable([this, conn, weak]() {
+        if (std::this_thread::get_id() == _thread_id) {
+            conn->state = State::SendAnswer;
+            return;
+        }
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _durable.push_back(weak);
+        }
+        uint64_t wakeup = 1;
+        if (write(_wakeup_fd, &wakeup, sizeof(wakeup)) < 0) {
+            std::cerr << "Can't wake worker up" << std::endl;
+        }
+    });
+    if (conn->state == State::SendAnswer) {
+        return true;
+    }
+
+    // Whatever client sends meanwhile stays in the socket
+    event.data.ptr = conn;
+    event.events = EPOLLHUP | EPOLLERR;
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, conn->socket, &event) == -1) {
+        throw std::runtime_error("Can't remove EPOLLIN");
+    }
+    return false;
+}
+
+void Worker::Release(epoll_event &event) {
+    std::vector<std::weak_ptr<Connection>> durable;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        durable.swap(_durable);
+    }
+    for (auto &weak : durable) {
+        std::shared_ptr<Connection> conn = weak.lock();
+        if (!conn || conn->state != State::WaitDurable) {
+            continue;
+        }
+        conn->state = State::SendAnswer;
+        if (!Process(conn.get(), EPOLLOUT, event)) {
+            epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, conn->socket, NULL);
+            FinishWorkWithClient(conn->socket);
+        }
+    }
+}
+
 // See Worker.h
 Worker::Worker(std::shared_ptr<Afina::Storage> ps) : _storage_ptr(ps) {}
 
@@ -230,6 +348,11 @@ void Worker::Start(int server_socket) {
     _running.store(true);
     _server_socket = server_socket;
 
+    _wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_wakeup_fd < 0) {
+        throw std::runtime_error("Can't create wakeup eventfd");
+    }
+
     // the same way as RunAcceptor in ServerImpl for blocking server
     if (pthread_create(&_thread, nullptr, Worker::RunWorkerProxy,
                        new WorkerInfo(this, _server_socket)) < 0) {
@@ -241,15 +364,17 @@ void Worker::Start(int server_socket) {
 void Worker::Stop() {
     std::cout << "network debug: " << __PRETTY_FUNCTION__ << std::endl;
     _running.store(false);
+    uint64_t wakeup = 1;
+    if (write(_wakeup_fd, &wakeup, sizeof(wakeup)) < 0) {
+        std::cerr << "Can't wake worker up" << std::endl;
+    }
 }
 
 // See Worker.h
 void Worker::Join() {
     std::cout << "network debug: " << __PRETTY_FUNCTION__ << std::endl;
-    shutdown(
-        _server_socket,
-        SHUT_RDWR);  // further receptions and transmissions will be disallowed
     pthread_join(_thread, nullptr);
+    close(_wakeup_fd);
     // If retval is not NULL, then pthread_join() copies the exit status of the
     // target thread (i.e., the value that the target thread supplied to
     // pthread_exit(3)) into the location pointed to by retval.
@@ -268,6 +393,7 @@ void *Worker::RunWorkerProxy(void *p) {
 // See Worker.h
 void Worker::OnRun(int server_socket) {
     std::cout << "network debug: " << __PRETTY_FUNCTION__ << std::endl;
+    _thread_id = std::this_thread::get_id();
 
     // TODO: implementation here
     // 1. Create epoll_context here
@@ -297,6 +423,14 @@ void Worker::OnRun(int server_socket) {
         throw std::runtime_error("Can't add server socket to context");
     }
 
+    // Wakeup has no connection, it only makes epoll_wait return once worker is stopped
+    struct epoll_event wakeup_event;
+    wakeup_event.events = EPOLLIN;
+    wakeup_event.data.ptr = nullptr;
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _wakeup_fd, &wakeup_event) == -1) {
+        throw std::runtime_error("Can't add wakeup eventfd to context");
+    }
+
     // 3. Accept new connections, don't forget to call make_socket_nonblocking
     // on the client socket descriptor
 
@@ -321,6 +455,14 @@ void Worker::OnRun(int server_socket) {
         for (int i = 0; i < events_number; i++) {
             Connection *connection =
                 reinterpret_cast<Connection *>(events_chunk[i].data.ptr);
+            if (connection == nullptr) {
+                uint64_t value;
+                if (read(_wakeup_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+                    std::cerr << "Can't read eventfd: " << strerror(errno) << std::endl;
+                }
+                Release(event);
+                continue;
+            }
             if (connection->socket == _server_socket) {
                 int client_socket = accept(_server_socket, NULL, NULL);
                 if (client_socket == -1) {
@@ -331,7 +473,6 @@ void Worker::OnRun(int server_socket) {
                         // this case, and do not require these constants to have
                         // the same value, so a portable application should
                         // check for both possibilities".
-                        close(_server_socket);
                         epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, _server_socket,
                                   NULL);
                         
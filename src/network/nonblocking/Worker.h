@@ -2,16 +2,20 @@
 #define AFINA_NETWORK_NONBLOCKING_WORKER_H
 
 #include <afina/execute/Command.h>
+#include <afina/execute/Response.h>
 #include <pthread.h>
 #include <sys/epoll.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <atomic>
 #include <cstring>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 #include "../../protocol/Parser.h"
 
@@ -24,16 +28,18 @@ namespace NonBlocking {
 const uint32_t EPOLLEXCLUSIVE =
     (1 << 28);  // why do we have to set it explicitly?
 
-enum class State { ReadCommand, ExtractArguments, SendAnswer };
+// WaitDurable: answer is ready, but changes behind it aren't on disk yet, nothing is read meanwhile
+enum class State { ReadCommand, ExtractArguments, WaitDurable, SendAnswer };
 
-class Connection {
+class Connection : public std::enable_shared_from_this<Connection> {
    public:
     Connection(int fd, std::atomic<bool>& running,
                std::shared_ptr<Afina::Storage> ps)
         : socket(fd),
-          state(State::ReadCommand),
           storage_ptr(ps),
-          running(running) {}
+          running(running),
+          answer(OUTPUT_BUDGET),
+          state(State::ReadCommand) {}
     ~Connection() { close(socket); }
 
     int socket;
@@ -41,13 +47,17 @@ class Connection {
     std::atomic<bool>& running;
 
     uint32_t command_body_size;
+    size_t body_received;
+
+    // Storage can't take value of the declared size, its data block is skipped
+    bool too_large = false;
     std::unique_ptr<Execute::Command> resulting_command;
 
     bool done = false;
     bool result;
 
     std::string command_body;
-    std::string answer;
+    Execute::Response answer;
 
     Protocol::Parser parser;
 
@@ -55,8 +65,14 @@ class Connection {
 
     static const size_t CHUNK_SIZE = 2048;
     char chunk[CHUNK_SIZE];
-    size_t read_counter;
-    size_t sent_counter = 0;
+
+    // Max number of answer fragments passed to a single writev
+    static const size_t IOV_SIZE = 64;
+
+    // Connection output budget, bigger answers are streamed
+    static const size_t OUTPUT_BUDGET = 256 * 1024;
+
+    size_t read_counter = 0;
     size_t parsed_length;
     ssize_t read_length;
     ssize_t sent_length;
@@ -115,6 +131,13 @@ class Worker {
 
     static void* RunWorkerProxy(void* p);
     bool Process(Connection* conn, uint32_t events, epoll_event& event);
+
+    // Asks storage to tell once answer could be sent, returns false if connection has to wait for it
+    bool Hold(Connection* conn, epoll_event& event);
+
+    // Sends answers of connections storage has called back for
+    void Release(epoll_event& event);
+
     void AddConnection(int client_socket, epoll_event& event);
     void FinishWorkWithClient(int client_socket);
     void CleanUp();
@@ -124,10 +147,19 @@ class Worker {
     size_t _max_events = 32;
 
     std::atomic<bool> _running;
-    std::vector<std::unique_ptr<Connection>> _connections;
+    std::vector<std::shared_ptr<Connection>> _connections;
+    std::thread::id _thread_id;
 
     int _epoll_fd;
+
+    // Eventfd Stop wakes epoll_wait up with. Listening socket is shared with other workers and maybe with
+    // another process, so it can't be shut down for that
+    int _wakeup_fd;
     std::shared_ptr<Afina::Storage> _storage_ptr;
+
+    // Connections storage has called back for from another thread, they could be gone by now
+    std::mutex _mutex;
+    std::vector<std::weak_ptr<Connection>> _durable;
 };
 
 }  // namespace NonBlocking
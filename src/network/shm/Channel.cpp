@@ -0,0 +1,231 @@
+#include "Channel.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "network/Handoff.h"
+
+namespace Afina {
+namespace Network {
+namespace Shm {
+
+namespace {
+
+// Requests ring header, responses ring header, then data of both
+struct Layout {
+    RingHeader request;
+    RingHeader response;
+};
+
+const size_t kDataOffset = (sizeof(Layout) + 4095) / 4096 * 4096;
+const size_t kRegionSize = kDataOffset + 2 * Channel::kRingSize;
+
+// How long Wait spins before going to sleep. Round trip to a busy server is well below that. Spinning on the
+// only CPU just keeps the server from running
+const auto kSpin = std::chrono::microseconds(std::thread::hardware_concurrency() > 1 ? 50 : 0);
+
+void Close(const std::vector<int> &fds) {
+    for (int fd : fds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+} // namespace
+
+const size_t Channel::kRingSize;
+
+Channel::Channel(int socket, int memory_fd, int wakeup_fd, int peer_fd, bool server)
+    : _socket(socket), _wakeup_fd(wakeup_fd), _peer_fd(peer_fd), _size(kRegionSize) {
+    _region = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, memory_fd, 0);
+    close(memory_fd);
+    if (_region == MAP_FAILED) {
+        Close({socket, wakeup_fd, peer_fd});
+        throw std::runtime_error(std::string("Can't map channel memory: ") + strerror(errno));
+    }
+
+    Layout *layout = static_cast<Layout *>(_region);
+    if (server) {
+        new (layout) Layout();
+    }
+    char *data = static_cast<char *>(_region) + kDataOffset;
+    Ring request(&layout->request, data, kRingSize);
+    Ring response(&layout->response, data + kRingSize, kRingSize);
+    _in = server ? request : response;
+    _out = server ? response : request;
+}
+
+// See Channel.h
+std::shared_ptr<Channel> Channel::Create(int socket) {
+    int memory_fd = memfd_create("afina-shm", MFD_CLOEXEC);
+    int to_server = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    int to_client = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (memory_fd < 0 || to_server < 0 || to_client < 0 || ftruncate(memory_fd, kRegionSize) != 0) {
+        std::string error = strerror(errno);
+        Close({socket, memory_fd, to_server, to_client});
+        throw std::runtime_error("Can't create channel: " + error);
+    }
+
+    // Descriptors are sent after region is initialized, client must not see it half done
+    std::vector<int> handoff = {dup(memory_fd), to_server, to_client};
+    if (handoff[0] < 0) {
+        Close({socket, memory_fd, to_server, to_client});
+        throw std::runtime_error("Can't create channel: " + std::string(strerror(errno)));
+    }
+    std::shared_ptr<Channel> channel;
+    try {
+        channel.reset(new Channel(socket, memory_fd, to_server, to_client, true));
+    } catch (std::runtime_error &) {
+        close(handoff[0]);
+        throw;
+    }
+    try {
+        SendSockets(socket, handoff);
+    } catch (std::runtime_error &) {
+        close(handoff[0]);
+        throw;
+    }
+    close(handoff[0]);
+    return channel;
+}
+
+// See Channel.h
+std::unique_ptr<Channel> Channel::Attach(const std::string &path) {
+    struct sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path is too long: " + path);
+    }
+    std::memcpy(address.sun_path, path.data(), path.size());
+
+    int socket = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (socket < 0) {
+        throw std::runtime_error(std::string("Can't create socket: ") + strerror(errno));
+    }
+    if (connect(socket, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0) {
+        std::string error = strerror(errno);
+        close(socket);
+        throw std::runtime_error("Can't connect to " + path + ": " + error);
+    }
+
+    std::vector<int> fds;
+    try {
+        fds = ReceiveSockets(socket);
+    } catch (std::runtime_error &) {
+        close(socket);
+        throw;
+    }
+    if (fds.size() != 3) {
+        fds.push_back(socket);
+        Close(fds);
+        throw std::runtime_error("Unexpected channel handoff");
+    }
+    return std::unique_ptr<Channel>(new Channel(socket, fds[0], fds[2], fds[1], false));
+}
+
+Channel::~Channel() {
+    munmap(_region, _size);
+    Close({_socket, _wakeup_fd, _peer_fd});
+}
+
+// See Channel.h
+size_t Channel::Send(const char *data, size_t size) {
+    size_t written = _out.Write(data, size);
+    if (written > 0 && _out.TakeDataWaiter()) {
+        Notify();
+    }
+    return written;
+}
+
+// See Channel.h
+size_t Channel::Receive(char *data, size_t size) {
+    size_t read = _in.Read(data, size);
+    if (read > 0 && _in.TakeSpaceWaiter()) {
+        Notify();
+    }
+    return read;
+}
+
+// See Channel.h
+bool Channel::Idle(bool want_data, bool want_space) {
+    if (want_data && !_in.SleepForData()) {
+        return false;
+    }
+    if (want_space && !_out.SleepForSpace()) {
+        return false;
+    }
+    return true;
+}
+
+// See Channel.h
+bool Channel::Wait(bool want_space, int timeout_ms) {
+    auto ready = [this, want_space] { return _in.Readable() > 0 || (want_space && _out.Writable() > 0); };
+
+    auto now = std::chrono::steady_clock::now();
+    auto deadline = now + std::chrono::milliseconds(timeout_ms);
+    for (auto spin = now + kSpin; now < spin; now = std::chrono::steady_clock::now()) {
+        if (ready()) {
+            return true;
+        }
+    }
+
+    for (;;) {
+        if (!Idle(true, want_space) || ready()) {
+            return true;
+        }
+
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+        if (left <= 0) {
+            return false;
+        }
+
+        struct pollfd fds[2];
+        fds[0].fd = _wakeup_fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = _socket;
+        fds[1].events = POLLIN | POLLRDHUP;
+        int count = poll(fds, 2, left);
+        if (count < 0 && errno != EINTR) {
+            std::cerr << "Channel poll failed: " << strerror(errno) << std::endl;
+            return false;
+        }
+
+        // Nothing is ever sent over the socket after handoff, so it gets readable only once peer is gone
+        if (count > 0 && fds[1].revents != 0) {
+            return false;
+        }
+        if (count > 0 && fds[0].revents != 0) {
+            uint64_t value;
+            if (read(_wakeup_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+                return false;
+            }
+        }
+        now = std::chrono::steady_clock::now();
+    }
+}
+
+void Channel::Notify() {
+    uint64_t value = 1;
+    if (write(_peer_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+        std::cerr << "Can't wake channel peer up: " << strerror(errno) << std::endl;
+    }
+}
+
+} // namespace Shm
+} // namespace Network
+} // namespace Afina
@@ -0,0 +1,100 @@
+#ifndef AFINA_NETWORK_SHM_CHANNEL_H
+#define AFINA_NETWORK_SHM_CHANNEL_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "Ring.h"
+
+namespace Afina {
+namespace Network {
+namespace Shm {
+
+/**
+ * # Shared memory channel between a client thread and the server
+ * Memory region with two rings: requests go from client to server, responses back. Both carry memcached text
+ * protocol, so server runs the same parser and commands as for sockets.
+ *
+ * Server creates region as memfd together with two eventfds, one each side sleeps on, and passes all three
+ * to the client over the unix socket it connected by. Socket stays open for the life of the channel, its
+ * hangup tells that other side is gone.
+ */
+class Channel {
+public:
+    // Capacity of each ring
+    static const size_t kRingSize = 256 << 10;
+
+    /**
+     * Server side: creates channel and hands it to the client connected by the socket. Channel owns socket
+     * from now on. Throws std::runtime_error if that fails
+     */
+    static std::shared_ptr<Channel> Create(int socket);
+
+    /**
+     * Client side: connects to the server listening on the unix socket path and maps channel it hands out.
+     * Throws std::runtime_error if that fails
+     */
+    static std::unique_ptr<Channel> Attach(const std::string &path);
+
+    ~Channel();
+
+    Channel(const Channel &) = delete;
+    Channel &operator=(const Channel &) = delete;
+
+    /**
+     * Writes as much as fits into outgoing ring, wakes the other side up if it waits for data. Never blocks
+     */
+    size_t Send(const char *data, size_t size);
+
+    /**
+     * Reads as much as there is in incoming ring, wakes the other side up if it waits for space. Never blocks
+     */
+    size_t Receive(char *data, size_t size);
+
+    /**
+     * Bytes waiting in incoming ring and free space in outgoing one
+     */
+    size_t Readable() const { return _in.Readable(); }
+    size_t Writable() const { return _out.Writable(); }
+
+    /**
+     * Prepares to sleep until data comes and/or space frees up in outgoing ring. Returns false if there is
+     * something to do already. Once true is returned, eventfd gets signaled on change
+     */
+    bool Idle(bool want_data, bool want_space);
+
+    /**
+     * Blocks until there is data to receive, or space to send if asked for. Spins a bit before going to sleep,
+     * so reply coming quickly costs no syscalls. Returns false if the other side has gone or on timeout
+     */
+    bool Wait(bool want_space, int timeout_ms);
+
+    /**
+     * Eventfd this side sleeps on and the socket to watch for hangup
+     */
+    int WakeupFd() const { return _wakeup_fd; }
+    int Socket() const { return _socket; }
+
+private:
+    Channel(int socket, int memory_fd, int wakeup_fd, int peer_fd, bool server);
+
+    // Wakes the other side up
+    void Notify();
+
+    int _socket;
+    int _wakeup_fd;
+    int _peer_fd;
+
+    void *_region;
+    size_t _size;
+
+    Ring _in;
+    Ring _out;
+};
+
+} // namespace Shm
+} // namespace Network
+} // namespace Afina
+
+#endif // AFINA_NETWORK_SHM_CHANNEL_H
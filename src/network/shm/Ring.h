@@ -0,0 +1,137 @@
+#ifndef AFINA_NETWORK_SHM_RING_H
+#define AFINA_NETWORK_SHM_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace Afina {
+namespace Network {
+namespace Shm {
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+              "Ring atomics are shared between processes, they must be lock free");
+
+/**
+ * Ring state placed in shared memory. Positions only grow, each is written by one side only and lives on a
+ * cache line of its own, so producer and consumer don't bounce lines when both are busy
+ */
+struct RingHeader {
+    // Bytes ever written, advanced by producer
+    alignas(64) std::atomic<uint64_t> head;
+
+    // Bytes ever read, advanced by consumer
+    alignas(64) std::atomic<uint64_t> tail;
+
+    // Consumer sleeps until data comes, producer sleeps until space frees up
+    alignas(64) std::atomic<uint32_t> data_waiting;
+    std::atomic<uint32_t> space_waiting;
+};
+
+/**
+ * # Single producer single consumer byte ring
+ * Stream of bytes over shared memory, no locks and no syscalls while both sides are busy. Side going to sleep
+ * raises its waiting flag and checks the ring once more; other side clears the flag after changing the ring
+ * and only then wakes the sleeper up. Both steps are sequentially consistent, so either sleeper sees the
+ * change or the other side sees the flag, wakeup can't be lost
+ */
+class Ring {
+public:
+    Ring() : _header(nullptr), _data(nullptr), _capacity(0) {}
+
+    /**
+     * Capacity must be a power of two
+     */
+    Ring(RingHeader *header, char *data, size_t capacity) : _header(header), _data(data), _capacity(capacity) {}
+
+    /**
+     * Copies as much as fits into the ring, returns number of bytes written. Producer only
+     */
+    size_t Write(const char *data, size_t size) {
+        uint64_t head = _header->head.load(std::memory_order_relaxed);
+        size = std::min<size_t>(size, _capacity - (head - _header->tail.load(std::memory_order_acquire)));
+        size_t offset = head & (_capacity - 1);
+        size_t first = std::min(size, _capacity - offset);
+        std::memcpy(_data + offset, data, first);
+        std::memcpy(_data, data + first, size - first);
+        _header->head.store(head + size, std::memory_order_seq_cst);
+        return size;
+    }
+
+    /**
+     * Copies as much as available out of the ring, returns number of bytes read. Consumer only
+     */
+    size_t Read(char *data, size_t size) {
+        uint64_t tail = _header->tail.load(std::memory_order_relaxed);
+        size = std::min<size_t>(size, _header->head.load(std::memory_order_acquire) - tail);
+        size_t offset = tail & (_capacity - 1);
+        size_t first = std::min(size, _capacity - offset);
+        std::memcpy(data, _data + offset, first);
+        std::memcpy(data + first, _data, size - first);
+        _header->tail.store(tail + size, std::memory_order_seq_cst);
+        return size;
+    }
+
+    size_t Readable() const {
+        return _header->head.load(std::memory_order_seq_cst) - _header->tail.load(std::memory_order_relaxed);
+    }
+
+    size_t Writable() const {
+        return _capacity - (_header->head.load(std::memory_order_relaxed) -
+                            _header->tail.load(std::memory_order_seq_cst));
+    }
+
+    /**
+     * Consumer is going to sleep. Returns false if data is already there, flag is left down then
+     */
+    bool SleepForData() {
+        _header->data_waiting.store(1, std::memory_order_seq_cst);
+        if (Readable() > 0) {
+            _header->data_waiting.store(0, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Producer is going to sleep. Returns false if there is space already, flag is left down then
+     */
+    bool SleepForSpace() {
+        _header->space_waiting.store(1, std::memory_order_seq_cst);
+        if (Writable() > 0) {
+            _header->space_waiting.store(0, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Returns true if consumer sleeps and must be woken up after write. Producer only. Flag is only read while
+     * consumer is busy, so its cache line stays shared
+     */
+    bool TakeDataWaiter() {
+        return _header->data_waiting.load(std::memory_order_seq_cst) != 0 &&
+               _header->data_waiting.exchange(0, std::memory_order_seq_cst) != 0;
+    }
+
+    /**
+     * Returns true if producer sleeps and must be woken up after read. Consumer only
+     */
+    bool TakeSpaceWaiter() {
+        return _header->space_waiting.load(std::memory_order_seq_cst) != 0 &&
+               _header->space_waiting.exchange(0, std::memory_order_seq_cst) != 0;
+    }
+
+private:
+    RingHeader *_header;
+    char *_data;
+    size_t _capacity;
+};
+
+} // namespace Shm
+} // namespace Network
+} // namespace Afina
+
+#endif // AFINA_NETWORK_SHM_RING_H
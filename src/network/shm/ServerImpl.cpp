@@ -0,0 +1,115 @@
+#include "ServerImpl.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <afina/Storage.h>
+
+#include "../Listen.h"
+
+namespace Afina {
+namespace Network {
+namespace Shm {
+
+// See ServerImpl.h
+ServerImpl::ServerImpl(std::shared_ptr<Afina::Storage> storage)
+    : _storage(storage), _listen_socket(-1), _wakeup_fd(-1), _running(false) {}
+
+// See ServerImpl.h
+ServerImpl::~ServerImpl() {}
+
+// See ServerImpl.h
+void ServerImpl::Start(const std::string &path, size_t workers) { Start(ListenUnix(path), workers); }
+
+// See ServerImpl.h
+void ServerImpl::Start(int socket, size_t workers) {
+    _listen_socket = socket;
+    _wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_wakeup_fd < 0) {
+        throw std::runtime_error("Can't create wakeup eventfd");
+    }
+
+    for (size_t i = 0; i < std::max<size_t>(workers, 1); i++) {
+        _workers.emplace_back(new Worker(_storage));
+        _workers.back()->Start();
+    }
+
+    _running.store(true);
+    _thread = std::thread(&ServerImpl::OnRun, this);
+}
+
+// See ServerImpl.h
+void ServerImpl::Stop() {
+    _running.store(false);
+    uint64_t wakeup = 1;
+    if (write(_wakeup_fd, &wakeup, sizeof(wakeup)) < 0) {
+        std::cerr << "Can't wake acceptor up" << std::endl;
+    }
+    for (auto &worker : _workers) {
+        worker->Stop();
+    }
+}
+
+// See ServerImpl.h
+void ServerImpl::Join() {
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+    for (auto &worker : _workers) {
+        worker->Join();
+    }
+    _workers.clear();
+
+    if (_listen_socket >= 0) {
+        close(_listen_socket);
+        close(_wakeup_fd);
+        _listen_socket = _wakeup_fd = -1;
+    }
+}
+
+void ServerImpl::OnRun() {
+    size_t next = 0;
+    while (_running.load()) {
+        struct pollfd fds[2];
+        fds[0].fd = _listen_socket;
+        fds[0].events = POLLIN;
+        fds[1].fd = _wakeup_fd;
+        fds[1].events = POLLIN;
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Shared memory acceptor poll failed: " << strerror(errno) << std::endl;
+            break;
+        }
+        if (fds[0].revents == 0) {
+            continue;
+        }
+
+        int client_socket = accept4(_listen_socket, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client_socket < 0) {
+            if (errno != EINTR && errno != ECONNABORTED) {
+                std::cerr << "Can't accept: " << strerror(errno) << std::endl;
+            }
+            continue;
+        }
+
+        try {
+            _workers[next++ % _workers.size()]->Add(Channel::Create(client_socket));
+        } catch (std::runtime_error &ex) {
+            std::cerr << "Can't set shared memory channel up: " << ex.what() << std::endl;
+        }
+    }
+}
+
+} // namespace Shm
+} // namespace Network
+} // namespace Afina
@@ -0,0 +1,81 @@
+#ifndef AFINA_NETWORK_SHM_SERVER_IMPL_H
+#define AFINA_NETWORK_SHM_SERVER_IMPL_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Worker.h"
+
+namespace Afina {
+
+class Storage;
+
+namespace Network {
+namespace Shm {
+
+/**
+ * # Shared memory transport for clients on the same host
+ * Listens on a unix socket. Every connection gets its own channel: memory region with request and response
+ * rings, see Channel. Connection only carries the handoff and tells when client is gone, commands and replies
+ * never touch the socket.
+ *
+ * Channels are spread over workers round robin.
+ */
+class ServerImpl {
+public:
+    explicit ServerImpl(std::shared_ptr<Afina::Storage> storage);
+    ~ServerImpl();
+
+    ServerImpl(const ServerImpl &) = delete;
+    ServerImpl &operator=(const ServerImpl &) = delete;
+
+    /**
+     * Starts listening on the unix socket path, see Network::ListenUnix. Throws std::runtime_error if it can't
+     */
+    void Start(const std::string &path, size_t workers = 1);
+
+    /**
+     * Same as above, but accepts on the socket which is already listening, e.g. taken over from the old binary
+     * on upgrade. Server owns the socket from now on
+     */
+    void Start(int socket, size_t workers = 1);
+
+    /**
+     * Socket server accepts on, so it could be handed off to the new binary on upgrade
+     */
+    int ListenSocket() const { return _listen_socket; }
+
+    /**
+     * Signals acceptor and workers to stop, returns immediately
+     */
+    void Stop();
+
+    /**
+     * Blocks until everything is stopped. Socket file is left to the caller, it stays if socket has been handed
+     * off
+     */
+    void Join();
+
+private:
+    void OnRun();
+
+    std::shared_ptr<Afina::Storage> _storage;
+
+    int _listen_socket;
+    int _wakeup_fd;
+
+    std::vector<std::unique_ptr<Worker>> _workers;
+
+    std::atomic<bool> _running;
+    std::thread _thread;
+};
+
+} // namespace Shm
+} // namespace Network
+} // namespace Afina
+
+#endif // AFINA_NETWORK_SHM_SERVER_IMPL_H
@@ -0,0 +1,372 @@
+#include "Worker.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <afina/Storage.h>
+#include <afina/execute/Response.h>
+
+namespace Afina {
+namespace Network {
+namespace Shm {
+
+namespace {
+
+// How long worker polls rings after last piece of work before going to sleep, not at all if it would only
+// keep clients from running
+const auto kSpin = std::chrono::microseconds(std::thread::hardware_concurrency() > 1 ? 50 : 0);
+
+void Drain(int eventfd) {
+    uint64_t value;
+    if (read(eventfd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+        std::cerr << "Can't read eventfd: " << strerror(errno) << std::endl;
+    }
+}
+
+} // namespace
+
+const size_t Worker::kMaxOutput;
+
+// Channel eventfd and socket are polled with tags telling which one has fired
+struct Worker::Tag {
+    Client *client;
+    bool hangup;
+};
+
+struct Worker::Client {
+    explicit Client(std::shared_ptr<Channel> channel)
+        : channel(std::move(channel)), position(0), body_size(0), covered(0), holding(false), closed(false) {
+        wakeup_tag = {this, false};
+        socket_tag = {this, true};
+    }
+
+    std::shared_ptr<Channel> channel;
+    Tag wakeup_tag;
+    Tag socket_tag;
+
+    // Received bytes, how far they are parsed
+    std::string input;
+    size_t position;
+
+    // Command which header is parsed, it waits for its data block
+    Protocol::Parser parser;
+    std::unique_ptr<Execute::Command> command;
+    uint32_t body_size;
+
+    // Replies ready to be written and replies waiting for changes to become durable
+    std::string output;
+    std::string held;
+
+    // Bytes of held covered by durability request in progress
+    size_t covered;
+    bool holding;
+
+    bool closed;
+};
+
+// See Worker.h
+Worker::Worker(std::shared_ptr<Afina::Storage> storage) : _storage(storage), _epoll_fd(-1), _wakeup_fd(-1) {}
+
+// See Worker.h
+Worker::~Worker() {}
+
+// See Worker.h
+void Worker::Start() {
+    _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (_epoll_fd < 0) {
+        throw std::runtime_error("Can't create epoll context");
+    }
+    _wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_wakeup_fd < 0) {
+        close(_epoll_fd);
+        throw std::runtime_error("Can't create wakeup eventfd");
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _wakeup_fd, &event) != 0) {
+        throw std::runtime_error("Can't add wakeup eventfd to context");
+    }
+
+    _running.store(true);
+    _thread = std::thread(&Worker::OnRun, this);
+}
+
+// See Worker.h
+void Worker::Stop() {
+    _running.store(false);
+    uint64_t wakeup = 1;
+    if (write(_wakeup_fd, &wakeup, sizeof(wakeup)) < 0) {
+        std::cerr << "Can't wake worker up" << std::endl;
+    }
+}
+
+// See Worker.h
+void Worker::Join() {
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+    if (_wakeup_fd >= 0) {
+        close(_wakeup_fd);
+        close(_epoll_fd);
+        _wakeup_fd = _epoll_fd = -1;
+    }
+}
+
+// See Worker.h
+void Worker::Add(std::shared_ptr<Channel> channel) {
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _incoming.push_back(std::move(channel));
+    }
+    uint64_t wakeup = 1;
+    if (write(_wakeup_fd, &wakeup, sizeof(wakeup)) < 0) {
+        std::cerr << "Can't wake worker up" << std::endl;
+    }
+}
+
+void Worker::OnRun() {
+    _thread_id = std::this_thread::get_id();
+
+    const int max_events = 64;
+    struct epoll_event events[max_events];
+    while (_running.load()) {
+        // Clients are likely to send next command right after they got the reply, so rings are polled for a
+        // while. Any piece of work found extends that
+        auto now = std::chrono::steady_clock::now();
+        for (auto until = now + kSpin; now < until && !_clients.empty(); now = std::chrono::steady_clock::now()) {
+            for (auto &client : _clients) {
+                if (HasWork(client.first)) {
+                    Pump(client.second);
+                    until = std::chrono::steady_clock::now() + kSpin;
+                }
+            }
+        }
+
+        // Client which has got something meanwhile is served right away, nobody is going to wake worker for it
+        int timeout = -1;
+        for (auto &client : _clients) {
+            Client *c = client.first;
+            if (!c->channel->Idle(c->output.size() + c->held.size() < kMaxOutput, !c->output.empty())) {
+                Pump(client.second);
+                timeout = 0;
+            }
+        }
+
+        int count = epoll_wait(_epoll_fd, events, max_events, timeout);
+        if (count < 0 && errno != EINTR) {
+            std::cerr << "Shared memory worker epoll_wait failed: " << strerror(errno) << std::endl;
+            break;
+        }
+
+        std::vector<Client *> closed;
+        for (int i = 0; i < count; i++) {
+            Tag *tag = static_cast<Tag *>(events[i].data.ptr);
+            if (tag == nullptr) {
+                Drain(_wakeup_fd);
+                continue;
+            }
+
+            Client *client = tag->client;
+            if (client->closed) {
+                continue;
+            }
+            if (tag->hangup || (events[i].events & (EPOLLERR | EPOLLHUP)) != 0) {
+                Close(client);
+                closed.push_back(client);
+                continue;
+            }
+            Drain(client->channel->WakeupFd());
+            Pump(_clients[client]);
+        }
+        for (Client *client : closed) {
+            _clients.erase(client);
+        }
+
+        std::vector<std::shared_ptr<Channel>> incoming;
+        std::vector<std::shared_ptr<Client>> durable;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            incoming.swap(_incoming);
+            durable.swap(_durable);
+        }
+        for (auto &channel : incoming) {
+            Accept(std::move(channel));
+        }
+        for (auto &client : durable) {
+            if (!client->closed) {
+                Release(client);
+                Pump(client);
+            }
+        }
+    }
+
+    for (auto &client : _clients) {
+        Close(client.first);
+    }
+    _clients.clear();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _incoming.clear();
+}
+
+void Worker::Accept(std::shared_ptr<Channel> channel) {
+    auto client = std::make_shared<Client>(std::move(channel));
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = &client->wakeup_tag;
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, client->channel->WakeupFd(), &event) != 0) {
+        std::cerr << "Can't poll channel: " << strerror(errno) << std::endl;
+        return;
+    }
+    event.events = EPOLLRDHUP;
+    event.data.ptr = &client->socket_tag;
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, client->channel->Socket(), &event) != 0) {
+        std::cerr << "Can't poll channel socket: " << strerror(errno) << std::endl;
+        epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, client->channel->WakeupFd(), nullptr);
+        return;
+    }
+    _clients[client.get()] = client;
+
+    // Client could have sent something already
+    Pump(client);
+}
+
+void Worker::Pump(const std::shared_ptr<Client> &client) {
+    char chunk[64 << 10];
+    for (;;) {
+        bool moved = false;
+        if (!client->output.empty()) {
+            size_t sent = client->channel->Send(client->output.data(), client->output.size());
+            client->output.erase(0, sent);
+            moved = sent > 0;
+        }
+
+        // Commands left unprocessed while replies didn't fit go as well, nothing is going to be sent after them
+        size_t replies = client->output.size() + client->held.size();
+        if (replies < kMaxOutput) {
+            size_t got = client->channel->Receive(chunk, sizeof(chunk));
+            client->input.append(chunk, got);
+            ProcessInput(client.get());
+            Hold(client);
+            moved = moved || got > 0 || client->output.size() + client->held.size() != replies;
+        }
+
+        if (!moved) {
+            return;
+        }
+    }
+}
+
+void Worker::ProcessInput(Client *client) {
+    while (client->output.size() + client->held.size() < kMaxOutput) {
+        try {
+            if (!client->command) {
+                size_t parsed = 0;
+                bool complete = client->position < client->input.size() &&
+                                client->parser.Parse(&client->input[client->position],
+                                                     client->input.size() - client->position, parsed);
+                client->position += parsed;
+                if (!complete) {
+                    break;
+                }
+                client->command = client->parser.Build(client->body_size);
+                client->parser.Reset();
+            }
+
+            // Data block is followed by \r\n
+            std::string args;
+            if (client->body_size > 0) {
+                if (client->input.size() - client->position < client->body_size + 2) {
+                    break;
+                }
+                if (client->input.compare(client->position + client->body_size, 2, "\r\n") != 0) {
+                    throw std::runtime_error("Invalid data block trailer, \\r\\n expected");
+                }
+                args.assign(client->input, client->position, client->body_size);
+                client->position += client->body_size + 2;
+            }
+
+            std::unique_ptr<Execute::Command> command = std::move(client->command);
+            Execute::Response response;
+            command->Execute(*_storage, args, response);
+            while (command->Pending()) {
+                command->Continue(*_storage, response);
+            }
+            if (!command->noreply()) {
+                client->held += response.ToString();
+                client->held += "\r\n";
+            }
+        } catch (std::runtime_error &ex) {
+            // Stream can't be resynchronized after garbage, whatever is received is dropped
+            client->held += std::string("SERVER_ERROR ") + ex.what() + "\r\n";
+            client->command.reset();
+            client->parser.Reset();
+            client->input.clear();
+            client->position = 0;
+            return;
+        }
+    }
+
+    client->input.erase(0, client->position);
+    client->position = 0;
+}
+
+void Worker::Hold(const std::shared_ptr<Client> &client) {
+    if (client->holding || client->held.empty()) {
+        return;
+    }
+    client->holding = true;
+    client->covered = client->held.size();
+
+    // Storage could call back right away on this thread or later on its own one
+    std::shared_ptr<Client> self = client;
+    _storage->WhenDurable([this, self]() {
+        if (std::this_thread::get_id() == _thread_id) {
+            Release(self);
+            return;
+        }
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _durable.push_back(self);
+        }
+        uint64_t wakeup = 1;
+        if (write(_wakeup_fd, &wakeup, sizeof(wakeup)) < 0) {
+            std::cerr << "Can't wake worker up" << std::endl;
+        }
+    });
+}
+
+void Worker::Release(const std::shared_ptr<Client> &client) {
+    client->holding = false;
+    client->output.append(client->held, 0, client->covered);
+    client->held.erase(0, client->covered);
+    client->covered = 0;
+    Hold(client);
+}
+
+bool Worker::HasWork(const Client *client) const {
+    return (client->channel->Readable() > 0 && client->output.size() + client->held.size() < kMaxOutput) ||
+           (!client->output.empty() && client->channel->Writable() > 0);
+}
+
+void Worker::Close(Client *client) {
+    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, client->channel->WakeupFd(), nullptr);
+    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, client->channel->Socket(), nullptr);
+    client->closed = true;
+
+    // Channel is unmapped and its descriptors closed once durability callbacks in flight let it go
+    client->channel.reset();
+}
+
+} // namespace Shm
+} // namespace Network
+} // namespace Afina
@@ -0,0 +1,103 @@
+#ifndef AFINA_NETWORK_SHM_WORKER_H
+#define AFINA_NETWORK_SHM_WORKER_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <afina/execute/Command.h>
+
+#include "Channel.h"
+#include "protocol/Parser.h"
+
+namespace Afina {
+
+class Storage;
+
+namespace Network {
+namespace Shm {
+
+/**
+ * # Shared memory worker
+ * Thread serving its share of channels. Requests are parsed and executed exactly as they are for sockets,
+ * replies are written back into the channel once storage tells they are durable.
+ *
+ * Worker which has just had something to do polls rings of all its channels for a short while before going
+ * to sleep, so client issuing commands one after another gets served without a single syscall on either side.
+ * Only then it raises waiting flags and sleeps in epoll on channel eventfds.
+ */
+class Worker {
+public:
+    explicit Worker(std::shared_ptr<Afina::Storage> storage);
+    ~Worker();
+
+    Worker(const Worker &) = delete;
+    Worker &operator=(const Worker &) = delete;
+
+    void Start();
+
+    /**
+     * Signals worker thread to stop, returns immediately
+     */
+    void Stop();
+
+    /**
+     * Blocks until worker thread is stopped, all channels are closed then
+     */
+    void Join();
+
+    /**
+     * Hands channel over to the worker, could be called from any thread
+     */
+    void Add(std::shared_ptr<Channel> channel);
+
+private:
+    // Nothing more is read from channel while that many reply bytes wait to be written
+    static const size_t kMaxOutput = 4 * Channel::kRingSize;
+
+    struct Client;
+    struct Tag;
+
+    void OnRun();
+    void Accept(std::shared_ptr<Channel> channel);
+
+    // Moves bytes both ways until there is nothing more to do for now
+    void Pump(const std::shared_ptr<Client> &client);
+
+    // Executes complete commands found in the input, replies are held until they are durable
+    void ProcessInput(Client *client);
+
+    // Asks storage to tell once replies held so far could be released
+    void Hold(const std::shared_ptr<Client> &client);
+    void Release(const std::shared_ptr<Client> &client);
+
+    bool HasWork(const Client *client) const;
+    void Close(Client *client);
+
+    std::shared_ptr<Afina::Storage> _storage;
+    std::thread::id _thread_id;
+
+    int _epoll_fd;
+    int _wakeup_fd;
+
+    std::unordered_map<Client *, std::shared_ptr<Client>> _clients;
+
+    // Guards channels not picked up by worker yet and clients which replies became durable
+    std::mutex _mutex;
+    std::vector<std::shared_ptr<Channel>> _incoming;
+    std::vector<std::shared_ptr<Client>> _durable;
+
+    std::atomic<bool> _running;
+    std::thread _thread;
+};
+
+} // namespace Shm
+} // namespace Network
+} // namespace Afina
+
+#endif // AFINA_NETWORK_SHM_WORKER_H
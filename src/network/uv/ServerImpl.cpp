@@ -1,9 +1,12 @@
 #include "ServerImpl.h"
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <stdexcept>
+#include <fcntl.h>
 #include <sys/mman.h>
+#include <unistd.h>
 
 #include <afina/Storage.h>
 
@@ -33,6 +36,33 @@ void ServerImpl::Start(uint32_t port, uint16_t n_workers) {
     }
 }
 
+// See Server.h
+void ServerImpl::Start(const std::vector<int> &sockets, uint16_t n_workers) {
+    // Each worker owns its listening handle, so sockets shared by several workers are duplicated
+    size_t count = std::max<size_t>(n_workers, sockets.size());
+    for (size_t i = 0; i < count; i++) {
+        int socket = fcntl(sockets[i % sockets.size()], F_DUPFD_CLOEXEC, 0);
+        if (socket < 0) {
+            throw std::runtime_error("Failed to duplicate listening socket");
+        }
+        workers.push_back(new Worker(pStorage));
+        workers[i]->Start(socket);
+    }
+
+    for (int socket : sockets) {
+        close(socket);
+    }
+}
+
+// See Server.h
+std::vector<int> ServerImpl::ListenSockets() const {
+    std::vector<int> sockets;
+    for (auto worker : workers) {
+        sockets.push_back(worker->ListenSocket());
+    }
+    return sockets;
+}
+
 // See Server.h
 void ServerImpl::Stop() {
     for (auto worker : workers) {
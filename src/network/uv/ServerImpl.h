@@ -25,6 +25,12 @@ public:
     // See Server.h
     void Start(uint32_t port, uint16_t workers) override;
 
+    // See Server.h
+    void Start(const std::vector<int> &sockets, uint16_t workers) override;
+
+    // See Server.h
+    std::vector<int> ListenSockets() const override;
+
     // See Server.h
     void Stop() override;
 
@@ -55,75 +55,112 @@ void noop(uv_signal_t *handle, int signum) {}
 
 // See Worker.h
 void Worker::Start(const struct sockaddr_storage &address) {
-    // Init loop
-    int rc = uv_loop_init(&uvLoop);
+    Init();
+
+    // Setup Network
+    int rc = uv_tcp_init_ex(&uvLoop, &uvNetwork, address.ss_family);
     if (rc != 0) {
         std::stringstream ss;
-        ss << "Failed to create loop: [" << uv_err_name(rc) << ", " << rc << "]: " << uv_strerror(rc);
+        ss << "Failed to call uv_tcp_init_ex: [" << uv_err_name(rc) << ", " << rc << "]: " << uv_strerror(rc);
         throw std::runtime_error(ss.str());
     }
-    uvLoop.data = this;
+    uvNetwork.data = this;
 
-    // Init stop infrastructure
-    rc = uv_async_init(&uvLoop, &uvStopAsync, delegate<Worker>::callback<&Worker::OnStop>);
+    // Configure network
+    int fd;
+    rc = uv_fileno((uv_handle_t *)&uvNetwork, &fd);
     if (rc != 0) {
         std::stringstream ss;
-        ss << "Failed to call uv_async_init: [" << uv_err_name(rc) << ", " << rc << "]: " << uv_strerror(rc);
+        ss << "Failed to call uv_fileno: [" << uv_err_name(rc) << ", " << rc << "]: " << uv_strerror(rc);
         throw std::runtime_error(ss.str());
     }
-    uvStopAsync.data = this;
 
-    // Init signals
-    rc = uv_signal_init(&uvLoop, &uvSigPipe);
+    rc = uv_tcp_keepalive(&uvNetwork, 1, 60);
     if (rc != 0) {
         std::stringstream ss;
-        ss << "Failed to call uv_signal_init: [" << uv_err_name(rc) << ", " << rc << "]: " << uv_strerror(rc);
+        ss << "Failed to call uv_tcp_keepalive: [" << uv_err_name(rc) << ", " << rc << "]: " << uv_strerror(rc);
         throw std::runtime_error(ss.str());
     }
-    uvSigPipe.data = this;
-    uv_signal_start(&uvSigPipe, noop, SIGPIPE);
 
-    // Setup Network
-    rc = uv_tcp_init_ex(&uvLoop, &uvNetwork, address.ss_family);
+    int on = 1;
+    rc = setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
     if (rc != 0) {
         std::stringstream ss;
-        ss << "Failed to call uv_tcp_init_ex: [" << uv_err_name(rc) << ", " << rc << "]: " << uv_strerror(rc);
+        ss << "Failed to call setsockopt: [" << uv_err_name(rc) << ", " << rc << "]: " << uv_strerror(rc);
+        throw std::runtime_error(ss.str());
+    }
+
+    rc = uv_tcp_bind(&uvNetwork, (const struct sockaddr *)&address, 0);
+    if (rc != 0) {
+        std::stringstream ss;
+        ss << "Failed to call uv_tcp_bind: [" << uv_err_name(rc) << ", " << rc << "]: " << uv_strerror(rc);
+        throw std::runtime_error(ss.str());
+    }
+
+    Listen();
+}
+
+// See Worker.h
+void Worker::Start(int socket) {
+    Init();
+
+    int rc = uv_tcp_init(&uvLoop, &uvNetwork);
+    if (rc != 0) {
+        std::stringstream ss;
+        ss << "Failed to call uv_tcp_init: [" << uv_err_name(rc) << ", " << rc << "]: " << uv_strerror(rc);
         throw std::runtime_error(ss.str());
     }
     uvNetwork.data = this;
 
-    // Configure network
-    int fd;
-    rc = uv_fileno((uv_handle_t *)&uvNetwork, &fd);
+    rc = uv_tcp_open(&uvNetwork, socket);
     if (rc != 0) {
         std::stringstream ss;
-        ss << "Failed to call uv_fileno: [" << uv_err_name(rc) << ", " << rc << "]: " << uv_strerror(rc);
+        ss << "Failed to call uv_tcp_open: [" << uv_err_name(rc) << ", " << rc << "]: " << uv_strerror(rc);
         throw std::runtime_error(ss.str());
     }
 
-    rc = uv_tcp_keepalive(&uvNetwork, 1, 60);
+    Listen();
+}
+
+// See Worker.h
+int Worker::ListenSocket() const {
+    int fd = -1;
+    uv_fileno((const uv_handle_t *)&uvNetwork, &fd);
+    return fd;
+}
+
+void Worker::Init() {
+    // Init loop
+    int rc = uv_loop_init(&uvLoop);
     if (rc != 0) {
         std::stringstream ss;
-        ss << "Failed to call uv_tcp_keepalive: [" << uv_err_name(rc) << ", " << rc << "]: " << uv_strerror(rc);
+        ss << "Failed to create loop: [" << uv_err_name(rc) << ", " << rc << "]: " << uv_strerror(rc);
         throw std::runtime_error(ss.str());
     }
+    uvLoop.data = this;
 
-    int on = 1;
-    rc = setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+    // Init stop infrastructure
+    rc = uv_async_init(&uvLoop, &uvStopAsync, delegate<Worker>::callback<&Worker::OnStop>);
     if (rc != 0) {
         std::stringstream ss;
-        ss << "Failed to call setsockopt: [" << uv_err_name(rc) << ", " << rc << "]: " << uv_strerror(rc);
+        ss << "Failed to call uv_async_init: [" << uv_err_name(rc) << ", " << rc << "]: " << uv_strerror(rc);
         throw std::runtime_error(ss.str());
     }
+    uvStopAsync.data = this;
 
-    rc = uv_tcp_bind(&uvNetwork, (const struct sockaddr *)&address, 0);
+    // Init signals
+    rc = uv_signal_init(&uvLoop, &uvSigPipe);
     if (rc != 0) {
         std::stringstream ss;
-        ss << "Failed to call uv_tcp_bind: [" << uv_err_name(rc) << ", " << rc << "]: " << uv_strerror(rc);
+        ss << "Failed to call uv_signal_init: [" << uv_err_name(rc) << ", " << rc << "]: " << uv_strerror(rc);
         throw std::runtime_error(ss.str());
     }
+    uvSigPipe.data = this;
+    uv_signal_start(&uvSigPipe, noop, SIGPIPE);
+}
 
-    rc = uv_listen((uv_stream_t *)&uvNetwork, 511, delegate<Worker, int>::callback<&Worker::OnConnectionOpen>);
+void Worker::Listen() {
+    int rc = uv_listen((uv_stream_t *)&uvNetwork, 511, delegate<Worker, int>::callback<&Worker::OnConnectionOpen>);
     if (rc != 0) {
         std::stringstream ss;
         ss << "Failed to call uv_listen: [" << uv_err_name(rc) << ", " << rc << "]: " << uv_strerror(rc);
@@ -263,6 +300,17 @@ void Worker::OnAllocate(uv_handle_t *conn, size_t suggested_size, uv_buf_t *buf)
     Connection *pconn = (Connection *)(conn);
     assert(pconn->input_parsed <= pconn->input_used);
 
+    // Input is drained while data block isn't complete yet, so let libuv read the rest of block
+    // straight into the buffer reserved by storage
+    if (pconn->state == ConnectionState::sRecvBody && pconn->input_parsed == pconn->input_used) {
+        pconn->input_parsed = 0;
+        pconn->input_used = 0;
+
+        buf->base = &pconn->body[pconn->body.size() - pconn->body_size];
+        buf->len = pconn->body_size;
+        return;
+    }
+
     size_t unparsed = pconn->input_used - pconn->input_parsed;
     std::memmove(pconn->input, pconn->input + pconn->input_parsed, unparsed);
 
@@ -290,15 +338,33 @@ void Worker::OnRead(uv_stream_t *conn, ssize_t nread, const uv_buf_t *buf) {
         return;
     }
 
+    // Data went directly into the value buffer, see OnAllocate
+    if (buf->base < pconn->input || buf->base >= pconn->input + ConnectionInputBufferSize) {
+        pconn->body_size -= nread;
+        if (pconn->body_size == 0) {
+            pconn->state = ConnectionState::sRecvTrailerCR;
+        }
+        return;
+    }
+
+    pconn->input_used += nread;
+    OnInput(pconn);
+}
+
+// See Worker.h
+void Worker::OnInput(Connection *pconn) {
     // Look for the command delimeters in the [parsed, input.size()). Note that buffer could contains
     // many commands, not only one
     try {
-        pconn->input_used += nread;
-        while (pconn->input_parsed < pconn->input_used) {
+        while (pconn->input_parsed < pconn->input_used && pconn->state != ConnectionState::sStreaming) {
             // Read header or body if needs
             if (pconn->state == ConnectionState::sRecvHeader) {
                 // Try to parse command out
-                if (!pconn->parser.Parse(pconn->input, pconn->input_used, pconn->input_parsed)) {
+                size_t parsed = 0;
+                bool complete = pconn->parser.Parse(pconn->input + pconn->input_parsed,
+                                                    pconn->input_used - pconn->input_parsed, parsed);
+                pconn->input_parsed += parsed;
+                if (!complete) {
                     continue;
                 }
 
@@ -307,19 +373,30 @@ void Worker::OnRead(uv_stream_t *conn, ssize_t nread, const uv_buf_t *buf) {
 
                 // Command has argument that needs to be read from the network connection before execution could take
                 // place
-                if (pconn->body_size > 0) {
-                    pconn->body.clear();
+                if (pconn->body_size > 0 && pStorage->Reserve(pconn->body_size, pconn->body)) {
                     pconn->state = ConnectionState::sRecvBody;
+                } else if (pconn->body_size > 0) {
+                    pconn->cmd.reset();
+                    pconn->state = ConnectionState::sSkipBody;
                 } else {
                     pconn->state = ConnectionState::sExecute;
                 }
             } else if (pconn->state == ConnectionState::sRecvBody) {
                 size_t for_copy = std::min(uint32_t(pconn->input_used - pconn->input_parsed), pconn->body_size);
-                pconn->body.append(pconn->input + pconn->input_parsed, for_copy);
+                std::memcpy(&pconn->body[pconn->body.size() - pconn->body_size], pconn->input + pconn->input_parsed,
+                            for_copy);
 
                 pconn->body_size -= for_copy;
                 pconn->input_parsed += for_copy;
 
+                if (pconn->body_size == 0) {
+                    pconn->state = ConnectionState::sRecvTrailerCR;
+                }
+            } else if (pconn->state == ConnectionState::sSkipBody) {
+                size_t skipped = std::min(uint32_t(pconn->input_used - pconn->input_parsed), pconn->body_size);
+                pconn->body_size -= skipped;
+                pconn->input_parsed += skipped;
+
                 if (pconn->body_size == 0) {
                     pconn->state = ConnectionState::sRecvTrailerCR;
                 }
@@ -343,7 +420,9 @@ void Worker::OnRead(uv_stream_t *conn, ssize_t nread, const uv_buf_t *buf) {
                 pconn->cmd.reset();
                 pconn->body.clear();
                 pconn->parser.Reset();
-                pconn->state = ConnectionState::sRecvHeader;
+                if (pconn->state != ConnectionState::sStreaming) {
+                    pconn->state = ConnectionState::sRecvHeader;
+                }
             }
         }
     } catch (std::runtime_error &ex) {
@@ -359,15 +438,11 @@ void Worker::OnRead(uv_stream_t *conn, ssize_t nread, const uv_buf_t *buf) {
         uv_async_init(&uvLoop, &ptask->done, delegate<Worker>::callback<&Worker::OnExecutionDone>);
         ptask->done.data = this;
 
-        size_t size = output.size() + 2;
-        ptask->result.base = new char[size];
-        ptask->result.len = size;
-
-        std::memcpy(ptask->result.base, &output[0], size - 2);
-        ptask->result.base[size - 2] = '\r';
-        ptask->result.base[size - 1] = '\n';
+        ptask->result.Append(output);
+        ptask->result.Append("\r\n", 2);
 
         pconn->runningTasks++;
+        pconn->replies.push_back(ptask);
         pconn->state = ConnectionState::sClosed;
         OnExecutionDone(&ptask->done);
     }
@@ -383,6 +458,7 @@ void Worker::Execute(Connection &pconn) {
     ptask->cmd = std::move(pconn.cmd);
     ptask->argument = std::move(pconn.body);
     pconn.runningTasks++;
+    pconn.replies.push_back(ptask);
 
     // Setup async signal to be called once task execution is complete
     int rc = uv_async_init(&uvLoop, &ptask->done, delegate<Worker>::callback<&Worker::OnExecutionDone>);
@@ -393,28 +469,39 @@ void Worker::Execute(Connection &pconn) {
 
     // TODO: That should be in another thread
     {
-        std::string output;
+        bool reply = true;
         try {
-            ptask->cmd->Execute(*pStorage, ptask->argument, output);
+            if (ptask->cmd) {
+                ptask->cmd->Execute(*pStorage, ptask->argument, ptask->result);
+                reply = !ptask->cmd->noreply();
+            } else {
+                // Data block has been skipped, storage can't take value of that size
+                ptask->result.Append("SERVER_ERROR object too large for cache");
+            }
         } catch (std::runtime_error &ex) {
             std::cerr << "Failed to execute command: " << ex.what() << std::endl;
 
             std::stringstream ss;
             ss << "SERVER_ERROR " << ex.what();
-            output = ss.str();
+            ptask->result.Clear();
+            ptask->result.Append(ss.str());
         }
 
-        // Prepare output
-        size_t size = output.size() + 2;
-        ptask->result.base = new char[size];
-        ptask->result.len = size;
-
-        std::memcpy(ptask->result.base, &output[0], size - 2);
-        ptask->result.base[size - 2] = '\r';
-        ptask->result.base[size - 1] = '\n';
+        // Prepare output, empty result means there is nothing to send. Rest of big response is produced
+        // once first portion is written
+        if (!reply) {
+            ptask->result.Clear();
+        } else if (ptask->cmd && ptask->cmd->Pending()) {
+            ptask->streaming = true;
+            pconn.state = ConnectionState::sStreaming;
+            uv_read_stop(&pconn.handler);
+        } else {
+            ptask->result.Append("\r\n", 2);
+        }
 
-        // Notify event loop about task completition
-        uv_async_send(&ptask->done);
+        // Notify event loop about task completition once its changes are durable, log writer thread could
+        // do that later instead of blocking the loop
+        pStorage->WhenDurable([ptask]() { uv_async_send(&ptask->done); });
     }
 }
 
@@ -429,9 +516,36 @@ void Worker::OnExecutionDone(uv_async_t *handle) {
     // We don't need async anymore
     uv_close((uv_handle_t *)&task->done, delegate<Worker>::callback<&Worker::OnHandleClosed>);
 
+    // Writes go out in the order they are requested, so replies are requested in the order of commands
+    task->durable = true;
+    Connection *pconn = task->connection;
+    while (!pconn->replies.empty() && pconn->replies.front()->durable) {
+        ExecuteTask *next = pconn->replies.front();
+        pconn->replies.pop_front();
+        Write(next);
+    }
+}
+
+// See Worker.h
+void Worker::Write(ExecuteTask *task) {
+    // Client asked for no reply, task is complete
+    if (task->result.Empty()) {
+        OnWriteDone(&task->handler, 0);
+        return;
+    }
+
+    // Result fragments are passed to libuv as is, they stay alive in the task until write is done
+    std::vector<struct iovec> iov(task->result.Count());
+    size_t count = task->result.Gather(iov.data(), iov.size());
+    std::vector<uv_buf_t> bufs(count);
+    for (size_t i = 0; i < count; i++) {
+        bufs[i] = uv_buf_init(static_cast<char *>(iov[i].iov_base), iov[i].iov_len);
+    }
+
     // Send buffer to socket. Even if connection is already closed we are still try to write data out,
     // that would lead to possible write error which is ok and will be handled in the OnWriteDone
-    int rc = uv_write(&task->handler, &task->connection->handler, &task->result, 1,
+    task->handler.data = this;
+    int rc = uv_write(&task->handler, &task->connection->handler, bufs.data(), count,
                       delegate<Worker, int>::callback<&Worker::OnWriteDone>);
     if (rc != 0) {
         throw std::runtime_error("Failed to write request");
@@ -445,12 +559,37 @@ void Worker::OnWriteDone(uv_write_t *req, int status) {
     ExecuteTask *task = (ExecuteTask *)req;
     Connection *pconn = task->connection;
 
+    if (task->streaming) {
+        // Next portion of big response
+        if (status == 0 && pconn->state == ConnectionState::sStreaming && task->cmd->Pending()) {
+            task->result.Clear();
+            task->cmd->Continue(*pStorage, task->result);
+            if (!task->cmd->Pending()) {
+                task->result.Append("\r\n", 2);
+            }
+            Write(task);
+            return;
+        }
+
+        if (status != 0) {
+            // Reading is paused, so nobody else notice broken connection
+            pconn->state = ConnectionState::sClosed;
+        }
+    }
+
     task->connection->runningTasks--;
     if (task->connection->state == ConnectionState::sClosed && task->connection->runningTasks == 0) {
         uv_close((uv_handle_t *)(task->connection), delegate<Worker>::callback<&Worker::OnConnectionClosed>);
+    } else if (pconn->state == ConnectionState::sStreaming && task->streaming) {
+        // Response is complete, process commands buffered meanwhile and get back to reading
+        pconn->state = ConnectionState::sRecvHeader;
+        OnInput(pconn);
+        if (pconn->state != ConnectionState::sStreaming && pconn->state != ConnectionState::sClosed) {
+            uv_read_start(&pconn->handler, delegate<Worker, size_t, uv_buf_t *>::callback<&Worker::OnAllocate>,
+                          delegate<Worker, ssize_t, const uv_buf_t *>::callback<&Worker::OnRead>);
+        }
     }
 
-    delete[] task->result.base;
     delete task;
 }
 
@@ -1,6 +1,7 @@
 #ifndef AFINA_NETWORK_UV_WORKER_H
 #define AFINA_NETWORK_UV_WORKER_H
 
+#include <deque>
 #include <string>
 #include <unordered_set>
 #include <uv.h>
@@ -30,8 +31,22 @@ public:
     Worker(const Worker &) = delete;
     Worker &operator=(const Worker &) = delete;
 
+    /**
+     * Binds new listening socket to the given address and starts worker thread accepting on it
+     */
     void Start(const struct sockaddr_storage &addr);
 
+    /**
+     * Starts worker thread accepting on the listening socket taken over from another process. Worker owns
+     * the socket once method returns
+     */
+    void Start(int socket);
+
+    /**
+     * Listening socket of the worker
+     */
+    int ListenSocket() const;
+
     /**
      * Signal worker that  it should stop. Method returns immediately, after that
      * all new incomming connections will be rejected, currently readed commands complete
@@ -51,6 +66,9 @@ protected:
     // Size of input buffer
     const static size_t ConnectionInputBufferSize = 64 * 1024L;
 
+    // Output budget of the connection, bigger responses are written by portions
+    const static size_t ConnectionOutputBudget = 256 * 1024L;
+
     // Determinates how connection reacts on different async events, such as
     // new input data or command execution complete
     enum ConnectionState : uint8_t {
@@ -61,6 +79,9 @@ protected:
         // Data block expected, i.e read until all neccessary bytes consumed
         sRecvBody,
 
+        // Data block of a value storage can't take, bytes are consumed and dropped
+        sSkipBody,
+
         // Data block received and \r trailer expected
         sRecvTrailerCR,
 
@@ -70,11 +91,17 @@ protected:
         // Command was parsed out, time to execute it
         sExecute,
 
+        // Response of the last command is still being written by portions. Reading is paused and input isn't
+        // processed until it is complete, so responses are not reordered
+        sStreaming,
+
         // Connection has been requested to shutdown. It still flys around as wasn't completely
         // cleanup yet.
         sClosed
     };
 
+    struct ExecuteTask;
+
     /**
      * Holds information about single connection from the client
      */
@@ -98,18 +125,22 @@ protected:
         // State of the header parser
         Protocol::Parser parser;
 
-        // Command parsed out from the input
+        // Command parsed out from the input, null once its data block is skipped
         std::unique_ptr<Execute::Command> cmd;
 
         // Number of bytes left to read to get command
         uint32_t body_size;
 
-        // Argument for the command
+        // Argument for the command, allocated by Storage::Reserve
         std::string body;
 
         // Number of tasks that are running now
         size_t runningTasks;
 
+        // Tasks in the order commands came in. Storage could report later command durable first, so reply is
+        // written only once all replies before it are
+        std::deque<ExecuteTask *> replies;
+
         Connection()
             : state(ConnectionState::sRecvHeader), input(nullptr), input_used(0), input_parsed(0), cmd(nullptr),
               body_size(0), body(""), runningTasks(0) {
@@ -140,10 +171,26 @@ protected:
         // Argument for the command
         std::string argument;
 
-        // Execution result
-        uv_buf_t result;
+        // Execution result, fragments could reference storage memory
+        Execute::Response result{ConnectionOutputBudget};
+
+        // Command has more output than budget allows, see sStreaming
+        bool streaming = false;
+
+        // Storage has reported changes behind the result durable, see Connection::replies
+        bool durable = false;
     } ExecuteTask;
 
+    /**
+     * Sets up loop, stop and signal handlers
+     */
+    void Init();
+
+    /**
+     * Starts listening on uvNetwork and launches worker thread
+     */
+    void Listen();
+
     /**
      * Called by thread once started, while this method is running Worker considered as alive
      */
@@ -177,7 +224,8 @@ protected:
 
     /**
      * LibUV used that method just before call OnRead to allocate temporary buffer
-     * for the input
+     * for the input. While data block is being received buffer points right into
+     * the value reserved by storage
      */
     void OnAllocate(uv_handle_t *, size_t suggested_size, uv_buf_t *buf);
 
@@ -186,6 +234,11 @@ protected:
      */
     void OnRead(uv_stream_t *, ssize_t nread, const uv_buf_t *buf);
 
+    /**
+     * Parses and executes commands buffered in connection input
+     */
+    void OnInput(Connection *pconn);
+
     /**
      * Execute last command readed from the connection. Once method return all fields in connection allocated for the
      * command will be released, so implementation must take care to copy/move data somewhere else in case it needs
@@ -198,6 +251,11 @@ protected:
      */
     void OnExecutionDone(uv_async_t *handle);
 
+    /**
+     * Passes task result to libuv write pipeline
+     */
+    void Write(ExecuteTask *task);
+
     /**
      * Called by libuv once ExecuteTask output buffer has been written to the output connection
      */
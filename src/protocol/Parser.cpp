@@ -1,16 +1,28 @@
 #include "Parser.h"
 
 #include <iostream>
+#include <limits>
 #include <sstream>
 #include <stdexcept>
 
+#include <afina/Hash.h>
 #include <afina/execute/Add.h>
 #include <afina/execute/Append.h>
+#include <afina/execute/Cas.h>
 #include <afina/execute/Command.h>
+#include <afina/execute/Decr.h>
 #include <afina/execute/Delete.h>
+#include <afina/execute/CacheMemlimit.h>
+#include <afina/execute/DeletePrefix.h>
+#include <afina/execute/Error.h>
+#include <afina/execute/Gat.h>
 #include <afina/execute/Get.h>
+#include <afina/execute/Incr.h>
+#include <afina/execute/Prepend.h>
+#include <afina/execute/Replace.h>
 #include <afina/execute/Set.h>
 #include <afina/execute/Stats.h>
+#include <afina/execute/Touch.h>
 
 namespace Afina {
 namespace Protocol {
@@ -27,10 +39,20 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
         case State::sName: {
             if (c == ' ' || c == '\r') {
                 // std::cout << "parser debug: name='" << name << "'" << std::endl;
-                if (name == "set" || name == "add" || name == "append" || name == "prepend") {
+                if (name == "set" || name == "add" || name == "replace" || name == "append" || name == "prepend" ||
+                    name == "cas") {
                     state = State::spKey;
                 } else if (name == "get" || name == "gets") {
                     state = State::sgKey;
+                } else if (name == "gat" || name == "gats") {
+                    negative = false;
+                    state = State::spExprTimeStart;
+                } else if (name == "touch") {
+                    state = c == '\r' ? State::sLF : State::stKey;
+                } else if (name == "delete" || name == "delete_prefix" || name == "cache_memlimit") {
+                    state = c == '\r' ? State::sLF : State::sdKey;
+                } else if (name == "incr" || name == "decr") {
+                    state = c == '\r' ? State::sLF : State::siKey;
                 } else if (name == "stats") {
                     state = State::sLF;
                     continue;
@@ -46,7 +68,7 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
         case State::spKey: {
             if (c == ' ') {
                 state = State::spFlags;
-                keys.push_back(curKey);
+                PushKey();
                 // std::cout << "parser debug: key[" << keys.size() - 1 << "]='" << curKey << "'" << std::endl;
             } else {
                 curKey.push_back(c);
@@ -56,7 +78,7 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
 
         case State::sgKey: {
             if (c == '\r') {
-                keys.push_back(curKey);
+                PushKey();
                 // std::cout << "parser debug: total '" << keys.size() << " keys" << std::endl;
 
                 if (keys.size() == 0) {
@@ -68,7 +90,7 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
             } else if (c == ' ') {
                 // std::cout << "parser debug: key[" << keys.size() << "]='" << curKey << "'" << std::endl;
                 state = State::sgKey;
-                keys.push_back(curKey);
+                PushKey();
                 curKey.clear();
             } else {
                 curKey.push_back(c);
@@ -76,6 +98,68 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
             break;
         }
 
+        case State::siKey: {
+            if (c == '\r') {
+                // Line ends before the delta, Build makes it an error
+                state = State::sLF;
+            } else if (c == ' ') {
+                state = State::siValue;
+                PushKey();
+                curKey.clear();
+            } else {
+                curKey.push_back(c);
+            }
+            break;
+        }
+
+        case State::stKey: {
+            if (c == '\r') {
+                // Line ends before the expiration time, Build makes it an error
+                state = State::sLF;
+            } else if (c == ' ') {
+                negative = false;
+                state = State::spExprTimeStart;
+                PushKey();
+                curKey.clear();
+            } else {
+                curKey.push_back(c);
+            }
+            break;
+        }
+
+        case State::sdKey: {
+            if (c == '\r') {
+                PushKey();
+                curKey.clear();
+                state = State::sLF;
+            } else if (c == ' ') {
+                PushKey();
+                curKey.clear();
+                state = State::sNoreply;
+            } else {
+                curKey.push_back(c);
+            }
+            break;
+        }
+
+        case State::siValue: {
+            if (c == '\r') {
+                state = State::sLF;
+            } else if (c == ' ') {
+                state = State::sNoreply;
+            } else if (c >= '0' && c <= '9') {
+                uint64_t v = (value * 10) + (c - '0');
+                if (v / 10 != value) {
+                    // Overflow
+                    throw std::runtime_error("Value field overflow");
+                }
+                value = v;
+            } else {
+                throw std::runtime_error("Invalid numeric delta argument");
+            }
+            break;
+        }
+
         case State::spFlags: {
             if (c == ' ') {
                 negative = false;
@@ -99,28 +183,31 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
             } else if (c >= '0' && c <= '9') {
                 exprtime = (c - '0');
                 state = State::spExprTime;
+            } else {
+                throw std::runtime_error("Invalid expiration time argument");
             }
             break;
         }
 
         case State::spExprTime: {
-            if (c == ' ') {
+            if (c == ' ' && (name == "gat" || name == "gats")) {
+                state = State::sgKey;
+            } else if (c == ' ' && name == "touch") {
+                state = State::sNoreply;
+            } else if (c == ' ') {
                 state = State::spBytes;
                 // std::cout << "parser debug: ExprTime='" << exprtime << "'" << std::endl;
+            } else if (c == '\r' && name == "touch") {
+                state = State::sLF;
             } else if (c >= '0' && c <= '9') {
-                int32_t et = exprtime;
-                if (negative) {
-                    et -= (c - '0');
-                    if (et > exprtime) {
-                        throw std::runtime_error("Expire time field overflow");
-                    }
-                } else {
-                    et += (c - '0');
-                    if (et < exprtime) {
-                        throw std::runtime_error("Expire time field overflow");
-                    }
+                // Computed in 64 bits, 32-bit one could overflow before the check
+                int64_t et = int64_t(exprtime) * 10 + (negative ? -(c - '0') : (c - '0'));
+                if (et > std::numeric_limits<int32_t>::max() || et < std::numeric_limits<int32_t>::min()) {
+                    throw std::runtime_error("Expire time field overflow");
                 }
                 exprtime = et;
+            } else {
+                throw std::runtime_error("Invalid expiration time argument");
             }
             break;
         }
@@ -129,6 +216,11 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
             if (c == '\r') {
                 state = State::sLF;
                 // std::cout << "parser debug: bytes='" << bytes << "'" << std::endl;
+            } else if (c == ' ' && name == "cas") {
+                state = State::spCas;
+            } else if (c == ' ') {
+                curKey.clear();
+                state = State::sNoreply;
             } else if (c >= '0' && c <= '9') {
                 uint32_t b = (bytes * 10) + (c - '0');
                 if (b < bytes) {
@@ -140,6 +232,42 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
             break;
         }
 
+        case State::spCas: {
+            if (c == '\r') {
+                state = State::sLF;
+            } else if (c == ' ') {
+                curKey.clear();
+                state = State::sNoreply;
+            } else if (c >= '0' && c <= '9') {
+                uint64_t v = (cas * 10) + (c - '0');
+                if (v / 10 != cas) {
+                    // Overflow
+                    throw std::runtime_error("Cas field overflow");
+                }
+                cas = v;
+            } else {
+                throw std::runtime_error("Invalid cas unique argument");
+            }
+            break;
+        }
+
+        case State::sNoreply: {
+            // Optional trailing arguments, only "noreply" means something, legacy "delete <key> 0" time
+            // argument gets skipped
+            if (c == '\r' || c == ' ') {
+                if (curKey == "noreply") {
+                    noreply = true;
+                }
+                curKey.clear();
+                if (c == '\r') {
+                    state = State::sLF;
+                }
+            } else {
+                curKey.push_back(c);
+            }
+            break;
+        }
+
         case State::sLF: {
             if (c == '\n') {
                 parse_complete = true;
@@ -167,19 +295,54 @@ std::unique_ptr<Execute::Command> Parser::Build(uint32_t &body_size) const {
     }
 
     body_size = bytes;
-    if (name == "set") {
-        return std::unique_ptr<Execute::Command>(new Execute::Set(keys[0], flags, exprtime));
+    std::unique_ptr<Execute::Command> command;
+    // Every command but stats has a key or an argument in its place
+    if (keys.empty() && name != "stats") {
+        command.reset(new Execute::Error());
+    } else if (name == "set") {
+        command.reset(new Execute::Set(keys[0], flags, exprtime, hashes[0]));
     } else if (name == "add") {
-        return std::unique_ptr<Execute::Command>(new Execute::Add(keys[0], flags, exprtime));
+        command.reset(new Execute::Add(keys[0], flags, exprtime));
+    } else if (name == "replace") {
+        command.reset(new Execute::Replace(keys[0], flags, exprtime));
     } else if (name == "append") {
-        return std::unique_ptr<Execute::Command>(new Execute::Append(keys[0], flags, exprtime));
+        command.reset(new Execute::Append(keys[0], flags, exprtime));
+    } else if (name == "prepend") {
+        command.reset(new Execute::Prepend(keys[0], flags, exprtime));
+    } else if (name == "incr") {
+        command.reset(new Execute::Incr(keys[0], value));
+    } else if (name == "decr") {
+        command.reset(new Execute::Decr(keys[0], value));
+    } else if (name == "cas") {
+        command.reset(new Execute::Cas(keys[0], flags, exprtime, cas));
     } else if (name == "get") {
-        return std::unique_ptr<Execute::Command>(new Execute::Get(keys));
+        command.reset(new Execute::Get(keys, hashes));
+    } else if (name == "gets") {
+        command.reset(new Execute::Get(keys, hashes, true));
+    } else if (name == "gat") {
+        command.reset(new Execute::Gat(exprtime, keys));
+    } else if (name == "gats") {
+        command.reset(new Execute::Gat(exprtime, keys, true));
+    } else if (name == "touch") {
+        command.reset(new Execute::Touch(keys[0], exprtime));
+    } else if (name == "delete") {
+        command.reset(new Execute::Delete(keys[0]));
+    } else if (name == "delete_prefix") {
+        command.reset(new Execute::DeletePrefix(keys[0]));
+    } else if (name == "cache_memlimit") {
+        // Argument is parsed as a key, it must be a plain number
+        if (keys[0].empty() || keys[0].size() > 12 || keys[0].find_first_not_of("0123456789") != std::string::npos) {
+            throw std::runtime_error("Invalid memory limit");
+        }
+        command.reset(new Execute::CacheMemlimit(std::stoull(keys[0])));
     } else if (name == "stats") {
-        return std::unique_ptr<Execute::Command>(new Execute::Stats());
+        command.reset(new Execute::Stats());
     } else {
         throw std::runtime_error("Unsupported command");
     }
+
+    command->SetNoreply(noreply);
+    return command;
 }
 
 // See Parse.h
@@ -187,11 +350,21 @@ void Parser::Reset() {
     state = State::sName;
     name.clear();
     keys.clear();
+    hashes.clear();
     curKey.clear();
     parse_complete = false;
     flags = 0;
     bytes = 0;
     exprtime = 0;
+    value = 0;
+    cas = 0;
+    noreply = false;
+}
+
+// See Parse.h
+void Parser::PushKey() {
+    keys.push_back(curKey);
+    hashes.push_back(Hash(curKey));
 }
 
 } // namespace Protocol
@@ -55,14 +55,47 @@ public:
 
     inline const std::string &Name() const { return name; }
 
+    /**
+     * Keys of the parsed command, for proxies and clients routing it without building
+     */
+    inline const std::vector<std::string> &Keys() const { return keys; }
+
+    /**
+     * Size of the data block following parsed command, without delimiting \r\n
+     */
+    inline uint32_t Bytes() const { return bytes; }
+
+    inline bool Noreply() const { return noreply; }
+
 private:
     /**
      * State of the command parser. Prefixes are:
      * - s: state for PUT and GET commands
      * - sp: for PUT commands only
      * - sg: for GET commands only
+     * - si: for INCR/DECR commands only
+     * - st: for TOUCH command only
+     * - sd: for DELETE, DELETE_PREFIX and CACHE_MEMLIMIT commands only
+     *
+     * GAT commands go through spExprTime into sgKey
      */
-    enum State : uint16_t { sCR, sLF, sName, spKey, spFlags, spExprTimeStart, spExprTime, spBytes, sgKey };
+    enum State : uint16_t {
+        sCR,
+        sLF,
+        sName,
+        spKey,
+        spFlags,
+        spExprTimeStart,
+        spExprTime,
+        spBytes,
+        spCas,
+        sgKey,
+        siKey,
+        siValue,
+        stKey,
+        sdKey,
+        sNoreply
+    };
 
     // Current parser state
     State state;
@@ -71,6 +104,9 @@ private:
     std::string name;
     std::vector<std::string> keys;
 
+    // Hashes of the keys, computed once while key is hot in cache and passed down to the storage by set and get/gets
+    std::vector<uint64_t> hashes;
+
     // <flags> is an arbitrary 16-bit unsigned integer (written out in decimal) that the server stores along with
     // the data and sends back when the item is retrieved. Clients may use this as a bit field to store data-specific
     //  information; this field is opaque to the server. Note that in memcached 1.2.1 and higher, flags may be 32-bits,
@@ -88,9 +124,23 @@ private:
     // it's followed by an empty data block).
     uint32_t bytes;
 
+    // <value> is the amount by which the client wants to increase/decrease the item. It is a decimal representation
+    // of a 64-bit unsigned integer.
+    uint64_t value;
+
+    // <cas unique> is a unique 64-bit value of an existing entry. Clients should use the value returned from the
+    // "gets" command when issuing "cas" updates.
+    uint64_t cas;
+
+    // "noreply" optional parameter tells server not to send a reply for the command
+    bool noreply;
+
     bool negative;
     std::string curKey;
     bool parse_complete;
+
+    // Completes current key
+    void PushKey();
 };
 
 } // namespace Protocol
@@ -0,0 +1,76 @@
+#include "ReplyParser.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace Afina {
+namespace Protocol {
+
+const size_t ReplyParser::kMaxLine;
+
+// See ReplyParser.h
+void ReplyParser::Reset(Kind kind) {
+    _kind = kind;
+    _line.clear();
+    _data = 0;
+    _complete = false;
+}
+
+// See ReplyParser.h
+bool ReplyParser::Parse(const char *input, size_t size, size_t &parsed) {
+    parsed = 0;
+    while (parsed < size && !_complete) {
+        if (_data > 0) {
+            size_t skip = std::min<uint64_t>(_data, size - parsed);
+            parsed += skip;
+            _data -= skip;
+            continue;
+        }
+
+        const char *start = input + parsed;
+        const char *end = static_cast<const char *>(std::memchr(start, '\n', size - parsed));
+        size_t length = end == nullptr ? size - parsed : end - start + 1;
+        if (_line.size() + length > kMaxLine) {
+            throw std::runtime_error("Reply line is too long");
+        }
+        _line.append(start, length);
+        parsed += length;
+        if (end != nullptr) {
+            OnLine();
+            _line.clear();
+        }
+    }
+    return _complete;
+}
+
+void ReplyParser::OnLine() {
+    if (_kind == Kind::kLine || _line.compare(0, 6, "VALUE ") != 0) {
+        // END or an error line finishes retrieval reply as well
+        _complete = true;
+        return;
+    }
+
+    // VALUE <key> <flags> <bytes> [<cas>]
+    size_t key_end = _line.find(' ', 6);
+    size_t flags_end = key_end == std::string::npos ? key_end : _line.find(' ', key_end + 1);
+    if (flags_end == std::string::npos) {
+        throw std::runtime_error("Malformed VALUE line");
+    }
+
+    uint64_t bytes = 0;
+    size_t position = flags_end + 1;
+    for (; position < _line.size() && _line[position] >= '0' && _line[position] <= '9'; position++) {
+        bytes = bytes * 10 + (_line[position] - '0');
+        if (bytes > uint64_t(1) << 32) {
+            throw std::runtime_error("Malformed VALUE line");
+        }
+    }
+    if (position == flags_end + 1) {
+        throw std::runtime_error("Malformed VALUE line");
+    }
+    _data = bytes + 2;
+}
+
+} // namespace Protocol
+} // namespace Afina
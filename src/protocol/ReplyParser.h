@@ -0,0 +1,65 @@
+#ifndef AFINA_PROTOCOL_REPLY_PARSER_H
+#define AFINA_PROTOCOL_REPLY_PARSER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Afina {
+namespace Protocol {
+
+/**
+ * # Memcached reply parser
+ * Finds where reply of the server ends in the stream, so replies to pipelined commands could be told apart.
+ * Replies are either a single line, or for retrieval commands a number of VALUE blocks terminated by END.
+ * Content of the reply isn't interpreted beyond that
+ */
+class ReplyParser {
+public:
+    enum class Kind : uint8_t {
+        // STORED, DELETED, a number and so on
+        kLine,
+
+        // VALUE <key> <flags> <bytes> [<cas>]\r\n<data>\r\n ... END\r\n, or an error line
+        kValues
+    };
+
+    ReplyParser() { Reset(Kind::kLine); }
+
+    /**
+     * Starts parsing next reply of the given kind
+     */
+    void Reset(Kind kind);
+
+    /**
+     * Pushes reply bytes into parser. Throws std::runtime_error if stream doesn't look like a reply
+     *
+     * @param input reply bytes
+     * @param size number of bytes in the input
+     * @param parsed output parameter tells how many bytes belong to the current reply
+     * @return true once the whole reply is consumed
+     */
+    bool Parse(const char *input, size_t size, size_t &parsed);
+
+private:
+    // Longest line reply could have, VALUE line with 250 bytes key included
+    static const size_t kMaxLine = 1024;
+
+    // Called once line is complete
+    void OnLine();
+
+    Kind _kind;
+
+    // Part of the current line seen so far
+    std::string _line;
+
+    // Bytes of value data block, with its \r\n, still to be skipped
+    uint64_t _data;
+
+    bool _complete;
+};
+
+} // namespace Protocol
+} // namespace Afina
+
+#endif // AFINA_PROTOCOL_REPLY_PARSER_H
@@ -0,0 +1,55 @@
+#include "Ring.h"
+
+#include <algorithm>
+
+namespace Afina {
+namespace Protocol {
+
+const size_t Ring::kPoints;
+
+// See Ring.h
+void Ring::Build(const std::vector<std::string> &servers, const std::vector<bool> &alive) {
+    _points.clear();
+    for (size_t server = 0; server < servers.size(); server++) {
+        if (!alive[server]) {
+            continue;
+        }
+        for (size_t i = 0; i < kPoints; i++) {
+            std::string point = servers[server] + "-" + std::to_string(i);
+            _points.emplace_back(Hash(point.data(), point.size()), uint32_t(server));
+        }
+    }
+    std::sort(_points.begin(), _points.end());
+}
+
+// See Ring.h
+int Ring::Find(const char *key, size_t size) const {
+    if (_points.empty()) {
+        return -1;
+    }
+    uint32_t hash = Hash(key, size);
+    auto point = std::lower_bound(_points.begin(), _points.end(), std::make_pair(hash, uint32_t(0)));
+    if (point == _points.end()) {
+        point = _points.begin();
+    }
+    return point->second;
+}
+
+// See Ring.h
+uint32_t Ring::Hash(const char *data, size_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ uint8_t(data[i])) * 1099511628211ULL;
+    }
+
+    // FNV alone leaves similar names clustered on the circle
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return uint32_t(hash);
+}
+
+} // namespace Protocol
+} // namespace Afina
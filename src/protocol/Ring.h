@@ -0,0 +1,50 @@
+#ifndef AFINA_PROTOCOL_RING_H
+#define AFINA_PROTOCOL_RING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Afina {
+namespace Protocol {
+
+/**
+ * # Consistent hash ring
+ * Ketama-style ring spreading keys over servers: each server owns a number of points on a 32-bit circle
+ * derived from its name, key belongs to the server of the first point at or after the key hash. Once a server
+ * is gone only its keys move, to the servers following its points.
+ *
+ * Hash is FNV-1a with a murmur finalizer rather than md5 of libketama, it is the same for every process and
+ * build, so all proxies and clients configured with the same servers route keys the same way.
+ */
+class Ring {
+public:
+    // Points each server owns on the circle
+    static const size_t kPoints = 160;
+
+    /**
+     * Places given servers on the ring, ones not alive are skipped. Names are usually host:port
+     */
+    void Build(const std::vector<std::string> &servers, const std::vector<bool> &alive);
+
+    /**
+     * Index of the server key belongs to, -1 if ring is empty
+     */
+    int Find(const std::string &key) const { return Find(key.data(), key.size()); }
+    int Find(const char *key, size_t size) const;
+
+    bool Empty() const { return _points.empty(); }
+
+    static uint32_t Hash(const char *data, size_t size);
+
+private:
+    // Point on the circle and server owning it, sorted by point
+    std::vector<std::pair<uint32_t, uint32_t>> _points;
+};
+
+} // namespace Protocol
+} // namespace Afina
+
+#endif // AFINA_PROTOCOL_RING_H
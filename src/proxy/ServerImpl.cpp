@@ -0,0 +1,72 @@
+#include "ServerImpl.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace Afina {
+namespace Proxy {
+
+// See ServerImpl.h
+ServerImpl::ServerImpl(const std::vector<std::string> &backends) : _backends(backends), _listen_socket(-1) {}
+
+// See ServerImpl.h
+ServerImpl::~ServerImpl() {
+    if (_listen_socket >= 0) {
+        close(_listen_socket);
+    }
+}
+
+// See ServerImpl.h
+void ServerImpl::Start(uint16_t port, uint16_t workers) {
+    if (_backends.empty()) {
+        throw std::runtime_error("No backends to proxy to");
+    }
+
+    _listen_socket = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+    if (_listen_socket < 0) {
+        throw std::runtime_error(std::string("Can't create socket: ") + strerror(errno));
+    }
+
+    int on = 1;
+    struct sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = INADDR_ANY;
+    if (setsockopt(_listen_socket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0 ||
+        bind(_listen_socket, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(_listen_socket, 128) != 0) {
+        std::string error = strerror(errno);
+        close(_listen_socket);
+        _listen_socket = -1;
+        throw std::runtime_error("Can't listen on port " + std::to_string(port) + ": " + error);
+    }
+
+    for (uint16_t i = 0; i < std::max<uint16_t>(workers, 1); i++) {
+        _workers.emplace_back(new Worker(_backends, _stats));
+        _workers.back()->Start(_listen_socket);
+    }
+}
+
+// See ServerImpl.h
+void ServerImpl::Stop() {
+    for (auto &worker : _workers) {
+        worker->Stop();
+    }
+}
+
+// See ServerImpl.h
+void ServerImpl::Join() {
+    for (auto &worker : _workers) {
+        worker->Join();
+    }
+    _workers.clear();
+}
+
+} // namespace Proxy
+} // namespace Afina
@@ -0,0 +1,53 @@
+#ifndef AFINA_PROXY_SERVER_IMPL_H
+#define AFINA_PROXY_SERVER_IMPL_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Worker.h"
+
+namespace Afina {
+namespace Proxy {
+
+/**
+ * # Memcached proxy
+ * Spreads keys of its clients over a set of afina or memcached servers. Clients are served by several workers,
+ * sharing one listening socket
+ */
+class ServerImpl {
+public:
+    explicit ServerImpl(const std::vector<std::string> &backends);
+    ~ServerImpl();
+
+    ServerImpl(const ServerImpl &) = delete;
+    ServerImpl &operator=(const ServerImpl &) = delete;
+
+    /**
+     * Starts listening on the given port, throws std::runtime_error if it can't
+     */
+    void Start(uint16_t port, uint16_t workers = 1);
+
+    /**
+     * Signals all workers to stop, returns immediately
+     */
+    void Stop();
+
+    /**
+     * Blocks until all workers are stopped
+     */
+    void Join();
+
+private:
+    std::vector<std::string> _backends;
+    Stats _stats;
+
+    int _listen_socket;
+    std::vector<std::unique_ptr<Worker>> _workers;
+};
+
+} // namespace Proxy
+} // namespace Afina
+
+#endif // AFINA_PROXY_SERVER_IMPL_H
@@ -0,0 +1,792 @@
+#include "Worker.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace Afina {
+namespace Proxy {
+
+namespace {
+
+const char kEnd[] = "END\r\n";
+const size_t kEndSize = sizeof(kEnd) - 1;
+
+bool EndsWith(const std::string &text, const char *suffix, size_t size) {
+    return text.size() >= size && text.compare(text.size() - size, size, suffix) == 0;
+}
+
+bool IsError(const std::string &reply) {
+    return reply.compare(0, 5, "ERROR") == 0 || reply.compare(0, 12, "CLIENT_ERROR") == 0 ||
+           reply.compare(0, 12, "SERVER_ERROR") == 0;
+}
+
+bool IsStorage(const std::string &name) {
+    return name == "set" || name == "add" || name == "replace" || name == "append" || name == "prepend" ||
+           name == "cas";
+}
+
+bool IsRetrieval(const std::string &name) {
+    return name == "get" || name == "gets" || name == "gat" || name == "gats";
+}
+
+// Writes as much as socket takes, returns false on error
+bool Write(int socket, std::string &output) {
+    size_t written = 0;
+    while (written < output.size()) {
+        ssize_t sent = send(socket, output.data() + written, output.size() - written, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        written += sent;
+    }
+    output.erase(0, written);
+    return true;
+}
+
+// Appends everything socket has to the input. Returns false once peer has closed connection or on error
+bool Read(int socket, std::string &input) {
+    char chunk[64 << 10];
+    for (;;) {
+        ssize_t got = recv(socket, chunk, sizeof(chunk), 0);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        input.append(chunk, got);
+        if (size_t(got) < sizeof(chunk)) {
+            return true;
+        }
+    }
+}
+
+} // namespace
+
+const size_t Worker::kRetryMs;
+const size_t Worker::kMaxInflight;
+
+struct Worker::Endpoint {
+    enum Type : uint8_t { kListener, kWakeup, kClient, kBackend };
+
+    Endpoint(Type type, int socket) : type(type), socket(socket), events(0), registered(false) {}
+    virtual ~Endpoint() {}
+
+    Type type;
+    int socket;
+
+    // Events socket is polled for
+    uint32_t events;
+    bool registered;
+};
+
+// Client command, replies of the backends it is split into are kept until all of them arrive
+struct Worker::Request {
+    enum Merge : uint8_t {
+        // Reply of the only backend
+        kSingle,
+
+        // VALUE blocks of all the backends followed by END
+        kValues,
+
+        // Sent to every backend: first error, DELETED counts summed up, otherwise the first reply
+        kBroadcast
+    };
+
+    // Nullptr once client is gone
+    Client *client;
+    Merge merge;
+    bool noreply;
+
+    std::vector<std::string> parts;
+    size_t missing;
+
+    bool done;
+    std::string reply;
+};
+
+struct Worker::Pending {
+    std::shared_ptr<Request> request;
+    size_t part;
+    Protocol::ReplyParser::Kind kind;
+};
+
+struct Worker::Client : Endpoint {
+    explicit Client(int socket)
+        : Endpoint(kClient, socket), position(0), header_end(0), in_body(false), body_size(0), closing(false),
+          closed(false), dirty(false) {}
+
+    // Received bytes, current command starts at the beginning
+    std::string input;
+
+    // How far input is parsed, where header of the current command ends and size of its data block
+    size_t position;
+    size_t header_end;
+    bool in_body;
+    size_t body_size;
+
+    Protocol::Parser parser;
+
+    // Commands in order they were received, replies are sent in the same order
+    std::deque<std::shared_ptr<Request>> requests;
+    std::string output;
+
+    // Nothing more is read, connection is closed once all replies are sent
+    bool closing;
+    bool closed;
+    bool dirty;
+};
+
+struct Worker::Backend : Endpoint {
+    Backend(const std::string &name)
+        : Endpoint(kBackend, -1), name(name), alive(true), connecting(false), fed(0), dirty(false) {}
+
+    std::string name;
+
+    // Whenever backend is on the ring, and connection is being established
+    bool alive;
+    bool connecting;
+    std::chrono::steady_clock::time_point retry;
+
+    // Commands not written yet
+    std::string output;
+
+    // Commands waiting for replies in order they were sent, received bytes and how many of them are parsed
+    std::deque<Pending> pending;
+    std::string input;
+    size_t fed;
+    Protocol::ReplyParser reply;
+
+    bool dirty;
+};
+
+// See Worker.h
+Worker::Worker(const std::vector<std::string> &backends, Stats &stats)
+    : _names(backends), _stats(stats), _listen_socket(-1), _epoll_fd(-1), _wakeup_fd(-1), _running(false) {
+    for (auto &name : _names) {
+        _backends.emplace_back(new Backend(name));
+    }
+}
+
+// See Worker.h
+Worker::~Worker() {}
+
+// See Worker.h
+void Worker::Start(int listen_socket) {
+    _listen_socket = listen_socket;
+    _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (_epoll_fd < 0) {
+        throw std::runtime_error("Can't create epoll context");
+    }
+    _wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_wakeup_fd < 0) {
+        close(_epoll_fd);
+        throw std::runtime_error("Can't create wakeup eventfd");
+    }
+
+    _listener.reset(new Endpoint(Endpoint::kListener, _listen_socket));
+    _wakeup.reset(new Endpoint(Endpoint::kWakeup, _wakeup_fd));
+    Watch(_listener.get(), EPOLLIN | EPOLLEXCLUSIVE);
+    Watch(_wakeup.get(), EPOLLIN);
+
+    _running.store(true);
+    _thread = std::thread(&Worker::OnRun, this);
+}
+
+// See Worker.h
+void Worker::Stop() {
+    _running.store(false);
+    uint64_t wakeup = 1;
+    if (write(_wakeup_fd, &wakeup, sizeof(wakeup)) < 0) {
+        std::cerr << "Can't wake proxy worker up" << std::endl;
+    }
+}
+
+// See Worker.h
+void Worker::Join() {
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+    close(_wakeup_fd);
+    close(_epoll_fd);
+}
+
+void Worker::OnRun() {
+    for (auto &backend : _backends) {
+        Connect(backend.get());
+    }
+    Rebuild();
+
+    const int max_events = 64;
+    struct epoll_event events[max_events];
+    while (_running.load()) {
+        int count = epoll_wait(_epoll_fd, events, max_events, kRetryMs / 10);
+        if (count < 0 && errno != EINTR) {
+            std::cerr << "Proxy epoll_wait failed: " << strerror(errno) << std::endl;
+            break;
+        }
+
+        for (int i = 0; i < count; i++) {
+            Endpoint *endpoint = static_cast<Endpoint *>(events[i].data.ptr);
+            switch (endpoint->type) {
+            case Endpoint::kListener:
+                Accept();
+                break;
+            case Endpoint::kWakeup:
+                break;
+            case Endpoint::kClient:
+                if (!static_cast<Client *>(endpoint)->closed) {
+                    OnClient(static_cast<Client *>(endpoint), events[i].events);
+                }
+                break;
+            case Endpoint::kBackend:
+                OnBackend(static_cast<Backend *>(endpoint), events[i].events);
+                break;
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        for (auto &backend : _backends) {
+            if (backend->socket < 0 && now >= backend->retry) {
+                Connect(backend.get());
+            }
+        }
+
+        // Backend failing on write completes its commands, so clients go after backends. Client could dispatch
+        // input it has left unparsed so far, so it goes on until nothing is left to write
+        while (!_dirty_backends.empty() || !_dirty_clients.empty()) {
+            std::vector<Backend *> backends;
+            backends.swap(_dirty_backends);
+            for (Backend *backend : backends) {
+                FlushBackend(backend);
+            }
+
+            std::vector<Client *> clients;
+            clients.swap(_dirty_clients);
+            for (Client *client : clients) {
+                if (!client->closed) {
+                    FlushClient(client);
+                }
+            }
+        }
+        for (Client *client : _closed) {
+            delete client;
+        }
+        _closed.clear();
+    }
+
+    while (!_clients.empty()) {
+        CloseClient(*_clients.begin());
+    }
+    for (Client *client : _closed) {
+        delete client;
+    }
+    _closed.clear();
+    for (auto &backend : _backends) {
+        if (backend->socket >= 0) {
+            close(backend->socket);
+            backend->socket = -1;
+        }
+    }
+}
+
+void Worker::Accept() {
+    for (;;) {
+        int socket = accept4(_listen_socket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (socket < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            return;
+        }
+
+        int on = 1;
+        setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        Client *client = new Client(socket);
+        _clients.insert(client);
+        Watch(client, EPOLLIN);
+        _stats.curr_connections++;
+        _stats.total_connections++;
+    }
+}
+
+void Worker::OnClient(Client *client, uint32_t events) {
+    if (events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+        if (!Read(client->socket, client->input)) {
+            // Commands sent before half close are still answered
+            client->closing = true;
+        }
+        ProcessInput(client);
+        MarkDirty(client);
+    }
+    if (events & EPOLLOUT) {
+        MarkDirty(client);
+    }
+}
+
+void Worker::ProcessInput(Client *client) {
+    while (client->requests.size() < kMaxInflight) {
+        if (!client->in_body) {
+            size_t parsed = 0;
+            bool complete;
+            try {
+                complete = client->parser.Parse(&client->input[client->position],
+                                                client->input.size() - client->position, parsed);
+            } catch (std::runtime_error &ex) {
+                // Stream can't be resynchronized after garbage, so client is answered and disconnected
+                auto request = std::make_shared<Request>();
+                request->client = client;
+                request->merge = Request::kSingle;
+                request->noreply = false;
+                request->missing = 0;
+                request->done = true;
+                request->reply = std::string("CLIENT_ERROR ") + ex.what() + "\r\n";
+                client->requests.push_back(request);
+                client->closing = true;
+                client->input.clear();
+                client->position = 0;
+                return;
+            }
+            client->position += parsed;
+            if (!complete) {
+                break;
+            }
+
+            client->header_end = client->position;
+            client->in_body = IsStorage(client->parser.Name());
+            client->body_size = client->in_body ? client->parser.Bytes() + 2 : 0;
+        }
+
+        if (client->input.size() - client->header_end < client->body_size) {
+            break;
+        }
+
+        std::string header = client->input.substr(0, client->header_end);
+        Dispatch(client, header, client->input.data() + client->header_end, client->body_size);
+
+        client->input.erase(0, client->header_end + client->body_size);
+        client->position = 0;
+        client->header_end = 0;
+        client->in_body = false;
+        client->body_size = 0;
+        client->parser.Reset();
+    }
+}
+
+void Worker::Dispatch(Client *client, const std::string &header, const char *body, size_t body_size) {
+    _stats.commands++;
+    const std::string &name = client->parser.Name();
+    const std::vector<std::string> &keys = client->parser.Keys();
+
+    auto request = std::make_shared<Request>();
+    request->client = client;
+    request->merge = Request::kSingle;
+    request->noreply = false;
+    request->missing = 0;
+    request->done = false;
+    client->requests.push_back(request);
+
+    if (name == "stats") {
+        request->reply = LocalStats();
+        request->done = true;
+        MarkDirty(client);
+        return;
+    }
+
+    if (IsRetrieval(name)) {
+        // gat has expiration time before keys, it is passed to every backend
+        std::string prefix = name;
+        if (name == "gat" || name == "gats") {
+            size_t start = header.find(' ');
+            size_t end = header.find(' ', start + 1);
+            prefix = header.substr(0, end);
+        }
+
+        std::vector<std::string> commands(_backends.size());
+        for (auto &key : keys) {
+            int owner = _ring.Find(key);
+            if (owner >= 0) {
+                commands[owner] += " " + key;
+            }
+        }
+
+        request->merge = Request::kValues;
+        for (size_t owner = 0; owner < commands.size(); owner++) {
+            if (!commands[owner].empty()) {
+                request->parts.emplace_back();
+                Send(_backends[owner].get(), request, request->parts.size() - 1,
+                     Protocol::ReplyParser::Kind::kValues, prefix + commands[owner] + "\r\n");
+            }
+        }
+        request->missing = request->parts.size();
+        if (request->missing == 0) {
+            request->reply = kEnd;
+            request->done = true;
+            MarkDirty(client);
+        }
+        return;
+    }
+
+    if (name == "delete_prefix" || name == "cache_memlimit") {
+        request->merge = Request::kBroadcast;
+        for (auto &backend : _backends) {
+            if (backend->alive) {
+                request->parts.emplace_back();
+                Send(backend.get(), request, request->parts.size() - 1, Protocol::ReplyParser::Kind::kLine, header);
+            }
+        }
+        request->missing = request->parts.size();
+    } else {
+        int owner = _ring.Find(keys.empty() ? std::string() : keys[0]);
+        if (owner >= 0) {
+            // Backend always replies, so pipelined replies can't get out of step, proxy drops the reply instead
+            std::string command = header;
+            request->noreply = client->parser.Noreply();
+            if (request->noreply) {
+                command.erase(command.rfind(" noreply"), 8);
+            }
+            command.append(body, body_size);
+
+            request->parts.emplace_back();
+            request->missing = 1;
+            Send(_backends[owner].get(), request, 0, Protocol::ReplyParser::Kind::kLine, command);
+        }
+    }
+
+    if (request->missing == 0) {
+        request->reply = "SERVER_ERROR no backend available\r\n";
+        request->done = true;
+        MarkDirty(client);
+    }
+}
+
+void Worker::Send(Backend *backend, const std::shared_ptr<Request> &request, size_t part,
+                  Protocol::ReplyParser::Kind kind, const std::string &command) {
+    if (backend->pending.empty()) {
+        backend->reply.Reset(kind);
+    }
+    backend->output += command;
+    backend->pending.push_back(Pending{request, part, kind});
+    MarkDirty(backend);
+}
+
+void Worker::Complete(Pending &pending, std::string &&reply) {
+    Request &request = *pending.request;
+    if (request.merge == Request::kValues) {
+        // Error of a backend is a miss for its keys
+        if (EndsWith(reply, kEnd, kEndSize)) {
+            reply.resize(reply.size() - kEndSize);
+        } else {
+            reply.clear();
+        }
+    }
+    request.parts[pending.part] = std::move(reply);
+    if (--request.missing > 0) {
+        return;
+    }
+
+    switch (request.merge) {
+    case Request::kSingle:
+        request.reply = std::move(request.parts[0]);
+        break;
+
+    case Request::kValues:
+        for (auto &part : request.parts) {
+            request.reply += part;
+        }
+        request.reply += kEnd;
+        break;
+
+    case Request::kBroadcast: {
+        uint64_t deleted = 0;
+        bool counted = true;
+        for (auto &part : request.parts) {
+            if (IsError(part)) {
+                request.reply = part;
+                break;
+            }
+            counted = counted && part.compare(0, 8, "DELETED ") == 0;
+            if (counted) {
+                deleted += std::strtoull(part.c_str() + 8, nullptr, 10);
+            }
+        }
+        if (request.reply.empty()) {
+            request.reply = counted ? "DELETED " + std::to_string(deleted) + "\r\n" : request.parts[0];
+        }
+        break;
+    }
+    }
+
+    request.parts.clear();
+    request.done = true;
+    if (request.client != nullptr) {
+        MarkDirty(request.client);
+    }
+}
+
+void Worker::FlushClient(Client *client) {
+    client->dirty = false;
+    while (!client->requests.empty() && client->requests.front()->done) {
+        if (!client->requests.front()->noreply) {
+            client->output += client->requests.front()->reply;
+        }
+        client->requests.pop_front();
+    }
+
+    if (!Write(client->socket, client->output)) {
+        CloseClient(client);
+        return;
+    }
+    if (client->closing && client->requests.empty() && client->output.empty()) {
+        CloseClient(client);
+        return;
+    }
+
+    // Input left unparsed while too many commands were in flight
+    if (!client->closing && client->requests.size() < kMaxInflight && client->position < client->input.size()) {
+        ProcessInput(client);
+    }
+
+    bool readable = !client->closing && client->requests.size() < kMaxInflight;
+    Watch(client, (readable ? EPOLLIN : 0) | (client->output.empty() ? 0 : EPOLLOUT));
+}
+
+void Worker::FlushBackend(Backend *backend) {
+    backend->dirty = false;
+    if (backend->socket < 0 || backend->connecting) {
+        return;
+    }
+    if (!Write(backend->socket, backend->output)) {
+        Fail(backend);
+        return;
+    }
+    Watch(backend, EPOLLIN | (backend->output.empty() ? 0 : EPOLLOUT));
+}
+
+void Worker::OnBackend(Backend *backend, uint32_t events) {
+    if (backend->socket < 0) {
+        return;
+    }
+
+    if (backend->connecting) {
+        int error = 0;
+        socklen_t size = sizeof(error);
+        if (getsockopt(backend->socket, SOL_SOCKET, SO_ERROR, &error, &size) != 0 || error != 0) {
+            Fail(backend);
+            return;
+        }
+        backend->connecting = false;
+        if (!backend->alive) {
+            backend->alive = true;
+            Rebuild();
+        }
+        FlushBackend(backend);
+        return;
+    }
+
+    if (events & EPOLLOUT) {
+        MarkDirty(backend);
+    }
+    if ((events & (EPOLLIN | EPOLLERR | EPOLLHUP)) == 0) {
+        return;
+    }
+    if (!Read(backend->socket, backend->input)) {
+        Fail(backend);
+        return;
+    }
+
+    size_t start = 0;
+    while (backend->fed < backend->input.size()) {
+        if (backend->pending.empty()) {
+            std::cerr << "Unexpected reply from backend " << backend->name << std::endl;
+            Fail(backend);
+            return;
+        }
+
+        size_t parsed;
+        bool complete;
+        try {
+            complete = backend->reply.Parse(&backend->input[backend->fed], backend->input.size() - backend->fed,
+                                            parsed);
+        } catch (std::runtime_error &ex) {
+            std::cerr << "Bad reply from backend " << backend->name << ": " << ex.what() << std::endl;
+            Fail(backend);
+            return;
+        }
+        backend->fed += parsed;
+        if (!complete) {
+            break;
+        }
+
+        Pending pending = std::move(backend->pending.front());
+        backend->pending.pop_front();
+        Complete(pending, backend->input.substr(start, backend->fed - start));
+        start = backend->fed;
+        if (!backend->pending.empty()) {
+            backend->reply.Reset(backend->pending.front().kind);
+        }
+    }
+    backend->input.erase(0, start);
+    backend->fed -= start;
+}
+
+void Worker::CloseClient(Client *client) {
+    if (client->closed) {
+        return;
+    }
+    client->closed = true;
+    for (auto &request : client->requests) {
+        request->client = nullptr;
+    }
+    client->requests.clear();
+
+    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, client->socket, nullptr);
+    close(client->socket);
+    _clients.erase(client);
+    _closed.push_back(client);
+    _stats.curr_connections--;
+}
+
+void Worker::MarkDirty(Client *client) {
+    if (!client->dirty) {
+        client->dirty = true;
+        _dirty_clients.push_back(client);
+    }
+}
+
+void Worker::MarkDirty(Backend *backend) {
+    if (!backend->dirty) {
+        backend->dirty = true;
+        _dirty_backends.push_back(backend);
+    }
+}
+
+void Worker::Connect(Backend *backend) {
+    backend->retry = std::chrono::steady_clock::now() + std::chrono::milliseconds(kRetryMs);
+
+    size_t colon = backend->name.rfind(':');
+    std::string host = backend->name.substr(0, colon);
+    std::string port = colon == std::string::npos ? "8080" : backend->name.substr(colon + 1);
+
+    struct addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *address = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &address) != 0) {
+        Fail(backend);
+        return;
+    }
+
+    int socket = ::socket(address->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (socket < 0) {
+        freeaddrinfo(address);
+        Fail(backend);
+        return;
+    }
+    int on = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    int rc = connect(socket, address->ai_addr, address->ai_addrlen);
+    freeaddrinfo(address);
+    backend->socket = socket;
+    backend->registered = false;
+    backend->events = 0;
+    if (rc != 0 && errno != EINPROGRESS) {
+        Fail(backend);
+        return;
+    }
+
+    backend->connecting = true;
+    Watch(backend, EPOLLOUT);
+}
+
+void Worker::Fail(Backend *backend) {
+    if (backend->socket >= 0) {
+        epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, backend->socket, nullptr);
+        close(backend->socket);
+        backend->socket = -1;
+    }
+    backend->connecting = false;
+    backend->output.clear();
+    backend->input.clear();
+    backend->fed = 0;
+
+    std::deque<Pending> pending;
+    pending.swap(backend->pending);
+    for (auto &command : pending) {
+        Complete(command, command.kind == Protocol::ReplyParser::Kind::kValues
+                              ? std::string(kEnd)
+                              : std::string("SERVER_ERROR backend unavailable\r\n"));
+    }
+
+    if (backend->alive) {
+        std::cerr << "Backend " << backend->name << " is unavailable" << std::endl;
+        backend->alive = false;
+        _stats.backend_failures++;
+        Rebuild();
+    }
+}
+
+void Worker::Rebuild() {
+    std::vector<bool> alive;
+    for (auto &backend : _backends) {
+        alive.push_back(backend->alive);
+    }
+    _ring.Build(_names, alive);
+}
+
+void Worker::Watch(Endpoint *endpoint, uint32_t events) {
+    if (endpoint->registered && endpoint->events == events) {
+        return;
+    }
+
+    struct epoll_event event;
+    event.events = events;
+    event.data.ptr = endpoint;
+    if (epoll_ctl(_epoll_fd, endpoint->registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, endpoint->socket, &event) != 0) {
+        throw std::runtime_error(std::string("Can't poll socket: ") + strerror(errno));
+    }
+    endpoint->registered = true;
+    endpoint->events = events;
+}
+
+std::string Worker::LocalStats() const {
+    size_t alive = 0;
+    for (auto &backend : _backends) {
+        alive += backend->alive ? 1 : 0;
+    }
+
+    std::string out;
+    out += "STAT curr_connections " + std::to_string(_stats.curr_connections.load()) + "\r\n";
+    out += "STAT total_connections " + std::to_string(_stats.total_connections.load()) + "\r\n";
+    out += "STAT commands " + std::to_string(_stats.commands.load()) + "\r\n";
+    out += "STAT backends " + std::to_string(_backends.size()) + "\r\n";
+    out += "STAT backends_alive " + std::to_string(alive) + "\r\n";
+    out += "STAT backend_failures " + std::to_string(_stats.backend_failures.load()) + "\r\n";
+    out += kEnd;
+    return out;
+}
+
+} // namespace Proxy
+} // namespace Afina
@@ -0,0 +1,144 @@
+#ifndef AFINA_PROXY_WORKER_H
+#define AFINA_PROXY_WORKER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "protocol/Parser.h"
+#include "protocol/ReplyParser.h"
+#include "protocol/Ring.h"
+
+namespace Afina {
+namespace Proxy {
+
+/**
+ * Counters shared by all the workers
+ */
+struct Stats {
+    std::atomic<uint64_t> curr_connections{0};
+    std::atomic<uint64_t> total_connections{0};
+    std::atomic<uint64_t> commands{0};
+    std::atomic<uint64_t> backend_failures{0};
+};
+
+/**
+ * # Proxy worker
+ * Event loop thread serving its share of clients. Every worker has its own connection to each backend, all
+ * commands of its clients routed there are pipelined over it: written in order, replies come back in the same
+ * order. Commands queued for a backend during one loop iteration go out with a single write.
+ *
+ * Keys are routed by consistent hash ring. Multi-key get is split into one get per backend, parts of the reply
+ * are merged back once all of them arrive. Client gets replies in the order of its commands, whatever order
+ * backends answer in.
+ *
+ * Backend which connection fails leaves the ring, so its keys go to the next servers, and it is reconnected in
+ * background. Commands which were in flight to it get SERVER_ERROR, gets treat it as a miss.
+ */
+class Worker {
+public:
+    Worker(const std::vector<std::string> &backends, Stats &stats);
+    ~Worker();
+
+    Worker(const Worker &) = delete;
+    Worker &operator=(const Worker &) = delete;
+
+    /**
+     * Spawns worker thread accepting clients on the given listening socket, which could be shared by
+     * several workers
+     */
+    void Start(int listen_socket);
+
+    /**
+     * Signals worker thread to stop, returns immediately
+     */
+    void Stop();
+
+    /**
+     * Blocks until worker thread is stopped, all connections are closed then
+     */
+    void Join();
+
+private:
+    // Pause before failed backend is reconnected
+    static const size_t kRetryMs = 1000;
+
+    // Client isn't read from while it has that many commands waiting for replies
+    static const size_t kMaxInflight = 1024;
+
+    struct Endpoint;
+    struct Client;
+    struct Backend;
+    struct Request;
+    struct Pending;
+
+    void OnRun();
+
+    void Accept();
+    void OnClient(Client *client, uint32_t events);
+    void OnBackend(Backend *backend, uint32_t events);
+
+    // Parses whatever client has sent and dispatches complete commands
+    void ProcessInput(Client *client);
+    void Dispatch(Client *client, const std::string &header, const char *body, size_t body_size);
+
+    // Queues command for the backend, it is written once loop iteration is over
+    void Send(Backend *backend, const std::shared_ptr<Request> &request, size_t part, Protocol::ReplyParser::Kind kind,
+              const std::string &command);
+
+    // Stores reply part, client gets reply once all parts are there
+    void Complete(Pending &pending, std::string &&reply);
+
+    // Writes replies ready in order, updates events client is polled for
+    void FlushClient(Client *client);
+    void FlushBackend(Backend *backend);
+    void CloseClient(Client *client);
+
+    // Schedules flush once loop iteration is over, so replies and commands are written in batches
+    void MarkDirty(Client *client);
+    void MarkDirty(Backend *backend);
+
+    void Connect(Backend *backend);
+    void Fail(Backend *backend);
+    void Rebuild();
+
+    // Sets events endpoint is polled for
+    void Watch(Endpoint *endpoint, uint32_t events);
+
+    std::string LocalStats() const;
+
+    std::vector<std::string> _names;
+    Stats &_stats;
+
+    int _listen_socket;
+    int _epoll_fd;
+    int _wakeup_fd;
+
+    std::unique_ptr<Endpoint> _listener;
+    std::unique_ptr<Endpoint> _wakeup;
+
+    std::vector<std::unique_ptr<Backend>> _backends;
+    Protocol::Ring _ring;
+
+    std::unordered_set<Client *> _clients;
+
+    // Endpoints with something to write after current iteration, clients closed during it
+    std::vector<Backend *> _dirty_backends;
+    std::vector<Client *> _dirty_clients;
+    std::vector<Client *> _closed;
+
+    std::atomic<bool> _running;
+    std::thread _thread;
+};
+
+} // namespace Proxy
+} // namespace Afina
+
+#endif // AFINA_PROXY_WORKER_H
@@ -0,0 +1,90 @@
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <uv.h>
+
+#include <cxxopts.hpp>
+
+#include <afina/Version.h>
+
+#include "ServerImpl.h"
+
+// Handle all signals catched
+void signal_handler(uv_signal_t *handle, int signum) {
+    std::cout << "Receive stop signal" << std::endl;
+    uv_stop(handle->loop);
+}
+
+int main(int argc, char **argv) {
+    std::stringstream app_string;
+    app_string << "Afina proxy " << Afina::Version_Major << "." << Afina::Version_Minor << "."
+               << Afina::Version_Patch;
+    if (Afina::Version_SHA.size() > 0) {
+        app_string << "-" << Afina::Version_SHA;
+    }
+
+    // Command line arguments parsing
+    cxxopts::Options options("afina-proxy", "Consistent hashing proxy in front of afina servers");
+    try {
+        options.add_options()("b,backends", "Servers keys are spread over, as <host>:<port>,...",
+                              cxxopts::value<std::string>());
+        options.add_options()("p,port", "Port clients connect to, 11211 by default", cxxopts::value<uint16_t>());
+        options.add_options()("w,workers", "Number of worker threads, 1 by default", cxxopts::value<uint16_t>());
+        options.add_options()("h,help", "Print usage info");
+        options.parse(argc, argv);
+
+        if (options.count("help") > 0) {
+            std::cerr << options.help() << std::endl;
+            return 0;
+        }
+        if (options.count("backends") == 0) {
+            std::cerr << "Error: no backends given" << std::endl;
+            return 1;
+        }
+    } catch (cxxopts::OptionParseException &ex) {
+        std::cerr << "Error: " << ex.what() << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> backends;
+    std::stringstream list(options["backends"].as<std::string>());
+    std::string backend;
+    while (std::getline(list, backend, ',')) {
+        if (!backend.empty()) {
+            backends.push_back(backend);
+        }
+    }
+
+    std::cout << "Starting " << app_string.str() << std::endl;
+
+    uv_loop_t loop;
+    uv_loop_init(&loop);
+
+    uv_signal_t sigterm;
+    uv_signal_init(&loop, &sigterm);
+    uv_signal_start(&sigterm, signal_handler, SIGTERM);
+
+    uv_signal_t sigint;
+    uv_signal_init(&loop, &sigint);
+    uv_signal_start(&sigint, signal_handler, SIGINT);
+
+    Afina::Proxy::ServerImpl server(backends);
+    try {
+        server.Start(options.count("port") > 0 ? options["port"].as<uint16_t>() : 11211,
+                     options.count("workers") > 0 ? options["workers"].as<uint16_t>() : 1);
+
+        std::cout << "Proxy started" << std::endl;
+        uv_run(&loop, UV_RUN_DEFAULT);
+
+        server.Stop();
+        server.Join();
+        std::cout << "Proxy stopped" << std::endl;
+    } catch (std::exception &e) {
+        std::cerr << "Fatal error " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,603 @@
+#ifndef AFINA_STORAGE_ADAPTIVE_RADIX_TREE_H
+#define AFINA_STORAGE_ADAPTIVE_RADIX_TREE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Adaptive radix tree
+ * Ordered index of item pointers by key bytes (Leis et al, "The Adaptive Radix Tree"). Inner nodes grow and
+ * shrink between 4, 16, 48 and 256 children so fan-out costs memory only where keys actually diverge. Single
+ * child chains are collapsed into node prefix (path compression), and a lone item hangs directly off its
+ * parent until another key shares its path (lazy expansion), so lookup costs O(key length) regardless of the
+ * number of items.
+ *
+ * Unlike hash index, keys sharing a prefix live in one subtree: prefix iteration costs O(prefix + matches).
+ * Items are visited in byte-wise lexicographic key order.
+ *
+ * Key may be a prefix of another key: item which key ends at an inner node is kept as node terminal.
+ *
+ * Item type must provide GetKeyReference(), which must stay the same while item is in the tree. Tree doesn't
+ * own items. Not threadsafe.
+ */
+template <typename T> class AdaptiveRadixTree {
+public:
+    AdaptiveRadixTree() : _root(0), _size(0) {}
+    ~AdaptiveRadixTree() { Free(_root); }
+
+    AdaptiveRadixTree(const AdaptiveRadixTree &) = delete;
+    AdaptiveRadixTree &operator=(const AdaptiveRadixTree &) = delete;
+
+    /**
+     * Returns item with the given key or nullptr
+     */
+    T *Find(const std::string &key) const {
+        Ref ref = _root;
+        size_t depth = 0;
+        while (ref != 0) {
+            if (IsLeaf(ref)) {
+                T *item = AsLeaf(ref);
+                return item->GetKeyReference() == key ? item : nullptr;
+            }
+
+            Node *node = AsNode(ref);
+            if (!MatchPrefix(node, key, depth)) {
+                return nullptr;
+            }
+            depth += node->prefix.size();
+            if (depth == key.size()) {
+                return node->terminal;
+            }
+
+            Ref *child = FindChild(node, key[depth]);
+            if (child == nullptr) {
+                return nullptr;
+            }
+            ref = *child;
+            depth++;
+        }
+        return nullptr;
+    }
+
+    /**
+     * Adds item to the tree, there must be no item with the same key yet
+     */
+    void Insert(T *item) {
+        const std::string &key = item->GetKeyReference();
+        Ref *ref = &_root;
+        size_t depth = 0;
+        _size++;
+
+        while (true) {
+            if (*ref == 0) {
+                *ref = MakeLeaf(item);
+                return;
+            }
+
+            if (IsLeaf(*ref)) {
+                // Lazy expansion: the first key sharing leaf path turns it into a node
+                T *other = AsLeaf(*ref);
+                const std::string &other_key = other->GetKeyReference();
+                size_t common = depth;
+                while (common < key.size() && common < other_key.size() && key[common] == other_key[common]) {
+                    common++;
+                }
+
+                Node *node = new Node4();
+                node->prefix.assign(key, depth, common - depth);
+                node = Place(node, other, common);
+                node = Place(node, item, common);
+                *ref = MakeNode(node);
+                return;
+            }
+
+            Node *node = AsNode(*ref);
+            size_t mismatch = 0;
+            while (mismatch < node->prefix.size() && depth + mismatch < key.size() &&
+                   node->prefix[mismatch] == key[depth + mismatch]) {
+                mismatch++;
+            }
+
+            if (mismatch < node->prefix.size()) {
+                // Key leaves compressed path in the middle, split it
+                Node *parent = new Node4();
+                parent->prefix.assign(node->prefix, 0, mismatch);
+                uint8_t byte = node->prefix[mismatch];
+                node->prefix.erase(0, mismatch + 1);
+                parent = AddChild(parent, byte, MakeNode(node));
+                parent = Place(parent, item, depth + mismatch);
+                *ref = MakeNode(parent);
+                return;
+            }
+
+            depth += node->prefix.size();
+            if (depth == key.size()) {
+                node->terminal = item;
+                return;
+            }
+
+            Ref *child = FindChild(node, key[depth]);
+            if (child == nullptr) {
+                *ref = MakeNode(AddChild(node, key[depth], MakeLeaf(item)));
+                return;
+            }
+            ref = child;
+            depth++;
+        }
+    }
+
+    /**
+     * Removes exactly this item from the tree. Returns false if it wasn't there
+     */
+    bool Erase(T *item) {
+        if (!Erase(_root, item, item->GetKeyReference(), 0)) {
+            return false;
+        }
+        _size--;
+        return true;
+    }
+
+    /**
+     * Calls visitor for each item which key starts with the given prefix, in key order, until visitor
+     * returns false. Visitor must not change the tree
+     */
+    template <typename Visitor> void ForEachPrefix(const std::string &prefix, Visitor visitor) const {
+        Ref ref = _root;
+        size_t depth = 0;
+        while (ref != 0) {
+            if (IsLeaf(ref)) {
+                T *item = AsLeaf(ref);
+                if (item->GetKeyReference().compare(0, prefix.size(), prefix) == 0) {
+                    visitor(item);
+                }
+                return;
+            }
+
+            // Node prefix could go beyond the one requested, then the whole subtree matches
+            Node *node = AsNode(ref);
+            size_t length = std::min(node->prefix.size(), prefix.size() - depth);
+            if (prefix.compare(depth, length, node->prefix, 0, length) != 0) {
+                return;
+            }
+            depth += node->prefix.size();
+            if (depth >= prefix.size()) {
+                Walk(ref, visitor);
+                return;
+            }
+
+            Ref *child = FindChild(node, prefix[depth]);
+            if (child == nullptr) {
+                return;
+            }
+            ref = *child;
+            depth++;
+        }
+    }
+
+    size_t Size() const { return _size; }
+
+private:
+    // Child reference: inner node pointer or item pointer with the lowest bit set, 0 is no child
+    using Ref = uintptr_t;
+
+    enum Type : uint8_t { kNode4, kNode16, kNode48, kNode256 };
+
+    struct Node {
+        Node(Type type) : type(type), count(0), terminal(nullptr) {}
+
+        Type type;
+        uint16_t count;
+
+        // Compressed path: bytes all keys in the subtree share after parent byte
+        std::string prefix;
+
+        // Item which key ends right after the prefix
+        T *terminal;
+    };
+
+    // Up to 4/16 children, keys are sorted
+    struct Node4 : Node {
+        Node4() : Node(kNode4) {
+            std::memset(keys, 0, sizeof(keys));
+            std::memset(children, 0, sizeof(children));
+        }
+        uint8_t keys[4];
+        Ref children[4];
+    };
+
+    struct Node16 : Node {
+        Node16() : Node(kNode16) {
+            std::memset(keys, 0, sizeof(keys));
+            std::memset(children, 0, sizeof(children));
+        }
+        uint8_t keys[16];
+        Ref children[16];
+    };
+
+    // Byte maps to child slot plus one, 0 means no child
+    struct Node48 : Node {
+        Node48() : Node(kNode48) {
+            std::memset(index, 0, sizeof(index));
+            std::memset(children, 0, sizeof(children));
+        }
+        uint8_t index[256];
+        Ref children[48];
+    };
+
+    struct Node256 : Node {
+        Node256() : Node(kNode256) { std::memset(children, 0, sizeof(children)); }
+        Ref children[256];
+    };
+
+    static bool IsLeaf(Ref ref) { return (ref & 1) != 0; }
+    static T *AsLeaf(Ref ref) { return reinterpret_cast<T *>(ref & ~Ref(1)); }
+    static Node *AsNode(Ref ref) { return reinterpret_cast<Node *>(ref); }
+    static Ref MakeLeaf(T *item) { return reinterpret_cast<Ref>(item) | 1; }
+    static Ref MakeNode(Node *node) { return reinterpret_cast<Ref>(node); }
+
+    static bool MatchPrefix(const Node *node, const std::string &key, size_t depth) {
+        return key.size() - depth >= node->prefix.size() && key.compare(depth, node->prefix.size(), node->prefix) == 0;
+    }
+
+    static Ref *FindChild(Node *node, char c) {
+        uint8_t byte = static_cast<uint8_t>(c);
+        switch (node->type) {
+        case kNode4: {
+            Node4 *n = static_cast<Node4 *>(node);
+            for (size_t i = 0; i < n->count; i++) {
+                if (n->keys[i] == byte) {
+                    return &n->children[i];
+                }
+            }
+            return nullptr;
+        }
+        case kNode16: {
+            Node16 *n = static_cast<Node16 *>(node);
+#ifdef __SSE2__
+            __m128i keys = _mm_loadu_si128(reinterpret_cast<const __m128i *>(n->keys));
+            uint32_t match = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(keys, _mm_set1_epi8(c))));
+            match &= (1u << n->count) - 1;
+            return match != 0 ? &n->children[__builtin_ctz(match)] : nullptr;
+#else
+            for (size_t i = 0; i < n->count; i++) {
+                if (n->keys[i] == byte) {
+                    return &n->children[i];
+                }
+            }
+            return nullptr;
+#endif
+        }
+        case kNode48: {
+            Node48 *n = static_cast<Node48 *>(node);
+            return n->index[byte] != 0 ? &n->children[n->index[byte] - 1] : nullptr;
+        }
+        case kNode256: {
+            Node256 *n = static_cast<Node256 *>(node);
+            return n->children[byte] != 0 ? &n->children[byte] : nullptr;
+        }
+        }
+        return nullptr;
+    }
+
+    // Moves header fields into the node of another size and frees the old one
+    template <typename To, typename From> static To *Replace(From *from) {
+        To *to = new To();
+        to->count = from->count;
+        to->prefix.swap(from->prefix);
+        to->terminal = from->terminal;
+        return to;
+    }
+
+    // Inserts sorted child into Node4/Node16
+    template <typename N> static void InsertSorted(N *n, uint8_t byte, Ref child) {
+        size_t position = 0;
+        while (position < n->count && n->keys[position] < byte) {
+            position++;
+        }
+        std::memmove(&n->keys[position + 1], &n->keys[position], n->count - position);
+        std::memmove(&n->children[position + 1], &n->children[position], (n->count - position) * sizeof(Ref));
+        n->keys[position] = byte;
+        n->children[position] = child;
+        n->count++;
+    }
+
+    // Adds child, possibly growing the node. Returns node to be referenced from now on
+    static Node *AddChild(Node *node, char c, Ref child) {
+        uint8_t byte = static_cast<uint8_t>(c);
+        switch (node->type) {
+        case kNode4: {
+            Node4 *n = static_cast<Node4 *>(node);
+            if (n->count < 4) {
+                InsertSorted(n, byte, child);
+                return n;
+            }
+            Node16 *grown = Replace<Node16>(n);
+            std::memcpy(grown->keys, n->keys, sizeof(n->keys));
+            std::memcpy(grown->children, n->children, sizeof(n->children));
+            delete n;
+            InsertSorted(grown, byte, child);
+            return grown;
+        }
+        case kNode16: {
+            Node16 *n = static_cast<Node16 *>(node);
+            if (n->count < 16) {
+                InsertSorted(n, byte, child);
+                return n;
+            }
+            Node48 *grown = Replace<Node48>(n);
+            for (size_t i = 0; i < n->count; i++) {
+                grown->index[n->keys[i]] = i + 1;
+                grown->children[i] = n->children[i];
+            }
+            delete n;
+            return AddChild(grown, c, child);
+        }
+        case kNode48: {
+            Node48 *n = static_cast<Node48 *>(node);
+            if (n->count < 48) {
+                size_t slot = 0;
+                while (n->children[slot] != 0) {
+                    slot++;
+                }
+                n->index[byte] = slot + 1;
+                n->children[slot] = child;
+                n->count++;
+                return n;
+            }
+            Node256 *grown = Replace<Node256>(n);
+            for (size_t b = 0; b < 256; b++) {
+                if (n->index[b] != 0) {
+                    grown->children[b] = n->children[n->index[b] - 1];
+                }
+            }
+            delete n;
+            return AddChild(grown, c, child);
+        }
+        case kNode256: {
+            Node256 *n = static_cast<Node256 *>(node);
+            n->children[byte] = child;
+            n->count++;
+            return n;
+        }
+        }
+        return node;
+    }
+
+    // Removes child, possibly shrinking the node. Returns node to be referenced from now on
+    static Node *RemoveChild(Node *node, char c) {
+        uint8_t byte = static_cast<uint8_t>(c);
+        switch (node->type) {
+        case kNode4:
+        case kNode16: {
+            uint8_t *keys = node->type == kNode4 ? static_cast<Node4 *>(node)->keys : static_cast<Node16 *>(node)->keys;
+            Ref *children =
+                node->type == kNode4 ? static_cast<Node4 *>(node)->children : static_cast<Node16 *>(node)->children;
+            size_t position = 0;
+            while (keys[position] != byte) {
+                position++;
+            }
+            std::memmove(&keys[position], &keys[position + 1], node->count - position - 1);
+            std::memmove(&children[position], &children[position + 1], (node->count - position - 1) * sizeof(Ref));
+            node->count--;
+
+            if (node->type == kNode16 && node->count <= 3) {
+                Node16 *n = static_cast<Node16 *>(node);
+                Node4 *shrunk = Replace<Node4>(n);
+                std::memcpy(shrunk->keys, n->keys, n->count);
+                std::memcpy(shrunk->children, n->children, n->count * sizeof(Ref));
+                delete n;
+                return shrunk;
+            }
+            return node;
+        }
+        case kNode48: {
+            Node48 *n = static_cast<Node48 *>(node);
+            n->children[n->index[byte] - 1] = 0;
+            n->index[byte] = 0;
+            n->count--;
+
+            if (n->count <= 12) {
+                Node16 *shrunk = Replace<Node16>(n);
+                size_t position = 0;
+                for (size_t b = 0; b < 256; b++) {
+                    if (n->index[b] != 0) {
+                        shrunk->keys[position] = b;
+                        shrunk->children[position++] = n->children[n->index[b] - 1];
+                    }
+                }
+                delete n;
+                return shrunk;
+            }
+            return n;
+        }
+        case kNode256: {
+            Node256 *n = static_cast<Node256 *>(node);
+            n->children[byte] = 0;
+            n->count--;
+
+            if (n->count <= 36) {
+                Node48 *shrunk = Replace<Node48>(n);
+                size_t slot = 0;
+                for (size_t b = 0; b < 256; b++) {
+                    if (n->children[b] != 0) {
+                        shrunk->index[b] = slot + 1;
+                        shrunk->children[slot++] = n->children[b];
+                    }
+                }
+                delete n;
+                return shrunk;
+            }
+            return n;
+        }
+        }
+        return node;
+    }
+
+    // Puts item under node which prefix ends at depth of the item key
+    static Node *Place(Node *node, T *item, size_t depth) {
+        const std::string &key = item->GetKeyReference();
+        if (key.size() == depth) {
+            node->terminal = item;
+            return node;
+        }
+        return AddChild(node, key[depth], MakeLeaf(item));
+    }
+
+    // Calls visitor for each child in byte order until it returns false
+    template <typename Visitor> static bool ForEachChild(Node *node, Visitor visitor) {
+        switch (node->type) {
+        case kNode4: {
+            Node4 *n = static_cast<Node4 *>(node);
+            for (size_t i = 0; i < n->count; i++) {
+                if (!visitor(n->keys[i], n->children[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        case kNode16: {
+            Node16 *n = static_cast<Node16 *>(node);
+            for (size_t i = 0; i < n->count; i++) {
+                if (!visitor(n->keys[i], n->children[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        case kNode48: {
+            Node48 *n = static_cast<Node48 *>(node);
+            for (size_t b = 0; b < 256; b++) {
+                if (n->index[b] != 0 && !visitor(uint8_t(b), n->children[n->index[b] - 1])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        case kNode256: {
+            Node256 *n = static_cast<Node256 *>(node);
+            for (size_t b = 0; b < 256; b++) {
+                if (n->children[b] != 0 && !visitor(uint8_t(b), n->children[b])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        }
+        return true;
+    }
+
+    // Replaces node which has no more reasons to exist: no children, or single child and no terminal
+    static void Collapse(Ref &ref) {
+        Node *node = AsNode(ref);
+        if (node->count == 0) {
+            ref = node->terminal != nullptr ? MakeLeaf(node->terminal) : 0;
+            Delete(node);
+        } else if (node->count == 1 && node->terminal == nullptr) {
+            ForEachChild(node, [node, &ref](uint8_t byte, Ref child) {
+                if (!IsLeaf(child)) {
+                    Node *next = AsNode(child);
+                    next->prefix = node->prefix + char(byte) + next->prefix;
+                }
+                ref = child;
+                return false;
+            });
+            Delete(node);
+        }
+    }
+
+    static bool Erase(Ref &ref, T *item, const std::string &key, size_t depth) {
+        if (ref == 0) {
+            return false;
+        }
+        if (IsLeaf(ref)) {
+            if (AsLeaf(ref) != item) {
+                return false;
+            }
+            ref = 0;
+            return true;
+        }
+
+        Node *node = AsNode(ref);
+        if (!MatchPrefix(node, key, depth)) {
+            return false;
+        }
+        depth += node->prefix.size();
+        if (depth == key.size()) {
+            if (node->terminal != item) {
+                return false;
+            }
+            node->terminal = nullptr;
+            Collapse(ref);
+            return true;
+        }
+
+        Ref *child = FindChild(node, key[depth]);
+        if (child == nullptr || !Erase(*child, item, key, depth + 1)) {
+            return false;
+        }
+        if (*child == 0) {
+            ref = MakeNode(RemoveChild(node, key[depth]));
+            Collapse(ref);
+        }
+        return true;
+    }
+
+    // Visits subtree in key order, returns false once visitor asked to stop
+    template <typename Visitor> static bool Walk(Ref ref, Visitor &visitor) {
+        if (IsLeaf(ref)) {
+            return visitor(AsLeaf(ref));
+        }
+        Node *node = AsNode(ref);
+        if (node->terminal != nullptr && !visitor(node->terminal)) {
+            return false;
+        }
+        return ForEachChild(node, [&visitor](uint8_t, Ref child) { return Walk(child, visitor); });
+    }
+
+    static void Delete(Node *node) {
+        switch (node->type) {
+        case kNode4:
+            delete static_cast<Node4 *>(node);
+            break;
+        case kNode16:
+            delete static_cast<Node16 *>(node);
+            break;
+        case kNode48:
+            delete static_cast<Node48 *>(node);
+            break;
+        case kNode256:
+            delete static_cast<Node256 *>(node);
+            break;
+        }
+    }
+
+    static void Free(Ref ref) {
+        if (ref == 0 || IsLeaf(ref)) {
+            return;
+        }
+        Node *node = AsNode(ref);
+        ForEachChild(node, [](uint8_t, Ref child) {
+            Free(child);
+            return true;
+        });
+        Delete(node);
+    }
+
+    Ref _root;
+    size_t _size;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_ADAPTIVE_RADIX_TREE_H
@@ -0,0 +1,131 @@
+#ifndef AFINA_STORAGE_ARC_POLICY_H
+#define AFINA_STORAGE_ARC_POLICY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "Entry.h"
+#include "EvictionPolicy.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Adaptive replacement cache
+ * Megiddo and Modha, "ARC: A Self-Tuning, Low Overhead Replacement Cache", with all sizes in bytes. Entries
+ * seen once live in recent LRU list T1, seen twice or more in frequent LRU list T2. Evicted keys are kept in
+ * ghost lists B1 and B2. Return of a key from B1 means T1 was too small and grows its target share, return
+ * from B2 shrinks it. See EvictionPolicy.h for the interface.
+ */
+class ArcPolicy {
+   public:
+    ArcPolicy(size_t max_size)
+        : _max_size(max_size), _target(0), _recent_size(0), _frequent_size(0), _victim(nullptr) {}
+
+    void Insert(Entry *entry) {
+        _victim = nullptr;
+        size_t size = entry->Size();
+        if (_recent_ghosts.Take(entry->GetHash())) {
+            size_t ratio = _recent_ghosts.Size() > 0 ? _frequent_ghosts.Size() / _recent_ghosts.Size() : 1;
+            _target = std::min(_max_size, _target + size * std::max<size_t>(ratio, 1));
+            AddFrequent(entry);
+        } else if (_frequent_ghosts.Take(entry->GetHash())) {
+            size_t ratio = _frequent_ghosts.Size() > 0 ? _recent_ghosts.Size() / _frequent_ghosts.Size() : 1;
+            size_t delta = size * std::max<size_t>(ratio, 1);
+            _target = _target > delta ? _target - delta : 0;
+            AddFrequent(entry);
+        } else {
+            entry->SetSegment(kRecent);
+            _recent.AddToHead(entry);
+            _recent_size += size;
+        }
+    }
+
+    void Touch(Entry *entry) {
+        if (entry->GetSegment() == kFrequent) {
+            _frequent.MoveToHead(entry);
+            return;
+        }
+        _recent.Exclude(entry);
+        _recent_size -= entry->Size();
+        AddFrequent(entry);
+    }
+
+    void Resize(Entry *entry, size_t old_size) {
+        size_t &size = entry->GetSegment() == kFrequent ? _frequent_size : _recent_size;
+        size = size + entry->Size() - old_size;
+    }
+
+    void Remove(Entry *entry) {
+        bool evicted = entry == _victim;
+        _victim = nullptr;
+        if (entry->GetSegment() == kFrequent) {
+            _frequent.Exclude(entry);
+            _frequent_size -= entry->Size();
+            if (evicted) {
+                _frequent_ghosts.Add(entry->GetHash(), entry->Size());
+            }
+        } else {
+            _recent.Exclude(entry);
+            _recent_size -= entry->Size();
+            if (evicted) {
+                _recent_ghosts.Add(entry->GetHash(), entry->Size());
+            }
+        }
+
+        // Each list with its ghosts covers at most the whole budget
+        _recent_ghosts.Trim(_max_size - std::min(_max_size, _recent_size));
+        _frequent_ghosts.Trim(_max_size - std::min(_max_size, _frequent_size));
+    }
+
+    void Miss(uint64_t hash) {}
+
+    Entry *Victim(const Entry *pinned = nullptr) {
+        Entry *recent = _recent.GetTail(pinned);
+        Entry *frequent = _frequent.GetTail(pinned);
+        _victim = recent != nullptr && (_recent_size > _target || frequent == nullptr) ? recent : frequent;
+        return _victim;
+    }
+
+    void SetMaxSize(size_t max_size) {
+        _max_size = max_size;
+        _target = std::min(_target, max_size);
+        _recent_ghosts.Trim(_max_size - std::min(_max_size, _recent_size));
+        _frequent_ghosts.Trim(_max_size - std::min(_max_size, _frequent_size));
+    }
+
+    template <typename F> void ForEach(F visit) {
+        _recent.ForEachFromTail(visit);
+        _frequent.ForEachFromTail(visit);
+    }
+
+   private:
+    enum Segment : uint8_t { kRecent, kFrequent };
+
+    void AddFrequent(Entry *entry) {
+        entry->SetSegment(kFrequent);
+        _frequent.AddToHead(entry);
+        _frequent_size += entry->Size();
+    }
+
+    size_t _max_size;
+
+    // Adaptive target size of T1
+    size_t _target;
+
+    CacheList _recent;
+    CacheList _frequent;
+    size_t _recent_size;
+    size_t _frequent_size;
+    GhostList _recent_ghosts;
+    GhostList _frequent_ghosts;
+
+    // Entry last returned by Victim
+    Entry *_victim;
+};
+
+}  // namespace Backend
+}  // namespace Afina
+
+#endif  // AFINA_STORAGE_ARC_POLICY_H
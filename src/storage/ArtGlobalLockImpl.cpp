@@ -0,0 +1,64 @@
+#include "ArtGlobalLockImpl.h"
+
+namespace Afina {
+namespace Backend {
+
+// See ArtGlobalLockImpl.h
+template <typename Policy> ArtGlobalLockImpl<Policy>::~ArtGlobalLockImpl() {
+    // Maintainer must not reach the tree once it is gone
+    this->Stop();
+}
+
+// See ArtGlobalLockImpl.h
+template <typename Policy>
+bool ArtGlobalLockImpl<Policy>::Scan(const std::string &prefix, size_t limit, std::vector<std::string> &keys,
+                                     std::vector<Storage::Item> &items) const {
+    std::unique_lock<std::mutex> lock(this->_mutex);
+
+    // Expired entries are skipped, tree must not change while being walked
+    size_t found = 0;
+    _tree.ForEachPrefix(prefix, [&](Entry *entry) {
+        if (found == limit) {
+            return false;
+        }
+        if (!entry->IsExpired(this->_now)) {
+            keys.push_back(entry->GetKeyReference());
+            items.push_back(Storage::Item{true, entry->GetSlice(), entry->GetFlags(), entry->GetCas()});
+            found++;
+        }
+        return true;
+    });
+    return true;
+}
+
+// See ArtGlobalLockImpl.h
+template <typename Policy>
+bool ArtGlobalLockImpl<Policy>::DeletePrefix(const std::string &prefix, size_t &deleted) {
+    std::unique_lock<std::mutex> lock(this->_mutex);
+
+    std::vector<Entry *> entries;
+    _tree.ForEachPrefix(prefix, [&entries](Entry *entry) {
+        entries.push_back(entry);
+        return true;
+    });
+
+    deleted = 0;
+    for (Entry *entry : entries) {
+        if (!entry->IsExpired(this->_now)) {
+            deleted++;
+        }
+        this->Log(MutationLog::kDelete, entry);
+        this->RemoveEntry(entry);
+    }
+    return true;
+}
+
+template class ArtGlobalLockImpl<LruPolicy>;
+template class ArtGlobalLockImpl<SlruPolicy>;
+template class ArtGlobalLockImpl<TwoQueuePolicy>;
+template class ArtGlobalLockImpl<ArcPolicy>;
+template class ArtGlobalLockImpl<GdsfPolicy>;
+template class ArtGlobalLockImpl<TinyLfuPolicy>;
+
+}  // namespace Backend
+}  // namespace Afina
@@ -0,0 +1,49 @@
+#ifndef AFINA_STORAGE_ART_GLOBAL_LOCK_IMPL_H
+#define AFINA_STORAGE_ART_GLOBAL_LOCK_IMPL_H
+
+#include <string>
+#include <vector>
+
+#include "AdaptiveRadixTree.h"
+#include "MapBasedGlobalLockImpl.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Radix tree based implementation with global lock
+ * Same storage as MapBasedGlobalLockImpl: byte budget with policy driven eviction, expiration and version stamps,
+ * but entries are indexed by adaptive radix tree instead of hash table. Point lookups cost O(key length), and
+ * keys are ordered, so all keys under some prefix could be listed or dropped in O(prefix + matches).
+ */
+template <typename Policy = LruPolicy> class ArtGlobalLockImpl : public MapBasedGlobalLockImpl<Policy> {
+   public:
+    // See MapBasedGlobalLockImpl.h
+    ArtGlobalLockImpl(size_t max_size = 1024, size_t low_headroom = 0, size_t high_headroom = 0)
+        : MapBasedGlobalLockImpl<Policy>(max_size, low_headroom, high_headroom) {}
+    ~ArtGlobalLockImpl();
+
+    // Implements Afina::Storage interface
+    bool Scan(const std::string &prefix, size_t limit, std::vector<std::string> &keys,
+              std::vector<Storage::Item> &items) const override;
+
+    // Implements Afina::Storage interface
+    bool DeletePrefix(const std::string &prefix, size_t &deleted) override;
+
+   protected:
+    // See MapBasedGlobalLockImpl.h
+    Entry *IndexFind(const std::string &key, uint64_t hash) const override { return _tree.Find(key); }
+    void IndexInsert(Entry *entry) const override { _tree.Insert(entry); }
+    void IndexErase(Entry *entry) const override { _tree.Erase(entry); }
+
+    // Tree has no capacity, it grows node by node
+    bool IndexReserve(size_t count) override { return false; }
+
+   private:
+    mutable AdaptiveRadixTree<Entry> _tree;
+};
+
+}  // namespace Backend
+}  // namespace Afina
+
+#endif  // AFINA_STORAGE_ART_GLOBAL_LOCK_IMPL_H
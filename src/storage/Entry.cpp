@@ -0,0 +1,123 @@
+#include "Entry.h"
+
+namespace Afina {
+namespace Backend {
+
+std::shared_ptr<const std::string> Entry::GetSlice() const {
+    if (_is_number) {
+        return std::make_shared<std::string>(std::to_string(_number));
+    }
+    return _value;
+}
+
+void Entry::Append(const std::string &value) const {
+    if (_is_number) {
+        _value = std::make_shared<std::string>(std::to_string(_number));
+        _is_number = false;
+    } else if (_value.use_count() > 1) {
+        _value = std::make_shared<std::string>(*_value);
+    }
+    _value->append(value);
+}
+
+void Entry::Prepend(const std::string &value) const {
+    if (_is_number) {
+        _value = std::make_shared<std::string>(std::to_string(_number));
+        _is_number = false;
+    } else if (_value.use_count() > 1) {
+        _value = std::make_shared<std::string>(*_value);
+    }
+    _value->insert(0, value);
+}
+
+bool Entry::GetNumber(uint64_t &number) const {
+    if (_is_number) {
+        number = _number;
+        return true;
+    }
+
+    // memcached keeps at most 20 digits for 64-bit counters
+    if (_value->empty() || _value->size() > 20) {
+        return false;
+    }
+
+    uint64_t result = 0;
+    for (char c : *_value) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        uint64_t next = result * 10 + (c - '0');
+        if (next / 10 != result) {
+            // Overflow
+            return false;
+        }
+        result = next;
+    }
+    number = result;
+    return true;
+}
+
+CacheList::~CacheList() {
+    Entry *tmp = _head;
+    while (tmp != nullptr) {
+        Entry *previous = tmp;
+        tmp = tmp->GetNext();
+        delete previous;
+    }
+}
+
+Entry *CacheList::GetHead() { return _head; }
+
+Entry *CacheList::GetTail() { return _tail; }
+
+Entry *CacheList::GetTail(const Entry *skip) {
+    if (_tail == nullptr || _tail != skip) {
+        return _tail;
+    }
+    return _tail->GetPrevious();
+}
+
+void CacheList::AddToHead(Entry *entry) {
+    entry->SetPrevious(nullptr);
+    if (_head != nullptr) {
+        entry->SetNext(_head);
+        _head->SetPrevious(entry);
+        _head = entry;
+    } else {
+        entry->SetNext(_head);
+        _head = entry;
+        _tail = entry;
+    }
+}
+
+void CacheList::Exclude(Entry *entry) {
+    Entry *next = entry->GetNext();
+    Entry *previous = entry->GetPrevious();
+
+    if (entry != _tail) {
+        next->SetPrevious(previous);
+    } else {
+        _tail = previous;
+    }
+    if (entry != _head) {
+        previous->SetNext(next);
+    } else {
+        _head = next;
+    }
+}
+void CacheList::Delete(Entry *entry) {
+    Exclude(entry);
+    delete entry;
+}
+
+void CacheList::MoveToHead(Entry *entry) {
+    if (entry != _head) {
+        Exclude(entry);
+        AddToHead(entry);
+    }
+}
+
+void CacheList::DeleteTail() { Delete(_tail); }
+
+}  // namespace Backend
+}  // namespace Afina
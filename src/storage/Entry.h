@@ -0,0 +1,166 @@
+#ifndef AFINA_STORAGE_ENTRY_H
+#define AFINA_STORAGE_ENTRY_H
+
+#include <cstdint>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "TimingWheel.h"
+
+namespace Afina {
+namespace Backend {
+using key = std::string;
+using value = std::string;
+
+class Entry {
+   public:
+    Entry(const std::string &key, uint64_t hash, std::string &&value,
+          Entry *next = nullptr, Entry *previous = nullptr)
+        : _key(key), _hash(hash), _value(std::make_shared<std::string>(std::move(value))), _number(0), _is_number(false), _flags(0), _cas(0), _timer(this), _segment(0), _next(next),
+          _previous(previous) {}
+
+    size_t Size() const { return _key.size() + GetValueSize(); }
+
+    std::string GetValue() const { return _is_number ? std::to_string(_number) : *_value; }
+    size_t GetValueSize() const { return _is_number ? NumberSize(_number) : _value->size(); }
+    void SetValue(std::string &&value) const {
+        _value = std::make_shared<std::string>(std::move(value));
+        _is_number = false;
+    }
+
+    // Immutable snapshot of the value shared with readers, see Storage::Get
+    std::shared_ptr<const std::string> GetSlice() const;
+
+    // Value in place updates, see Storage::Append/Prepend
+    void Append(const std::string &value) const;
+    void Prepend(const std::string &value) const;
+
+    // Number, that value represents. Returns false if value isn't a decimal unsigned integer
+    bool GetNumber(uint64_t &number) const;
+    void SetNumber(uint64_t number) const {
+        _number = number;
+        _is_number = true;
+        _value = std::make_shared<std::string>();
+    }
+    uint32_t GetFlags() const { return _flags; }
+    void SetFlags(uint32_t flags) const { _flags = flags; }
+    uint64_t GetCas() const { return _cas; }
+    void SetCas(uint64_t cas) const { _cas = cas; }
+
+    // Expiration timer, its expire field is an absolute deadline in seconds, 0 means never
+    TimingWheel<Entry>::Node *GetTimer() const { return &_timer; }
+    bool IsExpired(time_t now) const { return _timer.expire != 0 && _timer.expire <= now; }
+
+    // Eviction policy bookkeeping, e.g. which of policy lists entry belongs to
+    uint8_t GetSegment() const { return _segment; }
+    void SetSegment(uint8_t segment) const { _segment = segment; }
+
+    static size_t NumberSize(uint64_t number) {
+        size_t digits = 1;
+        while (number >= 10) {
+            number /= 10;
+            digits++;
+        }
+        return digits;
+    }
+
+    const std::string &GetKeyReference() const { return _key; }
+    uint64_t GetHash() const { return _hash; }
+
+    Entry *GetPrevious() const { return _previous; }
+    void SetPrevious(Entry *previous) { _previous = previous; }
+
+    Entry *GetNext() const { return _next; }
+    void SetNext(Entry *next) { _next = next; }
+
+    friend std::ostream &operator<<(std::ostream &out, const Entry &entry) {
+        out << "Address: " << &entry;
+        out << " key: " << entry.GetKeyReference();
+        out << " value: " << entry.GetValue();
+        out << " next: " << entry._next;
+        out << " previous: " << entry._previous;
+        return out;
+    }
+
+   private:
+    const std::string _key;
+
+    // Full hash of the key, see Afina::Hash
+    const uint64_t _hash;
+
+    // Value buffer could be shared with readers which are still sending it out. Buffer is never changed
+    // once shared, in place updates copy it first
+    mutable std::shared_ptr<std::string> _value;
+
+    // Once value gets incremented/decremented it is kept as a native number
+    // until the next non-numeric update
+    mutable uint64_t _number;
+    mutable bool _is_number;
+
+    // Opaque client flags
+    mutable uint32_t _flags;
+
+    // Version stamp of the value, changes on each update
+    mutable uint64_t _cas;
+
+    mutable TimingWheel<Entry>::Node _timer;
+
+    mutable uint8_t _segment;
+
+    Entry *_next;
+    Entry *_previous;
+
+    // Entry& will be used instead of iterator
+};
+class CacheList {
+   public:
+    CacheList() : _head(nullptr), _tail(nullptr) {}
+    ~CacheList();
+    void MoveToHead(Entry *entry);
+
+    Entry *GetHead();
+    Entry *GetTail();
+    // Tail or entry before it if the tail is skipped one, nullptr if there is no other entry
+    Entry *GetTail(const Entry *skip);
+    void AddToHead(Entry *entry);
+    void DeleteTail();
+    void Delete(Entry *entry);
+    void Exclude(Entry *entry);
+
+    // Calls visit(entry) for each entry from tail to head
+    template <typename F> void ForEachFromTail(F visit) {
+        for (Entry *entry = _tail; entry != nullptr; entry = entry->GetPrevious()) {
+            visit(entry);
+        }
+    }
+    friend std::ostream &operator<<(std::ostream &out,
+                                    const CacheList &cache_list) {
+        Entry *tmp = nullptr;
+        Entry *head = cache_list._head;
+        Entry *tail = cache_list._tail;
+        if (head != nullptr) {
+            out << "HEAD " << *head << std::endl;
+            tmp = head->GetNext();
+        }
+        if (tail != nullptr) {
+            out << "TAIL " << *head << std::endl;
+        }
+
+        while (tmp != nullptr) {
+            out << *tmp << std::endl;
+            tmp = tmp->GetNext();
+        }
+        return out;
+    }
+
+   private:
+    Entry *_head;
+    Entry *_tail;
+};
+
+}  // namespace Backend
+}  // namespace Afina
+
+#endif  // AFINA_STORAGE_ENTRY_H
@@ -0,0 +1,109 @@
+#ifndef AFINA_STORAGE_EVICTION_POLICY_H
+#define AFINA_STORAGE_EVICTION_POLICY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+#include "Entry.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Eviction policies
+ * Storage decides when bytes have to be freed, policy decides which entry goes. Policy is a template
+ * parameter of the storage, so calls are resolved at compile time. Every policy provides:
+ *
+ * - Policy(size_t max_size): byte budget of the storage
+ * - void Insert(Entry *entry): takes new entry under control
+ * - void Touch(Entry *entry): entry has been accessed
+ * - void Resize(Entry *entry, size_t old_size): entry size has changed
+ * - void Remove(Entry *entry): releases entry, doesn't free it
+ * - void Miss(uint64_t hash): lookup of the key with given hash has failed
+ * - Entry *Victim(const Entry *pinned = nullptr): entry to be evicted next other than pinned one, nullptr if there
+ *   are none. Pinned entry is passed over in place, not treated as evicted
+ * - void SetMaxSize(size_t max_size): byte budget has changed, storage evicts down to it on its own
+ * - void ForEach(F visit): calls visit(entry) for every entry, roughly from the next victim to the most
+ *   valuable one, so snapshot restores eviction order
+ *
+ * Entries still under control are freed together with the policy. Policies aren't threadsafe.
+ *
+ * Entry removed right after being returned by Victim() counts as evicted, policies which learn from evictions
+ * (ghost lists, aging) rely on that.
+ */
+
+/**
+ * # Least recently used
+ * Single recency list, victim is the tail.
+ */
+class LruPolicy {
+   public:
+    LruPolicy(size_t max_size) {}
+
+    void Insert(Entry *entry) { _list.AddToHead(entry); }
+    void Touch(Entry *entry) { _list.MoveToHead(entry); }
+    void Resize(Entry *entry, size_t old_size) {}
+    void Remove(Entry *entry) { _list.Exclude(entry); }
+    void Miss(uint64_t hash) {}
+    Entry *Victim(const Entry *pinned = nullptr) { return _list.GetTail(pinned); }
+    void SetMaxSize(size_t max_size) {}
+    template <typename F> void ForEach(F visit) { _list.ForEachFromTail(visit); }
+
+   private:
+    CacheList _list;
+};
+
+/**
+ * # Eviction history
+ * Hashes of recently evicted keys with sizes of their entries, oldest are forgotten first. Lets policies notice
+ * that evicted key came back and was evicted too early.
+ */
+class GhostList {
+   public:
+    GhostList() : _size(0) {}
+
+    void Add(uint64_t hash, size_t size) {
+        Take(hash);
+        _order.emplace_front(hash, size);
+        _index[hash] = _order.begin();
+        _size += size;
+    }
+
+    // Forgets the key, returns false if there was no such key
+    bool Take(uint64_t hash) {
+        auto it = _index.find(hash);
+        if (it == _index.end()) {
+            return false;
+        }
+        _size -= it->second->second;
+        _order.erase(it->second);
+        _index.erase(it);
+        return true;
+    }
+
+    // Forgets the oldest keys until total size of entries they had fits into max_size
+    void Trim(size_t max_size) {
+        while (_size > max_size) {
+            _size -= _order.back().second;
+            _index.erase(_order.back().first);
+            _order.pop_back();
+        }
+    }
+
+    size_t Size() const { return _size; }
+
+   private:
+    std::list<std::pair<uint64_t, size_t>> _order;
+    std::unordered_map<uint64_t, std::list<std::pair<uint64_t, size_t>>::iterator> _index;
+
+    // Total size of forgotten entries
+    size_t _size;
+};
+
+}  // namespace Backend
+}  // namespace Afina
+
+#endif  // AFINA_STORAGE_EVICTION_POLICY_H
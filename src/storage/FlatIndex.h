@@ -0,0 +1,290 @@
+#ifndef AFINA_STORAGE_FLAT_INDEX_H
+#define AFINA_STORAGE_FLAT_INDEX_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Flat open addressing index
+ * Swiss table style hash set of item pointers. Slots are split into groups of 16, each slot has one control
+ * byte: empty, deleted or 7 lower bits of the item hash. Lookup compares 16 control bytes at once (SSE2, with
+ * portable fallback) and touches item only on tag match, so a miss usually costs one cache line and a hit
+ * one more for the item itself. No per item allocations, no pointer chasing through buckets.
+ *
+ * Groups are probed triangularly starting from the upper hash bits. Probing stops at the first group having
+ * an empty slot, so erase leaves a tombstone only when group is full.
+ *
+ * Rehash is incremental, as in Redis dict: new table is allocated and every following insert or erase moves
+ * a few groups of the old one into it. Until the old table is drained lookups check both. Old table is
+ * always drained before the new one could fill up, so single operation never moves more than kMigrateGroups
+ * groups.
+ *
+ * Item type must provide GetHash() and GetKeyReference(). Index doesn't own items, rehash never calls
+ * GetKeyReference(). Not threadsafe.
+ */
+template <typename T> class FlatIndex {
+public:
+    FlatIndex() : _size(0), _growth_left(0), _migrated(0) { Rehash(kGroupSize); }
+
+    FlatIndex(const FlatIndex &) = delete;
+    FlatIndex &operator=(const FlatIndex &) = delete;
+
+    /**
+     * Returns item with the given key or nullptr
+     *
+     * @param key key to look for
+     * @param hash Afina::Hash of the key
+     */
+    T *Find(const std::string &key, uint64_t hash) const {
+        T *item = _table.Find(key, hash);
+        if (item == nullptr && !_old.Empty()) {
+            item = _old.Find(key, hash);
+        }
+        return item;
+    }
+
+    /**
+     * Adds item to the index, there must be no item with the same key yet
+     */
+    void Insert(T *item) {
+        if (_growth_left == 0) {
+            Rehash(Capacity() * (_size * 2 >= Capacity() ? 2 : 1));
+        }
+        if (_table.Place(item) == kEmpty) {
+            _growth_left--;
+        }
+        _size++;
+        Migrate(kMigrateGroups);
+    }
+
+    /**
+     * Removes exactly this item from the index. Returns false if it wasn't there
+     */
+    bool Erase(T *item) {
+        bool freed;
+        if (_table.Erase(item, freed)) {
+            _growth_left += freed ? 1 : 0;
+        } else if (_old.Empty() || !_old.Erase(item, freed)) {
+            return false;
+        }
+        _size--;
+        Migrate(kMigrateGroups);
+        return true;
+    }
+
+    /**
+     * Makes room for the given number of items, so they could be inserted without rehash. Items are moved
+     * into the larger table incrementally as usual
+     */
+    void Reserve(size_t count) {
+        size_t capacity = kGroupSize;
+        while (capacity - capacity / 8 < count) {
+            capacity *= 2;
+        }
+        if (capacity > Capacity()) {
+            Rehash(capacity);
+        }
+    }
+
+    size_t Size() const { return _size; }
+
+    size_t Capacity() const { return _table.capacity; }
+
+    // Whenever items are being moved from the old table
+    bool Rehashing() const { return !_old.Empty(); }
+
+    /**
+     * Bytes used by the index itself, items are not counted
+     */
+    size_t MemoryUsage() const {
+        return (_table.capacity + _old.capacity) * (1 + sizeof(T *));
+    }
+
+private:
+    static const size_t kGroupSize = 16;
+    static const size_t kMigrateGroups = 2;
+    static const int8_t kEmpty = -128;
+    static const int8_t kDeleted = -2;
+
+    static int8_t Tag(uint64_t hash) { return static_cast<int8_t>(hash & 0x7f); }
+
+    // Bit i is set if control byte i of the group equals to the given one
+    static uint32_t Match(const int8_t *control, int8_t tag) {
+#ifdef __SSE2__
+        __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i *>(control));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(tag))));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < kGroupSize; i++) {
+            mask |= static_cast<uint32_t>(control[i] == tag) << i;
+        }
+        return mask;
+#endif
+    }
+
+    // Bit i is set if slot i of the group is empty or deleted, i.e. has the highest bit set
+    static uint32_t MatchFree(const int8_t *control) {
+#ifdef __SSE2__
+        __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i *>(control));
+        return static_cast<uint32_t>(_mm_movemask_epi8(group));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < kGroupSize; i++) {
+            mask |= static_cast<uint32_t>(control[i] < 0) << i;
+        }
+        return mask;
+#endif
+    }
+
+    // Control bytes and item pointers, both have the same power of two size. Slot is valid only if its
+    // control byte is a tag, so pointers are left uninitialized: big table allocation doesn't touch memory
+    struct Table {
+        Table() : capacity(0), mask(0) {}
+
+        std::unique_ptr<int8_t[]> control;
+        std::unique_ptr<T *[]> slots;
+        size_t capacity;
+
+        // Number of groups minus one
+        size_t mask;
+
+        bool Empty() const { return capacity == 0; }
+
+        size_t Groups() const { return capacity / kGroupSize; }
+
+        size_t Start(uint64_t hash) const { return static_cast<size_t>(hash >> 7) & mask; }
+
+        T *Find(const std::string &key, uint64_t hash) const {
+            const int8_t tag = Tag(hash);
+            size_t group = Start(hash);
+            for (size_t step = 1;; step++) {
+                const int8_t *group_control = &control[group * kGroupSize];
+                for (uint32_t match = Match(group_control, tag); match != 0; match &= match - 1) {
+                    T *item = slots[group * kGroupSize + __builtin_ctz(match)];
+                    if (item->GetHash() == hash && item->GetKeyReference() == key) {
+                        return item;
+                    }
+                }
+                if (Match(group_control, kEmpty) != 0) {
+                    return nullptr;
+                }
+                group = (group + step) & mask;
+            }
+        }
+
+        // Puts item into the first free slot of its probe sequence, returns previous control byte of the slot
+        int8_t Place(T *item) {
+            const uint64_t hash = item->GetHash();
+            size_t group = Start(hash);
+            for (size_t step = 1;; step++) {
+                uint32_t free = MatchFree(&control[group * kGroupSize]);
+                if (free != 0) {
+                    size_t slot = group * kGroupSize + __builtin_ctz(free);
+                    int8_t previous = control[slot];
+                    control[slot] = Tag(hash);
+                    slots[slot] = item;
+                    return previous;
+                }
+                group = (group + step) & mask;
+            }
+        }
+
+        // Removes exactly this item, freed is set if slot became empty rather than a tombstone
+        bool Erase(T *item, bool &freed) {
+            const uint64_t hash = item->GetHash();
+            const int8_t tag = Tag(hash);
+            size_t group = Start(hash);
+            for (size_t step = 1;; step++) {
+                int8_t *group_control = &control[group * kGroupSize];
+                for (uint32_t match = Match(group_control, tag); match != 0; match &= match - 1) {
+                    size_t slot = group * kGroupSize + __builtin_ctz(match);
+                    if (slots[slot] == item) {
+                        // Probes never passed a group with empty slot, so it could get one more
+                        freed = Match(group_control, kEmpty) != 0;
+                        control[slot] = freed ? kEmpty : kDeleted;
+                        return true;
+                    }
+                }
+                if (Match(group_control, kEmpty) != 0) {
+                    return false;
+                }
+                group = (group + step) & mask;
+            }
+        }
+    };
+
+    // Starts moving items into a new table with the given number of slots, drops all tombstones. Previous
+    // rehash, if any, is finished at once
+    void Rehash(size_t capacity) {
+        Migrate(_old.Groups());
+
+        std::swap(_old, _table);
+        _migrated = 0;
+
+        _table.control.reset(new int8_t[capacity]);
+        std::memset(_table.control.get(), kEmpty, capacity);
+        _table.slots.reset(new T *[capacity]);
+        _table.capacity = capacity;
+        _table.mask = capacity / kGroupSize - 1;
+        _growth_left = capacity - capacity / 8;
+    }
+
+    // Moves items of the next groups from the old table, releases it once drained. Moved slots become
+    // tombstones, so probes for the rest of old items still pass them
+    void Migrate(size_t groups) {
+        if (_old.Empty()) {
+            return;
+        }
+
+        size_t last = std::min(_migrated + groups, _old.Groups());
+        for (; _migrated < last; _migrated++) {
+            for (size_t slot = _migrated * kGroupSize; slot < (_migrated + 1) * kGroupSize; slot++) {
+                if (_old.control[slot] >= 0) {
+                    if (_table.Place(_old.slots[slot]) == kEmpty && _growth_left > 0) {
+                        _growth_left--;
+                    }
+                    _old.control[slot] = kDeleted;
+                }
+            }
+        }
+
+        if (_migrated == _old.Groups()) {
+            _old = Table();
+        }
+    }
+
+    Table _table;
+
+    // Table being drained, empty unless rehash is in progress
+    Table _old;
+
+    size_t _size;
+
+    // Inserts left before rehash, keeps load factor under 7/8 counting tombstones
+    size_t _growth_left;
+
+    // Number of old table groups already moved
+    size_t _migrated;
+};
+
+template <typename T> const size_t FlatIndex<T>::kGroupSize;
+template <typename T> const size_t FlatIndex<T>::kMigrateGroups;
+template <typename T> const int8_t FlatIndex<T>::kEmpty;
+template <typename T> const int8_t FlatIndex<T>::kDeleted;
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_FLAT_INDEX_H
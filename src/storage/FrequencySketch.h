@@ -0,0 +1,110 @@
+#ifndef AFINA_STORAGE_FREQUENCY_SKETCH_H
+#define AFINA_STORAGE_FREQUENCY_SKETCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Access frequency sketch
+ * Count-min sketch with 4-bit saturating counters, 16 counters per 64-bit word, 4 rows sharing one table
+ * (as in Caffeine). Key frequency is the minimum of its 4 counters, so collisions could only overestimate it.
+ *
+ * Counters are aged: once number of increments reaches 10 times the table width all of them are halved, so
+ * sketch forgets old popularity and follows the workload.
+ */
+class FrequencySketch {
+   public:
+    FrequencySketch() : _mask(0), _sample(0), _additions(0) { EnsureCapacity(kMinWidth); }
+
+    /**
+     * Grows table to track about the given number of keys
+     */
+    void EnsureCapacity(size_t keys) {
+        size_t width = kMinWidth;
+        while (width < keys) {
+            width <<= 1;
+        }
+        if (width <= _table.size()) {
+            return;
+        }
+
+        // Each word is copied to every position its keys could be mapped to now, so all estimates survive
+        std::vector<uint64_t> table(width, 0);
+        for (size_t i = 0; i < width && !_table.empty(); i++) {
+            table[i] = _table[i & _mask];
+        }
+        _table.swap(table);
+        _mask = width - 1;
+        _sample = 10 * width;
+    }
+
+    /**
+     * Estimated number of accesses to the key, up to 15
+     */
+    uint32_t Frequency(uint64_t hash) const {
+        uint32_t frequency = kMaxCounter;
+        size_t start = (hash & 3) << 2;
+        for (size_t row = 0; row < kRows; row++) {
+            uint32_t counter = (_table[Index(hash, row)] >> ((start + row) << 2)) & kMaxCounter;
+            frequency = counter < frequency ? counter : frequency;
+        }
+        return frequency;
+    }
+
+    /**
+     * Counts one more access to the key
+     */
+    void Increment(uint64_t hash) {
+        bool added = false;
+        size_t start = (hash & 3) << 2;
+        for (size_t row = 0; row < kRows; row++) {
+            uint64_t &word = _table[Index(hash, row)];
+            size_t offset = (start + row) << 2;
+            if (((word >> offset) & kMaxCounter) != kMaxCounter) {
+                word += uint64_t(1) << offset;
+                added = true;
+            }
+        }
+
+        if (added && ++_additions == _sample) {
+            Age();
+        }
+    }
+
+   private:
+    static const size_t kRows = 4;
+    static const size_t kMinWidth = 1024;
+    static const uint32_t kMaxCounter = 15;
+
+    size_t Index(uint64_t hash, size_t row) const {
+        static const uint64_t seeds[kRows] = {0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL, 0x9ae16a3b2f90404fULL,
+                                              0xcbf29ce484222325ULL};
+        uint64_t h = (hash + seeds[row]) * seeds[row];
+        h += h >> 32;
+        return static_cast<size_t>(h) & _mask;
+    }
+
+    // Halves all counters
+    void Age() {
+        for (uint64_t &word : _table) {
+            word = (word >> 1) & 0x7777777777777777ULL;
+        }
+        _additions /= 2;
+    }
+
+    std::vector<uint64_t> _table;
+    size_t _mask;
+
+    // Increments between two agings and increments done since the last one
+    size_t _sample;
+    size_t _additions;
+};
+
+}  // namespace Backend
+}  // namespace Afina
+
+#endif  // AFINA_STORAGE_FREQUENCY_SKETCH_H
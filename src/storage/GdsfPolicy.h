@@ -0,0 +1,105 @@
+#ifndef AFINA_STORAGE_GDSF_POLICY_H
+#define AFINA_STORAGE_GDSF_POLICY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+
+#include "Entry.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # GreedyDual-Size-Frequency
+ * Cherkasova, "Improving WWW Proxies Performance with Greedy-Dual-Size-Frequency Caching Policy". Entry priority
+ * is L + frequency / size, victim is the entry with the lowest one. L is raised to priority of each evicted
+ * entry, so entries which aren't accessed anymore fall behind new ones. Many small popular values are kept
+ * instead of a single large one: policy favours hit ratio over byte hit ratio. Ties go to the oldest entry.
+ *
+ * Unlike list based policies it takes O(log n) per access. See EvictionPolicy.h for the interface.
+ */
+class GdsfPolicy {
+   public:
+    GdsfPolicy(size_t max_size) : _clock(0), _victim(nullptr) {}
+    ~GdsfPolicy() {
+        for (auto &queued : _queue) {
+            delete queued.second;
+        }
+    }
+
+    void Insert(Entry *entry) {
+        _victim = nullptr;
+        _ranks[entry] = Rank{1, Enqueue(entry, 1)};
+    }
+
+    void Touch(Entry *entry) {
+        Rank &rank = _ranks[entry];
+        _queue.erase(rank.position);
+        rank.position = Enqueue(entry, ++rank.frequency);
+    }
+
+    void Resize(Entry *entry, size_t old_size) {
+        Rank &rank = _ranks[entry];
+        _queue.erase(rank.position);
+        rank.position = Enqueue(entry, rank.frequency);
+    }
+
+    void Remove(Entry *entry) {
+        auto it = _ranks.find(entry);
+        if (entry == _victim) {
+            _clock = it->second.position->first;
+        }
+        _victim = nullptr;
+        _queue.erase(it->second.position);
+        _ranks.erase(it);
+    }
+
+    void Miss(uint64_t hash) {}
+
+    Entry *Victim(const Entry *pinned = nullptr) {
+        auto it = _queue.begin();
+        if (it != _queue.end() && it->second == pinned) {
+            ++it;
+        }
+        _victim = it == _queue.end() ? nullptr : it->second;
+        return _victim;
+    }
+
+    void SetMaxSize(size_t max_size) {}
+
+    template <typename F> void ForEach(F visit) {
+        for (auto &queued : _queue) {
+            visit(queued.second);
+        }
+    }
+
+   private:
+    using Queue = std::multimap<double, Entry *>;
+
+    struct Rank {
+        uint32_t frequency;
+        Queue::iterator position;
+    };
+
+    // Empty key with empty value costs as much as a byte, otherwise its priority is infinite and it is never evicted
+    Queue::iterator Enqueue(Entry *entry, uint32_t frequency) {
+        return _queue.emplace(_clock + double(frequency) / std::max<size_t>(entry->Size(), 1), entry);
+    }
+
+    // Priority of the last evicted entry, L
+    double _clock;
+
+    Queue _queue;
+    std::unordered_map<const Entry *, Rank> _ranks;
+
+    // Entry last returned by Victim
+    Entry *_victim;
+};
+
+}  // namespace Backend
+}  // namespace Afina
+
+#endif  // AFINA_STORAGE_GDSF_POLICY_H
@@ -1,178 +1,1035 @@
 #include "MapBasedGlobalLockImpl.h"
 
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Snapshot.h"
+
 namespace Afina {
 namespace Backend {
 
+namespace {
+
+// Checks whenever forked child has exited, waits for it if asked to. Returns false if it is still running
+bool WaitChild(pid_t child, bool wait, bool &ok) {
+    int status;
+    pid_t pid;
+    do {
+        pid = waitpid(child, &status, wait ? 0 : WNOHANG);
+    } while (pid < 0 && errno == EINTR);
+    if (pid == 0) {
+        return false;
+    }
+
+    ok = pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    return true;
+}
+
+} // namespace
+
+template <typename Policy>
+const int32_t MapBasedGlobalLockImpl<Policy>::kMaxRelativeExpire;
+template <typename Policy>
+const size_t MapBasedGlobalLockImpl<Policy>::kTickMs;
+template <typename Policy>
+const size_t MapBasedGlobalLockImpl<Policy>::kExpireBatch;
+template <typename Policy>
+const size_t MapBasedGlobalLockImpl<Policy>::kEvictBatch;
+
 // See MapBasedGlobalLockImpl.h
-bool MapBasedGlobalLockImpl::Put(const std::string &key,
+template <typename Policy>
+MapBasedGlobalLockImpl<Policy>::MapBasedGlobalLockImpl(size_t max_size, size_t low_headroom, size_t high_headroom)
+    : _max_size(max_size), _current_size(0), _low_headroom(low_headroom),
+      _high_headroom(high_headroom > low_headroom ? high_headroom : low_headroom), _evictions(0),
+      _inline_evictions(0), _last_cas(0), _policy(max_size), _now(time(nullptr)), _wheel(_now), _snapshot_pid(0),
+      _snapshots(0), _snapshot_failures(0), _snapshot_us(0), _loaded_items(0), _load_us(0), _rewrite_pid(0),
+      _running(false) {
+    if (_high_headroom > _max_size) {
+        throw std::runtime_error("Headroom exceeds storage size");
+    }
+}
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy> MapBasedGlobalLockImpl<Policy>::~MapBasedGlobalLockImpl() { Stop(); }
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy>
+void MapBasedGlobalLockImpl<Policy>::Start() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_running) {
+        return;
+    }
+    _running = true;
+    _maintainer = std::thread(&MapBasedGlobalLockImpl::RunMaintainer, this);
+}
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy>
+void MapBasedGlobalLockImpl<Policy>::Stop() {
+    // Replication threads take the lock themselves, so they are stopped without holding it
+    std::unique_ptr<ReplicaLink> link;
+    std::unique_ptr<ReplicaFeed> feed;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        link = std::move(_link);
+        feed = std::move(_feed);
+    }
+    link.reset();
+    feed.reset();
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _running = false;
+        _maintainer_cv.notify_all();
+    }
+    if (_maintainer.joinable()) {
+        _maintainer.join();
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    ReapSnapshot(true);
+    ReapRewrite(true);
+}
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy>
+size_t MapBasedGlobalLockImpl<Policy>::Expire(time_t now, size_t limit) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (now > _now) {
+        _now = now;
+    }
+
+    size_t expired = 0;
+    Entry *entry;
+    while (expired < limit && (entry = _wheel.NextExpired(_now)) != nullptr) {
+        RemoveEntry(entry);
+        expired++;
+    }
+    return expired;
+}
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy>
+size_t MapBasedGlobalLockImpl<Policy>::Evict(size_t limit) {
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    size_t evicted = 0;
+    Entry *victim;
+    while (evicted < limit && _current_size + _high_headroom > _max_size && (victim = _policy.Victim()) != nullptr) {
+        RemoveEntry(victim);
+        evicted++;
+    }
+    _evictions += evicted;
+    return evicted;
+}
+
+// Maintainer thread owns the coarse clock: once per loop it advances the clock and frees expired entries in
+// small batches, releasing the lock between them, so writers never wait for a long sweep. Eviction down to the
+// high watermark is done the same way, writers wake maintainer up as soon as low watermark is crossed
+template <typename Policy>
+void MapBasedGlobalLockImpl<Policy>::RunMaintainer() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (_running) {
+        lock.unlock();
+        while (Expire(time(nullptr), kExpireBatch) == kExpireBatch) {
+        }
+        while (Evict(kEvictBatch) == kEvictBatch) {
+        }
+        lock.lock();
+        ReapSnapshot(false);
+        ReapRewrite(false);
+        if (_log != nullptr && _rewrite_pid == 0 && _log->NeedsRewrite()) {
+            StartRewrite();
+        }
+
+        _maintainer_cv.wait_for(lock, std::chrono::milliseconds(kTickMs),
+                                [this] { return !_running || _current_size + _low_headroom > _max_size; });
+    }
+}
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy>
+bool MapBasedGlobalLockImpl<Policy>::Put(const std::string &key,
                                  const std::string &value) {
+    return Put(key, std::string(value));
+}
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy>
+bool MapBasedGlobalLockImpl<Policy>::Put(const std::string &key, std::string &&value, uint32_t flags, int32_t expire) {
+    return Put(key, Hash(key), std::move(value), flags, expire);
+}
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy>
+bool MapBasedGlobalLockImpl<Policy>::Put(const std::string &key, uint64_t hash, std::string &&value, uint32_t flags,
+                                 int32_t expire) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    return PutEntry(key, hash, std::move(value), flags, expire);
+}
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy>
+size_t MapBasedGlobalLockImpl<Policy>::MultiPut(const std::vector<std::string> &keys, std::vector<std::string> &values,
+                                        uint32_t flags, int32_t expire) {
     std::unique_lock<std::mutex> lock(_mutex);
 
+    size_t stored = 0;
+    for (size_t i = 0; i < keys.size(); i++) {
+        stored += PutEntry(keys[i], Hash(keys[i]), std::move(values[i]), flags, expire) ? 1 : 0;
+    }
+    return stored;
+}
+
+template <typename Policy>
+bool MapBasedGlobalLockImpl<Policy>::PutEntry(const std::string &key, uint64_t hash, std::string &&value, uint32_t flags,
+                                      int32_t expire) {
     if (CheckSize(key, value)) {
-        auto iterator = _backend.find(key);
-        // std::cout << typeid(iterator).name() << std::endl;
-        if (iterator != _backend.end()) {
-            _cache.MoveToHead(&iterator->second);
-            return SetHeadValue(key, value);
+        Entry *entry = Find(key, hash);
+        if (entry != nullptr) {
+            _policy.Touch(entry);
+            SetEntryValue(entry, std::move(value));
         } else {
-            // std::cout << _cache << std::endl;
-            return AddEntry(key, value);
+            entry = AddEntry(key, hash, std::move(value));
         }
+        entry->SetFlags(flags);
+        SetDeadline(entry, expire);
+        Log(MutationLog::kPut, entry);
+        return true;
     }
     return false;
 }
 
 // See MapBasedGlobalLockImpl.h
-bool MapBasedGlobalLockImpl::PutIfAbsent(const std::string &key,
+template <typename Policy>
+bool MapBasedGlobalLockImpl<Policy>::PutIfAbsent(const std::string &key,
                                          const std::string &value) {
+    return PutIfAbsent(key, std::string(value));
+}
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy>
+bool MapBasedGlobalLockImpl<Policy>::PutIfAbsent(const std::string &key,
+                                         std::string &&value, uint32_t flags, int32_t expire) {
     std::unique_lock<std::mutex> lock(_mutex);
 
     if (CheckSize(key, value)) {
-        if (_backend.find(key) != _backend.end()) {
+        uint64_t hash = Hash(key);
+        if (Find(key, hash) != nullptr) {
             return false;
         }
 
-        return AddEntry(key, value);
+        Entry *entry = AddEntry(key, hash, std::move(value));
+        entry->SetFlags(flags);
+        SetDeadline(entry, expire);
+        Log(MutationLog::kPut, entry);
+        return true;
     }
     return false;
 }
 // See MapBasedGlobalLockImpl.h
-bool MapBasedGlobalLockImpl::Set(const std::string &key,
+template <typename Policy>
+bool MapBasedGlobalLockImpl<Policy>::Set(const std::string &key,
                                  const std::string &value) {
+    return Set(key, std::string(value));
+}
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy>
+bool MapBasedGlobalLockImpl<Policy>::Set(const std::string &key, std::string &&value, uint32_t flags, int32_t expire) {
     std::unique_lock<std::mutex> lock(_mutex);  // shared?
 
     if (CheckSize(key, value)) {
-        auto iterator = _backend.find(key);
+        Entry *entry = Find(key);
 
-        if (iterator == _backend.end()) {
+        if (entry == nullptr) {
             return false;
         } else {
-            _cache.MoveToHead(&iterator->second);
-            return SetHeadValue(key, value);
+            _policy.Touch(entry);
+            SetEntryValue(entry, std::move(value));
+            entry->SetFlags(flags);
+            SetDeadline(entry, expire);
+            Log(MutationLog::kPut, entry);
+            return true;
         }
     }
     return false;
 }
 
 // See MapBasedGlobalLockImpl.h
-bool MapBasedGlobalLockImpl::Delete(const std::string &key) {
+template <typename Policy>
+bool MapBasedGlobalLockImpl<Policy>::Append(const std::string &key, const std::string &value) {
     std::unique_lock<std::mutex> lock(_mutex);
 
-    auto iterator = _backend.find(key);
+    Entry *entry = Find(key);
+    if (entry == nullptr || entry->Size() + value.size() > _max_size) {
+        return false;
+    }
 
-    if (iterator == _backend.end()) {
-        return true;
+    _policy.Touch(entry);
+    size_t old_size = entry->Size();
+    MakeRoom(value.size(), entry);
+    entry->Append(value);
+    entry->SetCas(++_last_cas);
+    Resized(entry, old_size);
+    Log(MutationLog::kAppend, entry, value);
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy>
+bool MapBasedGlobalLockImpl<Policy>::Prepend(const std::string &key, const std::string &value) {
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    Entry *entry = Find(key);
+    if (entry == nullptr || entry->Size() + value.size() > _max_size) {
+        return false;
+    }
+
+    _policy.Touch(entry);
+    size_t old_size = entry->Size();
+    MakeRoom(value.size(), entry);
+    entry->Prepend(value);
+    entry->SetCas(++_last_cas);
+    Resized(entry, old_size);
+    Log(MutationLog::kPrepend, entry, value);
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy>
+bool MapBasedGlobalLockImpl<Policy>::Increment(const std::string &key, uint64_t delta, uint64_t &value) {
+    return Update(key, delta, true, value);
+}
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy>
+bool MapBasedGlobalLockImpl<Policy>::Decrement(const std::string &key, uint64_t delta, uint64_t &value) {
+    return Update(key, delta, false, value);
+}
+
+template <typename Policy>
+bool MapBasedGlobalLockImpl<Policy>::Update(const std::string &key, uint64_t delta, bool increment, uint64_t &value) {
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    Entry *entry = Find(key);
+    if (entry == nullptr) {
+        return false;
+    }
+
+    uint64_t number;
+    if (!entry->GetNumber(number)) {
+        throw std::runtime_error("cannot increment or decrement non-numeric value");
+    }
+
+    if (increment) {
+        number += delta;
     } else {
-        _cache.Delete(&iterator->second);
-        return true;
+        number = number > delta ? number - delta : 0;
     }
-    return false;
+
+    size_t old_size = entry->Size();
+    size_t new_size = Entry::NumberSize(number);
+    _policy.Touch(entry);
+    if (new_size > entry->GetValueSize()) {
+        MakeRoom(new_size - entry->GetValueSize(), entry);
+    }
+    entry->SetNumber(number);
+    entry->SetCas(++_last_cas);
+    Resized(entry, old_size);
+    Log(MutationLog::kPut, entry);
+
+    value = number;
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy>
+bool MapBasedGlobalLockImpl<Policy>::Touch(const std::string &key, int32_t expire) {
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    Entry *entry = Find(key);
+    if (entry == nullptr) {
+        return false;
+    }
+
+    _policy.Touch(entry);
+    SetDeadline(entry, expire);
+    Log(MutationLog::kTouch, entry);
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy>
+bool MapBasedGlobalLockImpl<Policy>::Delete(const std::string &key) {
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    Entry *entry = Find(key);
+    if (entry == nullptr) {
+        return false;
+    }
+
+    Log(MutationLog::kDelete, entry);
+    RemoveEntry(entry);
+    return true;
 }
 
 // See MapBasedGlobalLockImpl.h
-bool MapBasedGlobalLockImpl::Get(const std::string &key,
+template <typename Policy>
+bool MapBasedGlobalLockImpl<Policy>::Get(const std::string &key,
                                  std::string &value) const {
+    uint32_t flags;
+    uint64_t cas;
+    return Get(key, value, flags, cas);
+}
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy>
+bool MapBasedGlobalLockImpl<Policy>::Get(const std::string &key, std::string &value, uint32_t &flags,
+                                 uint64_t &cas) const {
     std::unique_lock<std::mutex> lock(_mutex);  // shared?
-    auto iterator = _backend.find(key);
-    if (iterator == _backend.end()) {
+    Entry *entry = Find(key);
+    if (entry == nullptr) {
         return false;
     }
 
-    _cache.MoveToHead(&iterator->second);
-    Entry *head = _cache.GetHead();
-    _backend.emplace(key, std::ref(*head));
-    value = _cache.GetHead()->GetValue();
+    _policy.Touch(entry);
+    value = entry->GetValue();
+    flags = entry->GetFlags();
+    cas = entry->GetCas();
 
     return true;
 }
-bool MapBasedGlobalLockImpl::AddEntry(const std::string &key,
-                                      const std::string &value) {
-    Entry *entry = new Entry(key, value);
-    size_t entry_size = entry->Size();
-    while (entry_size + _current_size > _max_size) {
-        DeleteLast();
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy>
+bool MapBasedGlobalLockImpl<Policy>::Get(const std::string &key, std::shared_ptr<const std::string> &value, uint32_t &flags,
+                                 uint64_t &cas) const {
+    return Get(key, Hash(key), value, flags, cas);
+}
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy>
+bool MapBasedGlobalLockImpl<Policy>::Get(const std::string &key, uint64_t hash, std::shared_ptr<const std::string> &value,
+                                 uint32_t &flags, uint64_t &cas) const {
+    std::unique_lock<std::mutex> lock(_mutex);
+    Entry *entry = Find(key, hash);
+    if (entry == nullptr) {
+        return false;
     }
 
-    _cache.AddToHead(entry);
-    Entry *head = _cache.GetHead();
-    _backend.emplace(head->GetKeyReference(), std::ref(*head));
-    _current_size += entry_size;
+    _policy.Touch(entry);
+    value = entry->GetSlice();
+    flags = entry->GetFlags();
+    cas = entry->GetCas();
 
     return true;
 }
-void MapBasedGlobalLockImpl::DeleteLast() {
-    Entry *tail = _cache.GetTail();
-    size_t tail_size = tail->Size();
-    _backend.erase(tail->GetKeyReference());
-    _cache.DeleteTail();
-    _current_size -= tail_size;
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy>
+void MapBasedGlobalLockImpl<Policy>::MultiGet(const std::vector<std::string> &keys, std::vector<Item> &items) const {
+    std::vector<uint64_t> hashes(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        hashes[i] = Hash(keys[i]);
+    }
+    MultiGet(keys, hashes, items);
 }
 
-bool MapBasedGlobalLockImpl::SetHeadValue(const std::string &key,
-                                          const std::string &value) {
-    size_t size_difference =  value.size() - _cache.GetHead()->GetValueSize();
+// See MapBasedGlobalLockImpl.h
+template <typename Policy>
+void MapBasedGlobalLockImpl<Policy>::MultiGet(const std::vector<std::string> &keys, const std::vector<uint64_t> &hashes,
+                                      std::vector<Item> &items) const {
+    items.resize(keys.size());
+    std::vector<Entry *> entries(keys.size());
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    // Group prefetching: all entries are resolved first and each one is prefetched right away, so by the time
+    // entries are read their cache misses have been overlapped instead of paid one after another
+    for (size_t i = 0; i < keys.size(); i++) {
+        entries[i] = Find(keys[i], hashes[i]);
+        if (entries[i] != nullptr) {
+            __builtin_prefetch(entries[i]);
+        }
+    }
+
+    for (size_t i = 0; i < keys.size(); i++) {
+        Entry *entry = entries[i];
+        items[i].found = (entry != nullptr);
+        if (entry == nullptr) {
+            items[i].value.reset();
+            continue;
+        }
+
+        _policy.Touch(entry);
+        items[i].value = entry->GetSlice();
+        items[i].flags = entry->GetFlags();
+        items[i].cas = entry->GetCas();
+    }
+}
 
-    while (size_difference + _current_size > _max_size) {
-        DeleteLast();
+// See MapBasedGlobalLockImpl.h
+template <typename Policy>
+bool MapBasedGlobalLockImpl<Policy>::GetAndTouch(const std::string &key, int32_t expire, std::string &value,
+                                         uint32_t &flags, uint64_t &cas) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    Entry *entry = Find(key);
+    if (entry == nullptr) {
+        return false;
     }
-    _cache.GetHead()->SetValue(value);
-    _current_size += size_difference;
+
+    _policy.Touch(entry);
+    SetDeadline(entry, expire);
+    Log(MutationLog::kTouch, entry);
+    value = entry->GetValue();
+    flags = entry->GetFlags();
+    cas = entry->GetCas();
+
     return true;
 }
 
-CacheList::~CacheList() {
-    Entry *tmp = _head;
-    while (tmp != nullptr) {
-        Entry *previous = tmp;
-        tmp = tmp->GetNext();
-        delete previous;
+// See MapBasedGlobalLockImpl.h
+template <typename Policy>
+bool MapBasedGlobalLockImpl<Policy>::GetAndTouch(const std::string &key, int32_t expire,
+                                         std::shared_ptr<const std::string> &value, uint32_t &flags, uint64_t &cas) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    Entry *entry = Find(key);
+    if (entry == nullptr) {
+        return false;
     }
+
+    _policy.Touch(entry);
+    SetDeadline(entry, expire);
+    Log(MutationLog::kTouch, entry);
+    value = entry->GetSlice();
+    flags = entry->GetFlags();
+    cas = entry->GetCas();
+
+    return true;
 }
 
-Entry *CacheList::GetHead() { return _head; }
+// See MapBasedGlobalLockImpl.h
+template <typename Policy>
+Storage::CasResult MapBasedGlobalLockImpl<Policy>::CompareAndSet(const std::string &key, uint64_t cas,
+                                                         std::string &&value, uint32_t flags, int32_t expire) {
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    Entry *entry = Find(key);
+    if (entry == nullptr) {
+        return CasResult::kNotFound;
+    }
+    if (entry->GetCas() != cas) {
+        return CasResult::kExists;
+    }
+    if (!CheckSize(key, value)) {
+        return CasResult::kNotStored;
+    }
 
-Entry *CacheList::GetTail() { return _tail; }
+    _policy.Touch(entry);
+    SetEntryValue(entry, std::move(value));
+    entry->SetFlags(flags);
+    SetDeadline(entry, expire);
+    Log(MutationLog::kPut, entry);
+    return CasResult::kStored;
+}
 
-void CacheList::AddToHead(Entry *entry) {
-    if (_head != nullptr) {
-        entry->SetNext(_head);
-        _head->SetPrevious(entry);
-        _head = entry;
-    } else {
-        entry->SetNext(_head);
-        _head = entry;
-        _tail = entry;
+// See MapBasedGlobalLockImpl.h
+template <typename Policy> bool MapBasedGlobalLockImpl<Policy>::SetMaxSize(size_t max_size) {
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (max_size < _high_headroom) {
+            return false;
+        }
+        _max_size = max_size;
+        _policy.SetMaxSize(max_size);
+    }
+
+    // Shrink evicts in batches, writers get the lock between them
+    while (Evict(kEvictBatch) == kEvictBatch) {
+    }
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy> bool MapBasedGlobalLockImpl<Policy>::SetCapacity(size_t count) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    return IndexReserve(count);
+}
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy> bool MapBasedGlobalLockImpl<Policy>::Snapshot(const std::string &path) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    ReapSnapshot(false);
+    if (_snapshot_pid != 0) {
+        return false;
+    }
+
+    // Child gets consistent image of the storage as it is under the lock, pages are copied lazily by kernel
+    // only when parent modifies them
+    _snapshot_start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid < 0) {
+        _snapshot_failures++;
+        return false;
+    }
+    if (pid == 0) {
+        _exit(WriteSnapshot(path) ? 0 : 1);
+    }
+    _snapshot_pid = pid;
+    return true;
+}
+
+// Runs in the forked child: the only thread there is this one, so lock isn't needed and couldn't be taken anyway
+template <typename Policy> bool MapBasedGlobalLockImpl<Policy>::WriteSnapshot(const std::string &path) {
+    try {
+        SnapshotWriter writer(path);
+        bool ok = true;
+        _policy.ForEach([&](Entry *entry) {
+            if (ok && !entry->IsExpired(_now)) {
+                ok = writer.Add(entry->GetKeyReference(), entry->GetValue(), entry->GetFlags(),
+                                entry->GetTimer()->expire);
+            }
+        });
+        return ok && writer.Commit();
+    } catch (...) {
+        return false;
     }
 }
 
-void CacheList::Exclude(Entry *entry) {
-    Entry *next = entry->GetNext();
-    Entry *previous = entry->GetPrevious();
+template <typename Policy> void MapBasedGlobalLockImpl<Policy>::ReapSnapshot(bool wait) const {
+    bool ok;
+    if (_snapshot_pid == 0 || !WaitChild(_snapshot_pid, wait, ok)) {
+        return;
+    }
 
-    if (entry != _tail) {
-        next->SetPrevious(previous);
+    _snapshot_pid = 0;
+    _snapshot_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                         _snapshot_start)
+                       .count();
+    if (ok) {
+        _snapshots++;
     } else {
-        _tail = previous;
+        _snapshot_failures++;
+    }
+}
+
+// Blocks are decoded and hashed by all threads in parallel, but get applied one by one in file order, so that
+// eviction order is restored. Each block is applied under a single lock acquisition
+template <typename Policy>
+bool MapBasedGlobalLockImpl<Policy>::LoadSnapshot(const std::string &path, size_t threads) {
+    auto start = std::chrono::steady_clock::now();
+    SnapshotReader reader(path);
+
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> loaded(0);
+    std::mutex order_mutex;
+    std::condition_variable order_cv;
+    size_t applied = 0;
+    std::exception_ptr error;
+
+    auto load = [&]() {
+        std::vector<SnapshotReader::Record> records;
+        std::vector<uint64_t> hashes;
+        for (size_t block; (block = next++) < reader.Blocks();) {
+            records.clear();
+            hashes.clear();
+            try {
+                reader.Read(block, records);
+            } catch (...) {
+                std::unique_lock<std::mutex> lock(order_mutex);
+                error = std::current_exception();
+                order_cv.notify_all();
+                return;
+            }
+            for (auto &record : records) {
+                hashes.push_back(Hash(record.key));
+            }
+
+            {
+                std::unique_lock<std::mutex> lock(order_mutex);
+                order_cv.wait(lock, [&] { return error != nullptr || applied == block; });
+                if (error != nullptr) {
+                    return;
+                }
+            }
+
+            size_t stored = 0;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                for (size_t i = 0; i < records.size(); i++) {
+                    SnapshotReader::Record &record = records[i];
+                    if (record.deadline != 0 && record.deadline <= _now) {
+                        continue;
+                    }
+                    stored += PutEntry(record.key, hashes[i], std::move(record.value), record.flags,
+                                       int32_t(record.deadline))
+                                  ? 1
+                                  : 0;
+                }
+            }
+            loaded += stored;
+
+            std::unique_lock<std::mutex> lock(order_mutex);
+            applied++;
+            order_cv.notify_all();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < threads; i++) {
+        workers.emplace_back(load);
+    }
+    load();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    if (error != nullptr) {
+        std::rethrow_exception(error);
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _loaded_items = loaded;
+    _load_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy>
+bool MapBasedGlobalLockImpl<Policy>::OpenLog(const std::string &path, LogSync sync, size_t interval_ms) {
+    // Replayed changes must not get into the log again, so it is attached only once replay is done
+    std::unique_ptr<MutationLog> log(
+        new MutationLog(path, sync, interval_ms, [this](MutationLog::Record &record) { Apply(record); }));
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _log = std::move(log);
+    return true;
+}
+
+template <typename Policy> void MapBasedGlobalLockImpl<Policy>::Apply(MutationLog::Record &record) {
+    bool expired = record.deadline != 0 && record.deadline <= _now;
+    switch (record.op) {
+    case MutationLog::kPut:
+        if (expired) {
+            Delete(record.key);
+        } else {
+            Put(record.key, std::move(record.value), record.flags, int32_t(record.deadline));
+        }
+        break;
+    case MutationLog::kAppend:
+        Append(record.key, record.value);
+        break;
+    case MutationLog::kPrepend:
+        Prepend(record.key, record.value);
+        break;
+    case MutationLog::kTouch:
+        if (expired) {
+            Delete(record.key);
+        } else {
+            Touch(record.key, int32_t(record.deadline));
+        }
+        break;
+    case MutationLog::kDelete:
+        Delete(record.key);
+        break;
+    }
+}
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy> void MapBasedGlobalLockImpl<Policy>::WhenDurable(std::function<void()> done) const {
+    if (_log == nullptr) {
+        done();
+        return;
+    }
+    _log->WhenDurable(std::move(done));
+}
+
+template <typename Policy>
+void MapBasedGlobalLockImpl<Policy>::Log(MutationLog::Op op, const Entry *entry, const std::string &data) const {
+    if (_log == nullptr && _feed == nullptr) {
+        return;
+    }
+    const std::string &value = op == MutationLog::kPut ? entry->GetValue() : data;
+    if (_log != nullptr) {
+        _log->Add(op, entry->GetKeyReference(), value, entry->GetFlags(), entry->GetTimer()->expire);
+    }
+    if (_feed != nullptr) {
+        _feed->Add(op, entry->GetKeyReference(), value, entry->GetFlags(), entry->GetTimer()->expire);
+    }
+}
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy> bool MapBasedGlobalLockImpl<Policy>::RewriteLog() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    ReapRewrite(false);
+    return _log != nullptr && _rewrite_pid == 0 && StartRewrite();
+}
+
+// Child dumps storage as it is at the moment of fork, log keeps everything coming after that for the new file
+template <typename Policy> bool MapBasedGlobalLockImpl<Policy>::StartRewrite() {
+    std::string path = _log->StartRewrite();
+    pid_t pid = fork();
+    if (pid < 0) {
+        _log->FinishRewrite(false);
+        return false;
     }
-    if (entry != _head) {
-        previous->SetNext(next);
+    if (pid == 0) {
+        _exit(WriteLog(path) ? 0 : 1);
+    }
+    _rewrite_pid = pid;
+    return true;
+}
+
+// Runs in the forked child, see WriteSnapshot
+template <typename Policy> bool MapBasedGlobalLockImpl<Policy>::WriteLog(const std::string &path) {
+    try {
+        MutationLog::Writer writer(path);
+        bool ok = true;
+        _policy.ForEach([&](Entry *entry) {
+            if (ok && !entry->IsExpired(_now)) {
+                ok = writer.Put(entry->GetKeyReference(), entry->GetValue(), entry->GetFlags(),
+                                entry->GetTimer()->expire);
+            }
+        });
+        return writer.Commit() && ok;
+    } catch (...) {
+        return false;
+    }
+}
+
+template <typename Policy> void MapBasedGlobalLockImpl<Policy>::ReapRewrite(bool wait) {
+    bool ok;
+    if (_rewrite_pid == 0 || !WaitChild(_rewrite_pid, wait, ok)) {
+        return;
+    }
+    _rewrite_pid = 0;
+    _log->FinishRewrite(ok);
+}
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy> bool MapBasedGlobalLockImpl<Policy>::ServeReplicas(uint16_t port) {
+    std::unique_ptr<ReplicaFeed> feed(new ReplicaFeed(port, [this](int socket) { return SyncReplica(socket); }));
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _feed = std::move(feed);
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy>
+bool MapBasedGlobalLockImpl<Policy>::ReplicateFrom(const std::string &host, uint16_t port) {
+    std::unique_ptr<ReplicaLink> link(new ReplicaLink(host, port, [this]() { Clear(); },
+                                                      [this](MutationLog::Record &record) { Apply(record); }));
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _link = std::move(link);
+    return true;
+}
+
+// Child sends storage as it is at the moment of fork, feed queues everything coming after that for the replica
+template <typename Policy> bool MapBasedGlobalLockImpl<Policy>::SyncReplica(int socket) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_feed == nullptr) {
+        return false;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        return false;
+    }
+    if (pid == 0) {
+        // Runs in the forked child, see WriteSnapshot
+        bool ok = true;
+        try {
+            MutationLog::Writer writer(socket);
+            _policy.ForEach([&](Entry *entry) {
+                if (ok && !entry->IsExpired(_now)) {
+                    ok = writer.Put(entry->GetKeyReference(), entry->GetValue(), entry->GetFlags(),
+                                    entry->GetTimer()->expire);
+                }
+            });
+            ok = writer.Commit() && ok;
+        } catch (...) {
+            ok = false;
+        }
+        _exit(ok ? 0 : 1);
+    }
+    _feed->Attach(socket, pid);
+    return true;
+}
+
+// Removals are logged, so the log and replicas of this storage get cleared as well
+template <typename Policy> void MapBasedGlobalLockImpl<Policy>::Clear() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    std::vector<Entry *> entries;
+    _policy.ForEach([&entries](Entry *entry) { entries.push_back(entry); });
+    for (Entry *entry : entries) {
+        Log(MutationLog::kDelete, entry);
+        RemoveEntry(entry);
+    }
+}
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy> bool MapBasedGlobalLockImpl<Policy>::Reserve(size_t size, std::string &value) const {
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (size > _max_size) {
+            value.clear();
+            return false;
+        }
+    }
+    return Storage::Reserve(size, value);
+}
+
+// See MapBasedGlobalLockImpl.h
+template <typename Policy>
+void MapBasedGlobalLockImpl<Policy>::GetStats(std::vector<std::pair<std::string, uint64_t>> &stats) const {
+    std::unique_lock<std::mutex> lock(_mutex);
+    ReapSnapshot(false);
+    stats.emplace_back("bytes", _current_size);
+    stats.emplace_back("limit_maxbytes", _max_size);
+    stats.emplace_back("evictions", _evictions);
+    stats.emplace_back("inline_evictions", _inline_evictions);
+    stats.emplace_back("snapshot_in_progress", _snapshot_pid != 0 ? 1 : 0);
+    stats.emplace_back("snapshots", _snapshots);
+    stats.emplace_back("snapshot_failures", _snapshot_failures);
+    stats.emplace_back("last_snapshot_us", _snapshot_us);
+    stats.emplace_back("snapshot_loaded_items", _loaded_items);
+    stats.emplace_back("snapshot_load_us", _load_us);
+    stats.emplace_back("snapshot_load_items_per_sec", _load_us > 0 ? _loaded_items * 1000000 / _load_us : 0);
+    if (_log != nullptr) {
+        _log->GetStats(stats);
+    }
+    if (_feed != nullptr) {
+        _feed->GetStats(stats);
+    }
+    if (_link != nullptr) {
+        _link->GetStats(stats);
+    }
+}
+
+template <typename Policy>
+Entry *MapBasedGlobalLockImpl<Policy>::Find(const std::string &key) const { return Find(key, Hash(key)); }
+
+template <typename Policy>
+Entry *MapBasedGlobalLockImpl<Policy>::Find(const std::string &key, uint64_t hash) const {
+    Entry *entry = IndexFind(key, hash);
+    if (entry == nullptr) {
+        _policy.Miss(hash);
+        return nullptr;
+    }
+
+    // Lazy expiration, item could be already dead even if wheel hasn't got to it yet
+    if (entry->IsExpired(_now)) {
+        RemoveEntry(entry);
+        return nullptr;
+    }
+    return entry;
+}
+
+template <typename Policy>
+void MapBasedGlobalLockImpl<Policy>::SetDeadline(Entry *entry, int32_t expire) const {
+    _wheel.Remove(entry->GetTimer());
+
+    if (expire == 0) {
+        entry->GetTimer()->expire = 0;
+        return;
+    }
+
+    time_t deadline;
+    if (expire < 0) {
+        // Already expired
+        deadline = 1;
+    } else if (expire > kMaxRelativeExpire) {
+        deadline = expire;
     } else {
-        _head = next;
+        deadline = _now + expire;
     }
+    entry->GetTimer()->expire = deadline;
+    _wheel.Insert(entry->GetTimer());
 }
-void CacheList::Delete(Entry *entry) {
-    Exclude(entry);
+
+template <typename Policy>
+Entry *MapBasedGlobalLockImpl<Policy>::AddEntry(const std::string &key, uint64_t hash, std::string &&value) {
+    Entry *entry = new Entry(key, hash, std::move(value));
+    entry->SetCas(++_last_cas);
+    size_t entry_size = entry->Size();
+    MakeRoom(entry_size);
+
+    _policy.Insert(entry);
+    IndexInsert(entry);
+    _current_size += entry_size;
+    CheckHeadroom();
+
+    return entry;
+}
+
+template <typename Policy>
+void MapBasedGlobalLockImpl<Policy>::MakeRoom(size_t size, Entry *pinned) {
+    // Policy passes over pinned entry, so it keeps its place and policy history isn't skewed by fake eviction
+    while (size + _current_size > _max_size) {
+        Entry *victim = _policy.Victim(pinned);
+        if (victim == nullptr) {
+            break;
+        }
+        RemoveEntry(victim);
+        _evictions++;
+        _inline_evictions++;
+    }
+}
+
+template <typename Policy> void MapBasedGlobalLockImpl<Policy>::DeleteLast() {
+    Entry *victim = _policy.Victim();
+    if (victim != nullptr) {
+        RemoveEntry(victim);
+    }
+}
+
+template <typename Policy>
+void MapBasedGlobalLockImpl<Policy>::RemoveEntry(Entry *entry) const {
+    _wheel.Remove(entry->GetTimer());
+    _current_size -= entry->Size();
+    IndexErase(entry);
+    _policy.Remove(entry);
     delete entry;
 }
 
-void CacheList::MoveToHead(Entry *entry) {
-    if (entry != _head) {
-        Exclude(entry);
-        AddToHead(entry);
+template <typename Policy>
+void MapBasedGlobalLockImpl<Policy>::Resized(Entry *entry, size_t old_size) {
+    _current_size = _current_size + entry->Size() - old_size;
+    _policy.Resize(entry, old_size);
+    CheckHeadroom();
+}
+
+template <typename Policy>
+bool MapBasedGlobalLockImpl<Policy>::SetEntryValue(Entry *entry, std::string &&value) {
+    size_t old_size = entry->Size();
+    if (value.size() > entry->GetValueSize()) {
+        MakeRoom(value.size() - entry->GetValueSize(), entry);
+    }
+    entry->SetValue(std::move(value));
+    entry->SetCas(++_last_cas);
+    Resized(entry, old_size);
+    return true;
+}
+
+template <typename Policy> void MapBasedGlobalLockImpl<Policy>::CheckHeadroom() {
+    if (_current_size + _low_headroom > _max_size) {
+        _maintainer_cv.notify_one();
     }
 }
 
-void CacheList::DeleteTail() { Delete(_tail); }
+template class MapBasedGlobalLockImpl<LruPolicy>;
+template class MapBasedGlobalLockImpl<SlruPolicy>;
+template class MapBasedGlobalLockImpl<TwoQueuePolicy>;
+template class MapBasedGlobalLockImpl<ArcPolicy>;
+template class MapBasedGlobalLockImpl<GdsfPolicy>;
+template class MapBasedGlobalLockImpl<TinyLfuPolicy>;
 
 //
 }  // namespace Backend
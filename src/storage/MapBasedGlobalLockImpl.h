@@ -1,147 +1,330 @@
 #ifndef AFINA_STORAGE_MAP_BASED_GLOBAL_LOCK_IMPL_H
 #define AFINA_STORAGE_MAP_BASED_GLOBAL_LOCK_IMPL_H
 
+#include <afina/Hash.h>
 #include <afina/Storage.h>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <sys/types.h>
+#include <thread>
 #include <unordered_map>
+#include <vector>
+
+#include "ArcPolicy.h"
+#include "Entry.h"
+#include "EvictionPolicy.h"
+#include "FlatIndex.h"
+#include "GdsfPolicy.h"
+#include "MutationLog.h"
+#include "Replication.h"
+#include "SlruPolicy.h"
+#include "TimingWheel.h"
+#include "TinyLfuPolicy.h"
+#include "TwoQueuePolicy.h"
 
 namespace Afina {
 namespace Backend {
-using key = std::string;
-using value = std::string;
-
-class Entry {
+/**
+ * # Map based implementation with global lock
+ * Entries with exptime are tracked by timing wheel. Expired entry is never returned: lookups drop it lazily,
+ * and background maintainer thread started by Start() reclaims the rest in small batches.
+ *
+ * Clock is coarse: it is advanced only by Expire(), so storage doesn't call time() on each request.
+ *
+ * Policy chooses entries to be evicted once byte budget is exhausted, see EvictionPolicy.h. Implementation is
+ * instantiated for every policy there is.
+ *
+ * Maintainer also keeps some of the budget free: once free bytes drop below low watermark it evicts entries in
+ * small batches until high watermark is reached, so writers rarely evict inline while holding the lock. Inline
+ * eviction stays as the last resort, e.g. for a value larger than headroom, and is reported by GetStats.
+ *
+ * Snapshot is taken as Redis BGSAVE does: process forks under the lock, child walks its copy-on-write image of
+ * the storage and writes it out (see Snapshot.h), while parent keeps serving. Maintainer collects the child.
+ * Mutation log, once opened, is compacted the same way when it grows too much.
+ */
+template <typename Policy = LruPolicy> class MapBasedGlobalLockImpl : public Afina::Storage {
    public:
-    Entry() : _key(NULL), _value(NULL), _next(nullptr), _previous(nullptr) {}
-    Entry(const std::string &key, const std::string &value,
-          Entry *next = nullptr, Entry *previous = nullptr)
-        : _key(key), _value(value), _next(next), _previous(previous) {}
+    /**
+     * @param max_size byte budget
+     * @param low_headroom maintainer starts eviction once less bytes are free, 0 disables background eviction
+     * @param high_headroom maintainer evicts until that many bytes are free, at least low_headroom
+     */
+    MapBasedGlobalLockImpl(size_t max_size = 1024, size_t low_headroom = 0, size_t high_headroom = 0);
+    ~MapBasedGlobalLockImpl();
 
-    size_t Size() const { return _key.size() + _value.size(); }
+    // Implements Afina::Storage interface
+    void Start() override;
 
-    std::string GetValue() const { return _value; }
-    size_t GetValueSize() const { return _value.size(); }
-    void SetValue(const std::string &value) const { _value = value; }
+    // Implements Afina::Storage interface
+    void Stop() override;
 
-    const std::string &GetKeyReference() const { return _key; }
+    /**
+     * Advances storage clock to now and removes at most limit expired entries
+     * Returns number of removed entries
+     */
+    size_t Expire(time_t now, size_t limit);
 
-    Entry *GetPrevious() const { return _previous; }
-    void SetPrevious(Entry *previous) { _previous = previous; }
+    /**
+     * Evicts at most limit entries chosen by policy while less than high watermark bytes are free
+     * Returns number of evicted entries
+     */
+    size_t Evict(size_t limit);
 
-    Entry *GetNext() const { return _next; }
-    void SetNext(Entry *next) { _next = next; }
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value) override;
 
-    friend std::ostream &operator<<(std::ostream &out, const Entry &entry) {
-        out << "Address: " << &entry;
-        out << " key: " << entry.GetKeyReference();
-        out << " value: " << entry.GetValue();
-        out << " next: " << entry._next;
-        out << " previous: " << entry._previous;
-        return out;
-    }
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, std::string &&value, uint32_t flags = 0, int32_t expire = 0) override;
 
-   private:
-    const std::string _key;
-    mutable std::string _value;
-    Entry *_next;
-    Entry *_previous;
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, uint64_t hash, std::string &&value, uint32_t flags = 0,
+             int32_t expire = 0) override;
 
-    // Entry& will be used instead of iterator
-};
-class CacheList {
-   public:
-    CacheList() : _head(nullptr), _tail(nullptr) {}
-    ~CacheList();
-    void MoveToHead(Entry *entry);
-
-    Entry *GetHead();
-    Entry *GetTail();
-    void AddToHead(Entry *entry);
-    void DeleteTail();
-    void Delete(Entry *entry);
-    void Exclude(Entry *entry);
-    friend std::ostream &operator<<(std::ostream &out,
-                                    const CacheList &cache_list) {
-        Entry *tmp = nullptr;
-        Entry *head = cache_list._head;
-        Entry *tail = cache_list._tail;
-        if (head != nullptr) {
-            out << "HEAD " << *head << std::endl;
-            tmp = head->GetNext();
-        }
-        if (tail != nullptr) {
-            out << "TAIL " << *head << std::endl;
-        }
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value) override;
 
-        while (tmp != nullptr) {
-            out << *tmp << std::endl;
-            tmp = tmp->GetNext();
-        }
-        return out;
-    }
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, std::string &&value, uint32_t flags = 0, int32_t expire = 0) override;
 
-   private:
-    Entry *_head;
-    Entry *_tail;
-};
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value) override;
 
-/**
- * # Map based implementation with global lock
- *
- *
- */
-class MapBasedGlobalLockImpl : public Afina::Storage {
-   public:
-    MapBasedGlobalLockImpl(size_t max_size = 1024)
-        : _max_size(max_size), _current_size(0) {}
-    ~MapBasedGlobalLockImpl() {}
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, std::string &&value, uint32_t flags = 0, int32_t expire = 0) override;
 
     // Implements Afina::Storage interface
-    bool Put(const std::string &key, const std::string &value) override;
+    CasResult CompareAndSet(const std::string &key, uint64_t cas, std::string &&value, uint32_t flags = 0,
+                            int32_t expire = 0) override;
 
     // Implements Afina::Storage interface
-    bool PutIfAbsent(const std::string &key, const std::string &value) override;
+    bool Touch(const std::string &key, int32_t expire) override;
 
     // Implements Afina::Storage interface
-    bool Set(const std::string &key, const std::string &value) override;
+    bool Append(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool Prepend(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool Increment(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    bool Decrement(const std::string &key, uint64_t delta, uint64_t &value) override;
 
     // Implements Afina::Storage interface
     bool Delete(const std::string &key) override;
 
     // Implements Afina::Storage interface
     bool Get(const std::string &key, std::string &value) const override;
-    bool SetHeadValue(const std::string &key, const std::string &value);
-    bool AddEntry(const std::string &key, const std::string &value);
-    void DeleteLast();
-    bool CheckSize(const std::string &key, const std::string &value) {
-        size_t entry_size = key.size() + value.size();
 
-        if (entry_size <= _max_size) {
-            return true;
-        } else {
-            return false;
-        }
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, std::string &value, uint32_t &flags, uint64_t &cas) const override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, std::shared_ptr<const std::string> &value, uint32_t &flags,
+             uint64_t &cas) const override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, uint64_t hash, std::shared_ptr<const std::string> &value, uint32_t &flags,
+             uint64_t &cas) const override;
+
+    // Implements Afina::Storage interface
+    void MultiGet(const std::vector<std::string> &keys, std::vector<Item> &items) const override;
+
+    // Implements Afina::Storage interface
+    void MultiGet(const std::vector<std::string> &keys, const std::vector<uint64_t> &hashes,
+                  std::vector<Item> &items) const override;
+
+    // Implements Afina::Storage interface
+    size_t MultiPut(const std::vector<std::string> &keys, std::vector<std::string> &values, uint32_t flags = 0,
+                    int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool GetAndTouch(const std::string &key, int32_t expire, std::string &value, uint32_t &flags,
+                     uint64_t &cas) override;
+
+    // Implements Afina::Storage interface
+    bool GetAndTouch(const std::string &key, int32_t expire, std::shared_ptr<const std::string> &value,
+                     uint32_t &flags, uint64_t &cas) override;
+
+    // Implements Afina::Storage interface
+    bool SetMaxSize(size_t max_size) override;
+
+    // Implements Afina::Storage interface
+    bool SetCapacity(size_t count) override;
+
+    // Implements Afina::Storage interface
+    bool Snapshot(const std::string &path) override;
+
+    // Implements Afina::Storage interface
+    bool LoadSnapshot(const std::string &path, size_t threads) override;
+
+    // Implements Afina::Storage interface
+    bool OpenLog(const std::string &path, LogSync sync, size_t interval_ms) override;
+
+    // Implements Afina::Storage interface
+    void WhenDurable(std::function<void()> done) const override;
+
+    // Implements Afina::Storage interface
+    bool ServeReplicas(uint16_t port) override;
+
+    // Implements Afina::Storage interface
+    bool ReplicateFrom(const std::string &host, uint16_t port) override;
+
+    /**
+     * Starts background rewrite of the mutation log, maintainer does that on its own once log doubles in size
+     *
+     * @return false if there is no log or it is being rewritten already
+     */
+    bool RewriteLog();
+
+    // Implements Afina::Storage interface
+    void GetStats(std::vector<std::pair<std::string, uint64_t>> &stats) const override;
+
+    // Implements Afina::Storage interface
+    bool Reserve(size_t size, std::string &value) const override;
+
+   protected:
+    // Key index operations. Storage logic only needs exact lookups, so subclasses could keep entries in
+    // another structure, see ArtGlobalLockImpl. Lock must be already held
+    virtual Entry *IndexFind(const std::string &key, uint64_t hash) const { return _backend.Find(key, hash); }
+    virtual void IndexInsert(Entry *entry) const { _backend.Insert(entry); }
+    virtual void IndexErase(Entry *entry) const { _backend.Erase(entry); }
+    virtual bool IndexReserve(size_t count) {
+        _backend.Reserve(count);
+        return true;
     }
 
-   private:
+    // Unlinks entry from index, list and timing wheel, frees it
+    void RemoveEntry(Entry *entry) const;
+
     // using entry = std::pair<const key, value>;
 
+    // Exptime above 30 days is an absolute unix time, as in memcached
+    static const int32_t kMaxRelativeExpire = 60 * 60 * 24 * 30;
+
+    // Maintainer period and number of entries freed per lock acquisition
+    static const size_t kTickMs = 100;
+    static const size_t kExpireBatch = 64;
+    static const size_t kEvictBatch = 64;
+
+    void RunMaintainer();
+
+    // Writes snapshot from the forked child, returns false on failure
+    bool WriteSnapshot(const std::string &path);
+
+    // Collects finished snapshot writer, waits for it if asked to. Lock must be already held
+    void ReapSnapshot(bool wait) const;
+
+    // Appends change of the entry to the mutation log and replication feed if there are ones: whole item for put,
+    // data for append and prepend, deadline for touch. Lock must be already held
+    void Log(MutationLog::Op op, const Entry *entry, const std::string &data = std::string()) const;
+
+    // Replays record of the mutation log
+    void Apply(MutationLog::Record &record);
+
+    // Forks log rewriter, lock must be already held
+    bool StartRewrite();
+
+    // Writes compacted log from the forked child, returns false on failure
+    bool WriteLog(const std::string &path);
+
+    // Collects finished log rewriter, waits for it if asked to. Lock must be already held
+    void ReapRewrite(bool wait);
+
+    // Forks child sending all items to the new replica, called by replication feed
+    bool SyncReplica(int socket);
+
+    // Drops all the items before replica gets full copy from primary
+    void Clear();
+
     size_t _max_size;
-    size_t _current_size;
+    mutable size_t _current_size;
+
+    // Free budget watermarks of background eviction
+    const size_t _low_headroom;
+    const size_t _high_headroom;
+
+    // Evicted entries, all of them and the ones evicted by writers themselves
+    uint64_t _evictions;
+    uint64_t _inline_evictions;
+
+    // Last version stamp given to an entry
+    uint64_t _last_cas;
 
     /*mutable std::unordered_map<std::reference_wrapper<const key>,
                                std::list<Entry>::const_iterator,
        std::hash<key>,
                                std::equal_to<key>>*/
-    mutable std::unordered_map<std::reference_wrapper<const key>, Entry &,
-                               std::hash<key>, std::equal_to<key>>
-        _backend;
+    // Entries are indexed by their own key and stored hash, see FlatIndex
+    mutable FlatIndex<Entry> _backend;
     // mutable std::list<Entry> _cache;
-    mutable CacheList _cache;
+    mutable Policy _policy;
+
+    // Coarse clock, seconds
+    time_t _now;
+    mutable TimingWheel<Entry> _wheel;
 
     mutable std::mutex _mutex;
+
+    // Snapshot writer process, 0 if there is none, and when it has been started
+    mutable pid_t _snapshot_pid;
+    std::chrono::steady_clock::time_point _snapshot_start;
+
+    // Finished snapshots, failed ones and duration of the last one
+    mutable uint64_t _snapshots;
+    mutable uint64_t _snapshot_failures;
+    mutable uint64_t _snapshot_us;
+
+    // Items restored by LoadSnapshot and time it took
+    uint64_t _loaded_items;
+    uint64_t _load_us;
+
+    // Mutation log, if opened, and its rewriter process
+    std::unique_ptr<MutationLog> _log;
+    pid_t _rewrite_pid;
+
+    // Replicas fed by this storage and link to the primary if this one is a replica
+    std::unique_ptr<ReplicaFeed> _feed;
+    std::unique_ptr<ReplicaLink> _link;
+
+    bool _running;
+    std::thread _maintainer;
+    std::condition_variable _maintainer_cv;
+
+   private:
+    // Replaces value of the existing entry
+    bool SetEntryValue(Entry *entry, std::string &&value);
+    Entry *AddEntry(const std::string &key, uint64_t hash, std::string &&value);
+    void DeleteLast();
+    // Evicts entries chosen by policy until size more bytes fit into storage, pinned entry is never evicted
+    void MakeRoom(size_t size, Entry *pinned = nullptr);
+    // Accounts entry size change
+    void Resized(Entry *entry, size_t old_size);
+    // Wakes maintainer up once free budget falls below low watermark
+    void CheckHeadroom();
+    bool Update(const std::string &key, uint64_t delta, bool increment, uint64_t &value);
+    // Put without locking, lock must be already held
+    bool PutEntry(const std::string &key, uint64_t hash, std::string &&value, uint32_t flags, int32_t expire);
+    // Returns live entry for the key or nullptr, expired entry is removed on the way
+    Entry *Find(const std::string &key) const;
+    Entry *Find(const std::string &key, uint64_t hash) const;
+    // Converts memcached exptime to entry deadline and (re)schedules it
+    void SetDeadline(Entry *entry, int32_t expire) const;
+    bool CheckSize(const std::string &key, const std::string &value) {
+        size_t entry_size = key.size() + value.size();
+
+        if (entry_size <= _max_size) {
+            return true;
+        } else {
+            return false;
+        }
+    }
 };
 
 }  // namespace Backend
@@ -0,0 +1,436 @@
+#include "MutationLog.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Afina {
+namespace Backend {
+
+namespace {
+
+struct RecordHeader {
+    uint32_t checksum;
+    uint32_t key_size;
+    uint32_t value_size;
+    uint32_t flags;
+    int64_t deadline;
+    uint8_t op;
+    uint8_t padding[7];
+};
+
+// CRC-32C table, byte at a time. Afina::Hash can't be used here as it isn't stable across builds
+struct CrcTable {
+    uint32_t entries[256];
+
+    CrcTable() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc >> 1) ^ (0x82f63b78 & (0 - (crc & 1)));
+            }
+            entries[i] = crc;
+        }
+    }
+};
+
+uint32_t Crc(uint32_t crc, const char *data, size_t size) {
+    static const CrcTable table;
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table.entries[(crc ^ uint8_t(data[i])) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// Checksum of the record from the header past checksum field till the end of value
+uint32_t Checksum(const RecordHeader &header, const char *key, const char *value) {
+    const char *rest = reinterpret_cast<const char *>(&header) + sizeof(header.checksum);
+    uint32_t crc = Crc(0, rest, sizeof(header) - sizeof(header.checksum));
+    crc = Crc(crc, key, header.key_size);
+    return Crc(crc, value, header.value_size);
+}
+
+// Size of buffers log is read and written by
+const size_t kChunkSize = 1 << 20;
+
+// Syncs directory the file is in, so file created or renamed there survives a crash
+bool SyncDirectory(const std::string &path) {
+    size_t slash = path.rfind('/');
+    std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+} // namespace
+
+const size_t MutationLog::kMinRewriteSize;
+
+// See MutationLog.h
+MutationLog::MutationLog(const std::string &path, Storage::LogSync sync, size_t interval_ms,
+                         const std::function<void(Record &)> &apply)
+    : _path(path), _sync(sync), _interval(interval_ms), _fd(-1), _added(0), _durable(0), _rewriting(false),
+      _rewrite_done(false), _rewrite_ok(false), _size(0), _base_size(0), _syncs(0), _rewrites(0), _errors(0),
+      _running(true) {
+    _fd = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (_fd < 0) {
+        throw std::runtime_error("Can't open log " + path + ": " + strerror(errno));
+    }
+
+    try {
+        Replay(apply);
+    } catch (...) {
+        close(_fd);
+        throw;
+    }
+    _base_size = _size;
+    _writer = std::thread(&MutationLog::Run, this);
+}
+
+// See MutationLog.h
+MutationLog::~MutationLog() {
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _running = false;
+        _cv.notify_all();
+    }
+    _writer.join();
+    close(_fd);
+}
+
+// See MutationLog.h
+void MutationLog::Add(Op op, const std::string &key, const std::string &value, uint32_t flags, int64_t deadline) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    size_t offset = _pending.size();
+    Encode(_pending, op, key, value, flags, deadline);
+    if (_rewriting) {
+        _rewrite_tail.append(_pending, offset, std::string::npos);
+    }
+    _added++;
+    _cv.notify_one();
+}
+
+// See MutationLog.h
+void MutationLog::WhenDurable(std::function<void()> done) {
+    if (_sync == Storage::LogSync::kAlways) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_durable < _added) {
+            _waiters.emplace_back(_added, std::move(done));
+            return;
+        }
+    }
+    done();
+}
+
+// See MutationLog.h
+bool MutationLog::NeedsRewrite() const {
+    std::unique_lock<std::mutex> lock(_mutex);
+    return !_rewriting && _size >= kMinRewriteSize && _size >= 2 * _base_size;
+}
+
+// See MutationLog.h
+std::string MutationLog::StartRewrite() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _rewriting = true;
+    _rewrite_done = false;
+    _rewrite_tail.clear();
+    return _path + ".rewrite";
+}
+
+// See MutationLog.h
+void MutationLog::FinishRewrite(bool ok) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _rewrite_done = true;
+    _rewrite_ok = ok;
+    _cv.notify_one();
+}
+
+// See MutationLog.h
+void MutationLog::GetStats(std::vector<std::pair<std::string, uint64_t>> &stats) const {
+    std::unique_lock<std::mutex> lock(_mutex);
+    stats.emplace_back("log_bytes", _size);
+    stats.emplace_back("log_records", _added);
+    stats.emplace_back("log_syncs", _syncs);
+    stats.emplace_back("log_rewrites", _rewrites);
+    stats.emplace_back("log_rewrite_in_progress", _rewriting ? 1 : 0);
+    stats.emplace_back("log_errors", _errors);
+}
+
+// See MutationLog.h
+void MutationLog::Encode(std::string &out, Op op, const std::string &key, const std::string &value, uint32_t flags,
+                         int64_t deadline) {
+    RecordHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.key_size = key.size();
+    header.value_size = value.size();
+    header.flags = flags;
+    header.deadline = deadline;
+    header.op = op;
+    header.checksum = Checksum(header, key.data(), value.data());
+
+    out.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.append(key);
+    out.append(value);
+}
+
+// See MutationLog.h
+bool MutationLog::Decode(const char *data, size_t size, Record &record, size_t &used) {
+    used = 0;
+    RecordHeader header;
+    if (size < sizeof(header)) {
+        return true;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    size_t record_size = sizeof(header) + size_t(header.key_size) + header.value_size;
+    if (header.op > kDelete || record_size > uint64_t(1) << 32) {
+        return false;
+    }
+    if (size < record_size) {
+        return true;
+    }
+
+    const char *key = data + sizeof(header);
+    if (Checksum(header, key, key + header.key_size) != header.checksum) {
+        return false;
+    }
+
+    record.op = Op(header.op);
+    record.key.assign(key, header.key_size);
+    record.value.assign(key + header.key_size, header.value_size);
+    record.flags = header.flags;
+    record.deadline = header.deadline;
+    used = record_size;
+    return true;
+}
+
+bool MutationLog::Write(int fd, const std::string &data) {
+    const char *position = data.data();
+    size_t size = data.size();
+    while (size > 0) {
+        ssize_t written = write(fd, position, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        position += written;
+        size -= written;
+    }
+    return true;
+}
+
+// Reads file by chunks, record crossing chunk border is carried over to the next one
+void MutationLog::Replay(const std::function<void(Record &)> &apply) {
+    std::string buffer;
+    size_t parsed = 0;
+    uint64_t offset = 0;
+    for (;;) {
+        buffer.erase(0, parsed);
+        parsed = 0;
+        size_t have = buffer.size();
+        buffer.resize(have + kChunkSize);
+        ssize_t got = pread(_fd, &buffer[have], kChunkSize, offset + have);
+        if (got < 0 && errno == EINTR) {
+            buffer.resize(have);
+            continue;
+        }
+        if (got < 0) {
+            throw std::runtime_error("Can't read log " + _path + ": " + strerror(errno));
+        }
+        buffer.resize(have + got);
+
+        for (;;) {
+            Record record;
+            size_t used;
+            if (!Decode(&buffer[parsed], buffer.size() - parsed, record, used)) {
+                got = 0;
+                break;
+            }
+            if (used == 0) {
+                break;
+            }
+            apply(record);
+            parsed += used;
+        }
+        offset += parsed;
+
+        if (got == 0) {
+            break;
+        }
+    }
+
+    // Whatever is past the last good record is garbage of interrupted write
+    struct stat st;
+    if (fstat(_fd, &st) != 0) {
+        throw std::runtime_error("Can't stat log " + _path + ": " + strerror(errno));
+    }
+    if (uint64_t(st.st_size) > offset && ftruncate(_fd, offset) != 0) {
+        throw std::runtime_error("Can't truncate log " + _path + ": " + strerror(errno));
+    }
+    _size = offset;
+}
+
+// Writer thread: everything queued since the last round is written at once, then synced if it is time to
+void MutationLog::Run() {
+    auto last_sync = std::chrono::steady_clock::now();
+    bool dirty = false;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (;;) {
+        if (_running && _pending.empty() && !_rewrite_done) {
+            if (_sync == Storage::LogSync::kInterval && dirty) {
+                _cv.wait_until(lock, last_sync + _interval);
+            } else {
+                _cv.wait(lock);
+            }
+        }
+
+        std::string batch;
+        batch.swap(_pending);
+        uint64_t added = _added;
+        bool stop = !_running;
+
+        bool rewritten = _rewrite_done;
+        bool rewrite_ok = _rewrite_ok;
+        std::string tail;
+        if (rewritten) {
+            tail.swap(_rewrite_tail);
+            _rewriting = false;
+            _rewrite_done = false;
+        }
+        lock.unlock();
+
+        bool ok = Write(_fd, batch);
+        dirty = dirty || !batch.empty();
+
+        auto now = std::chrono::steady_clock::now();
+        bool sync = dirty && (stop || (_sync == Storage::LogSync::kAlways) ||
+                              (_sync == Storage::LogSync::kInterval && now >= last_sync + _interval));
+        if (sync) {
+            ok = fdatasync(_fd) == 0 && ok;
+            last_sync = now;
+            dirty = false;
+        }
+
+        // Batch just written is in the tail as well, so rewritten log has everything
+        bool switched = false;
+        if (rewritten) {
+            if (rewrite_ok) {
+                switched = Switch(tail);
+                ok = switched && ok;
+            } else {
+                unlink((_path + ".rewrite").c_str());
+            }
+        }
+
+        std::vector<std::function<void()>> done;
+        lock.lock();
+        if (switched) {
+            _rewrites++;
+        } else {
+            _size += batch.size();
+        }
+        _syncs += sync ? 1 : 0;
+        _errors += ok ? 0 : 1;
+        _durable = added;
+
+        size_t waiting = 0;
+        for (auto &waiter : _waiters) {
+            if (waiter.first <= added) {
+                done.push_back(std::move(waiter.second));
+            } else {
+                _waiters[waiting++] = std::move(waiter);
+            }
+        }
+        _waiters.resize(waiting);
+
+        if (!done.empty()) {
+            lock.unlock();
+            for (auto &callback : done) {
+                callback();
+            }
+            lock.lock();
+        }
+
+        if (stop && _pending.empty()) {
+            break;
+        }
+    }
+}
+
+bool MutationLog::Switch(const std::string &tail) {
+    std::string rewritten = _path + ".rewrite";
+    int fd = open(rewritten.c_str(), O_RDWR | O_APPEND | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (!Write(fd, tail) || fdatasync(fd) != 0 || fstat(fd, &st) != 0 || rename(rewritten.c_str(), _path.c_str()) != 0) {
+        close(fd);
+        unlink(rewritten.c_str());
+        return false;
+    }
+
+    // Rewritten log has replaced the old one, but the rename itself is on disk only once directory is synced
+    bool synced = SyncDirectory(_path);
+
+    close(_fd);
+    _fd = fd;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _size = st.st_size;
+    _base_size = _size;
+    _errors += synced ? 0 : 1;
+    return true;
+}
+
+// See MutationLog.h
+MutationLog::Writer::Writer(const std::string &path) : _sync(true) {
+    _fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (_fd < 0) {
+        throw std::runtime_error("Can't create log " + path + ": " + strerror(errno));
+    }
+}
+
+// See MutationLog.h
+MutationLog::Writer::Writer(int fd) : _fd(fd), _sync(false) {}
+
+// See MutationLog.h
+MutationLog::Writer::~Writer() {
+    if (_fd >= 0) {
+        close(_fd);
+    }
+}
+
+// See MutationLog.h
+bool MutationLog::Writer::Put(const std::string &key, const std::string &value, uint32_t flags, int64_t deadline) {
+    Encode(_buffer, kPut, key, value, flags, deadline);
+    if (_buffer.size() < kChunkSize) {
+        return true;
+    }
+    bool ok = MutationLog::Write(_fd, _buffer);
+    _buffer.clear();
+    return ok;
+}
+
+// See MutationLog.h
+bool MutationLog::Writer::Commit() {
+    bool ok = MutationLog::Write(_fd, _buffer) && (!_sync || fsync(_fd) == 0);
+    ok = close(_fd) == 0 && ok;
+    _fd = -1;
+    return ok;
+}
+
+} // namespace Backend
+} // namespace Afina
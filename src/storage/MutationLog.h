@@ -0,0 +1,183 @@
+#ifndef AFINA_STORAGE_MUTATION_LOG_H
+#define AFINA_STORAGE_MUTATION_LOG_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <afina/Storage.h>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Append-only mutation log
+ * Every change of the storage is appended to the log as a record
+ *
+ *   uint32 checksum, uint32 key size, uint32 value size, uint32 flags, int64 deadline, uint8 operation,
+ *   7 bytes padding, key bytes, value bytes
+ *
+ * Put keeps the whole item, so increments, cas and friends are logged as puts of their result. Deadline is
+ * absolute unix time, 0 means never. Checksum covers everything after it, so a record torn by crash is detected
+ * and cut off together with the rest of the tail.
+ *
+ * Records are added under the storage lock into memory only. Dedicated writer thread takes everything queued so
+ * far, writes it with a single call and syncs it to disk according to the policy, so one fdatasync is shared by
+ * all the writers which came during the previous one (group commit). Nobody but the writer thread touches disk.
+ *
+ * Log grows forever unless it is rewritten: forked child dumps live items as puts into a new file, records added
+ * meanwhile are kept in memory and appended to it, then new file replaces the log.
+ */
+class MutationLog {
+   public:
+    enum Op : uint8_t { kPut, kAppend, kPrepend, kTouch, kDelete };
+
+    struct Record {
+        Op op;
+        std::string key;
+        std::string value;
+        uint32_t flags;
+        int64_t deadline;
+    };
+
+    /**
+     * Opens the log, creating it if needed, and passes each complete record to apply in order. Torn tail is
+     * truncated. Throws std::runtime_error if file can't be opened
+     */
+    MutationLog(const std::string &path, Storage::LogSync sync, size_t interval_ms,
+                const std::function<void(Record &)> &apply);
+
+    /**
+     * Writes and syncs everything queued so far
+     */
+    ~MutationLog();
+
+    MutationLog(const MutationLog &) = delete;
+    MutationLog &operator=(const MutationLog &) = delete;
+
+    /**
+     * Queues record, never blocks on disk
+     */
+    void Add(Op op, const std::string &key, const std::string &value, uint32_t flags, int64_t deadline);
+
+    /**
+     * Calls done once records added so far are durable as required by the policy: right away unless it is
+     * LogSync::kAlways, otherwise from the writer thread after fdatasync
+     */
+    void WhenDurable(std::function<void()> done);
+
+    /**
+     * Whenever log has grown enough since the last rewrite
+     */
+    bool NeedsRewrite() const;
+
+    /**
+     * Starts keeping records for the rewrite, returns path compacted log must be written into. Must be called
+     * at the point compacted log describes, e.g. under the storage lock right before fork
+     */
+    std::string StartRewrite();
+
+    /**
+     * Replaces the log with the rewritten one if it has been written successfully, drops it otherwise. Actual
+     * work is done by the writer thread
+     */
+    void FinishRewrite(bool ok);
+
+    void GetStats(std::vector<std::pair<std::string, uint64_t>> &stats) const;
+
+    /**
+     * Appends encoded record to out, replication stream is made of the same records
+     */
+    static void Encode(std::string &out, Op op, const std::string &key, const std::string &value, uint32_t flags,
+                       int64_t deadline);
+
+    /**
+     * Decodes record at the start of data. Sets used to the record size, or to 0 if data holds only part of it.
+     * Returns false if record is corrupted
+     */
+    static bool Decode(const char *data, size_t size, Record &record, size_t &used);
+
+    /**
+     * Writes compacted log, used by forked child. File becomes the log only once FinishRewrite is called
+     */
+    class Writer {
+       public:
+        Writer(const std::string &path);
+
+        /**
+         * Writes records into already open descriptor, e.g. socket of a replica. It isn't synced
+         */
+        explicit Writer(int fd);
+        ~Writer();
+
+        Writer(const Writer &) = delete;
+        Writer &operator=(const Writer &) = delete;
+
+        bool Put(const std::string &key, const std::string &value, uint32_t flags, int64_t deadline);
+        bool Commit();
+
+       private:
+        int _fd;
+        bool _sync;
+        std::string _buffer;
+    };
+
+   private:
+    // Log isn't rewritten while it is smaller than that
+    static const size_t kMinRewriteSize = 16 << 20;
+
+    static bool Write(int fd, const std::string &data);
+
+    void Replay(const std::function<void(Record &)> &apply);
+    void Run();
+
+    // Moves rewritten log in place of the current one, records added during rewrite are appended first
+    bool Switch(const std::string &tail);
+
+    const std::string _path;
+    const Storage::LogSync _sync;
+    const std::chrono::milliseconds _interval;
+
+    // Owned by the writer thread once it is started
+    int _fd;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _cv;
+
+    // Records waiting for the writer, how many records were added and how many of them are durable
+    std::string _pending;
+    uint64_t _added;
+    uint64_t _durable;
+
+    // Callbacks of WhenDurable with number of records each of them waits for
+    std::vector<std::pair<uint64_t, std::function<void()>>> _waiters;
+
+    // Rewrite in progress, records added since it has started and whenever it is done
+    bool _rewriting;
+    bool _rewrite_done;
+    bool _rewrite_ok;
+    std::string _rewrite_tail;
+
+    // File size and its size right after the last rewrite
+    uint64_t _size;
+    uint64_t _base_size;
+
+    uint64_t _syncs;
+    uint64_t _rewrites;
+    uint64_t _errors;
+
+    bool _running;
+    std::thread _writer;
+};
+
+}  // namespace Backend
+}  // namespace Afina
+
+#endif  // AFINA_STORAGE_MUTATION_LOG_H
@@ -0,0 +1,351 @@
+#include "Replication.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace Afina {
+namespace Backend {
+
+namespace {
+
+bool Send(int socket, const std::string &data) {
+    const char *position = data.data();
+    size_t size = data.size();
+    while (size > 0) {
+        ssize_t sent = send(socket, position, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        position += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+// Size of buffer replica reads stream by
+const size_t kChunkSize = 64 << 10;
+
+} // namespace
+
+const size_t ReplicaFeed::kMaxPending;
+const size_t ReplicaLink::kRetryMs;
+
+// See Replication.h
+ReplicaFeed::ReplicaFeed(uint16_t port, const std::function<bool(int socket)> &sync)
+    : _sync(sync), _syncs(0), _drops(0), _running(true) {
+    _listen_socket = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+    if (_listen_socket < 0) {
+        throw std::runtime_error(std::string("Can't create replication socket: ") + strerror(errno));
+    }
+
+    int on = 1;
+    struct sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = INADDR_ANY;
+    if (setsockopt(_listen_socket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0 ||
+        bind(_listen_socket, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(_listen_socket, 16) != 0) {
+        std::string error = strerror(errno);
+        close(_listen_socket);
+        throw std::runtime_error("Can't listen for replicas on port " + std::to_string(port) + ": " + error);
+    }
+
+    _acceptor = std::thread(&ReplicaFeed::RunAcceptor, this);
+}
+
+// See Replication.h
+ReplicaFeed::~ReplicaFeed() {
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _running = false;
+    }
+    shutdown(_listen_socket, SHUT_RDWR);
+    _acceptor.join();
+    close(_listen_socket);
+
+    // Shut down socket breaks syncer child as well, so senders don't wait for it long
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (auto &replica : _replicas) {
+        Drop(replica.get());
+    }
+    lock.unlock();
+    for (auto &replica : _replicas) {
+        replica->sender.join();
+    }
+}
+
+// See Replication.h
+void ReplicaFeed::Add(MutationLog::Op op, const std::string &key, const std::string &value, uint32_t flags,
+                      int64_t deadline) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_replicas.empty()) {
+        return;
+    }
+
+    std::string record;
+    MutationLog::Encode(record, op, key, value, flags, deadline);
+    for (auto &replica : _replicas) {
+        if (replica->dropped) {
+            continue;
+        }
+        replica->pending.append(record);
+        if (replica->pending.size() > kMaxPending) {
+            Drop(replica.get());
+        }
+    }
+    _cv.notify_all();
+}
+
+// See Replication.h
+void ReplicaFeed::Attach(int socket, pid_t syncer) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _replicas.emplace_back(new Replica{socket, syncer, std::string(), false, false, std::thread()});
+    Replica *replica = _replicas.back().get();
+    replica->sender = std::thread(&ReplicaFeed::RunSender, this, replica);
+    _syncs++;
+}
+
+// See Replication.h
+void ReplicaFeed::GetStats(std::vector<std::pair<std::string, uint64_t>> &stats) const {
+    std::unique_lock<std::mutex> lock(_mutex);
+    uint64_t replicas = 0;
+    uint64_t pending = 0;
+    for (auto &replica : _replicas) {
+        replicas += replica->dropped ? 0 : 1;
+        pending += replica->pending.size();
+    }
+    stats.emplace_back("replicas", replicas);
+    stats.emplace_back("replica_syncs", _syncs);
+    stats.emplace_back("replica_drops", _drops);
+    stats.emplace_back("replication_pending_bytes", pending);
+}
+
+void ReplicaFeed::RunAcceptor() {
+    for (;;) {
+        int socket = accept4(_listen_socket, nullptr, nullptr, SOCK_CLOEXEC);
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (!_running) {
+            if (socket >= 0) {
+                close(socket);
+            }
+            return;
+        }
+        if (socket < 0) {
+            // Out of descriptors or alike, accept is retried a bit later
+            if (errno != EINTR && errno != ECONNABORTED) {
+                _cv.wait_for(lock, std::chrono::milliseconds(100));
+            }
+            continue;
+        }
+
+        // Replicas gone since the last accept are forgotten
+        size_t alive = 0;
+        for (auto &replica : _replicas) {
+            if (replica->done) {
+                replica->sender.join();
+            } else {
+                _replicas[alive++] = std::move(replica);
+            }
+        }
+        _replicas.resize(alive);
+        lock.unlock();
+
+        if (!_sync(socket)) {
+            close(socket);
+        }
+    }
+}
+
+// Nothing is sent until syncer child has written all the items, changes queued meanwhile go right after them
+void ReplicaFeed::RunSender(Replica *replica) {
+    int status;
+    pid_t pid;
+    do {
+        pid = waitpid(replica->syncer, &status, 0);
+    } while (pid < 0 && errno == EINTR);
+    bool synced = pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (!synced) {
+        Drop(replica);
+    }
+    while (!replica->dropped) {
+        if (replica->pending.empty()) {
+            _cv.wait(lock);
+            continue;
+        }
+
+        std::string batch;
+        batch.swap(replica->pending);
+        lock.unlock();
+        bool sent = Send(replica->socket, batch);
+        lock.lock();
+        if (!sent) {
+            Drop(replica);
+        }
+    }
+
+    close(replica->socket);
+    replica->done = true;
+}
+
+void ReplicaFeed::Drop(Replica *replica) {
+    if (replica->dropped) {
+        return;
+    }
+    replica->dropped = true;
+    std::string().swap(replica->pending);
+    shutdown(replica->socket, SHUT_RDWR);
+    _drops += _running ? 1 : 0;
+    _cv.notify_all();
+}
+
+// See Replication.h
+ReplicaLink::ReplicaLink(const std::string &host, uint16_t port, const std::function<void()> &clear,
+                         const std::function<void(MutationLog::Record &)> &apply)
+    : _host(host), _port(port), _clear(clear), _apply(apply), _socket(-1), _connects(0), _records(0),
+      _running(true) {
+    _thread = std::thread(&ReplicaLink::Run, this);
+}
+
+// See Replication.h
+ReplicaLink::~ReplicaLink() {
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _running = false;
+        if (_socket >= 0) {
+            shutdown(_socket, SHUT_RDWR);
+        }
+        _cv.notify_all();
+    }
+    _thread.join();
+}
+
+// See Replication.h
+void ReplicaLink::GetStats(std::vector<std::pair<std::string, uint64_t>> &stats) const {
+    std::unique_lock<std::mutex> lock(_mutex);
+    stats.emplace_back("replication_connected", _socket >= 0 ? 1 : 0);
+    stats.emplace_back("replication_connects", _connects);
+    stats.emplace_back("replication_records", _records);
+}
+
+void ReplicaLink::Run() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (_running) {
+        lock.unlock();
+        int socket = Connect();
+        lock.lock();
+
+        if (socket >= 0) {
+            if (!_running) {
+                close(socket);
+                break;
+            }
+            _socket = socket;
+            _connects++;
+            lock.unlock();
+
+            Follow(socket);
+
+            lock.lock();
+            _socket = -1;
+            close(socket);
+        }
+
+        if (_running) {
+            _cv.wait_for(lock, std::chrono::milliseconds(kRetryMs));
+        }
+    }
+}
+
+int ReplicaLink::Connect() const {
+    struct addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo *addresses = nullptr;
+    if (getaddrinfo(_host.c_str(), std::to_string(_port).c_str(), &hints, &addresses) != 0) {
+        return -1;
+    }
+
+    // Replica never sends anything, so send timeout only bounds connect
+    struct timeval timeout;
+    timeout.tv_sec = kRetryMs / 1000;
+    timeout.tv_usec = (kRetryMs % 1000) * 1000;
+    int on = 1;
+
+    int result = -1;
+    for (struct addrinfo *address = addresses; address != nullptr && result < 0; address = address->ai_next) {
+        int socket = ::socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+        if (socket < 0) {
+            continue;
+        }
+        setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        setsockopt(socket, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+        if (connect(socket, address->ai_addr, address->ai_addrlen) == 0) {
+            result = socket;
+        } else {
+            close(socket);
+        }
+    }
+    freeaddrinfo(addresses);
+    return result;
+}
+
+// Primary starts with full copy, so whatever was there before is dropped first
+void ReplicaLink::Follow(int socket) {
+    _clear();
+
+    std::string buffer;
+    size_t parsed = 0;
+    for (;;) {
+        buffer.erase(0, parsed);
+        parsed = 0;
+        size_t have = buffer.size();
+        buffer.resize(have + kChunkSize);
+        ssize_t got = recv(socket, &buffer[have], kChunkSize, 0);
+        if (got < 0 && errno == EINTR) {
+            buffer.resize(have);
+            continue;
+        }
+        if (got <= 0) {
+            return;
+        }
+        buffer.resize(have + got);
+
+        uint64_t applied = 0;
+        for (;;) {
+            MutationLog::Record record;
+            size_t used;
+            if (!MutationLog::Decode(&buffer[parsed], buffer.size() - parsed, record, used)) {
+                return;
+            }
+            if (used == 0) {
+                break;
+            }
+            _apply(record);
+            parsed += used;
+            applied++;
+        }
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        _records += applied;
+    }
+}
+
+} // namespace Backend
+} // namespace Afina
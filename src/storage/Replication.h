@@ -0,0 +1,153 @@
+#ifndef AFINA_STORAGE_REPLICATION_H
+#define AFINA_STORAGE_REPLICATION_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "MutationLog.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Primary side of replication
+ * Accepts replicas on a TCP port and streams storage changes to them as mutation log records. Replica first
+ * gets a full copy: storage forks under its lock, child writes all live items to the replica socket as puts,
+ * while changes made meanwhile are queued and follow once the child is done. So replica sees exactly the
+ * storage state at fork and everything after it, in order.
+ *
+ * Each replica has a sender thread which takes everything queued so far and writes it with a single call.
+ * Slow replica is pushed back by TCP, its queue grows meanwhile; once queue exceeds the limit replica is
+ * dropped, it reconnects and starts over with a full copy. Writers of the primary are never blocked by
+ * replicas.
+ */
+class ReplicaFeed {
+   public:
+    /**
+     * Starts listening for replicas. Sync is called from acceptor thread for each one, it must take storage
+     * lock, fork child writing the items and call Attach before releasing the lock. Throws std::runtime_error
+     * if port can't be listened on
+     */
+    ReplicaFeed(uint16_t port, const std::function<bool(int socket)> &sync);
+
+    /**
+     * Disconnects all the replicas
+     */
+    ~ReplicaFeed();
+
+    ReplicaFeed(const ReplicaFeed &) = delete;
+    ReplicaFeed &operator=(const ReplicaFeed &) = delete;
+
+    /**
+     * Queues change for every replica, never blocks on network. Must be called under the storage lock
+     */
+    void Add(MutationLog::Op op, const std::string &key, const std::string &value, uint32_t flags, int64_t deadline);
+
+    /**
+     * Starts feeding replica once syncer child exits, changes added from now on are queued for it. Must be called
+     * under the storage lock right after fork
+     */
+    void Attach(int socket, pid_t syncer);
+
+    void GetStats(std::vector<std::pair<std::string, uint64_t>> &stats) const;
+
+   private:
+    // Replica is dropped once that much is queued for it
+    static const size_t kMaxPending = 64 << 20;
+
+    struct Replica {
+        int socket;
+        pid_t syncer;
+        std::string pending;
+        bool dropped;
+        bool done;
+        std::thread sender;
+    };
+
+    void RunAcceptor();
+    void RunSender(Replica *replica);
+
+    // Disconnects replica, lock must be already held
+    void Drop(Replica *replica);
+
+    const std::function<bool(int)> _sync;
+    int _listen_socket;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _cv;
+    std::vector<std::unique_ptr<Replica>> _replicas;
+
+    uint64_t _syncs;
+    uint64_t _drops;
+
+    bool _running;
+    std::thread _acceptor;
+};
+
+/**
+ * # Replica side of replication
+ * Connects to primary and applies records it streams. Once connection is lost it is restored in background,
+ * storage is cleared then, as primary sends full copy again.
+ */
+class ReplicaLink {
+   public:
+    /**
+     * Starts connecting to the primary, clear and apply are called from the link thread
+     */
+    ReplicaLink(const std::string &host, uint16_t port, const std::function<void()> &clear,
+                const std::function<void(MutationLog::Record &)> &apply);
+
+    /**
+     * Disconnects from the primary
+     */
+    ~ReplicaLink();
+
+    ReplicaLink(const ReplicaLink &) = delete;
+    ReplicaLink &operator=(const ReplicaLink &) = delete;
+
+    void GetStats(std::vector<std::pair<std::string, uint64_t>> &stats) const;
+
+   private:
+    // Pause between connection attempts
+    static const size_t kRetryMs = 1000;
+
+    void Run();
+
+    // Connected socket or -1
+    int Connect() const;
+
+    // Applies records until connection is lost
+    void Follow(int socket);
+
+    const std::string _host;
+    const uint16_t _port;
+    const std::function<void()> _clear;
+    const std::function<void(MutationLog::Record &)> _apply;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _cv;
+
+    // Socket of current connection, -1 if there is none
+    int _socket;
+
+    uint64_t _connects;
+    uint64_t _records;
+
+    bool _running;
+    std::thread _thread;
+};
+
+}  // namespace Backend
+}  // namespace Afina
+
+#endif  // AFINA_STORAGE_REPLICATION_H
@@ -0,0 +1,717 @@
+#include "ShmGlobalLockImpl.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdexcept>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <afina/Hash.h>
+
+namespace Afina {
+namespace Backend {
+
+namespace {
+
+// "AFSHM001"
+const uint64_t kMagic = 0x313030484d534641ULL;
+
+// Heap blocks are 2^kMinClass bytes and up
+const size_t kClasses = 48;
+const size_t kMinClass = 6;
+const size_t kAlign = size_t(1) << kMinClass;
+
+// Index has a bucket per that many bytes of region
+const size_t kBytesPerBucket = 256;
+
+// Key hashed into the header: Afina::Hash isn't stable across builds, so index is rebuilt once it changes
+const char kProbe[] = "afina shared memory";
+
+size_t Align(size_t size) { return (size + kAlign - 1) & ~(kAlign - 1); }
+
+size_t ClassOf(size_t size) {
+    size_t cls = kMinClass;
+    while ((size_t(1) << cls) < size) {
+        cls++;
+    }
+    return cls;
+}
+
+uint64_t HashProbe() { return Hash(kProbe, sizeof(kProbe) - 1); }
+
+void InitMutex(pthread_mutex_t *mutex) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+} // namespace
+
+struct ShmGlobalLockImpl::Header {
+    uint64_t magic;
+    uint64_t header_size;
+    uint64_t region_size;
+    uint64_t hash_probe;
+    pthread_mutex_t mutex;
+
+    // Set while lock is held, region left with it set has been abandoned in the middle of a change
+    uint64_t mutating;
+
+    // Offsets of index buckets and of heap, heap_top is where untouched part of heap begins
+    uint64_t buckets;
+    uint64_t bucket_count;
+    uint64_t heap;
+    uint64_t heap_end;
+    uint64_t heap_top;
+    uint64_t free_lists[kClasses];
+
+    // LRU list, head is the most recently used item
+    uint64_t head;
+    uint64_t tail;
+
+    uint64_t max_size;
+    uint64_t current_size;
+    uint64_t items;
+    uint64_t last_cas;
+    uint64_t evictions;
+};
+
+// Item header, key and value follow it. Free block keeps next free one in bucket_next
+struct ShmGlobalLockImpl::Item {
+    uint64_t bucket_next;
+    uint64_t prev;
+    uint64_t next;
+    uint64_t hash;
+    uint64_t cas;
+    int64_t deadline;
+    uint32_t flags;
+    uint32_t key_size;
+    uint32_t value_size;
+    uint8_t size_class;
+    uint8_t padding[3];
+
+    char *Key() { return reinterpret_cast<char *>(this + 1); }
+    char *Value() { return Key() + key_size; }
+};
+
+// Region lock, region is cleared if previous owner died holding it
+class ShmGlobalLockImpl::Lock {
+   public:
+    Lock(const ShmGlobalLockImpl &storage) : _header(storage._header) {
+        int rc = pthread_mutex_lock(&_header->mutex);
+        if (rc == EOWNERDEAD) {
+            storage.Clear();
+            pthread_mutex_consistent(&_header->mutex);
+        } else if (rc != 0) {
+            throw std::runtime_error(std::string("Can't lock shared storage: ") + strerror(rc));
+        }
+        _header->mutating = 1;
+    }
+    ~Lock() {
+        _header->mutating = 0;
+        pthread_mutex_unlock(&_header->mutex);
+    }
+
+   private:
+    Header *_header;
+};
+
+const int32_t ShmGlobalLockImpl::kMaxRelativeExpire;
+
+// See ShmGlobalLockImpl.h
+ShmGlobalLockImpl::ShmGlobalLockImpl(const std::string &path, size_t max_size, size_t region_size)
+    : _fd(-1), _base(nullptr), _size(0), _header(nullptr), _attached(false) {
+    if (region_size == 0) {
+        // Power-of-two blocks waste up to a half and items have headers of their own
+        region_size = (4 * max_size + (1 << 20) + 4095) & ~size_t(4095);
+    }
+
+    _fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (_fd < 0) {
+        throw std::runtime_error("Can't open shared storage " + path + ": " + strerror(errno));
+    }
+
+    try {
+        // Process alone with the region may format it and reset its lock, others wait until that is done
+        bool alone = flock(_fd, LOCK_EX | LOCK_NB) == 0;
+        if (!alone && flock(_fd, LOCK_SH) != 0) {
+            throw std::runtime_error("Can't lock shared storage " + path + ": " + strerror(errno));
+        }
+
+        struct stat st;
+        if (fstat(_fd, &st) != 0) {
+            throw std::runtime_error("Can't stat shared storage " + path + ": " + strerror(errno));
+        }
+        size_t file_size = st.st_size;
+        if (alone && file_size != region_size) {
+            // Items aren't dropped silently because of another budget
+            Header header;
+            if (file_size >= sizeof(Header) && pread(_fd, &header, sizeof(Header), 0) == sizeof(Header) &&
+                header.magic == kMagic && header.header_size == sizeof(Header) && header.mutating == 0 &&
+                header.items > 0) {
+                throw std::runtime_error("Shared storage " + path + " holds items in a region of " +
+                                         std::to_string(file_size) + " bytes, " + std::to_string(region_size) +
+                                         " needed; remove it to change the budget");
+            }
+            if (ftruncate(_fd, region_size) != 0) {
+                throw std::runtime_error("Can't resize shared storage " + path + ": " + strerror(errno));
+            }
+            file_size = region_size;
+        }
+        if (file_size < sizeof(Header)) {
+            throw std::runtime_error("Shared storage " + path + " is too small");
+        }
+
+        void *base = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+        if (base == MAP_FAILED) {
+            throw std::runtime_error("Can't map shared storage " + path + ": " + strerror(errno));
+        }
+        _base = static_cast<char *>(base);
+        _size = file_size;
+        _header = At<Header>(0);
+
+        if (!alone) {
+            if (!Valid(file_size)) {
+                throw std::runtime_error("Shared storage " + path + " is used by another process and is broken");
+            }
+            _attached = true;
+            return;
+        }
+
+        // Previous owner died in the middle of a change, nobody else has the region to reset the lock
+        if (Valid(file_size) && _header->mutating == 0) {
+            InitMutex(&_header->mutex);
+            if (_header->hash_probe != HashProbe()) {
+                Rehash();
+            }
+            _attached = _header->items > 0;
+            SetMaxSize(max_size);
+        } else {
+            Format(file_size, max_size);
+        }
+        flock(_fd, LOCK_SH);
+    } catch (...) {
+        if (_base != nullptr) {
+            munmap(_base, _size);
+        }
+        close(_fd);
+        throw;
+    }
+}
+
+// See ShmGlobalLockImpl.h
+ShmGlobalLockImpl::~ShmGlobalLockImpl() {
+    munmap(_base, _size);
+    close(_fd);
+}
+
+// See ShmGlobalLockImpl.h
+bool ShmGlobalLockImpl::Put(const std::string &key, const std::string &value) { return Put(key, std::string(value)); }
+
+// See ShmGlobalLockImpl.h
+bool ShmGlobalLockImpl::Put(const std::string &key, std::string &&value, uint32_t flags, int32_t expire) {
+    return Put(key, Hash(key), std::move(value), flags, expire);
+}
+
+// See ShmGlobalLockImpl.h
+bool ShmGlobalLockImpl::Put(const std::string &key, uint64_t hash, std::string &&value, uint32_t flags,
+                            int32_t expire) {
+    Lock lock(*this);
+    return Store(key, hash, value.data(), value.size(), flags, Deadline(expire, time(nullptr)));
+}
+
+// See ShmGlobalLockImpl.h
+bool ShmGlobalLockImpl::PutIfAbsent(const std::string &key, const std::string &value) {
+    return PutIfAbsent(key, std::string(value));
+}
+
+// See ShmGlobalLockImpl.h
+bool ShmGlobalLockImpl::PutIfAbsent(const std::string &key, std::string &&value, uint32_t flags, int32_t expire) {
+    uint64_t hash = Hash(key);
+    Lock lock(*this);
+    if (Find(key, hash) != 0) {
+        return false;
+    }
+    return Store(key, hash, value.data(), value.size(), flags, Deadline(expire, time(nullptr)));
+}
+
+// See ShmGlobalLockImpl.h
+bool ShmGlobalLockImpl::Set(const std::string &key, const std::string &value) { return Set(key, std::string(value)); }
+
+// See ShmGlobalLockImpl.h
+bool ShmGlobalLockImpl::Set(const std::string &key, std::string &&value, uint32_t flags, int32_t expire) {
+    uint64_t hash = Hash(key);
+    Lock lock(*this);
+    if (Find(key, hash) == 0) {
+        return false;
+    }
+    return Store(key, hash, value.data(), value.size(), flags, Deadline(expire, time(nullptr)));
+}
+
+// See ShmGlobalLockImpl.h
+Storage::CasResult ShmGlobalLockImpl::CompareAndSet(const std::string &key, uint64_t cas, std::string &&value,
+                                                    uint32_t flags, int32_t expire) {
+    uint64_t hash = Hash(key);
+    Lock lock(*this);
+    uint64_t item = Find(key, hash);
+    if (item == 0) {
+        return CasResult::kNotFound;
+    }
+    if (At<Item>(item)->cas != cas) {
+        return CasResult::kExists;
+    }
+    if (!Store(key, hash, value.data(), value.size(), flags, Deadline(expire, time(nullptr)))) {
+        return CasResult::kNotStored;
+    }
+    return CasResult::kStored;
+}
+
+// See ShmGlobalLockImpl.h
+bool ShmGlobalLockImpl::Touch(const std::string &key, int32_t expire) {
+    uint64_t hash = Hash(key);
+    Lock lock(*this);
+    uint64_t item = Find(key, hash);
+    if (item == 0) {
+        return false;
+    }
+    At<Item>(item)->deadline = Deadline(expire, time(nullptr));
+    MoveToHead(item);
+    return true;
+}
+
+// See ShmGlobalLockImpl.h
+bool ShmGlobalLockImpl::Append(const std::string &key, const std::string &value) {
+    uint64_t hash = Hash(key);
+    Lock lock(*this);
+    uint64_t item = Find(key, hash);
+    if (item == 0) {
+        return false;
+    }
+
+    // Item is replaced by a bigger one, old one must not be touched after Store
+    Item *old = At<Item>(item);
+    std::string result = Value(item) + value;
+    return Store(key, hash, result.data(), result.size(), old->flags, old->deadline);
+}
+
+// See ShmGlobalLockImpl.h
+bool ShmGlobalLockImpl::Prepend(const std::string &key, const std::string &value) {
+    uint64_t hash = Hash(key);
+    Lock lock(*this);
+    uint64_t item = Find(key, hash);
+    if (item == 0) {
+        return false;
+    }
+
+    Item *old = At<Item>(item);
+    std::string result = value + Value(item);
+    return Store(key, hash, result.data(), result.size(), old->flags, old->deadline);
+}
+
+// See ShmGlobalLockImpl.h
+bool ShmGlobalLockImpl::Increment(const std::string &key, uint64_t delta, uint64_t &value) {
+    return Update(key, delta, true, value);
+}
+
+// See ShmGlobalLockImpl.h
+bool ShmGlobalLockImpl::Decrement(const std::string &key, uint64_t delta, uint64_t &value) {
+    return Update(key, delta, false, value);
+}
+
+bool ShmGlobalLockImpl::Update(const std::string &key, uint64_t delta, bool increment, uint64_t &value) {
+    uint64_t hash = Hash(key);
+    Lock lock(*this);
+    uint64_t item = Find(key, hash);
+    if (item == 0) {
+        return false;
+    }
+
+    // memcached keeps at most 20 digits for 64-bit counters
+    Item *old = At<Item>(item);
+    if (old->value_size == 0 || old->value_size > 20) {
+        throw std::runtime_error("cannot increment or decrement non-numeric value");
+    }
+    uint64_t number = 0;
+    for (size_t i = 0; i < old->value_size; i++) {
+        char c = old->Value()[i];
+        if (c < '0' || c > '9') {
+            throw std::runtime_error("cannot increment or decrement non-numeric value");
+        }
+        number = number * 10 + (c - '0');
+    }
+
+    if (increment) {
+        number += delta;
+    } else {
+        number = number > delta ? number - delta : 0;
+    }
+
+    std::string result = std::to_string(number);
+    if (!Store(key, hash, result.data(), result.size(), old->flags, old->deadline)) {
+        return false;
+    }
+    value = number;
+    return true;
+}
+
+// See ShmGlobalLockImpl.h
+bool ShmGlobalLockImpl::Delete(const std::string &key) {
+    uint64_t hash = Hash(key);
+    Lock lock(*this);
+    uint64_t item = Find(key, hash);
+    if (item == 0) {
+        return false;
+    }
+    Remove(item);
+    return true;
+}
+
+// See ShmGlobalLockImpl.h
+bool ShmGlobalLockImpl::Get(const std::string &key, std::string &value) const {
+    uint32_t flags;
+    uint64_t cas;
+    return Get(key, value, flags, cas);
+}
+
+// See ShmGlobalLockImpl.h
+bool ShmGlobalLockImpl::Get(const std::string &key, std::string &value, uint32_t &flags, uint64_t &cas) const {
+    uint64_t hash = Hash(key);
+    Lock lock(*this);
+    uint64_t item = Find(key, hash);
+    if (item == 0) {
+        return false;
+    }
+
+    MoveToHead(item);
+    value = Value(item);
+    flags = At<Item>(item)->flags;
+    cas = At<Item>(item)->cas;
+    return true;
+}
+
+// See ShmGlobalLockImpl.h
+bool ShmGlobalLockImpl::Get(const std::string &key, std::shared_ptr<const std::string> &value, uint32_t &flags,
+                            uint64_t &cas) const {
+    return Get(key, Hash(key), value, flags, cas);
+}
+
+// See ShmGlobalLockImpl.h
+bool ShmGlobalLockImpl::Get(const std::string &key, uint64_t hash, std::shared_ptr<const std::string> &value,
+                            uint32_t &flags, uint64_t &cas) const {
+    // Region could be remapped by another process, so value is copied out of it
+    Lock lock(*this);
+    uint64_t item = Find(key, hash);
+    if (item == 0) {
+        return false;
+    }
+
+    MoveToHead(item);
+    value = std::make_shared<const std::string>(Value(item));
+    flags = At<Item>(item)->flags;
+    cas = At<Item>(item)->cas;
+    return true;
+}
+
+// See ShmGlobalLockImpl.h
+bool ShmGlobalLockImpl::GetAndTouch(const std::string &key, int32_t expire, std::string &value, uint32_t &flags,
+                                    uint64_t &cas) {
+    uint64_t hash = Hash(key);
+    Lock lock(*this);
+    uint64_t item = Find(key, hash);
+    if (item == 0) {
+        return false;
+    }
+
+    MoveToHead(item);
+    At<Item>(item)->deadline = Deadline(expire, time(nullptr));
+    value = Value(item);
+    flags = At<Item>(item)->flags;
+    cas = At<Item>(item)->cas;
+    return true;
+}
+
+// See ShmGlobalLockImpl.h
+bool ShmGlobalLockImpl::GetAndTouch(const std::string &key, int32_t expire, std::shared_ptr<const std::string> &value,
+                                    uint32_t &flags, uint64_t &cas) {
+    std::string copy;
+    if (!GetAndTouch(key, expire, copy, flags, cas)) {
+        return false;
+    }
+    value = std::make_shared<const std::string>(std::move(copy));
+    return true;
+}
+
+// See ShmGlobalLockImpl.h
+bool ShmGlobalLockImpl::SetMaxSize(size_t max_size) {
+    Lock lock(*this);
+    _header->max_size = max_size;
+    while (_header->current_size > max_size && EvictTail()) {
+    }
+    return true;
+}
+
+// See ShmGlobalLockImpl.h
+bool ShmGlobalLockImpl::Reserve(size_t size, std::string &value) const {
+    {
+        Lock lock(*this);
+        if (size > _header->max_size) {
+            value.clear();
+            return false;
+        }
+    }
+    return Storage::Reserve(size, value);
+}
+
+// See ShmGlobalLockImpl.h
+void ShmGlobalLockImpl::GetStats(std::vector<std::pair<std::string, uint64_t>> &stats) const {
+    Lock lock(*this);
+    stats.emplace_back("bytes", _header->current_size);
+    stats.emplace_back("limit_maxbytes", _header->max_size);
+    stats.emplace_back("evictions", _header->evictions);
+    stats.emplace_back("curr_items", _header->items);
+    stats.emplace_back("shm_region_bytes", _size);
+    stats.emplace_back("shm_heap_used_bytes", _header->heap_top - _header->heap);
+    stats.emplace_back("shm_heap_bytes", _header->heap_end - _header->heap);
+}
+
+void ShmGlobalLockImpl::Format(size_t region_size, size_t max_size) {
+    std::memset(_header, 0, sizeof(Header));
+
+    size_t bucket_count = 64;
+    while (bucket_count * 2 * kBytesPerBucket <= region_size) {
+        bucket_count *= 2;
+    }
+    _header->buckets = Align(sizeof(Header));
+    _header->bucket_count = bucket_count;
+    _header->heap = Align(_header->buckets + bucket_count * sizeof(uint64_t));
+    _header->heap_end = region_size & ~(kAlign - 1);
+    if (_header->heap >= _header->heap_end) {
+        throw std::runtime_error("Shared storage region is too small");
+    }
+
+    _header->header_size = sizeof(Header);
+    _header->region_size = region_size;
+    _header->hash_probe = HashProbe();
+    _header->max_size = max_size;
+    InitMutex(&_header->mutex);
+    Clear();
+
+    // Region is valid only once it is complete
+    _header->magic = kMagic;
+}
+
+bool ShmGlobalLockImpl::Valid(size_t file_size) const {
+    const Header *header = _header;
+    return header->magic == kMagic && header->header_size == sizeof(Header) && header->region_size == file_size &&
+           header->bucket_count > 0 && (header->bucket_count & (header->bucket_count - 1)) == 0 &&
+           header->buckets + header->bucket_count * sizeof(uint64_t) <= header->heap &&
+           header->heap <= header->heap_top && header->heap_top <= header->heap_end && header->heap_end <= file_size;
+}
+
+void ShmGlobalLockImpl::Clear() const {
+    std::memset(At<uint64_t>(_header->buckets), 0, _header->bucket_count * sizeof(uint64_t));
+    std::memset(_header->free_lists, 0, sizeof(_header->free_lists));
+    _header->heap_top = _header->heap;
+    _header->head = 0;
+    _header->tail = 0;
+    _header->current_size = 0;
+    _header->items = 0;
+}
+
+void ShmGlobalLockImpl::Rehash() const {
+    uint64_t *buckets = At<uint64_t>(_header->buckets);
+    std::memset(buckets, 0, _header->bucket_count * sizeof(uint64_t));
+    for (uint64_t offset = _header->head; offset != 0; offset = At<Item>(offset)->next) {
+        Item *item = At<Item>(offset);
+        item->hash = Hash(item->Key(), item->key_size);
+        uint64_t &bucket = buckets[item->hash & (_header->bucket_count - 1)];
+        item->bucket_next = bucket;
+        bucket = offset;
+    }
+    _header->hash_probe = HashProbe();
+}
+
+uint64_t ShmGlobalLockImpl::Find(const std::string &key, uint64_t hash) const {
+    uint64_t offset = At<uint64_t>(_header->buckets)[hash & (_header->bucket_count - 1)];
+    for (; offset != 0; offset = At<Item>(offset)->bucket_next) {
+        Item *item = At<Item>(offset);
+        if (item->hash != hash || item->key_size != key.size() ||
+            std::memcmp(item->Key(), key.data(), key.size()) != 0) {
+            continue;
+        }
+
+        // Lazy expiration, nobody else reclaims expired items
+        if (item->deadline != 0 && item->deadline <= time(nullptr)) {
+            Remove(offset);
+            return 0;
+        }
+        return offset;
+    }
+    return 0;
+}
+
+bool ShmGlobalLockImpl::Store(const std::string &key, uint64_t hash, const char *value, size_t size,
+                              uint32_t flags, int64_t deadline) const {
+    size_t need = key.size() + size;
+    if (need > _header->max_size) {
+        return false;
+    }
+
+    // Old item stays readable until its replacement is allocated, so failed update doesn't lose it
+    uint64_t old = Find(key, hash);
+    size_t freed = old != 0 ? At<Item>(old)->key_size + At<Item>(old)->value_size : 0;
+    while (_header->current_size - freed + need > _header->max_size && EvictTail(old)) {
+    }
+
+    uint64_t offset = Allocate(sizeof(Item) + need, old);
+    if (offset == 0) {
+        return false;
+    }
+    if (old != 0) {
+        Remove(old);
+    }
+
+    Item *item = At<Item>(offset);
+    item->hash = hash;
+    item->cas = ++_header->last_cas;
+    item->deadline = deadline;
+    item->flags = flags;
+    item->key_size = key.size();
+    item->value_size = size;
+    std::memcpy(item->Key(), key.data(), key.size());
+    std::memcpy(item->Value(), value, size);
+
+    uint64_t &bucket = At<uint64_t>(_header->buckets)[hash & (_header->bucket_count - 1)];
+    item->bucket_next = bucket;
+    bucket = offset;
+
+    item->prev = 0;
+    item->next = _header->head;
+    if (_header->head != 0) {
+        At<Item>(_header->head)->prev = offset;
+    }
+    _header->head = offset;
+    if (_header->tail == 0) {
+        _header->tail = offset;
+    }
+
+    _header->current_size += need;
+    _header->items++;
+    return true;
+}
+
+void ShmGlobalLockImpl::Remove(uint64_t offset) const {
+    Item *item = At<Item>(offset);
+
+    uint64_t *link = At<uint64_t>(_header->buckets) + (item->hash & (_header->bucket_count - 1));
+    while (*link != offset) {
+        link = &At<Item>(*link)->bucket_next;
+    }
+    *link = item->bucket_next;
+
+    if (item->prev != 0) {
+        At<Item>(item->prev)->next = item->next;
+    } else {
+        _header->head = item->next;
+    }
+    if (item->next != 0) {
+        At<Item>(item->next)->prev = item->prev;
+    } else {
+        _header->tail = item->prev;
+    }
+
+    _header->current_size -= item->key_size + item->value_size;
+    _header->items--;
+
+    item->bucket_next = _header->free_lists[item->size_class];
+    _header->free_lists[item->size_class] = offset;
+}
+
+void ShmGlobalLockImpl::MoveToHead(uint64_t offset) const {
+    if (_header->head == offset) {
+        return;
+    }
+
+    // Item isn't the head, so it has previous one
+    Item *item = At<Item>(offset);
+    At<Item>(item->prev)->next = item->next;
+    if (item->next != 0) {
+        At<Item>(item->next)->prev = item->prev;
+    } else {
+        _header->tail = item->prev;
+    }
+
+    item->prev = 0;
+    item->next = _header->head;
+    At<Item>(_header->head)->prev = offset;
+    _header->head = offset;
+}
+
+bool ShmGlobalLockImpl::EvictTail(uint64_t pinned) const {
+    uint64_t victim = _header->tail;
+    if (victim != 0 && victim == pinned) {
+        victim = At<Item>(victim)->prev;
+    }
+    if (victim == 0) {
+        return false;
+    }
+    Remove(victim);
+    _header->evictions++;
+    return true;
+}
+
+// Blocks of other sizes freed by eviction don't help, so with sizes changing a lot heap could get flushed
+// almost entirely. Budget normally runs out first though
+uint64_t ShmGlobalLockImpl::Allocate(size_t size, uint64_t pinned) const {
+    size_t cls = ClassOf(size);
+    if (cls >= kClasses || (uint64_t(1) << cls) > _header->heap_end - _header->heap) {
+        return 0;
+    }
+
+    uint64_t block = uint64_t(1) << cls;
+    for (;;) {
+        uint64_t offset = _header->free_lists[cls];
+        if (offset != 0) {
+            _header->free_lists[cls] = At<Item>(offset)->bucket_next;
+            return offset;
+        }
+
+        if (_header->heap_top + block <= _header->heap_end) {
+            offset = _header->heap_top;
+            _header->heap_top += block;
+            At<Item>(offset)->size_class = cls;
+            return offset;
+        }
+
+        if (!EvictTail(pinned)) {
+            return 0;
+        }
+    }
+}
+
+int64_t ShmGlobalLockImpl::Deadline(int32_t expire, time_t now) const {
+    if (expire == 0) {
+        return 0;
+    } else if (expire < 0) {
+        // Already expired
+        return 1;
+    } else if (expire > kMaxRelativeExpire) {
+        return expire;
+    }
+    return now + expire;
+}
+
+std::string ShmGlobalLockImpl::Value(uint64_t item) const {
+    Item *entry = At<Item>(item);
+    return std::string(entry->Value(), entry->value_size);
+}
+
+} // namespace Backend
+} // namespace Afina
@@ -0,0 +1,188 @@
+#ifndef AFINA_STORAGE_SHM_GLOBAL_LOCK_IMPL_H
+#define AFINA_STORAGE_SHM_GLOBAL_LOCK_IMPL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <afina/Storage.h>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Shared memory storage
+ * Whole storage, items and index, lives in a file mapped into memory, /dev/shm keeps it in RAM. Region refers
+ * to its parts by offsets instead of pointers, so it could be mapped at any address: restarted server maps the
+ * same file and serves previous items right away, there is nothing to load.
+ *
+ * Region is
+ *
+ *   header | buckets of the hash index | heap
+ *
+ * Heap is an arena carved into power-of-two blocks, freed blocks are kept in free lists per size. Items are
+ * chained in index buckets and in a single LRU list. Once byte budget is exhausted, or heap has no block of the
+ * needed size, least recently used items are evicted.
+ *
+ * Lock is a robust process-shared mutex in the header, so region could be used by two processes at once, e.g.
+ * during binary upgrade. If a process dies holding the lock, region content can't be trusted and the next one
+ * drops it. Header also tells whether lock was held when the last process left the region, then it is formatted
+ * on the next start. There is no maintainer, expired items are dropped lazily or get evicted.
+ *
+ * Region with items is never resized: server started with another budget refuses to map it.
+ */
+class ShmGlobalLockImpl : public Afina::Storage {
+   public:
+    /**
+     * Maps region file, creating or formatting it if needed. Throws std::runtime_error if that fails or if
+     * existing region of another size still has items
+     *
+     * @param path of the region file
+     * @param max_size budget in bytes for keys and values
+     * @param region_size size of the file, 0 means it is derived from max_size
+     */
+    ShmGlobalLockImpl(const std::string &path, size_t max_size = 1024, size_t region_size = 0);
+    ~ShmGlobalLockImpl();
+
+    ShmGlobalLockImpl(const ShmGlobalLockImpl &) = delete;
+    ShmGlobalLockImpl &operator=(const ShmGlobalLockImpl &) = delete;
+
+    /**
+     * Whenever region already had items when it was mapped
+     */
+    bool Attached() const { return _attached; }
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, std::string &&value, uint32_t flags = 0, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, uint64_t hash, std::string &&value, uint32_t flags = 0,
+             int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, std::string &&value, uint32_t flags = 0, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, std::string &&value, uint32_t flags = 0, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    CasResult CompareAndSet(const std::string &key, uint64_t cas, std::string &&value, uint32_t flags = 0,
+                            int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Touch(const std::string &key, int32_t expire) override;
+
+    // Implements Afina::Storage interface
+    bool Append(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool Prepend(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool Increment(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    bool Decrement(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    bool Delete(const std::string &key) override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, std::string &value) const override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, std::string &value, uint32_t &flags, uint64_t &cas) const override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, std::shared_ptr<const std::string> &value, uint32_t &flags,
+             uint64_t &cas) const override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, uint64_t hash, std::shared_ptr<const std::string> &value, uint32_t &flags,
+             uint64_t &cas) const override;
+
+    // Implements Afina::Storage interface
+    bool GetAndTouch(const std::string &key, int32_t expire, std::string &value, uint32_t &flags,
+                     uint64_t &cas) override;
+
+    // Implements Afina::Storage interface
+    bool GetAndTouch(const std::string &key, int32_t expire, std::shared_ptr<const std::string> &value,
+                     uint32_t &flags, uint64_t &cas) override;
+
+    // Implements Afina::Storage interface
+    bool SetMaxSize(size_t max_size) override;
+
+    // Implements Afina::Storage interface
+    void GetStats(std::vector<std::pair<std::string, uint64_t>> &stats) const override;
+
+    // Implements Afina::Storage interface
+    bool Reserve(size_t size, std::string &value) const override;
+
+   private:
+    struct Header;
+    struct Item;
+    class Lock;
+
+    // Exptime above 30 days is an absolute unix time, as in memcached
+    static const int32_t kMaxRelativeExpire = 60 * 60 * 24 * 30;
+
+    template <typename T> T *At(uint64_t offset) const { return reinterpret_cast<T *>(_base + offset); }
+
+    // Lays out empty region of the given size
+    void Format(size_t region_size, size_t max_size);
+    bool Valid(size_t file_size) const;
+
+    // Drops all the items, lock must be already held or region not shared yet
+    void Clear() const;
+
+    // Relinks all the items into buckets by their new hashes
+    void Rehash() const;
+
+    // Live item for the key or 0, expired one is removed on the way. Lock must be already held
+    uint64_t Find(const std::string &key, uint64_t hash) const;
+
+    // Replaces item for the key if there is one, returns false if it doesn't fit and leaves old item as it is.
+    // Lock must be already held
+    bool Store(const std::string &key, uint64_t hash, const char *value, size_t size, uint32_t flags,
+               int64_t deadline) const;
+
+    // Unlinks item from index and LRU list and frees its block
+    void Remove(uint64_t item) const;
+    void MoveToHead(uint64_t item) const;
+
+    // Evicts least recently used item but the pinned one, returns false if there is no such item
+    bool EvictTail(uint64_t pinned = 0) const;
+
+    // Block of at least size bytes, evicts items but the pinned one if needed. Returns 0 if there is no way to
+    // get one
+    uint64_t Allocate(size_t size, uint64_t pinned = 0) const;
+
+    bool Update(const std::string &key, uint64_t delta, bool increment, uint64_t &value);
+
+    int64_t Deadline(int32_t expire, time_t now) const;
+    std::string Value(uint64_t item) const;
+
+    int _fd;
+    char *_base;
+    size_t _size;
+    Header *_header;
+    bool _attached;
+};
+
+}  // namespace Backend
+}  // namespace Afina
+
+#endif  // AFINA_STORAGE_SHM_GLOBAL_LOCK_IMPL_H
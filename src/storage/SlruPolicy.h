@@ -0,0 +1,92 @@
+#ifndef AFINA_STORAGE_SLRU_POLICY_H
+#define AFINA_STORAGE_SLRU_POLICY_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Entry.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Segmented LRU
+ * New entries land in probation segment, hit there promotes entry into protected segment (80% of bytes).
+ * Protected overflow is demoted back to probation head, victim is the probation tail. Entries accessed only
+ * once never push out the ones accessed twice. See EvictionPolicy.h for the interface.
+ */
+class SlruPolicy {
+   public:
+    SlruPolicy(size_t max_size) : _protected_max(max_size * 4 / 5), _probation_size(0), _protected_size(0) {}
+
+    void Insert(Entry *entry) {
+        entry->SetSegment(kProbation);
+        _probation.AddToHead(entry);
+        _probation_size += entry->Size();
+    }
+
+    void Touch(Entry *entry) {
+        if (entry->GetSegment() == kProtected) {
+            _protected.MoveToHead(entry);
+            return;
+        }
+
+        _probation.Exclude(entry);
+        _probation_size -= entry->Size();
+        entry->SetSegment(kProtected);
+        _protected.AddToHead(entry);
+        _protected_size += entry->Size();
+
+        Entry *demoted;
+        while (_protected_size > _protected_max && (demoted = _protected.GetTail()) != entry) {
+            _protected.Exclude(demoted);
+            _protected_size -= demoted->Size();
+            Insert(demoted);
+        }
+    }
+
+    void Resize(Entry *entry, size_t old_size) {
+        size_t &size = entry->GetSegment() == kProtected ? _protected_size : _probation_size;
+        size = size + entry->Size() - old_size;
+    }
+
+    void Remove(Entry *entry) {
+        if (entry->GetSegment() == kProtected) {
+            _protected.Exclude(entry);
+            _protected_size -= entry->Size();
+        } else {
+            _probation.Exclude(entry);
+            _probation_size -= entry->Size();
+        }
+    }
+
+    void Miss(uint64_t hash) {}
+
+    Entry *Victim(const Entry *pinned = nullptr) {
+        Entry *victim = _probation.GetTail(pinned);
+        return victim != nullptr ? victim : _protected.GetTail(pinned);
+    }
+
+    // Protected overflow is demoted on the next promotion
+    void SetMaxSize(size_t max_size) { _protected_max = max_size * 4 / 5; }
+
+    template <typename F> void ForEach(F visit) {
+        _probation.ForEachFromTail(visit);
+        _protected.ForEachFromTail(visit);
+    }
+
+   private:
+    enum Segment : uint8_t { kProbation, kProtected };
+
+    size_t _protected_max;
+
+    CacheList _probation;
+    CacheList _protected;
+    size_t _probation_size;
+    size_t _protected_size;
+};
+
+}  // namespace Backend
+}  // namespace Afina
+
+#endif  // AFINA_STORAGE_SLRU_POLICY_H
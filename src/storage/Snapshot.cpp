@@ -0,0 +1,189 @@
+#include "Snapshot.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace Afina {
+namespace Backend {
+
+namespace {
+
+const char kMagic[8] = {'A', 'F', 'S', 'N', 'A', 'P', '0', '1'};
+
+struct BlockHeader {
+    uint32_t records;
+    uint32_t bytes;
+};
+
+struct RecordHeader {
+    uint32_t key_size;
+    uint32_t value_size;
+    uint32_t flags;
+    uint32_t padding;
+    int64_t deadline;
+};
+
+} // namespace
+
+const size_t SnapshotWriter::kBlockSize;
+
+// See Snapshot.h
+SnapshotWriter::SnapshotWriter(const std::string &path)
+    : _path(path), _temporary(path + ".tmp"), _fd(-1), _records(0) {
+    _fd = open(_temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (_fd < 0) {
+        throw std::runtime_error("Can't create snapshot " + _temporary + ": " + strerror(errno));
+    }
+    _block.reserve(kBlockSize + sizeof(BlockHeader));
+    _block.resize(sizeof(BlockHeader));
+    if (!Write(kMagic, sizeof(kMagic))) {
+        throw std::runtime_error("Can't write snapshot " + _temporary + ": " + strerror(errno));
+    }
+}
+
+// See Snapshot.h
+SnapshotWriter::~SnapshotWriter() {
+    if (_fd >= 0) {
+        close(_fd);
+        unlink(_temporary.c_str());
+    }
+}
+
+// See Snapshot.h
+bool SnapshotWriter::Add(const std::string &key, const std::string &value, uint32_t flags, int64_t deadline) {
+    RecordHeader header{uint32_t(key.size()), uint32_t(value.size()), flags, 0, deadline};
+    size_t size = sizeof(header) + key.size() + value.size();
+    if (_block.size() + size > kBlockSize + sizeof(BlockHeader) && !Flush()) {
+        return false;
+    }
+
+    // Large value makes a block of its own
+    _block.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    _block.append(key);
+    _block.append(value);
+    _records++;
+    return _block.size() < kBlockSize || Flush();
+}
+
+// See Snapshot.h
+bool SnapshotWriter::Commit() {
+    if ((_records > 0 && !Flush()) || !Flush() || fsync(_fd) != 0) {
+        return false;
+    }
+    close(_fd);
+    _fd = -1;
+    if (rename(_temporary.c_str(), _path.c_str()) != 0) {
+        unlink(_temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Writes out current block, empty one is the end mark
+bool SnapshotWriter::Flush() {
+    BlockHeader header{_records, uint32_t(_block.size() - sizeof(BlockHeader))};
+    std::memcpy(&_block[0], &header, sizeof(header));
+    if (!Write(_block.data(), _block.size())) {
+        return false;
+    }
+    _block.resize(sizeof(BlockHeader));
+    _records = 0;
+    return true;
+}
+
+bool SnapshotWriter::Write(const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(_fd, data, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+// See Snapshot.h
+SnapshotReader::SnapshotReader(const std::string &path) : _path(path) {
+    _fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (_fd < 0) {
+        throw std::runtime_error("Can't open snapshot " + path + ": " + strerror(errno));
+    }
+
+    try {
+        char magic[sizeof(kMagic)];
+        ReadAt(0, magic, sizeof(magic));
+        if (std::memcmp(magic, kMagic, sizeof(kMagic)) != 0) {
+            throw std::runtime_error("Not a snapshot: " + path);
+        }
+
+        // Only headers are read here, payload is skipped
+        uint64_t offset = sizeof(kMagic);
+        for (;;) {
+            BlockHeader header;
+            ReadAt(offset, reinterpret_cast<char *>(&header), sizeof(header));
+            offset += sizeof(header);
+            if (header.records == 0) {
+                break;
+            }
+            _blocks.push_back(Block{offset, header.records, header.bytes});
+            offset += header.bytes;
+        }
+    } catch (...) {
+        close(_fd);
+        throw;
+    }
+}
+
+// See Snapshot.h
+SnapshotReader::~SnapshotReader() { close(_fd); }
+
+// See Snapshot.h
+void SnapshotReader::Read(size_t block, std::vector<Record> &records) const {
+    const Block &info = _blocks.at(block);
+    std::string payload(info.bytes, '\0');
+    ReadAt(info.offset, &payload[0], payload.size());
+
+    size_t position = 0;
+    for (uint32_t i = 0; i < info.records; i++) {
+        RecordHeader header;
+        if (position + sizeof(header) > payload.size()) {
+            throw std::runtime_error("Corrupted snapshot " + _path);
+        }
+        std::memcpy(&header, &payload[position], sizeof(header));
+        position += sizeof(header);
+        if (position + header.key_size + header.value_size > payload.size()) {
+            throw std::runtime_error("Corrupted snapshot " + _path);
+        }
+
+        records.push_back(Record{payload.substr(position, header.key_size),
+                                 payload.substr(position + header.key_size, header.value_size), header.flags,
+                                 header.deadline});
+        position += header.key_size + header.value_size;
+    }
+}
+
+void SnapshotReader::ReadAt(uint64_t offset, char *data, size_t size) const {
+    while (size > 0) {
+        ssize_t got = pread(_fd, data, size, offset);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            throw std::runtime_error("Truncated snapshot " + _path);
+        }
+        data += got;
+        size -= got;
+        offset += got;
+    }
+}
+
+} // namespace Backend
+} // namespace Afina
@@ -0,0 +1,106 @@
+#ifndef AFINA_STORAGE_SNAPSHOT_H
+#define AFINA_STORAGE_SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Snapshot file
+ * Compact binary dump of storage items used for warm restart. File starts with 8 bytes magic and consists of
+ * blocks, each is a header {uint32 records, uint32 bytes} followed by bytes of records. Empty block marks the
+ * end, so truncated file is detected. Record is
+ *
+ *   uint32 key size, uint32 value size, uint32 flags, int64 deadline, key bytes, value bytes
+ *
+ * Deadline is absolute unix time, 0 means never. Items are written from the next eviction victim to the most
+ * valuable one, so loading them in file order restores eviction order. Numbers are in host byte order,
+ * snapshot is for the same machine restart, not for transfer.
+ *
+ * Blocks are independent, so they could be decoded in parallel.
+ */
+class SnapshotWriter {
+   public:
+    /**
+     * Creates the file, throws std::runtime_error on failure. Nothing is visible under path until Commit()
+     */
+    SnapshotWriter(const std::string &path);
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter &) = delete;
+    SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+    /**
+     * Appends record, returns false on write failure
+     */
+    bool Add(const std::string &key, const std::string &value, uint32_t flags, int64_t deadline);
+
+    /**
+     * Writes the end mark, syncs file to disk and moves it under the final path. Returns false on failure,
+     * then previous snapshot stays intact
+     */
+    bool Commit();
+
+   private:
+    // Block payload size writer aims for
+    static const size_t kBlockSize = 1 << 20;
+
+    bool Flush();
+    bool Write(const char *data, size_t size);
+
+    const std::string _path;
+    const std::string _temporary;
+    int _fd;
+
+    // Current block
+    std::string _block;
+    uint32_t _records;
+};
+
+class SnapshotReader {
+   public:
+    struct Record {
+        std::string key;
+        std::string value;
+        uint32_t flags;
+        int64_t deadline;
+    };
+
+    /**
+     * Opens file and indexes its blocks, throws std::runtime_error if file is not a complete snapshot
+     */
+    SnapshotReader(const std::string &path);
+    ~SnapshotReader();
+
+    SnapshotReader(const SnapshotReader &) = delete;
+    SnapshotReader &operator=(const SnapshotReader &) = delete;
+
+    size_t Blocks() const { return _blocks.size(); }
+
+    /**
+     * Decodes block with the given number, records get appended. Could be called from many threads at once
+     */
+    void Read(size_t block, std::vector<Record> &records) const;
+
+   private:
+    struct Block {
+        uint64_t offset;
+        uint32_t records;
+        uint32_t bytes;
+    };
+
+    void ReadAt(uint64_t offset, char *data, size_t size) const;
+
+    const std::string _path;
+    int _fd;
+    std::vector<Block> _blocks;
+};
+
+}  // namespace Backend
+}  // namespace Afina
+
+#endif  // AFINA_STORAGE_SNAPSHOT_H
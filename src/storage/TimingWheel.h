@@ -0,0 +1,152 @@
+#ifndef AFINA_STORAGE_TIMING_WHEEL_H
+#define AFINA_STORAGE_TIMING_WHEEL_H
+
+#include <cstddef>
+#include <ctime>
+#include <vector>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Hierarchical timing wheel
+ * Keeps track of item deadlines with one second resolution. Insert and remove are O(1), advancing the wheel
+ * touches only slots that are due, so expired items could be collected in small portions without scanning
+ * the whole storage.
+ *
+ * Level 0 has 256 one-second slots, each next level has 64 slots each covering the whole previous level.
+ * Once lower level wraps, items from the next slot of upper level get redistributed (cascaded) downwards.
+ * Four levels cover ~2 years, more distant deadlines are parked in the last slot and cascaded again.
+ *
+ * Wheel doesn't own items, each item embeds a Node. Not threadsafe.
+ */
+template <typename T> class TimingWheel {
+public:
+    /**
+     * Intrusive list node to be embedded into the item
+     */
+    struct Node {
+        Node *next;
+        Node *prev;
+        T *owner;
+
+        // Absolute deadline in seconds, 0 means never
+        time_t expire;
+
+        Node(T *owner = nullptr) : next(nullptr), prev(nullptr), owner(owner), expire(0) {}
+
+        bool Linked() const { return next != nullptr; }
+    };
+
+    TimingWheel(time_t now) : _current(now) {
+        for (size_t level = 0; level < kLevels; level++) {
+            _slots[level] = std::vector<Node>(level == 0 ? (1 << kRootBits) : (1 << kLevelBits));
+            for (auto &slot : _slots[level]) {
+                slot.next = &slot;
+                slot.prev = &slot;
+            }
+        }
+    }
+
+    TimingWheel(const TimingWheel &) = delete;
+    TimingWheel &operator=(const TimingWheel &) = delete;
+
+    /**
+     * Schedules node at its expire time. Node must not be linked, deadlines in the past are due at the
+     * next advance
+     */
+    void Insert(Node *node) {
+        time_t expire = node->expire > _current ? node->expire : _current;
+        time_t delta = expire - _current;
+
+        size_t level = 0;
+        while (level + 1 < kLevels && delta >= (time_t(1) << Shift(level + 1))) {
+            level++;
+        }
+        if (level + 1 == kLevels && delta >= (time_t(1) << (Shift(level) + kLevelBits))) {
+            // Too far away, park it in the most distant slot, it will be cascaded again
+            expire = _current + (time_t(1) << (Shift(level) + kLevelBits)) - 1;
+        }
+
+        Node &slot = _slots[level][(expire >> Shift(level)) & (_slots[level].size() - 1)];
+        node->next = &slot;
+        node->prev = slot.prev;
+        slot.prev->next = node;
+        slot.prev = node;
+    }
+
+    /**
+     * Unschedules node if it is linked
+     */
+    void Remove(Node *node) {
+        if (!node->Linked()) {
+            return;
+        }
+        node->prev->next = node->next;
+        node->next->prev = node->prev;
+        node->next = nullptr;
+        node->prev = nullptr;
+    }
+
+    /**
+     * Advances wheel up to the given time and returns one item which deadline has come. Item stays in the
+     * wheel, caller must Remove it before next call. Returns nullptr once there is nothing due up to now
+     */
+    T *NextExpired(time_t now) {
+        while (_current <= now) {
+            Node &slot = _slots[0][_current & ((1 << kRootBits) - 1)];
+            if (slot.next != &slot) {
+                return slot.next->owner;
+            }
+            if (_current == now) {
+                break;
+            }
+
+            _current++;
+            Cascade();
+        }
+        return nullptr;
+    }
+
+    /**
+     * Time wheel has been advanced to
+     */
+    time_t Current() const { return _current; }
+
+private:
+    static const size_t kLevels = 4;
+    static const size_t kRootBits = 8;
+    static const size_t kLevelBits = 6;
+
+    static size_t Shift(size_t level) { return level == 0 ? 0 : kRootBits + (level - 1) * kLevelBits; }
+
+    // Redistributes upper level slots that became current once lower levels wrapped
+    void Cascade() {
+        for (size_t level = 1; level < kLevels; level++) {
+            if ((_current & ((time_t(1) << Shift(level)) - 1)) != 0) {
+                break;
+            }
+
+            Node &slot = _slots[level][(_current >> Shift(level)) & (_slots[level].size() - 1)];
+            Node *node = slot.next;
+            slot.next = &slot;
+            slot.prev = &slot;
+            while (node != &slot) {
+                Node *next = node->next;
+                Insert(node);
+                node = next;
+            }
+        }
+    }
+
+    // Time in seconds wheel has been advanced to, all slots before it are empty
+    time_t _current;
+
+    // Slot list heads, each is a circular list sentinel
+    std::vector<Node> _slots[kLevels];
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_TIMING_WHEEL_H
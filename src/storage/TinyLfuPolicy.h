@@ -0,0 +1,169 @@
+#ifndef AFINA_STORAGE_TINY_LFU_POLICY_H
+#define AFINA_STORAGE_TINY_LFU_POLICY_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Entry.h"
+#include "FrequencySketch.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Window TinyLFU
+ * Admission policy in the style of Caffeine (Einziger et al, "TinyLFU: A Highly Efficient Cache Admission
+ * Policy"). New entries land in a small LRU window (1% of bytes), which absorbs bursts. The rest is the main
+ * region: segmented LRU with probation (20%) and protected (80%) parts, probation hit promotes entry into
+ * protected, protected overflow is demoted back to probation.
+ *
+ * Entry leaving the window is admitted to the main region only if the frequency sketch estimates it more
+ * popular than the main region victim it would replace, otherwise it is evicted itself. One pass scan over
+ * cold keys therefore churns through the window and never flushes the hot set.
+ *
+ * Sketch counts accesses to resident keys as well as misses, and is sized after the number of entries.
+ * See EvictionPolicy.h for the interface.
+ */
+class TinyLfuPolicy {
+   public:
+    TinyLfuPolicy(size_t max_size) : _window_size(0), _probation_size(0), _protected_size(0), _count(0) {
+        SetMaxSize(max_size);
+    }
+
+    void Insert(Entry *entry) {
+        // Access is already counted by the lookup miss that preceded insertion
+        _sketch.EnsureCapacity(++_count);
+
+        entry->SetSegment(kWindow);
+        _window.AddToHead(entry);
+        _window_size += entry->Size();
+        Drain();
+    }
+
+    void Touch(Entry *entry) {
+        _sketch.Increment(entry->GetHash());
+
+        switch (entry->GetSegment()) {
+        case kWindow:
+            _window.MoveToHead(entry);
+            break;
+        case kProbation:
+            _probation.Exclude(entry);
+            _probation_size -= entry->Size();
+            entry->SetSegment(kProtected);
+            _protected.AddToHead(entry);
+            _protected_size += entry->Size();
+            Demote();
+            break;
+        case kProtected:
+            _protected.MoveToHead(entry);
+            break;
+        }
+    }
+
+    void Resize(Entry *entry, size_t old_size) {
+        size_t &size = SegmentSize(entry->GetSegment());
+        size = size + entry->Size() - old_size;
+    }
+
+    void Remove(Entry *entry) {
+        List(entry->GetSegment()).Exclude(entry);
+        SegmentSize(entry->GetSegment()) -= entry->Size();
+        _count--;
+    }
+
+    void Miss(uint64_t hash) { _sketch.Increment(hash); }
+
+    Entry *Victim(const Entry *pinned = nullptr) {
+        Entry *victim = _probation.GetTail(pinned);
+        if (victim == nullptr) {
+            victim = _protected.GetTail(pinned);
+        }
+        Entry *candidate = _window.GetTail(pinned);
+        if (candidate == nullptr) {
+            return victim;
+        }
+        if (victim == nullptr) {
+            return candidate;
+        }
+
+        // Storage makes room before the new entry comes in, so window LRU entry is the one to be pushed out:
+        // it competes with main region victim and the loser is evicted
+        if (_sketch.Frequency(candidate->GetHash()) > _sketch.Frequency(victim->GetHash())) {
+            MoveToProbation(candidate);
+            return victim;
+        }
+        return candidate;
+    }
+
+    // Regions overflowing after shrink are balanced by the following inserts and promotions
+    void SetMaxSize(size_t max_size) {
+        _window_max = max_size / 100;
+        _main_max = max_size - _window_max;
+        _protected_max = _main_max * 4 / 5;
+    }
+
+    template <typename F> void ForEach(F visit) {
+        _probation.ForEachFromTail(visit);
+        _window.ForEachFromTail(visit);
+        _protected.ForEachFromTail(visit);
+    }
+
+   private:
+    enum Segment : uint8_t { kWindow, kProbation, kProtected };
+
+    CacheList &List(uint8_t segment) {
+        return segment == kWindow ? _window : (segment == kProbation ? _probation : _protected);
+    }
+
+    size_t &SegmentSize(uint8_t segment) {
+        return segment == kWindow ? _window_size : (segment == kProbation ? _probation_size : _protected_size);
+    }
+
+    void MoveToProbation(Entry *entry) {
+        List(entry->GetSegment()).Exclude(entry);
+        SegmentSize(entry->GetSegment()) -= entry->Size();
+        entry->SetSegment(kProbation);
+        _probation.AddToHead(entry);
+        _probation_size += entry->Size();
+    }
+
+    // Window overflow goes to probation without competition while main region isn't full yet
+    void Drain() {
+        Entry *entry;
+        while (_window_size > _window_max && (entry = _window.GetTail()) != nullptr &&
+               _probation_size + _protected_size + entry->Size() <= _main_max) {
+            MoveToProbation(entry);
+        }
+    }
+
+    // Protected overflow goes back to probation
+    void Demote() {
+        Entry *entry;
+        while (_protected_size > _protected_max && (entry = _protected.GetTail()) != nullptr) {
+            MoveToProbation(entry);
+        }
+    }
+
+    // Byte shares of the regions
+    size_t _window_max;
+    size_t _protected_max;
+    size_t _main_max;
+
+    CacheList _window;
+    CacheList _probation;
+    CacheList _protected;
+    size_t _window_size;
+    size_t _probation_size;
+    size_t _protected_size;
+
+    // Number of entries
+    size_t _count;
+
+    FrequencySketch _sketch;
+};
+
+}  // namespace Backend
+}  // namespace Afina
+
+#endif  // AFINA_STORAGE_TINY_LFU_POLICY_H
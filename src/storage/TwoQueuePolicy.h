@@ -0,0 +1,101 @@
+#ifndef AFINA_STORAGE_TWO_QUEUE_POLICY_H
+#define AFINA_STORAGE_TWO_QUEUE_POLICY_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Entry.h"
+#include "EvictionPolicy.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # 2Q
+ * Full version from Johnson and Shasha, "2Q: A Low Overhead High Performance Buffer Management Replacement
+ * Algorithm", with limits in bytes. New entries go to FIFO queue A1in (25% of bytes), hits there don't reorder
+ * it. Keys evicted from A1in are remembered in A1out ghost list (keys of up to 50% of bytes), and one coming
+ * back is considered hot and goes to main LRU queue Am. See EvictionPolicy.h for the interface.
+ */
+class TwoQueuePolicy {
+   public:
+    TwoQueuePolicy(size_t max_size)
+        : _in_max(max_size / 4), _out_max(max_size / 2), _in_size(0), _victim(nullptr) {}
+
+    void Insert(Entry *entry) {
+        _victim = nullptr;
+        if (_out.Take(entry->GetHash())) {
+            entry->SetSegment(kMain);
+            _main.AddToHead(entry);
+        } else {
+            entry->SetSegment(kIn);
+            _in.AddToHead(entry);
+            _in_size += entry->Size();
+        }
+    }
+
+    void Touch(Entry *entry) {
+        if (entry->GetSegment() == kMain) {
+            _main.MoveToHead(entry);
+        }
+    }
+
+    void Resize(Entry *entry, size_t old_size) {
+        if (entry->GetSegment() == kIn) {
+            _in_size = _in_size + entry->Size() - old_size;
+        }
+    }
+
+    void Remove(Entry *entry) {
+        if (entry->GetSegment() == kMain) {
+            _main.Exclude(entry);
+        } else {
+            _in.Exclude(entry);
+            _in_size -= entry->Size();
+            if (entry == _victim) {
+                _out.Add(entry->GetHash(), entry->Size());
+                _out.Trim(_out_max);
+            }
+        }
+        _victim = nullptr;
+    }
+
+    void Miss(uint64_t hash) {}
+
+    Entry *Victim(const Entry *pinned = nullptr) {
+        Entry *in = _in.GetTail(pinned);
+        Entry *main = _main.GetTail(pinned);
+        _victim = in != nullptr && (_in_size > _in_max || main == nullptr) ? in : main;
+        return _victim;
+    }
+
+    void SetMaxSize(size_t max_size) {
+        _in_max = max_size / 4;
+        _out_max = max_size / 2;
+        _out.Trim(_out_max);
+    }
+
+    template <typename F> void ForEach(F visit) {
+        _in.ForEachFromTail(visit);
+        _main.ForEachFromTail(visit);
+    }
+
+   private:
+    enum Segment : uint8_t { kIn, kMain };
+
+    size_t _in_max;
+    size_t _out_max;
+
+    CacheList _in;
+    CacheList _main;
+    GhostList _out;
+    size_t _in_size;
+
+    // Entry last returned by Victim
+    Entry *_victim;
+};
+
+}  // namespace Backend
+}  // namespace Afina
+
+#endif  // AFINA_STORAGE_TWO_QUEUE_POLICY_H
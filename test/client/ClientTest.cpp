@@ -0,0 +1,316 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <afina/client/Client.h>
+#include <client/Codec.h>
+#include <network/nonblocking/ServerImpl.h>
+#include <network/shm/ServerImpl.h>
+#include <storage/MapBasedGlobalLockImpl.h>
+
+using namespace Afina;
+using namespace Afina::Client;
+
+// Afina instance listening on local port
+class LocalServer {
+public:
+    explicit LocalServer(uint16_t port) : port(port) {
+        storage = std::make_shared<Backend::MapBasedGlobalLockImpl<>>(1 << 20);
+        storage->Start();
+        server = std::make_shared<Network::NonBlocking::ServerImpl>(storage);
+        server->Start(port);
+    }
+
+    ~LocalServer() {
+        server->Stop();
+        server->Join();
+        storage->Stop();
+    }
+
+    std::string Name() const { return "127.0.0.1:" + std::to_string(port); }
+
+    uint16_t port;
+    std::shared_ptr<Afina::Storage> storage;
+    std::shared_ptr<Network::Server> server;
+};
+
+static uint16_t BasePort() { return 30000 + getpid() % 10000 * 2; }
+
+TEST(ClientTest, Commands) {
+    LocalServer first(BasePort()), second(BasePort() + 1);
+    Options options;
+    options.servers = {first.Name(), second.Name()};
+    Client::Client client(options);
+
+    Item item;
+    EXPECT_EQ(Status::kNotFound, client.Get("KEY1", item));
+    EXPECT_EQ(Status::kOk, client.Set("KEY1", "val1", 7));
+    EXPECT_EQ(Status::kOk, client.Get("KEY1", item));
+    EXPECT_EQ("val1", item.value);
+    EXPECT_EQ(7, item.flags);
+
+    EXPECT_EQ(Status::kNotStored, client.Add("KEY1", "val"));
+    EXPECT_EQ(Status::kNotStored, client.Replace("KEY2", "val"));
+    EXPECT_EQ(Status::kOk, client.Append("KEY1", "+"));
+    EXPECT_EQ(Status::kOk, client.Prepend("KEY1", "-"));
+
+    EXPECT_EQ(Status::kOk, client.Gets("KEY1", item));
+    EXPECT_EQ("-val1+", item.value);
+    EXPECT_EQ(Status::kOk, client.Cas("KEY1", "new", item.cas));
+    EXPECT_EQ(Status::kExists, client.Cas("KEY1", "newer", item.cas));
+
+    uint64_t counter = 0;
+    EXPECT_EQ(Status::kOk, client.Set("COUNTER", "10"));
+    EXPECT_EQ(Status::kOk, client.Incr("COUNTER", 5, counter));
+    EXPECT_EQ(15, counter);
+    EXPECT_EQ(Status::kOk, client.Decr("COUNTER", 20, counter));
+    EXPECT_EQ(0, counter);
+    EXPECT_EQ(Status::kNotFound, client.Incr("NOCOUNTER", 1, counter));
+
+    EXPECT_EQ(Status::kOk, client.Touch("KEY1", 100));
+    EXPECT_EQ(Status::kOk, client.Delete("KEY1"));
+    EXPECT_EQ(Status::kNotFound, client.Delete("KEY1"));
+}
+
+// Keys land on both servers, multi-get gathers them back
+TEST(ClientTest, MultiGet) {
+    LocalServer first(BasePort()), second(BasePort() + 1);
+    Options options;
+    options.servers = {first.Name(), second.Name()};
+    Client::Client client(options);
+
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < 100; i++) {
+        keys.push_back("KEY" + std::to_string(i));
+        if (i % 2 == 0) {
+            ASSERT_EQ(Status::kOk, client.Set(keys.back(), "val" + std::to_string(i)));
+        }
+    }
+    size_t on_first = 0;
+    std::string value;
+    for (size_t i = 0; i < 100; i += 2) {
+        on_first += first.storage->Get(keys[i], value) ? 1 : 0;
+    }
+    EXPECT_GT(on_first, 0);
+    EXPECT_LT(on_first, 50);
+
+    std::unordered_map<std::string, Item> items;
+    EXPECT_EQ(Status::kOk, client.Get(keys, items));
+    EXPECT_EQ(50, items.size());
+    for (size_t i = 0; i < 100; i += 2) {
+        EXPECT_EQ("val" + std::to_string(i), items["KEY" + std::to_string(i)].value);
+    }
+}
+
+// Commands of many threads share few connections
+TEST(ClientTest, Concurrent) {
+    LocalServer server(BasePort());
+    Options options;
+    options.servers = {server.Name()};
+    options.connections = 1;
+    Client::Client client(options);
+
+    std::vector<std::thread> threads;
+    std::vector<size_t> errors(8);
+    for (size_t thread = 0; thread < errors.size(); thread++) {
+        threads.emplace_back([&client, &errors, thread] {
+            for (size_t i = 0; i < 200; i++) {
+                std::string key = "KEY" + std::to_string(thread) + "_" + std::to_string(i);
+                Item item;
+                if (client.Set(key, key) != Status::kOk || client.Get(key, item) != Status::kOk ||
+                    item.value != key) {
+                    errors[thread]++;
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (size_t count : errors) {
+        EXPECT_EQ(0, count);
+    }
+}
+
+// Near cache serves stale value until it expires, own changes are seen at once
+TEST(ClientTest, NearCache) {
+    LocalServer server(BasePort());
+    Options options;
+    options.servers = {server.Name()};
+    options.near_cache_items = 16;
+    options.near_cache_ttl = std::chrono::milliseconds(200);
+    Client::Client client(options);
+
+    Item item;
+    EXPECT_EQ(Status::kOk, client.Set("KEY1", "val1"));
+    EXPECT_EQ(Status::kOk, client.Get("KEY1", item));
+
+    EXPECT_TRUE(server.storage->Put("KEY1", "other"));
+    EXPECT_EQ(Status::kOk, client.Get("KEY1", item));
+    EXPECT_EQ("val1", item.value);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    EXPECT_EQ(Status::kOk, client.Get("KEY1", item));
+    EXPECT_EQ("other", item.value);
+
+    EXPECT_EQ(Status::kOk, client.Set("KEY1", "val2"));
+    EXPECT_EQ(Status::kOk, client.Get("KEY1", item));
+    EXPECT_EQ("val2", item.value);
+}
+
+TEST(ClientTest, Unavailable) {
+    Options options;
+    options.servers = {"127.0.0.1:1"};
+    options.timeout = std::chrono::milliseconds(500);
+    Client::Client client(options);
+
+    Item item;
+    EXPECT_EQ(Status::kError, client.Get("KEY1", item));
+    EXPECT_EQ(Status::kError, client.Set("KEY1", "val1"));
+}
+
+// Threads talk to the server over shared memory channels of their own
+TEST(ClientTest, Local) {
+    LocalServer server(BasePort());
+    std::string path = "/tmp/afina-test-" + std::to_string(getpid()) + ".sock";
+    Network::Shm::ServerImpl local(server.storage);
+    local.Start(path, 2);
+
+    Options options;
+    options.local = path;
+    Client::Client client(options);
+
+    Item item;
+    EXPECT_EQ(Status::kNotFound, client.Get("KEY1", item));
+    EXPECT_EQ(Status::kOk, client.Set("KEY1", "val1", 7));
+    EXPECT_EQ(Status::kOk, client.Get("KEY1", item));
+    EXPECT_EQ("val1", item.value);
+    EXPECT_EQ(7, item.flags);
+    EXPECT_EQ(Status::kNotStored, client.Add("KEY1", "val"));
+
+    // Value several times bigger than a ring goes both ways in portions
+    std::string big(3 * Network::Shm::Channel::kRingSize / 2, 'x');
+    EXPECT_EQ(Status::kOk, client.Set("BIG", big));
+    EXPECT_EQ(Status::kOk, client.Get("BIG", item));
+    EXPECT_EQ(big, item.value);
+    EXPECT_EQ(Status::kOk, client.Delete("BIG"));
+
+    std::unordered_map<std::string, Item> items;
+    EXPECT_EQ(Status::kOk, client.Get({"KEY1", "KEY2"}, items));
+    EXPECT_EQ(1, items.size());
+
+    std::vector<std::thread> threads;
+    std::vector<size_t> errors(4);
+    for (size_t thread = 0; thread < errors.size(); thread++) {
+        threads.emplace_back([&client, &errors, thread] {
+            for (size_t i = 0; i < 500; i++) {
+                std::string key = "KEY" + std::to_string(thread) + "_" + std::to_string(i);
+                Item item;
+                if (client.Set(key, key) != Status::kOk || client.Get(key, item) != Status::kOk ||
+                    item.value != key) {
+                    errors[thread]++;
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (size_t count : errors) {
+        EXPECT_EQ(0, count);
+    }
+
+    // Once server is gone commands fail instead of hanging
+    local.Stop();
+    local.Join();
+    EXPECT_EQ(Status::kError, client.Get("KEY1", item));
+}
+
+// Pipelined commands which replies didn't fit at once are executed without waiting for more input
+TEST(ClientTest, LocalPipelined) {
+    LocalServer server(BasePort());
+    server.storage->SetMaxSize(64 << 20);
+    std::string path = "/tmp/afina-test-" + std::to_string(getpid()) + ".sock";
+    Network::Shm::ServerImpl local(server.storage);
+    local.Start(path);
+
+    std::string big(2 * Network::Shm::Channel::kRingSize, 'x');
+    std::string request = "set BIG 0 0 " + std::to_string(big.size()) + "\r\n" + big + "\r\n";
+    std::string expected = "STORED\r\n";
+    for (int i = 0; i < 8; i++) {
+        request += "get BIG\r\n";
+        expected += "VALUE BIG 0 " + std::to_string(big.size()) + "\r\n" + big + "\r\nEND\r\n";
+    }
+
+    auto channel = Network::Shm::Channel::Attach(path);
+    std::string reply;
+    char chunk[64 << 10];
+    for (size_t sent = 0; reply.size() < expected.size();) {
+        sent += channel->Send(request.data() + sent, request.size() - sent);
+        size_t got = channel->Receive(chunk, sizeof(chunk));
+        reply.append(chunk, got);
+        if (got == 0) {
+            ASSERT_TRUE(channel->Wait(sent < request.size(), 5000));
+        }
+    }
+    EXPECT_TRUE(reply == expected);
+
+    local.Stop();
+    local.Join();
+}
+
+// Binary replies to pipelined commands are told apart whatever chunks they come in
+TEST(ClientTest, BinaryCodec) {
+    BinaryCodec codec;
+    Call get, set;
+    get.op = Call::Op::kGet;
+    get.keys = {"a", "b"};
+    set.op = Call::Op::kSet;
+    set.keys = {"a"};
+    set.value = "v";
+
+    std::string out;
+    codec.Encode(get, out);
+    EXPECT_EQ(3 * 24 + 2, out.size());
+
+    // GETKQ hit for "a" with flags 5 and cas 9, NOOP, then STORED for set
+    std::string hit("\x81\x0d\x00\x01\x04\x00\x00\x00\x00\x00\x00\x07\x00\x00\x00\x00"
+                    "\x00\x00\x00\x00\x00\x00\x00\x09"
+                    "\x00\x00\x00\x05"
+                    "a"
+                    "xy",
+                    31);
+    std::string noop("\x81\x0a\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+                     "\x00\x00\x00\x00\x00\x00\x00\x00",
+                     24);
+    std::string stored = noop;
+    stored[1] = 0x01;
+    std::string stream = hit + noop + stored;
+
+    for (size_t chunk = 1; chunk <= stream.size(); chunk++) {
+        get.items.clear();
+        Call *expected[] = {&get, &set};
+        size_t done = 0;
+        codec.Expect(expected[0]);
+        for (size_t position = 0; position < stream.size();) {
+            size_t parsed;
+            bool complete = codec.Decode(&stream[position], std::min(chunk, stream.size() - position), parsed);
+            position += parsed;
+            if (complete && ++done < 2) {
+                codec.Expect(expected[done]);
+            }
+        }
+        ASSERT_EQ(2, done);
+        ASSERT_EQ(1, get.items.size());
+        EXPECT_EQ("a", get.items[0].first);
+        EXPECT_EQ("xy", get.items[0].second.value);
+        EXPECT_EQ(5, get.items[0].second.flags);
+        EXPECT_EQ(9, get.items[0].second.cas);
+        EXPECT_EQ(Status::kOk, set.status);
+    }
+}
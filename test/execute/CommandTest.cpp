@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <afina/execute/CacheMemlimit.h>
+#include <afina/execute/Gat.h>
+#include <afina/execute/Get.h>
+#include <afina/execute/Set.h>
+#include <afina/execute/Stats.h>
+#include <storage/MapBasedGlobalLockImpl.h>
+
+using namespace Afina;
+
+// Value storage can't make room for isn't reported as stored
+TEST(CommandTest, SetTooLarge) {
+    Backend::MapBasedGlobalLockImpl<> storage(1024);
+
+    std::string out, args(2048, 'x');
+    Execute::Set big("KEY1", 0, 0);
+    big.Execute(storage, args, out);
+    EXPECT_EQ("SERVER_ERROR out of memory storing object", out);
+
+    args = "val1";
+    Execute::Set small("KEY1", 0, 0);
+    small.Execute(storage, args, out);
+    EXPECT_EQ("STORED", out);
+}
+
+// Limit that doesn't fit in bytes is refused before storage sees it
+TEST(CommandTest, CacheMemlimitRange) {
+    Backend::MapBasedGlobalLockImpl<> storage(1024);
+
+    std::string out, args;
+    Execute::CacheMemlimit huge(UINT64_MAX >> 10);
+    huge.Execute(storage, args, out);
+    EXPECT_EQ("CLIENT_ERROR invalid memory limit", out);
+    Execute::CacheMemlimit zero(0);
+    zero.Execute(storage, args, out);
+    EXPECT_EQ("CLIENT_ERROR invalid memory limit", out);
+
+    Execute::CacheMemlimit one(1);
+    one.Execute(storage, args, out);
+    EXPECT_EQ("OK", out);
+}
+
+// Get that records how many keys it looks up at once
+class CountingGet : public Execute::Get {
+public:
+    explicit CountingGet(const std::vector<std::string> &keys) : Get(keys) {}
+
+    std::vector<size_t> batches;
+
+protected:
+    void Lookup(Storage &storage, size_t first, size_t count, std::vector<Storage::Item> &items) override {
+        batches.push_back(count);
+        Get::Lookup(storage, first, count, items);
+    }
+};
+
+// Big multi-get looks values up batch by batch as response portions are written out
+TEST(CommandTest, GetLooksUpByBatches) {
+    Backend::MapBasedGlobalLockImpl<> storage(1 << 20);
+    std::vector<std::string> keys;
+    std::string expected;
+    for (size_t i = 0; i < 200; i++) {
+        keys.push_back("KEY" + std::to_string(i));
+        if (i % 3 != 0) {
+            std::string value(1000, 'a' + i % 26);
+            ASSERT_TRUE(storage.Put(keys.back(), value));
+            expected += "VALUE " + keys.back() + " 0 1000\r\n" + value + "\r\n";
+        }
+    }
+    expected += "END";
+
+    CountingGet get(keys);
+    Execute::Response portion(4096);
+    std::string args, reply;
+    get.Execute(storage, args, portion);
+    EXPECT_EQ(1, get.batches.size());
+    while (get.Pending()) {
+        reply += portion.ToString();
+        portion.Clear();
+        get.Continue(storage, portion);
+    }
+    reply += portion.ToString();
+
+    EXPECT_TRUE(reply == expected);
+    EXPECT_EQ((keys.size() + Execute::Get::kBatchSize - 1) / Execute::Get::kBatchSize, get.batches.size());
+    for (size_t count : get.batches) {
+        EXPECT_LE(count, Execute::Get::kBatchSize);
+    }
+}
+
+TEST(CommandTest, Mutating) {
+    std::vector<std::string> keys{"key"};
+
+    // Only replies of commands changing the storage wait for durability
+    EXPECT_TRUE(Execute::Set("key", 0, 0).Mutating());
+    EXPECT_TRUE(Execute::Gat(0, keys).Mutating());
+    EXPECT_FALSE(Execute::Get(keys).Mutating());
+    EXPECT_FALSE(Execute::Stats().Mutating());
+}
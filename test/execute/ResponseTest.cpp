@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+
+#include <afina/execute/Get.h>
+#include <afina/execute/Response.h>
+#include <afina/execute/Stats.h>
+#include <storage/MapBasedGlobalLockImpl.h>
+
+using namespace Afina;
+
+// Verify text gets merged while slices are kept as is
+TEST(ResponseTest, GatherConsume) {
+    Execute::Response response;
+    std::shared_ptr<const std::string> slice = std::make_shared<std::string>("value");
+
+    response.Append("VALUE ");
+    response.Append("key\r\n");
+    response.Append(slice);
+    response.Append("\r\n", 2);
+    ASSERT_EQ(3, response.Count());
+    ASSERT_EQ(18, response.Size());
+
+    struct iovec iov[4];
+    ASSERT_EQ(3, response.Gather(iov, 4));
+    ASSERT_EQ(slice->data(), iov[1].iov_base);
+
+    response.Consume(13);
+    ASSERT_EQ(2, response.Count());
+    ASSERT_EQ("lue\r\n", response.ToString());
+
+    ASSERT_EQ(2, response.Gather(iov, 4));
+    ASSERT_EQ(slice->data() + 2, iov[0].iov_base);
+    ASSERT_EQ(3, iov[0].iov_len);
+
+    response.Consume(5);
+    ASSERT_TRUE(response.Empty());
+    ASSERT_EQ(0, response.Count());
+}
+
+// Verify get response references storage memory
+TEST(ResponseTest, GetSlices) {
+    Backend::MapBasedGlobalLockImpl<> storage;
+    storage.Put("foo", "fooval", 3);
+
+    std::string args;
+    Execute::Response response;
+    Execute::Get get({"foo", "bar"});
+    get.Execute(storage, args, response);
+    ASSERT_EQ("VALUE foo 3 6\r\nfooval\r\nEND", response.ToString());
+
+    struct iovec iov[4];
+    ASSERT_EQ(3, response.Gather(iov, 4));
+
+    // Slice survives update of the item
+    storage.Append("foo", "x");
+    ASSERT_EQ("fooval", std::string(static_cast<char *>(iov[1].iov_base), iov[1].iov_len));
+}
+
+// Verify multi-get stops at response budget and continues where it stopped
+TEST(ResponseTest, GetStreaming) {
+    Backend::MapBasedGlobalLockImpl<> storage;
+    storage.Put("a", "1");
+    storage.Put("b", "2");
+    storage.Put("c", "3");
+
+    std::string args;
+    Execute::Response response(10);
+    Execute::Get get({"a", "b", "c"});
+
+    get.Execute(storage, args, response);
+    ASSERT_TRUE(get.Pending());
+    ASSERT_EQ("VALUE a 0 1\r\n1\r\n", response.ToString());
+
+    response.Clear();
+    get.Continue(storage, response);
+    ASSERT_TRUE(get.Pending());
+    ASSERT_EQ("VALUE b 0 1\r\n2\r\n", response.ToString());
+
+    response.Clear();
+    get.Continue(storage, response);
+    ASSERT_FALSE(get.Pending());
+    ASSERT_EQ("VALUE c 0 1\r\n3\r\nEND", response.ToString());
+}
+
+// Verify stats lists storage counters
+TEST(ResponseTest, Stats) {
+    Backend::MapBasedGlobalLockImpl<> storage(100);
+    storage.Put("a", std::string(59, 'x'));
+    storage.Put("b", std::string(59, 'x'));
+
+    std::string args, out;
+    Execute::Stats stats;
+    stats.Execute(storage, args, out);
+    ASSERT_EQ("STAT bytes 60\r\nSTAT limit_maxbytes 100\r\nSTAT evictions 1\r\nSTAT inline_evictions 1\r\n"
+              "STAT snapshot_in_progress 0\r\nSTAT snapshots 0\r\nSTAT snapshot_failures 0\r\n"
+              "STAT last_snapshot_us 0\r\nSTAT snapshot_loaded_items 0\r\nSTAT snapshot_load_us 0\r\n"
+              "STAT snapshot_load_items_per_sec 0\r\nEND",
+              out);
+}
+
+// Verify fragments move between responses as they are, partly sent one included
+TEST(ResponseTest, AppendResponse) {
+    std::shared_ptr<const std::string> slice = std::make_shared<std::string>("value");
+    Execute::Response first, second;
+    first.Append("END\r\n");
+    second.Append("VALUE k\r\n");
+    second.Append(slice);
+    second.Append("\r\n", 2);
+    second.Consume(6);
+
+    first.Append(std::move(second));
+    ASSERT_TRUE(second.Empty());
+    ASSERT_EQ(0, second.Count());
+    ASSERT_EQ("END\r\nk\r\nvalue\r\n", first.ToString());
+
+    struct iovec iov[4];
+    std::shared_ptr<const std::string> slices[4];
+    ASSERT_EQ(3, first.Gather(iov, slices, 4));
+    ASSERT_FALSE(slices[0]);
+    ASSERT_EQ(slice, slices[1]);
+    ASSERT_EQ(slice->data(), iov[1].iov_base);
+    ASSERT_FALSE(slices[2]);
+}
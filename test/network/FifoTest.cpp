@@ -0,0 +1,111 @@
+#include "gtest/gtest.h"
+#include <memory>
+#include <string>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <network/fifo/ServerImpl.h>
+#include <storage/MapBasedGlobalLockImpl.h>
+
+using namespace Afina;
+using namespace Afina::Network;
+
+class FifoServer {
+public:
+    FifoServer() : read_path(Path("r")), write_path(Path("w")) {
+        storage = std::make_shared<Backend::MapBasedGlobalLockImpl<>>(64 << 20);
+        storage->Start();
+        server.reset(new Fifo::ServerImpl(storage));
+        server->Start(read_path, write_path);
+
+        // Server holds both ends, opening doesn't wait for it
+        commands = open(read_path.c_str(), O_WRONLY);
+        replies = open(write_path.c_str(), O_RDONLY);
+    }
+
+    ~FifoServer() {
+        close(commands);
+        close(replies);
+        server->Stop();
+        server->Join();
+        storage->Stop();
+        unlink(read_path.c_str());
+        unlink(write_path.c_str());
+    }
+
+    // Writes request, returns replies once there is as much of them as expected or nothing comes for a while
+    std::string Request(const std::string &request, size_t expected) {
+        std::string reply;
+        char chunk[64 << 10];
+        for (size_t sent = 0; reply.size() < expected;) {
+            struct pollfd fds[2];
+            fds[0].fd = replies;
+            fds[0].events = POLLIN;
+            fds[1].fd = commands;
+            fds[1].events = sent < request.size() ? POLLOUT : 0;
+            if (poll(fds, 2, 5000) <= 0) {
+                break;
+            }
+            if (fds[1].revents != 0) {
+                ssize_t written = write(commands, request.data() + sent, request.size() - sent);
+                sent += written > 0 ? written : 0;
+            }
+            if (fds[0].revents != 0) {
+                ssize_t got = read(replies, chunk, sizeof(chunk));
+                reply.append(chunk, got > 0 ? got : 0);
+            }
+        }
+        return reply;
+    }
+
+    static std::string Path(const std::string &name) {
+        return "/tmp/afina-fifo-" + std::to_string(getpid()) + "-" + name;
+    }
+
+    std::string read_path, write_path;
+    std::shared_ptr<Afina::Storage> storage;
+    std::unique_ptr<Fifo::ServerImpl> server;
+    int commands, replies;
+};
+
+TEST(FifoTest, Commands) {
+    FifoServer server;
+    EXPECT_EQ(Fifo::ServerImpl::kPipeSize, fcntl(server.replies, F_GETPIPE_SZ));
+
+    std::string expected = "STORED\r\nVALUE foo 0 3\r\nbar\r\nEND\r\n";
+    EXPECT_EQ(expected, server.Request("set foo 0 0 3\r\nbar\r\nget foo\r\n", expected.size()));
+
+    // Stream goes on after the writer is gone
+    close(server.commands);
+    server.commands = open(server.read_path.c_str(), O_WRONLY);
+    expected = "STORED\r\nVALUE foo 0 3\r\nbaz\r\nEND\r\n";
+    EXPECT_EQ(expected, server.Request("set foo 0 0 3 noreply\r\nbaz\r\nset x 0 0 1\r\n1\r\nget foo\r\n",
+                                       expected.size()));
+}
+
+// Large values are spliced and stay intact while their memory is referenced by the pipe, replies several
+// times larger than the pipe are written as it drains
+TEST(FifoTest, LargeValues) {
+    FifoServer server;
+    std::string big(3 * Fifo::ServerImpl::kPipeSize, 'x'), small(Fifo::ServerImpl::kSpliceMin, 'y');
+    for (size_t i = 0; i < big.size(); i += 4096) {
+        big[i] = 'a' + i / 4096 % 26;
+    }
+
+    std::string request = "set big 0 0 " + std::to_string(big.size()) + "\r\n" + big + "\r\n";
+    request += "set small 0 0 " + std::to_string(small.size()) + "\r\n" + small + "\r\n";
+    std::string expected = "STORED\r\nSTORED\r\n";
+    for (int i = 0; i < 4; i++) {
+        request += "get big small\r\n";
+        expected += "VALUE big 0 " + std::to_string(big.size()) + "\r\n" + big + "\r\n";
+        expected += "VALUE small 0 " + std::to_string(small.size()) + "\r\n" + small + "\r\nEND\r\n";
+    }
+    request += "delete big\r\n";
+    expected += "DELETED\r\n";
+
+    std::string reply = server.Request(request, expected.size());
+    EXPECT_EQ(expected.size(), reply.size());
+    EXPECT_TRUE(expected == reply);
+}
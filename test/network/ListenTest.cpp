@@ -0,0 +1,120 @@
+#include "gtest/gtest.h"
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <network/Listen.h>
+#include <network/nonblocking/ServerImpl.h>
+#include <storage/MapBasedGlobalLockImpl.h>
+
+using namespace Afina;
+using namespace Afina::Network;
+
+static std::string SocketPath(const std::string &name) {
+    return "/tmp/afina-listen-" + std::to_string(getpid()) + "-" + name;
+}
+
+// Connected socket or -1
+static int Connect(const std::string &path) {
+    struct sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.data(), path.size());
+    socklen_t length = sizeof(address);
+    if (path[0] == '@') {
+        address.sun_path[0] = '\0';
+        length = offsetof(struct sockaddr_un, sun_path) + path.size();
+    }
+
+    int client = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connect(client, reinterpret_cast<struct sockaddr *>(&address), length) != 0) {
+        close(client);
+        return -1;
+    }
+    return client;
+}
+
+TEST(ListenTest, UnixMode) {
+    std::string path = SocketPath("mode");
+    int server = ListenUnix(path, 0600);
+
+    struct stat info;
+    ASSERT_EQ(0, stat(path.c_str(), &info));
+    EXPECT_TRUE(S_ISSOCK(info.st_mode));
+    EXPECT_EQ(0600, info.st_mode & 0777);
+
+    close(server);
+    UnlinkUnix(path);
+    EXPECT_NE(0, access(path.c_str(), F_OK));
+}
+
+// File left by a crashed process is taken over, the one somebody listens on is not
+TEST(ListenTest, UnixStaleAndBusy) {
+    std::string path = SocketPath("stale");
+    close(ListenUnix(path));
+    ASSERT_EQ(0, access(path.c_str(), F_OK));
+
+    int server = ListenUnix(path);
+    int client = Connect(path);
+    EXPECT_GE(client, 0);
+    close(client);
+
+    EXPECT_THROW(ListenUnix(path), std::runtime_error);
+    close(server);
+    UnlinkUnix(path);
+
+    std::string regular = SocketPath("regular");
+    close(creat(regular.c_str(), 0600));
+    EXPECT_THROW(ListenUnix(regular), std::runtime_error);
+    unlink(regular.c_str());
+}
+
+TEST(ListenTest, UnixAbstract) {
+    std::string name = "@afina-listen-" + std::to_string(getpid());
+    int server = ListenUnix(name);
+    EXPECT_NE(0, access(name.substr(1).c_str(), F_OK));
+
+    int client = Connect(name);
+    EXPECT_GE(client, 0);
+    close(client);
+    close(server);
+    EXPECT_LT(Connect(name), 0);
+}
+
+// Server accepts on whatever sockets it was given
+TEST(ListenTest, ServerOnUnixSocket) {
+    std::string path = SocketPath("server");
+    auto storage = std::make_shared<Backend::MapBasedGlobalLockImpl<>>(1 << 20);
+    storage->Start();
+    std::shared_ptr<Server> server = std::make_shared<NonBlocking::ServerImpl>(storage);
+    server->Start(std::vector<int>{ListenUnix(path)});
+
+    int client = Connect(path);
+    ASSERT_GE(client, 0);
+    std::string request = "set foo 0 0 3\r\nbar\r\nget foo\r\n";
+    ASSERT_EQ(request.size(), write(client, request.data(), request.size()));
+
+    std::string expected = "STORED\r\nVALUE foo 0 3\r\nbar\r\nEND\r\n", reply;
+    char buffer[256];
+    while (reply.size() < expected.size()) {
+        ssize_t got = read(client, buffer, sizeof(buffer));
+        ASSERT_GT(got, 0);
+        reply.append(buffer, got);
+    }
+    EXPECT_EQ(expected, reply);
+    close(client);
+
+    server->Stop();
+    server->Join();
+    storage->Stop();
+    UnlinkUnix(path);
+}
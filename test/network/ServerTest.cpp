@@ -0,0 +1,98 @@
+#include "gtest/gtest.h"
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <network/Listen.h>
+#include <network/nonblocking/ServerImpl.h>
+#include <storage/MapBasedGlobalLockImpl.h>
+
+using namespace Afina;
+using namespace Afina::Network;
+
+static int Connect(const std::string &path) {
+    struct sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    int client = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connect(client, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0) {
+        close(client);
+        return -1;
+    }
+    return client;
+}
+
+// Sends the whole request at once, returns as many reply bytes as expected
+static std::string Exchange(int client, const std::string &request, size_t expected) {
+    std::string reply;
+    if (write(client, request.data(), request.size()) != ssize_t(request.size())) {
+        return reply;
+    }
+    char buffer[4096];
+    while (reply.size() < expected) {
+        ssize_t got = read(client, buffer, sizeof(buffer));
+        if (got <= 0) {
+            break;
+        }
+        reply.append(buffer, got);
+    }
+    return reply;
+}
+
+// Data block larger than the whole storage isn't allocated, it is read and dropped, connection goes on
+TEST(ServerTest, TooLargeValue) {
+    std::string path = "/tmp/afina-server-" + std::to_string(getpid());
+    auto storage = std::make_shared<Backend::MapBasedGlobalLockImpl<>>(1024);
+    storage->Start();
+    std::shared_ptr<Server> server = std::make_shared<NonBlocking::ServerImpl>(storage);
+    server->Start(std::vector<int>{ListenUnix(path)});
+
+    int client = Connect(path);
+    ASSERT_GE(client, 0);
+    std::string big(5000, 'x');
+    std::string request = "set big 0 0 5000\r\n" + big + "\r\nget big\r\nset foo 0 0 3\r\nbar\r\nget foo\r\n";
+    std::string expected =
+        "SERVER_ERROR object too large for cache\r\nEND\r\nSTORED\r\nVALUE foo 0 3\r\nbar\r\nEND\r\n";
+    EXPECT_EQ(expected, Exchange(client, request, expected.size()));
+    close(client);
+
+    server->Stop();
+    server->Join();
+    storage->Stop();
+    UnlinkUnix(path);
+}
+
+// With log synced before every reply, pipelined replies wait for the writer thread and keep their order
+TEST(ServerTest, DurableReplies) {
+    std::string path = "/tmp/afina-server-" + std::to_string(getpid());
+    std::string log = "/tmp/afina-server-log-" + std::to_string(getpid());
+    unlink(log.c_str());
+    auto storage = std::make_shared<Backend::MapBasedGlobalLockImpl<>>(1 << 20);
+    ASSERT_TRUE(storage->OpenLog(log, Storage::LogSync::kAlways, 0));
+    storage->Start();
+    std::shared_ptr<Server> server = std::make_shared<NonBlocking::ServerImpl>(storage);
+    server->Start(std::vector<int>{ListenUnix(path)});
+
+    int client = Connect(path);
+    ASSERT_GE(client, 0);
+    std::string request, expected;
+    for (int i = 0; i < 100; i++) {
+        std::string value = std::to_string(i);
+        request += "set key 0 0 " + std::to_string(value.size()) + "\r\n" + value + "\r\nget key\r\n";
+        expected += "STORED\r\nVALUE key 0 " + std::to_string(value.size()) + "\r\n" + value + "\r\nEND\r\n";
+    }
+    EXPECT_EQ(expected, Exchange(client, request, expected.size()));
+    close(client);
+
+    server->Stop();
+    server->Join();
+    storage->Stop();
+    UnlinkUnix(path);
+    unlink(log.c_str());
+}
@@ -4,9 +4,17 @@
 #include <string>
 
 #include <afina/execute/Add.h>
+#include <afina/execute/CacheMemlimit.h>
+#include <afina/execute/Cas.h>
+#include <afina/execute/Delete.h>
+#include <afina/execute/DeletePrefix.h>
+#include <afina/execute/Error.h>
+#include <afina/execute/Gat.h>
 #include <afina/execute/Get.h>
+#include <afina/execute/Incr.h>
 #include <afina/execute/Set.h>
 #include <afina/execute/Stats.h>
+#include <afina/execute/Touch.h>
 
 #include <protocol/Parser.h>
 
@@ -81,6 +89,274 @@ TEST(MemcachedParserTest, SimpleGet) {
     ASSERT_EQ("super_long_key", keys[2]);
 }
 
+// Verify incr command with a 64-bit argument
+TEST(MemcachedParserTest, SimpleIncr) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    bool cmd_avail = parser.Parse("incr counter 18446744073709551615\r\n", consumed);
+    ASSERT_TRUE(cmd_avail);
+    ASSERT_EQ(35, consumed);
+    ASSERT_EQ("incr", parser.Name());
+
+    uint32_t value_size;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+    ASSERT_EQ(0, value_size);
+
+    Execute::Incr *tmp = reinterpret_cast<Execute::Incr *>(cmd.get());
+    ASSERT_EQ("counter", tmp->key());
+    ASSERT_EQ(18446744073709551615ULL, tmp->value());
+}
+
+// Line cut short is a complete command replying ERROR, next command is parsed as usual
+TEST(MemcachedParserTest, MissingArguments) {
+    Protocol::Parser parser;
+    for (const std::string line : {"incr key\r\n", "decr\r\n", "touch key\r\n", "touch\r\n", "delete\r\n"}) {
+        size_t consumed = 0;
+        ASSERT_TRUE(parser.Parse(line + "get key\r\n", consumed));
+        ASSERT_EQ(line.size(), consumed);
+
+        uint32_t value_size;
+        std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+        ASSERT_FALSE(dynamic_cast<Execute::Error *>(cmd.get()) == nullptr);
+        parser.Reset();
+    }
+}
+
+// Verify cas command carries version stamp
+TEST(MemcachedParserTest, SimpleCas) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    bool cmd_avail = parser.Parse("cas foo 1 0 6 12345\r\nfooval\r\n", consumed);
+    ASSERT_TRUE(cmd_avail);
+    ASSERT_EQ(21, consumed);
+    ASSERT_EQ("cas", parser.Name());
+
+    uint32_t value_size;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+    ASSERT_EQ(6, value_size);
+
+    Execute::Cas *tmp = reinterpret_cast<Execute::Cas *>(cmd.get());
+    ASSERT_EQ("foo", tmp->key());
+    ASSERT_EQ(1, tmp->flags());
+    ASSERT_EQ(12345, tmp->cas());
+}
+
+TEST(MemcachedParserTest, InvalidCas) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    ASSERT_THROW(parser.Parse("cas foo 1 0 6 12x45\r\nfooval\r\n", consumed), std::runtime_error);
+}
+
+// Verify gets is a get which asks for version stamps
+TEST(MemcachedParserTest, SimpleGets) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    bool cmd_avail = parser.Parse("gets foo\r\n", consumed);
+    ASSERT_TRUE(cmd_avail);
+    ASSERT_EQ("gets", parser.Name());
+
+    uint32_t value_size;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+
+    Execute::Get *tmp = reinterpret_cast<Execute::Get *>(cmd.get());
+    ASSERT_TRUE(tmp->with_cas());
+    ASSERT_EQ(1, tmp->keys().size());
+}
+
+// Verify multi-digit exptime
+TEST(MemcachedParserTest, ExprTime) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    bool cmd_avail = parser.Parse("set foo 0 3600 6\r\nfooval\r\n", consumed);
+    ASSERT_TRUE(cmd_avail);
+
+    uint32_t value_size;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+
+    Execute::Set *tmp = reinterpret_cast<Execute::Set *>(cmd.get());
+    ASSERT_EQ(3600, tmp->expire());
+}
+
+// Expiration time must fit into 32 bits, both ways
+TEST(MemcachedParserTest, ExprTimeOverflow) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    uint32_t value_size;
+    ASSERT_TRUE(parser.Parse("touch foo 2147483647\r\n", consumed));
+    ASSERT_EQ(2147483647, reinterpret_cast<Execute::Touch *>(parser.Build(value_size).get())->expire());
+
+    parser.Reset();
+    ASSERT_TRUE(parser.Parse("touch foo -2147483648\r\n", consumed));
+    ASSERT_EQ(-2147483648LL, reinterpret_cast<Execute::Touch *>(parser.Build(value_size).get())->expire());
+
+    parser.Reset();
+    ASSERT_THROW(parser.Parse("touch foo 2147483648\r\n", consumed), std::runtime_error);
+    parser.Reset();
+    ASSERT_THROW(parser.Parse("touch foo -2147483649\r\n", consumed), std::runtime_error);
+    parser.Reset();
+    ASSERT_THROW(parser.Parse("set foo 0 99999999999 6\r\n", consumed), std::runtime_error);
+}
+
+// Expiration time must be a number, missing one isn't waited for past the end of line
+TEST(MemcachedParserTest, InvalidExprTime) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    for (const char *line : {"gat\r\n", "gats\r\n", "touch k \r\n", "touch k abc\r\n", "touch k 1x\r\n",
+                             "set k 0 \r\n"}) {
+        ASSERT_THROW(parser.Parse(line, consumed), std::runtime_error) << line;
+        parser.Reset();
+    }
+}
+
+// Verify touch command
+TEST(MemcachedParserTest, SimpleTouch) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    bool cmd_avail = parser.Parse("touch foo 120\r\n", consumed);
+    ASSERT_TRUE(cmd_avail);
+    ASSERT_EQ(15, consumed);
+    ASSERT_EQ("touch", parser.Name());
+
+    uint32_t value_size;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+    ASSERT_EQ(0, value_size);
+
+    Execute::Touch *tmp = reinterpret_cast<Execute::Touch *>(cmd.get());
+    ASSERT_EQ("foo", tmp->key());
+    ASSERT_EQ(120, tmp->expire());
+}
+
+// Verify gats command takes exptime before keys
+TEST(MemcachedParserTest, SimpleGats) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    bool cmd_avail = parser.Parse("gats -15 foo bar\r\n", consumed);
+    ASSERT_TRUE(cmd_avail);
+    ASSERT_EQ(18, consumed);
+    ASSERT_EQ("gats", parser.Name());
+
+    uint32_t value_size;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+
+    Execute::Gat *tmp = reinterpret_cast<Execute::Gat *>(cmd.get());
+    ASSERT_TRUE(tmp->with_cas());
+    ASSERT_EQ(-15, tmp->expire());
+    ASSERT_EQ(2, tmp->keys().size());
+    ASSERT_EQ("bar", tmp->keys()[1]);
+}
+
+// Verify noreply is recognized on storage commands only when given
+TEST(MemcachedParserTest, Noreply) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    uint32_t value_size;
+    ASSERT_TRUE(parser.Parse("set foo 5 0 6 noreply\r\nfooval\r\n", consumed));
+    ASSERT_EQ(23, consumed);
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+    ASSERT_EQ(6, value_size);
+    ASSERT_TRUE(cmd->noreply());
+    ASSERT_EQ(5, reinterpret_cast<Execute::Set *>(cmd.get())->flags());
+
+    parser.Reset();
+    ASSERT_TRUE(parser.Parse("incr foo 1 noreply\r\n", consumed));
+    ASSERT_TRUE(parser.Build(value_size)->noreply());
+
+    parser.Reset();
+    ASSERT_TRUE(parser.Parse("set foo 0 0 6\r\nfooval\r\n", consumed));
+    ASSERT_FALSE(parser.Build(value_size)->noreply());
+}
+
+// Verify delete command with and without optional arguments
+TEST(MemcachedParserTest, SimpleDelete) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    uint32_t value_size;
+    ASSERT_TRUE(parser.Parse("delete foo\r\n", consumed));
+    ASSERT_EQ(12, consumed);
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+    ASSERT_EQ(0, value_size);
+    ASSERT_FALSE(cmd->noreply());
+    ASSERT_EQ("foo", reinterpret_cast<Execute::Delete *>(cmd.get())->key());
+
+    parser.Reset();
+    ASSERT_TRUE(parser.Parse("delete bar 0 noreply\r\n", consumed));
+    cmd = parser.Build(value_size);
+    ASSERT_TRUE(cmd->noreply());
+    ASSERT_EQ("bar", reinterpret_cast<Execute::Delete *>(cmd.get())->key());
+
+    // Missing key is an error, next line is a command of its own
+    parser.Reset();
+    std::string input = "delete\r\nget a\r\n";
+    ASSERT_TRUE(parser.Parse(input, consumed));
+    ASSERT_EQ(8, consumed);
+    ASSERT_FALSE(dynamic_cast<Execute::Error *>(parser.Build(value_size).get()) == nullptr);
+    parser.Reset();
+    ASSERT_TRUE(parser.Parse(input.substr(consumed), consumed));
+    ASSERT_EQ("get", parser.Name());
+    cmd = parser.Build(value_size);
+    ASSERT_EQ(1, reinterpret_cast<Execute::Get *>(cmd.get())->keys().size());
+    ASSERT_EQ("a", reinterpret_cast<Execute::Get *>(cmd.get())->keys()[0]);
+}
+
+TEST(MemcachedParserTest, SimpleDeletePrefix) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    uint32_t value_size;
+    ASSERT_TRUE(parser.Parse("delete_prefix user:1: noreply\r\n", consumed));
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+    ASSERT_EQ(0, value_size);
+    ASSERT_TRUE(cmd->noreply());
+    ASSERT_EQ("user:1:", reinterpret_cast<Execute::DeletePrefix *>(cmd.get())->prefix());
+
+    // Missing prefix is an error, following request is left alone
+    parser.Reset();
+    ASSERT_TRUE(parser.Parse("delete_prefix\r\nget a\r\n", consumed));
+    ASSERT_EQ(15, consumed);
+    ASSERT_FALSE(dynamic_cast<Execute::Error *>(parser.Build(value_size).get()) == nullptr);
+}
+
+TEST(MemcachedParserTest, CacheMemlimit) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    uint32_t value_size;
+    ASSERT_TRUE(parser.Parse("cache_memlimit 64\r\n", consumed));
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+    ASSERT_EQ(0, value_size);
+    ASSERT_EQ(64, reinterpret_cast<Execute::CacheMemlimit *>(cmd.get())->megabytes());
+
+    parser.Reset();
+    ASSERT_TRUE(parser.Parse("cache_memlimit lots\r\n", consumed));
+    ASSERT_THROW(parser.Build(value_size), std::runtime_error);
+
+    parser.Reset();
+    ASSERT_TRUE(parser.Parse("cache_memlimit\r\nget a\r\n", consumed));
+    ASSERT_EQ(16, consumed);
+    ASSERT_FALSE(dynamic_cast<Execute::Error *>(parser.Build(value_size).get()) == nullptr);
+}
+
 TEST(MemcachedParserTest, Stats) {
     Protocol::Parser parser;
 
@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <protocol/ReplyParser.h>
+#include <protocol/Ring.h>
+
+using namespace Afina;
+
+// Keys are spread over all servers roughly evenly
+TEST(RingTest, Distribution) {
+    std::vector<std::string> servers{"10.0.0.1:8080", "10.0.0.2:8080", "10.0.0.3:8080", "10.0.0.4:8080"};
+    Protocol::Ring ring;
+    ring.Build(servers, std::vector<bool>(servers.size(), true));
+
+    const size_t keys = 40000;
+    std::vector<size_t> owned(servers.size());
+    for (size_t i = 0; i < keys; i++) {
+        int server = ring.Find("key" + std::to_string(i));
+        ASSERT_GE(server, 0);
+        ASSERT_LT(server, servers.size());
+        owned[server]++;
+    }
+    for (size_t count : owned) {
+        EXPECT_GT(count, keys / servers.size() * 3 / 4);
+        EXPECT_LT(count, keys / servers.size() * 5 / 4);
+    }
+}
+
+// Once a server is gone only its own keys move
+TEST(RingTest, Removal) {
+    std::vector<std::string> servers{"a:1", "b:2", "c:3"};
+    Protocol::Ring full, reduced;
+    full.Build(servers, {true, true, true});
+    reduced.Build(servers, {true, false, true});
+
+    size_t moved = 0;
+    for (size_t i = 0; i < 10000; i++) {
+        std::string key = "key" + std::to_string(i);
+        int before = full.Find(key);
+        int after = reduced.Find(key);
+        ASSERT_NE(1, after);
+        if (before != 1) {
+            ASSERT_EQ(before, after);
+        } else {
+            moved++;
+        }
+    }
+    EXPECT_GT(moved, 0);
+}
+
+TEST(RingTest, Empty) {
+    Protocol::Ring ring;
+    EXPECT_TRUE(ring.Empty());
+    EXPECT_EQ(-1, ring.Find("key"));
+
+    ring.Build({"a:1"}, {false});
+    EXPECT_TRUE(ring.Empty());
+    EXPECT_EQ(-1, ring.Find("key"));
+}
+
+// Hash must not depend on the build, proxies and clients compiled separately route keys the same way
+TEST(RingTest, StableHash) {
+    EXPECT_EQ(Protocol::Ring::Hash("", 0), Protocol::Ring::Hash("", 0));
+    EXPECT_NE(Protocol::Ring::Hash("a", 1), Protocol::Ring::Hash("b", 1));
+
+    Protocol::Ring ring;
+    ring.Build({"a:1", "b:2"}, {true, true});
+    int first = ring.Find("foo");
+    ring.Build({"a:1", "b:2"}, {true, true});
+    EXPECT_EQ(first, ring.Find("foo"));
+}
+
+// Replies are split at the right place whatever chunks they come in
+TEST(ReplyParserTest, Pipelined) {
+    std::string stream = "STORED\r\nVALUE foo 0 5\r\nEND\r\n\r\nVALUE bar 1 2 7\r\nab\r\nEND\r\nEND\r\n";
+    std::vector<Protocol::ReplyParser::Kind> kinds{Protocol::ReplyParser::Kind::kLine,
+                                                   Protocol::ReplyParser::Kind::kValues,
+                                                   Protocol::ReplyParser::Kind::kValues};
+    std::vector<std::string> expected{"STORED\r\n", "VALUE foo 0 5\r\nEND\r\n\r\nVALUE bar 1 2 7\r\nab\r\nEND\r\n",
+                                      "END\r\n"};
+
+    for (size_t chunk = 1; chunk <= stream.size(); chunk++) {
+        Protocol::ReplyParser parser;
+        std::vector<std::string> replies;
+        std::string current;
+        parser.Reset(kinds[0]);
+        for (size_t position = 0; position < stream.size();) {
+            size_t size = std::min(chunk, stream.size() - position);
+            size_t parsed = 0;
+            bool complete = parser.Parse(&stream[position], size, parsed);
+            current.append(stream, position, parsed);
+            position += parsed;
+            if (complete) {
+                replies.push_back(current);
+                current.clear();
+                if (replies.size() < kinds.size()) {
+                    parser.Reset(kinds[replies.size()]);
+                }
+            }
+        }
+        ASSERT_EQ(expected, replies) << "chunk " << chunk;
+    }
+}
+
+// Error stops retrieval reply right away
+TEST(ReplyParserTest, Error) {
+    Protocol::ReplyParser parser;
+    parser.Reset(Protocol::ReplyParser::Kind::kValues);
+
+    size_t parsed = 0;
+    std::string reply = "SERVER_ERROR out of memory\r\nSTORED\r\n";
+    ASSERT_TRUE(parser.Parse(reply.data(), reply.size(), parsed));
+    EXPECT_EQ(28, parsed);
+
+    parser.Reset(Protocol::ReplyParser::Kind::kValues);
+    std::string garbage = "VALUE foo x y\r\n";
+    EXPECT_THROW(parser.Parse(garbage.data(), garbage.size(), parsed), std::runtime_error);
+}
@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <storage/MapBasedGlobalLockImpl.h>
+
+using namespace Afina;
+using namespace Afina::Backend;
+
+/**
+ * Replays access trace against storages with different eviction policies and reports hit ratio and byte hit
+ * ratio: every request is a get, miss is followed by put of the value with traced size, as a look-aside cache
+ * client does.
+ *
+ * Usage: runEvictionSimulator [budget bytes] [trace file]
+ * Trace is text, one "<key> <value size>" request per line. Without trace the synthetic one is used: zipfian
+ * reads over 10000 keys interleaved with one pass scans over cold keys, value sizes are heavy tailed from
+ * 20 bytes to 1Mb.
+ */
+
+namespace {
+
+struct Request {
+    std::string key;
+    size_t size;
+};
+
+std::vector<Request> LoadTrace(const char *path) {
+    std::vector<Request> trace;
+    std::ifstream input(path);
+    if (!input) {
+        throw std::runtime_error(std::string("Can't open trace ") + path);
+    }
+
+    Request request;
+    while (input >> request.key >> request.size) {
+        trace.push_back(request);
+    }
+    return trace;
+}
+
+std::vector<Request> MakeTrace() {
+    const size_t keys = 10000, requests = 1000000, scan = 20000;
+    std::mt19937_64 random(42);
+    std::uniform_real_distribution<double> uniform(0, 1);
+
+    // Most values are small, few are huge
+    auto value_size = [&]() { return std::min<size_t>(1 << 20, size_t(20 / (1 - uniform(random)))); };
+
+    std::vector<double> cdf(keys);
+    std::vector<size_t> sizes(keys);
+    double sum = 0;
+    for (size_t i = 0; i < keys; i++) {
+        sum += 1.0 / std::pow(double(i + 1), 0.9);
+        cdf[i] = sum;
+        sizes[i] = value_size();
+    }
+
+    std::vector<Request> trace;
+    trace.reserve(requests);
+    size_t cold = 0;
+    while (trace.size() < requests) {
+        for (size_t i = 0; i < 4 * scan && trace.size() < requests; i++) {
+            size_t rank = std::lower_bound(cdf.begin(), cdf.end(), uniform(random) * sum) - cdf.begin();
+            trace.push_back(Request{"key:" + std::to_string(rank), sizes[rank]});
+        }
+        for (size_t i = 0; i < scan && trace.size() < requests; i++) {
+            trace.push_back(Request{"scan:" + std::to_string(cold++), value_size()});
+        }
+    }
+    return trace;
+}
+
+template <typename Policy> void Replay(const char *name, size_t budget, const std::vector<Request> &trace) {
+    MapBasedGlobalLockImpl<Policy> storage(budget);
+    std::string value;
+    size_t hits = 0;
+    uint64_t hit_bytes = 0, total_bytes = 0;
+    for (auto &request : trace) {
+        total_bytes += request.size;
+        if (storage.Get(request.key, value)) {
+            hits++;
+            hit_bytes += request.size;
+        } else {
+            storage.Put(request.key, std::string(request.size, 'x'));
+        }
+    }
+    std::cout << name << ": hit ratio " << double(hits) / trace.size() << ", byte hit ratio "
+              << double(hit_bytes) / total_bytes << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const size_t budget = argc > 1 ? std::stoul(argv[1]) : (1 << 20);
+    std::vector<Request> trace = argc > 2 ? LoadTrace(argv[2]) : MakeTrace();
+
+    std::cout << "requests: " << trace.size() << ", budget: " << budget << std::endl;
+    Replay<LruPolicy>("lru", budget, trace);
+    Replay<SlruPolicy>("slru", budget, trace);
+    Replay<TwoQueuePolicy>("2q", budget, trace);
+    Replay<ArcPolicy>("arc", budget, trace);
+    Replay<GdsfPolicy>("gdsf", budget, trace);
+    Replay<TinyLfuPolicy>("w-tinylfu", budget, trace);
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <afina/Hash.h>
+#include <storage/MapBasedGlobalLockImpl.h>
+
+using namespace Afina;
+using namespace Afina::Backend;
+
+/**
+ * Compares Afina::Hash against std::hash on memcached-like keys:
+ * - bucket distribution: chi-square over power of two table, lower bits only as index does
+ * - avalanche: average number of output bits flipped by single input bit flip, ideal is 32
+ * - storage lookup latency with and without precomputed hash
+ */
+
+namespace {
+
+std::vector<std::string> MakeKeys(size_t count) {
+    std::vector<std::string> keys;
+    keys.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        keys.push_back("user:" + std::to_string(i) + ":session");
+    }
+    return keys;
+}
+
+double ChiSquare(const std::vector<std::string> &keys, const std::function<uint64_t(const std::string &)> &hash) {
+    const size_t buckets = 1 << 12;
+    std::vector<size_t> counts(buckets, 0);
+    for (auto &key : keys) {
+        counts[hash(key) & (buckets - 1)]++;
+    }
+
+    double expected = double(keys.size()) / buckets;
+    double chi = 0;
+    for (size_t count : counts) {
+        chi += (count - expected) * (count - expected) / expected;
+    }
+    return chi / buckets;
+}
+
+double Avalanche(const std::vector<std::string> &keys, const std::function<uint64_t(const std::string &)> &hash) {
+    uint64_t flipped = 0, trials = 0;
+    for (size_t i = 0; i < keys.size(); i += 97) {
+        std::string key = keys[i];
+        uint64_t base = hash(key);
+        for (size_t bit = 0; bit < key.size() * 8; bit++) {
+            key[bit / 8] ^= char(1 << (bit % 8));
+            flipped += __builtin_popcountll(base ^ hash(key));
+            key[bit / 8] ^= char(1 << (bit % 8));
+            trials++;
+        }
+    }
+    return double(flipped) / trials;
+}
+
+template <typename F> double NanosPerOp(size_t ops, F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return double(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / ops;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const size_t count = argc > 1 ? std::stoul(argv[1]) : 200000;
+    const size_t rounds = 5;
+    std::vector<std::string> keys = MakeKeys(count);
+
+    std::hash<std::string> std_hash;
+    auto afina_hash = [](const std::string &key) { return Hash(key); };
+    auto standard = [&std_hash](const std::string &key) { return uint64_t(std_hash(key)); };
+
+    std::cout << "keys: " << count << std::endl;
+    std::cout << "chi-square/bucket (1.0 is ideal): afina " << ChiSquare(keys, afina_hash) << ", std "
+              << ChiSquare(keys, standard) << std::endl;
+    std::cout << "avalanche bits (32 is ideal): afina " << Avalanche(keys, afina_hash) << ", std "
+              << Avalanche(keys, standard) << std::endl;
+
+    volatile uint64_t sink = 0;
+    std::cout << "hash ns/key: afina " << NanosPerOp(count * rounds, [&] {
+        for (size_t r = 0; r < rounds; r++)
+            for (auto &key : keys)
+                sink = sink + Hash(key);
+    }) << ", std " << NanosPerOp(count * rounds, [&] {
+        for (size_t r = 0; r < rounds; r++)
+            for (auto &key : keys)
+                sink = sink + std_hash(key);
+    }) << std::endl;
+
+    MapBasedGlobalLockImpl<> storage(count * 64);
+    for (auto &key : keys) {
+        storage.Put(key, std::string("value"));
+    }
+    std::vector<uint64_t> hashes(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        hashes[i] = Hash(keys[i]);
+    }
+
+    std::shared_ptr<const std::string> value;
+    uint32_t flags;
+    uint64_t cas;
+    std::cout << "get ns/op: hashing " << NanosPerOp(count * rounds, [&] {
+        for (size_t r = 0; r < rounds; r++)
+            for (auto &key : keys)
+                sink = sink + storage.Get(key, value, flags, cas);
+    }) << ", prehashed " << NanosPerOp(count * rounds, [&] {
+        for (size_t r = 0; r < rounds; r++)
+            for (size_t i = 0; i < keys.size(); i++)
+                sink = sink + storage.Get(keys[i], hashes[i], value, flags, cas);
+    }) << std::endl;
+
+    return 0;
+}
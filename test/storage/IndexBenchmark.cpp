@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <afina/Hash.h>
+#include <storage/AdaptiveRadixTree.h>
+#include <storage/FlatIndex.h>
+#include <storage/MapBasedGlobalLockImpl.h>
+
+using namespace Afina;
+using namespace Afina::Backend;
+
+/**
+ * Compares storage key indexes against std::unordered_map keyed the way storage used to be:
+ * - memory per key taken by index itself, entries are not counted
+ * - hit and miss probe latency in random order, hash indexes get precomputed hashes
+ * - worst insert latency while index grows: rehash pause of unordered_map against incremental one
+ */
+
+namespace {
+
+size_t allocated = 0;
+
+// Tracks bytes held by the map, including nodes and bucket array
+template <typename T> struct CountingAllocator {
+    using value_type = T;
+
+    CountingAllocator() {}
+    template <typename U> CountingAllocator(const CountingAllocator<U> &) {}
+
+    T *allocate(size_t n) {
+        allocated += n * sizeof(T);
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+    void deallocate(T *p, size_t n) {
+        allocated -= n * sizeof(T);
+        ::operator delete(p);
+    }
+
+    template <typename U> bool operator==(const CountingAllocator<U> &) const { return true; }
+    template <typename U> bool operator!=(const CountingAllocator<U> &) const { return false; }
+};
+
+struct KeyReference {
+    const std::string *key;
+    uint64_t hash;
+};
+
+struct KeyReferenceHash {
+    size_t operator()(const KeyReference &reference) const { return reference.hash; }
+};
+
+struct KeyReferenceEqual {
+    bool operator()(const KeyReference &a, const KeyReference &b) const {
+        return a.hash == b.hash && *a.key == *b.key;
+    }
+};
+
+using Map = std::unordered_map<KeyReference, Entry *, KeyReferenceHash, KeyReferenceEqual,
+                               CountingAllocator<std::pair<const KeyReference, Entry *>>>;
+
+// Longest single call of f(i) for i in [0, count)
+template <typename F> double WorstNanos(size_t count, F f) {
+    auto worst = std::chrono::nanoseconds(0);
+    for (size_t i = 0; i < count; i++) {
+        auto start = std::chrono::steady_clock::now();
+        f(i);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        worst = std::max(worst, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed));
+    }
+    return double(worst.count());
+}
+
+template <typename F> double NanosPerOp(size_t ops, F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return double(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / ops;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const size_t count = argc > 1 ? std::stoul(argv[1]) : 1000000;
+
+    std::vector<std::unique_ptr<Entry>> entries;
+    std::vector<std::string> misses;
+    for (size_t i = 0; i < count; i++) {
+        std::string key = "user:" + std::to_string(i) + ":session";
+        entries.emplace_back(new Entry(key, Hash(key), std::string("value")));
+        misses.push_back("miss:" + std::to_string(i));
+    }
+    std::vector<uint64_t> miss_hashes;
+    for (auto &key : misses) {
+        miss_hashes.push_back(Hash(key));
+    }
+
+    std::vector<size_t> order(count);
+    for (size_t i = 0; i < count; i++) {
+        order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937(42));
+
+    Map map;
+    double map_worst = WorstNanos(count, [&](size_t i) {
+        map.emplace(KeyReference{&entries[i]->GetKeyReference(), entries[i]->GetHash()}, entries[i].get());
+    });
+    FlatIndex<Entry> index;
+    double flat_worst = WorstNanos(count, [&](size_t i) { index.Insert(entries[i].get()); });
+
+    AdaptiveRadixTree<Entry> tree;
+    for (auto &entry : entries) {
+        tree.Insert(entry.get());
+    }
+
+    std::cout << "keys: " << count << std::endl;
+    std::cout << "bytes/key: unordered_map " << double(allocated) / count << ", flat "
+              << double(index.MemoryUsage()) / count << " (load " << double(index.Size()) / index.Capacity()
+              << ")" << std::endl;
+
+    std::cout << "worst insert us: unordered_map " << map_worst / 1000 << ", flat " << flat_worst / 1000
+              << std::endl;
+
+    volatile size_t sink = 0;
+    std::cout << "hit ns/op: unordered_map " << NanosPerOp(count, [&] {
+        for (size_t i : order) {
+            Entry &entry = *entries[i];
+            sink = sink + (map.find(KeyReference{&entry.GetKeyReference(), entry.GetHash()}) != map.end());
+        }
+    }) << ", flat " << NanosPerOp(count, [&] {
+        for (size_t i : order) {
+            Entry &entry = *entries[i];
+            sink = sink + (index.Find(entry.GetKeyReference(), entry.GetHash()) != nullptr);
+        }
+    }) << ", art " << NanosPerOp(count, [&] {
+        for (size_t i : order) {
+            sink = sink + (tree.Find(entries[i]->GetKeyReference()) != nullptr);
+        }
+    }) << std::endl;
+
+    std::cout << "miss ns/op: unordered_map " << NanosPerOp(count, [&] {
+        for (size_t i : order) {
+            sink = sink + (map.find(KeyReference{&misses[i], miss_hashes[i]}) != map.end());
+        }
+    }) << ", flat " << NanosPerOp(count, [&] {
+        for (size_t i : order) {
+            sink = sink + (index.Find(misses[i], miss_hashes[i]) != nullptr);
+        }
+    }) << ", art " << NanosPerOp(count, [&] {
+        for (size_t i : order) {
+            sink = sink + (tree.Find(misses[i]) != nullptr);
+        }
+    }) << std::endl;
+
+    return 0;
+}
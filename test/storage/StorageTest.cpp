@@ -1,22 +1,39 @@
 #include "gtest/gtest.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <future>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <random>
 #include <set>
+#include <thread>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <vector>
 
+#include <afina/Hash.h>
+#include <storage/AdaptiveRadixTree.h>
+#include <storage/ArtGlobalLockImpl.h>
+#include <storage/FlatIndex.h>
+#include <storage/FrequencySketch.h>
 #include <storage/MapBasedGlobalLockImpl.h>
+#include <storage/ShmGlobalLockImpl.h>
 #include <afina/execute/Get.h>
 #include <afina/execute/Set.h>
 #include <afina/execute/Add.h>
 #include <afina/execute/Append.h>
 #include <afina/execute/Delete.h>
 
+using namespace Afina;
 using namespace Afina::Backend;
 using namespace Afina::Execute;
 using namespace std;
 
 
 TEST(StorageTest, PutGet) {
-    MapBasedGlobalLockImpl storage;
+    MapBasedGlobalLockImpl<> storage;
 
     storage.Put("KEY1", "val1");
     storage.Put("KEY2", "val2");
@@ -33,7 +50,7 @@ TEST(StorageTest, PutGet) {
 }
 
 TEST(StorageTest, PutOverwrite) {
-    MapBasedGlobalLockImpl storage;
+    MapBasedGlobalLockImpl<> storage;
 
     storage.Put("KEY1", "val1");
     storage.Put("KEY1", "val2");
@@ -44,7 +61,7 @@ TEST(StorageTest, PutOverwrite) {
 }
 
 TEST(StorageTest, PutIfAbsent) {
-    MapBasedGlobalLockImpl storage;
+    MapBasedGlobalLockImpl<> storage;
 
     storage.Put("KEY1", "val1");
     storage.PutIfAbsent("KEY1", "val2");
@@ -54,6 +71,932 @@ TEST(StorageTest, PutIfAbsent) {
     EXPECT_TRUE(value == "val1");
 }
 
+TEST(StorageTest, ReservePut) {
+    MapBasedGlobalLockImpl<> storage;
+
+    std::string buffer;
+    storage.Reserve(4, buffer);
+    EXPECT_EQ(4, buffer.size());
+
+    buffer.replace(0, 4, "val1");
+    EXPECT_TRUE(storage.Put("KEY1", std::move(buffer)));
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_TRUE(value == "val1");
+}
+
+// Size of a data block comes from the client, nothing is allocated for value storage could never hold
+TEST(StorageTest, ReserveTooLarge) {
+    MapBasedGlobalLockImpl<> storage(1024);
+
+    std::string buffer("old");
+    EXPECT_FALSE(storage.Reserve(1 << 30, buffer));
+    EXPECT_TRUE(buffer.empty());
+    EXPECT_TRUE(storage.Reserve(512, buffer));
+    EXPECT_EQ(512, buffer.size());
+}
+
+TEST(StorageTest, AppendPrepend) {
+    MapBasedGlobalLockImpl<> storage;
+
+    EXPECT_FALSE(storage.Append("KEY1", "val"));
+    storage.Put("KEY1", "val1");
+    EXPECT_TRUE(storage.Append("KEY1", "_tail"));
+    EXPECT_TRUE(storage.Prepend("KEY1", "head_"));
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_TRUE(value == "head_val1_tail");
+}
+
+TEST(StorageTest, IncrementDecrement) {
+    MapBasedGlobalLockImpl<> storage;
+
+    uint64_t result;
+    EXPECT_FALSE(storage.Increment("KEY1", 1, result));
+
+    storage.Put("KEY1", "9");
+    EXPECT_TRUE(storage.Increment("KEY1", 1, result));
+    EXPECT_EQ(10, result);
+    EXPECT_TRUE(storage.Decrement("KEY1", 100, result));
+    EXPECT_EQ(0, result);
+    EXPECT_TRUE(storage.Increment("KEY1", 42, result));
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_TRUE(value == "42");
+    EXPECT_TRUE(storage.Append("KEY1", "x"));
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_TRUE(value == "42x");
+
+    EXPECT_THROW(storage.Increment("KEY1", 1, result), std::runtime_error);
+}
+
+TEST(StorageTest, CompareAndSet) {
+    MapBasedGlobalLockImpl<> storage;
+
+    EXPECT_TRUE(storage.CompareAndSet("KEY1", 0, "val") == Storage::CasResult::kNotFound);
+
+    storage.Put("KEY1", "val1");
+    std::string value;
+    uint32_t flags;
+    uint64_t cas;
+    EXPECT_TRUE(storage.Get("KEY1", value, flags, cas));
+
+    EXPECT_TRUE(storage.CompareAndSet("KEY1", cas, "val2") == Storage::CasResult::kStored);
+    EXPECT_TRUE(storage.CompareAndSet("KEY1", cas, "val3") == Storage::CasResult::kExists);
+
+    uint64_t new_cas;
+    EXPECT_TRUE(storage.Get("KEY1", value, flags, new_cas));
+    EXPECT_TRUE(value == "val2");
+    EXPECT_NE(cas, new_cas);
+
+    EXPECT_TRUE(storage.Append("KEY1", "x"));
+    EXPECT_TRUE(storage.CompareAndSet("KEY1", new_cas, "val4") == Storage::CasResult::kExists);
+}
+
+TEST(StorageTest, Flags) {
+    MapBasedGlobalLockImpl<> storage;
+
+    storage.Put("KEY1", "val1", 42);
+    storage.Put("KEY2", "val2");
+
+    std::string value;
+    uint32_t flags;
+    uint64_t cas;
+    EXPECT_TRUE(storage.Get("KEY1", value, flags, cas));
+    EXPECT_EQ(42, flags);
+    EXPECT_TRUE(storage.Get("KEY2", value, flags, cas));
+    EXPECT_EQ(0, flags);
+
+    // Append keeps flags, replace sets new ones
+    EXPECT_TRUE(storage.Append("KEY1", "x"));
+    EXPECT_TRUE(storage.Get("KEY1", value, flags, cas));
+    EXPECT_EQ(42, flags);
+    EXPECT_TRUE(storage.Set("KEY1", "val3", 7));
+    EXPECT_TRUE(storage.Get("KEY1", value, flags, cas));
+    EXPECT_EQ(7, flags);
+}
+
+TEST(StorageTest, MultiGetPut) {
+    MapBasedGlobalLockImpl<> storage;
+
+    std::vector<std::string> keys = {"KEY1", "KEY2", "KEY3"};
+    std::vector<std::string> values = {"val1", "val2", std::string(2048, 'x')};
+    EXPECT_EQ(2, storage.MultiPut(keys, values, 5));
+
+    std::vector<Storage::Item> items;
+    storage.MultiGet({"KEY2", "KEY3", "KEY1", "KEY2"}, items);
+    ASSERT_EQ(4, items.size());
+    EXPECT_TRUE(items[0].found);
+    EXPECT_TRUE(*items[0].value == "val2");
+    EXPECT_EQ(5, items[0].flags);
+    EXPECT_FALSE(items[1].found);
+    EXPECT_TRUE(items[2].found);
+    EXPECT_TRUE(*items[2].value == "val1");
+    EXPECT_TRUE(items[3].found);
+    EXPECT_EQ(items[0].cas, items[3].cas);
+}
+
+TEST(StorageTest, PrehashedPutGet) {
+    MapBasedGlobalLockImpl<> storage;
+
+    EXPECT_TRUE(storage.Put("KEY1", Hash("KEY1"), std::string("val1"), 3));
+    EXPECT_TRUE(storage.Put("KEY2", std::string("val2")));
+
+    std::shared_ptr<const std::string> slice;
+    uint32_t flags;
+    uint64_t cas;
+    EXPECT_TRUE(storage.Get("KEY1", slice, flags, cas));
+    EXPECT_TRUE(*slice == "val1");
+    EXPECT_EQ(3, flags);
+    EXPECT_TRUE(storage.Get("KEY2", Hash("KEY2"), slice, flags, cas));
+    EXPECT_TRUE(*slice == "val2");
+    EXPECT_FALSE(storage.Get("KEY3", Hash("KEY3"), slice, flags, cas));
+
+    std::vector<Storage::Item> items;
+    storage.MultiGet({"KEY2", "KEY1"}, {Hash("KEY2"), Hash("KEY1")}, items);
+    ASSERT_EQ(2, items.size());
+    EXPECT_TRUE(*items[0].value == "val2");
+    EXPECT_TRUE(*items[1].value == "val1");
+
+    EXPECT_NE(Hash("KEY1"), Hash("KEY2"));
+    EXPECT_EQ(Hash("KEY1"), Hash(std::string("KEY1")));
+}
+
+TEST(StorageTest, FlatIndex) {
+    std::vector<std::unique_ptr<Entry>> entries;
+    for (size_t i = 0; i < 1000; i++) {
+        std::string key = "KEY" + std::to_string(i);
+        entries.emplace_back(new Entry(key, Hash(key), std::string("val")));
+    }
+
+    FlatIndex<Entry> index;
+    for (auto &entry : entries) {
+        index.Insert(entry.get());
+    }
+    EXPECT_EQ(1000, index.Size());
+    EXPECT_GE(index.Capacity() * 7 / 8, index.Size());
+
+    for (size_t i = 0; i < entries.size(); i += 2) {
+        EXPECT_TRUE(index.Erase(entries[i].get()));
+    }
+    EXPECT_FALSE(index.Erase(entries[0].get()));
+    EXPECT_EQ(500, index.Size());
+
+    for (size_t i = 0; i < entries.size(); i++) {
+        const std::string &key = entries[i]->GetKeyReference();
+        EXPECT_EQ(i % 2 == 0 ? nullptr : entries[i].get(), index.Find(key, Hash(key)));
+    }
+    EXPECT_EQ(nullptr, index.Find("KEY1000", Hash("KEY1000")));
+
+    // Tombstones get reused or purged, index doesn't grow under churn
+    size_t capacity = index.Capacity();
+    for (size_t round = 0; round < 10; round++) {
+        for (size_t i = 0; i < entries.size(); i += 2) {
+            index.Insert(entries[i].get());
+        }
+        for (size_t i = 0; i < entries.size(); i += 2) {
+            EXPECT_TRUE(index.Erase(entries[i].get()));
+        }
+    }
+    EXPECT_EQ(capacity, index.Capacity());
+    EXPECT_EQ(entries[1].get(), index.Find("KEY1", Hash("KEY1")));
+}
+
+TEST(StorageTest, FlatIndexIncrementalRehash) {
+    std::vector<std::unique_ptr<Entry>> entries;
+    for (size_t i = 0; i < 2000; i++) {
+        std::string key = "KEY" + std::to_string(i);
+        entries.emplace_back(new Entry(key, Hash(key), std::string("val")));
+    }
+
+    // Items stay reachable while they are moved between tables, including the ones erased on the way
+    FlatIndex<Entry> index;
+    size_t rehashing = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        index.Insert(entries[i].get());
+        if (index.Rehashing()) {
+            rehashing++;
+            EXPECT_TRUE(index.Erase(entries[i / 2].get()));
+            index.Insert(entries[i / 2].get());
+        }
+        for (size_t j = 0; j <= i; j += 7) {
+            const std::string &key = entries[j]->GetKeyReference();
+            EXPECT_EQ(entries[j].get(), index.Find(key, Hash(key)));
+        }
+    }
+    EXPECT_LT(0, rehashing);
+    EXPECT_EQ(2000, index.Size());
+
+    // Rehash doesn't outlive a small fraction of inserts
+    FlatIndex<Entry> reserved;
+    reserved.Insert(entries[0].get());
+    reserved.Reserve(1000);
+    EXPECT_LE(1000, reserved.Capacity() * 7 / 8);
+    size_t capacity = reserved.Capacity();
+    for (size_t i = 1; i < 1000; i++) {
+        reserved.Insert(entries[i].get());
+    }
+    EXPECT_FALSE(reserved.Rehashing());
+    EXPECT_EQ(capacity, reserved.Capacity());
+    EXPECT_EQ(entries[0].get(), reserved.Find("KEY0", Hash("KEY0")));
+}
+
+TEST(StorageTest, AdaptiveRadixTree) {
+    // Keys sharing prefixes, prefixes of each other and enough siblings to pass through all node sizes
+    std::vector<std::string> keys = {"", "a", "ab", "abc", "abd", "b", "user:1", "user:10", "user:1:name"};
+    for (size_t i = 0; i < 300; i++) {
+        keys.push_back("fan:" + std::string(1, char(i % 256)) + std::to_string(i / 256));
+    }
+
+    std::vector<std::unique_ptr<Entry>> entries;
+    std::map<std::string, Entry *> expected;
+    AdaptiveRadixTree<Entry> tree;
+    std::mt19937 random(42);
+    std::shuffle(keys.begin(), keys.end(), random);
+    for (auto &key : keys) {
+        entries.emplace_back(new Entry(key, Hash(key), std::string("val")));
+        tree.Insert(entries.back().get());
+        expected[key] = entries.back().get();
+    }
+    ASSERT_EQ(expected.size(), tree.Size());
+
+    auto check = [&]() {
+        for (auto &entry : entries) {
+            const std::string &key = entry->GetKeyReference();
+            Entry *found = tree.Find(key);
+            EXPECT_EQ(expected.count(key) ? entry.get() : nullptr, found) << key;
+        }
+        EXPECT_EQ(nullptr, tree.Find("abcd"));
+        EXPECT_EQ(nullptr, tree.Find("user:"));
+
+        for (std::string prefix : {"", "a", "ab", "user:1", "fan:", "zzz"}) {
+            std::vector<Entry *> scanned;
+            tree.ForEachPrefix(prefix, [&scanned](Entry *entry) {
+                scanned.push_back(entry);
+                return true;
+            });
+            std::vector<Entry *> matches;
+            for (auto it = expected.lower_bound(prefix); it != expected.end() && it->first.compare(0, prefix.size(), prefix) == 0;
+                 ++it) {
+                matches.push_back(it->second);
+            }
+            EXPECT_EQ(matches, scanned) << prefix;
+        }
+    };
+    check();
+
+    // Erase in random order, checking node shrinking and path collapsing on the way
+    std::shuffle(entries.begin(), entries.end(), random);
+    for (size_t i = 0; i < entries.size(); i++) {
+        EXPECT_TRUE(tree.Erase(entries[i].get()));
+        EXPECT_FALSE(tree.Erase(entries[i].get()));
+        expected.erase(entries[i]->GetKeyReference());
+        if (i % 50 == 0) {
+            check();
+        }
+    }
+    EXPECT_EQ(0, tree.Size());
+    check();
+}
+
+TEST(StorageTest, ArtPrefix) {
+    ArtGlobalLockImpl<> storage;
+
+    EXPECT_TRUE(storage.Put("user:1:name", "ann"));
+    EXPECT_TRUE(storage.Put("user:1:mail", "ann@"));
+    EXPECT_TRUE(storage.Put("user:12:name", "bob"));
+    EXPECT_TRUE(storage.Put("user:2:name", "eve"));
+    EXPECT_TRUE(storage.Put("user:1", "counter"));
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("user:1:mail", value));
+    EXPECT_TRUE(value == "ann@");
+
+    std::vector<std::string> keys;
+    std::vector<Storage::Item> items;
+    EXPECT_TRUE(storage.Scan("user:1", 10, keys, items));
+    EXPECT_EQ(std::vector<std::string>({"user:1", "user:12:name", "user:1:mail", "user:1:name"}), keys);
+    ASSERT_EQ(4, items.size());
+    EXPECT_TRUE(*items[2].value == "ann@");
+
+    keys.clear();
+    items.clear();
+    EXPECT_TRUE(storage.Scan("user:", 2, keys, items));
+    EXPECT_EQ(2, keys.size());
+
+    size_t deleted;
+    EXPECT_TRUE(storage.DeletePrefix("user:1:", deleted));
+    EXPECT_EQ(2, deleted);
+    EXPECT_FALSE(storage.Get("user:1:name", value));
+    EXPECT_TRUE(storage.Get("user:1", value));
+    EXPECT_TRUE(storage.Get("user:12:name", value));
+
+    MapBasedGlobalLockImpl<> map;
+    EXPECT_FALSE(map.DeletePrefix("user:", deleted));
+}
+
+TEST(StorageTest, ArtEviction) {
+    ArtGlobalLockImpl<> storage(100);
+
+    for (size_t i = 0; i < 20; i++) {
+        EXPECT_TRUE(storage.Put("key" + std::to_string(i), "value"));
+    }
+
+    // key10..key19 take exactly 10 bytes each, all the older ones get evicted
+    std::string value;
+    EXPECT_FALSE(storage.Get("key9", value));
+    EXPECT_TRUE(storage.Get("key19", value));
+
+    std::vector<std::string> keys;
+    std::vector<Storage::Item> items;
+    EXPECT_TRUE(storage.Scan("key", 100, keys, items));
+    EXPECT_EQ(10, keys.size());
+}
+
+TEST(StorageTest, FrequencySketch) {
+    FrequencySketch sketch;
+    for (size_t i = 0; i < 10; i++) {
+        sketch.Increment(Hash("hot"));
+    }
+    sketch.Increment(Hash("warm"));
+    EXPECT_EQ(10, sketch.Frequency(Hash("hot")));
+    EXPECT_EQ(1, sketch.Frequency(Hash("warm")));
+    EXPECT_EQ(0, sketch.Frequency(Hash("cold")));
+
+    // Counters saturate and age, so hot key cools down once the workload moves on
+    for (size_t i = 0; i < 100000; i++) {
+        sketch.Increment(Hash("key" + std::to_string(i % 1000)));
+    }
+    EXPECT_GT(10, sketch.Frequency(Hash("hot")));
+    EXPECT_GE(15, sketch.Frequency(Hash("key1")));
+}
+
+TEST(StorageTest, TinyLfuScanResistance) {
+    MapBasedGlobalLockImpl<TinyLfuPolicy> tinylfu(10000);
+    MapBasedGlobalLockImpl<> lru(10000);
+
+    // 50 hot keys take half of the budget and are read again and again, then one pass scan of 1000 cold keys
+    std::string value(95, 'x');
+    for (size_t round = 0; round < 10; round++) {
+        for (size_t i = 0; i < 50; i++) {
+            std::string key = "hot" + std::to_string(i % 10) + std::to_string(i / 10);
+            if (!tinylfu.Get(key, value)) {
+                tinylfu.Put(key, std::string(95, 'x'));
+            }
+            if (!lru.Get(key, value)) {
+                lru.Put(key, std::string(95, 'x'));
+            }
+        }
+    }
+    for (size_t i = 0; i < 1000; i++) {
+        std::string key = "cold" + std::to_string(i + 1000);
+        tinylfu.Put(key, std::string(91, 'x'));
+        lru.Put(key, std::string(91, 'x'));
+    }
+
+    size_t tinylfu_hits = 0, lru_hits = 0;
+    for (size_t i = 0; i < 50; i++) {
+        std::string key = "hot" + std::to_string(i % 10) + std::to_string(i / 10);
+        tinylfu_hits += tinylfu.Get(key, value) ? 1 : 0;
+        lru_hits += lru.Get(key, value) ? 1 : 0;
+    }
+    EXPECT_EQ(0, lru_hits);
+    EXPECT_EQ(50, tinylfu_hits);
+}
+
+TEST(StorageTest, TinyLfuUpdates) {
+    MapBasedGlobalLockImpl<TinyLfuPolicy> storage(100);
+
+    EXPECT_TRUE(storage.Put("KEY1", std::string(40, 'a')));
+    EXPECT_TRUE(storage.Put("KEY2", std::string(40, 'b')));
+
+    // Growing entry is never evicted to make room for itself
+    EXPECT_TRUE(storage.Append("KEY1", std::string(50, 'c')));
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_EQ(90, value.size());
+    EXPECT_FALSE(storage.Get("KEY2", value));
+
+    EXPECT_TRUE(storage.Put("KEY1", "1"));
+    uint64_t number;
+    EXPECT_TRUE(storage.Increment("KEY1", 99, number));
+    EXPECT_EQ(100, number);
+    EXPECT_TRUE(storage.Delete("KEY1"));
+    EXPECT_FALSE(storage.Get("KEY1", value));
+}
+
+template <typename Policy> class EvictionPolicyTest : public ::testing::Test {};
+typedef ::testing::Types<LruPolicy, SlruPolicy, TwoQueuePolicy, ArcPolicy, GdsfPolicy, TinyLfuPolicy> Policies;
+TYPED_TEST_CASE(EvictionPolicyTest, Policies);
+
+TYPED_TEST(EvictionPolicyTest, RandomWorkload) {
+    MapBasedGlobalLockImpl<TypeParam> storage(1000);
+    std::map<std::string, std::string> written;
+    std::mt19937 random(7);
+
+    // Whatever policy evicts, surviving values are the last written ones and fit into the budget, which is
+    // halved on the way
+    for (size_t i = 0; i < 20000; i++) {
+        if (i == 10000) {
+            EXPECT_TRUE(storage.SetMaxSize(500));
+        }
+        std::string key = "k" + std::to_string(random() % 200);
+        std::string value;
+        switch (random() % 4) {
+        case 0:
+            EXPECT_TRUE(storage.Put(key, std::string(random() % 100, 'a' + i % 26)));
+            storage.Get(key, written[key]);
+            break;
+        case 1:
+            if (storage.Append(key, std::string(random() % 20, 'z'))) {
+                storage.Get(key, written[key]);
+            }
+            break;
+        case 2:
+            storage.Delete(key);
+            break;
+        default:
+            if (storage.Get(key, value)) {
+                EXPECT_EQ(written[key], value);
+            }
+        }
+    }
+
+    size_t total = 0;
+    for (auto &it : written) {
+        std::string value;
+        if (storage.Get(it.first, value)) {
+            EXPECT_EQ(it.second, value);
+            total += it.first.size() + value.size();
+        }
+    }
+    EXPECT_LT(0, total);
+    EXPECT_GE(500, total);
+}
+
+TYPED_TEST(EvictionPolicyTest, GrowingEntry) {
+    MapBasedGlobalLockImpl<TypeParam> storage(100);
+    EXPECT_TRUE(storage.Put("KEY1", std::string(40, 'a')));
+    EXPECT_TRUE(storage.Put("KEY2", std::string(40, 'b')));
+
+    // Growing entry is never evicted to make room for itself
+    EXPECT_TRUE(storage.Append("KEY2", std::string(50, 'c')));
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY2", value));
+    EXPECT_EQ(90, value.size());
+    EXPECT_FALSE(storage.Get("KEY1", value));
+}
+
+TYPED_TEST(EvictionPolicyTest, GrowingVictim) {
+    MapBasedGlobalLockImpl<TypeParam> storage(100);
+    EXPECT_TRUE(storage.Put("KEY1", std::string(25, 'a')));
+    EXPECT_TRUE(storage.Put("KEY2", std::string(25, 'b')));
+    EXPECT_TRUE(storage.Put("KEY3", std::string(25, 'c')));
+
+    // Growing entry is the first victim, policy passes over it to the next one
+    EXPECT_TRUE(storage.Append("KEY1", std::string(20, 'd')));
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_EQ(45, value.size());
+    EXPECT_FALSE(storage.Get("KEY2", value));
+    EXPECT_TRUE(storage.Get("KEY3", value));
+}
+
+TEST(StorageTest, GdsfSizeAware) {
+    MapBasedGlobalLockImpl<GdsfPolicy> gdsf(1000);
+    MapBasedGlobalLockImpl<> lru(1000);
+
+    // Large value is used as often as small ones, but it is cheaper to lose one miss than ten
+    std::string value;
+    for (size_t round = 0; round < 3; round++) {
+        for (size_t i = 0; i < 10; i++) {
+            std::string key = "small" + std::to_string(i);
+            if (!gdsf.Get(key, value)) {
+                gdsf.Put(key, std::string(44, 's'));
+            }
+            if (!lru.Get(key, value)) {
+                lru.Put(key, std::string(44, 's'));
+            }
+        }
+        if (!gdsf.Get("large", value)) {
+            gdsf.Put("large", std::string(495, 'l'));
+        }
+        if (!lru.Get("large", value)) {
+            lru.Put("large", std::string(495, 'l'));
+        }
+    }
+    EXPECT_TRUE(gdsf.Put("new", std::string(497, 'n')));
+    EXPECT_TRUE(lru.Put("new", std::string(497, 'n')));
+
+    size_t gdsf_small = 0, lru_small = 0;
+    for (size_t i = 0; i < 10; i++) {
+        std::string key = "small" + std::to_string(i);
+        gdsf_small += gdsf.Get(key, value) ? 1 : 0;
+        lru_small += lru.Get(key, value) ? 1 : 0;
+    }
+    EXPECT_FALSE(gdsf.Get("large", value));
+    EXPECT_EQ(10, gdsf_small);
+    EXPECT_GT(10, lru_small);
+}
+
+TEST(StorageTest, GdsfEmptyEntry) {
+    MapBasedGlobalLockImpl<GdsfPolicy> gdsf(1000);
+    EXPECT_TRUE(gdsf.Put("", ""));
+
+    // Entry of zero size ages like any other one
+    std::string value;
+    for (size_t i = 0; i < 1000; i++) {
+        EXPECT_TRUE(gdsf.Put("key" + std::to_string(i), std::string(40, 'v')));
+    }
+    EXPECT_FALSE(gdsf.Get("", value));
+    EXPECT_TRUE(gdsf.Get("key999", value));
+}
+
+TEST(StorageTest, Expire) {
+    MapBasedGlobalLockImpl<> storage;
+    time_t now = time(nullptr);
+
+    storage.Put("KEY1", "val1", 0, 10);
+    storage.Put("KEY2", "val2", 0, -1);
+    storage.Put("KEY3", "val3");
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_FALSE(storage.Get("KEY2", value));
+    EXPECT_FALSE(storage.Delete("KEY2"));
+
+    EXPECT_EQ(0, storage.Expire(now + 5, 100));
+    EXPECT_TRUE(storage.Get("KEY1", value));
+
+    EXPECT_EQ(1, storage.Expire(now + 11, 100));
+    EXPECT_FALSE(storage.Get("KEY1", value));
+    EXPECT_TRUE(storage.Get("KEY3", value));
+
+    // Freed space is reusable
+    EXPECT_TRUE(storage.PutIfAbsent("KEY1", "val1"));
+}
+
+TEST(StorageTest, Touch) {
+    MapBasedGlobalLockImpl<> storage;
+    time_t now = time(nullptr);
+
+    EXPECT_FALSE(storage.Touch("KEY1", 10));
+
+    storage.Put("KEY1", "val1", 0, 10);
+    storage.Put("KEY2", "val2", 0, 10);
+    EXPECT_TRUE(storage.Touch("KEY1", 100));
+
+    std::string value;
+    uint32_t flags;
+    uint64_t cas;
+    EXPECT_TRUE(storage.GetAndTouch("KEY2", 0, value, flags, cas));
+    EXPECT_TRUE(value == "val2");
+
+    EXPECT_EQ(0, storage.Expire(now + 50, 100));
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_TRUE(storage.Get("KEY2", value));
+
+    EXPECT_EQ(1, storage.Expire(now + 101, 100));
+    EXPECT_FALSE(storage.Get("KEY1", value));
+    EXPECT_TRUE(storage.Get("KEY2", value));
+}
+
+TEST(StorageTest, BackgroundEviction) {
+    MapBasedGlobalLockImpl<> storage(1000, 200, 400);
+    auto stat = [&storage](const std::string &name) {
+        std::vector<std::pair<std::string, uint64_t>> stats;
+        storage.GetStats(stats);
+        for (auto &it : stats) {
+            if (it.first == name) {
+                return it.second;
+            }
+        }
+        return uint64_t(-1);
+    };
+
+    // Without maintainer writers evict themselves
+    for (size_t i = 0; i < 20; i++) {
+        EXPECT_TRUE(storage.Put("KEY" + std::to_string(i + 10), std::string(45, 'x')));
+    }
+    EXPECT_EQ(1000, stat("bytes"));
+    EXPECT_EQ(0, stat("evictions"));
+    EXPECT_TRUE(storage.Put("KEY99", std::string(45, 'x')));
+    EXPECT_EQ(1, stat("inline_evictions"));
+
+    // Maintainer frees up to high watermark, then writes fit into headroom without evictions
+    storage.Start();
+    for (size_t i = 0; i < 100 && stat("bytes") > 600; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(600, stat("bytes"));
+    EXPECT_EQ(9, stat("evictions"));
+    for (size_t i = 0; i < 4; i++) {
+        EXPECT_TRUE(storage.Put("NEW" + std::to_string(i + 10), std::string(45, 'y')));
+    }
+    EXPECT_EQ(800, stat("bytes"));
+
+    // Crossing low watermark wakes maintainer up
+    EXPECT_TRUE(storage.Put("NEW99", std::string(45, 'y')));
+    for (size_t i = 0; i < 100 && stat("bytes") > 600; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(600, stat("bytes"));
+    EXPECT_EQ(1, stat("inline_evictions"));
+}
+
+TEST(StorageTest, RuntimeLimits) {
+    MapBasedGlobalLockImpl<> storage(1000, 100, 100);
+    for (size_t i = 0; i < 18; i++) {
+        EXPECT_TRUE(storage.Put("KEY" + std::to_string(i + 10), std::string(45, 'x')));
+    }
+
+    // Shrink keeps the most recent entries and the headroom
+    std::string value;
+    EXPECT_FALSE(storage.SetMaxSize(50));
+    EXPECT_TRUE(storage.SetMaxSize(500));
+    EXPECT_FALSE(storage.Get("KEY19", value));
+    EXPECT_TRUE(storage.Get("KEY20", value));
+    EXPECT_TRUE(storage.Get("KEY27", value));
+    EXPECT_FALSE(storage.Put("BIG", std::string(600, 'x')));
+
+    EXPECT_TRUE(storage.SetMaxSize(2000));
+    EXPECT_TRUE(storage.Put("BIG", std::string(600, 'x')));
+    EXPECT_TRUE(storage.Get("KEY20", value));
+
+    // Index could be presized, tree can't
+    EXPECT_TRUE(storage.SetCapacity(100000));
+    EXPECT_TRUE(storage.Get("BIG", value));
+    ArtGlobalLockImpl<> tree;
+    EXPECT_FALSE(tree.SetCapacity(100000));
+}
+
+TEST(StorageTest, Snapshot) {
+    std::string path = "/tmp/afina_snapshot_test_" + std::to_string(getpid());
+    MapBasedGlobalLockImpl<> storage(1000);
+    auto stat = [](const Storage &storage, const std::string &name) {
+        std::vector<std::pair<std::string, uint64_t>> stats;
+        storage.GetStats(stats);
+        for (auto &it : stats) {
+            if (it.first == name) {
+                return it.second;
+            }
+        }
+        return uint64_t(-1);
+    };
+
+    for (size_t i = 0; i < 10; i++) {
+        EXPECT_TRUE(storage.Put("KEY" + std::to_string(i + 10), std::string(45, 'x')));
+    }
+    EXPECT_TRUE(storage.Put("KEY12", std::string(45, 'x'), 0, -1));
+    EXPECT_TRUE(storage.Put("KEY13", std::string(45, 'x'), 7, 0));
+    EXPECT_TRUE(storage.Put("KEY14", std::string(45, 'x'), 0, 1000));
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY10", value));
+
+    EXPECT_TRUE(storage.Snapshot(path));
+    for (size_t i = 0; i < 100 && stat(storage, "snapshot_in_progress") == 1; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(0, stat(storage, "snapshot_failures"));
+    EXPECT_LE(1, stat(storage, "snapshots"));
+
+    // Eviction order survives: the coldest item doesn't fit into smaller storage
+    MapBasedGlobalLockImpl<> restored(400);
+    EXPECT_TRUE(restored.LoadSnapshot(path, 4));
+    EXPECT_EQ(9, stat(restored, "snapshot_loaded_items"));
+    EXPECT_FALSE(restored.Get("KEY11", value));
+    EXPECT_FALSE(restored.Get("KEY12", value));
+    EXPECT_TRUE(restored.Get("KEY10", value));
+    EXPECT_EQ(std::string(45, 'x'), value);
+
+    uint32_t flags;
+    uint64_t cas;
+    EXPECT_TRUE(restored.Get("KEY13", value, flags, cas));
+    EXPECT_EQ(7, flags);
+    EXPECT_EQ(1, restored.Expire(time(nullptr) + 2000, 100));
+    EXPECT_FALSE(restored.Get("KEY14", value));
+
+    // Many blocks decoded by many threads
+    MapBasedGlobalLockImpl<> big(8 << 20);
+    for (size_t i = 0; i < 5000; i++) {
+        EXPECT_TRUE(big.Put("KEY" + std::to_string(i), std::string(1000, 'a' + i % 26)));
+    }
+    EXPECT_TRUE(big.Snapshot(path));
+    big.Stop();
+    MapBasedGlobalLockImpl<> big_restored(8 << 20);
+    EXPECT_TRUE(big_restored.LoadSnapshot(path, 4));
+    EXPECT_EQ(5000, stat(big_restored, "snapshot_loaded_items"));
+    for (size_t i = 0; i < 5000; i++) {
+        EXPECT_TRUE(big_restored.Get("KEY" + std::to_string(i), value));
+        EXPECT_EQ(std::string(1000, 'a' + i % 26), value);
+    }
+    unlink(path.c_str());
+
+    EXPECT_THROW(big_restored.LoadSnapshot(path, 4), std::runtime_error);
+}
+
+TEST(StorageTest, MutationLog) {
+    std::string path = "/tmp/afina_log_test_" + std::to_string(getpid());
+    unlink(path.c_str());
+    std::string value;
+    uint32_t flags;
+    uint64_t cas;
+    {
+        MapBasedGlobalLockImpl<> storage(1000);
+        EXPECT_TRUE(storage.OpenLog(path, Storage::LogSync::kAlways, 0));
+        EXPECT_TRUE(storage.Put("KEY1", "val1", 5, 0));
+        EXPECT_TRUE(storage.Put("KEY2", "val2"));
+        EXPECT_TRUE(storage.Append("KEY1", "+"));
+        EXPECT_TRUE(storage.Prepend("KEY1", "-"));
+        EXPECT_TRUE(storage.Put("NUM", "10"));
+        uint64_t number;
+        EXPECT_TRUE(storage.Increment("NUM", 5, number));
+        EXPECT_TRUE(storage.Delete("KEY2"));
+        EXPECT_TRUE(storage.Put("GONE", "val", 0, 100));
+        EXPECT_TRUE(storage.Touch("GONE", -1));
+
+        // Reply is allowed once write is on disk
+        std::promise<void> durable;
+        storage.WhenDurable([&durable]() { durable.set_value(); });
+        EXPECT_EQ(std::future_status::ready, durable.get_future().wait_for(std::chrono::seconds(5)));
+    }
+
+    // Torn record at the end is cut off
+    {
+        FILE *file = fopen(path.c_str(), "a");
+        fwrite("garbage", 1, 7, file);
+        fclose(file);
+    }
+
+    {
+        MapBasedGlobalLockImpl<> storage(1000);
+        EXPECT_TRUE(storage.OpenLog(path, Storage::LogSync::kNever, 0));
+        EXPECT_TRUE(storage.Get("KEY1", value, flags, cas));
+        EXPECT_EQ("-val1+", value);
+        EXPECT_EQ(5, flags);
+        EXPECT_TRUE(storage.Get("NUM", value));
+        EXPECT_EQ("15", value);
+        EXPECT_FALSE(storage.Get("KEY2", value));
+        EXPECT_FALSE(storage.Get("GONE", value));
+
+        // Rewrite drops history, changes made meanwhile are kept
+        for (size_t i = 0; i < 100; i++) {
+            EXPECT_TRUE(storage.Put("KEY3", std::string(100, 'a' + i % 26)));
+        }
+        EXPECT_TRUE(storage.RewriteLog());
+        EXPECT_TRUE(storage.Put("KEY4", "val4"));
+        storage.Stop();
+    }
+
+    {
+        struct stat st;
+        ASSERT_EQ(0, stat(path.c_str(), &st));
+        EXPECT_GT(1000, st.st_size);
+        EXPECT_NE(0, access((path + ".rewrite").c_str(), F_OK));
+
+        MapBasedGlobalLockImpl<> storage(1000);
+        EXPECT_TRUE(storage.OpenLog(path, Storage::LogSync::kInterval, 10));
+        EXPECT_TRUE(storage.Get("KEY1", value));
+        EXPECT_EQ("-val1+", value);
+        EXPECT_TRUE(storage.Get("KEY3", value));
+        EXPECT_EQ(std::string(100, 'a' + 99 % 26), value);
+        EXPECT_TRUE(storage.Get("KEY4", value));
+        EXPECT_FALSE(storage.Get("KEY2", value));
+    }
+    unlink(path.c_str());
+}
+
+// Waits until replica has the key with the given value, empty value means key must be gone
+static bool Replicated(const Storage &replica, const std::string &key, const std::string &expected) {
+    for (int i = 0; i < 500; i++) {
+        std::string value;
+        bool found = replica.Get(key, value);
+        if (expected.empty() ? !found : found && value == expected) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+TEST(StorageTest, Replication) {
+    uint16_t port = 20000 + getpid() % 20000;
+    MapBasedGlobalLockImpl<> primary(1000);
+    EXPECT_TRUE(primary.ServeReplicas(port));
+    EXPECT_TRUE(primary.Put("KEY1", "val1"));
+    EXPECT_TRUE(primary.Put("KEY2", "val2"));
+
+    // Replica's own items are dropped, it gets full copy first and changes after
+    MapBasedGlobalLockImpl<> replica(1000);
+    EXPECT_TRUE(replica.Put("STALE", "val"));
+    EXPECT_TRUE(replica.ReplicateFrom("127.0.0.1", port));
+    EXPECT_TRUE(Replicated(replica, "KEY1", "val1"));
+    EXPECT_TRUE(Replicated(replica, "KEY2", "val2"));
+    EXPECT_TRUE(Replicated(replica, "STALE", ""));
+
+    EXPECT_TRUE(primary.Append("KEY1", "+"));
+    EXPECT_TRUE(primary.Delete("KEY2"));
+    EXPECT_TRUE(primary.Put("KEY3", "val3", 7, 0));
+    EXPECT_TRUE(Replicated(replica, "KEY1", "val1+"));
+    EXPECT_TRUE(Replicated(replica, "KEY2", ""));
+    EXPECT_TRUE(Replicated(replica, "KEY3", "val3"));
+
+    std::string value;
+    uint32_t flags;
+    uint64_t cas;
+    EXPECT_TRUE(replica.Get("KEY3", value, flags, cas));
+    EXPECT_EQ(7, flags);
+    replica.Stop();
+    primary.Stop();
+}
+
+TEST(StorageTest, SharedMemory) {
+    std::string path = "/tmp/afina_shm_test_" + std::to_string(getpid());
+    unlink(path.c_str());
+    std::string value;
+    uint32_t flags;
+    uint64_t cas, number;
+    {
+        ShmGlobalLockImpl storage(path, 1000);
+        EXPECT_FALSE(storage.Attached());
+        for (size_t i = 0; i < 20; i++) {
+            EXPECT_TRUE(storage.Put("KEY" + std::to_string(i + 10), std::string(45, 'x')));
+        }
+        EXPECT_TRUE(storage.Get("KEY10", value));
+
+        // Least recently used is evicted
+        EXPECT_TRUE(storage.Put("KEY30", std::string(45, 'x')));
+        EXPECT_FALSE(storage.Get("KEY11", value));
+        EXPECT_TRUE(storage.Get("KEY10", value));
+
+        EXPECT_TRUE(storage.Put("NUM", "10", 3, 0));
+        EXPECT_TRUE(storage.Increment("NUM", 5, number));
+        EXPECT_EQ(15, number);
+        EXPECT_TRUE(storage.Append("KEY19", "+"));
+        EXPECT_TRUE(storage.Put("GONE", "val", 0, -1));
+        EXPECT_FALSE(storage.Get("GONE", value));
+        EXPECT_FALSE(storage.Put("BIG", std::string(1000, 'x')));
+    }
+
+    // Restarted storage maps the same items, the second user of the region sees changes of the first
+    {
+        ShmGlobalLockImpl storage(path, 1000);
+        EXPECT_TRUE(storage.Attached());
+        EXPECT_TRUE(storage.Get("NUM", value, flags, cas));
+        EXPECT_EQ("15", value);
+        EXPECT_EQ(3, flags);
+        std::shared_ptr<const std::string> slice;
+        ASSERT_TRUE(storage.Get("KEY19", slice, flags, cas));
+        EXPECT_EQ(std::string(45, 'x') + "+", *slice);
+        EXPECT_EQ(Storage::CasResult::kStored, storage.CompareAndSet("KEY19", cas, "new"));
+
+        ShmGlobalLockImpl other(path, 1000);
+        EXPECT_TRUE(other.Get("KEY19", value));
+        EXPECT_EQ("new", value);
+        EXPECT_TRUE(other.Delete("KEY18"));
+        EXPECT_FALSE(storage.Get("KEY18", value));
+    }
+
+    // Other region size means other layout, items aren't dropped for it
+    EXPECT_THROW(ShmGlobalLockImpl(path, 1000, 1 << 21), std::runtime_error);
+    {
+        ShmGlobalLockImpl storage(path, 1000);
+        EXPECT_TRUE(storage.Attached());
+        EXPECT_TRUE(storage.SetMaxSize(0));
+    }
+    {
+        ShmGlobalLockImpl storage(path, 1000, 1 << 21);
+        EXPECT_FALSE(storage.Attached());
+        EXPECT_FALSE(storage.Get("NUM", value));
+    }
+    unlink(path.c_str());
+}
+
+TEST(StorageTest, SharedMemoryFailedOverwrite) {
+    std::string path = "/tmp/afina_shm_test_" + std::to_string(getpid());
+    unlink(path.c_str());
+    {
+        // Budget allows for more than the heap of the small region has
+        ShmGlobalLockImpl storage(path, 1 << 20, 1 << 16);
+        std::string value;
+        EXPECT_TRUE(storage.Put("KEY", "old"));
+        for (size_t i = 0; i < 300; i++) {
+            EXPECT_TRUE(storage.Put("KEY" + std::to_string(i), std::string(200, 'x')));
+            EXPECT_TRUE(storage.Get("KEY", value));
+        }
+
+        // Replacement can't be allocated even once everything else is evicted, old value is still there
+        EXPECT_FALSE(storage.Put("KEY", std::string(30000, 'n')));
+        EXPECT_FALSE(storage.Append("KEY", std::string(1 << 16, 'n')));
+        EXPECT_TRUE(storage.Get("KEY", value));
+        EXPECT_EQ("old", value);
+    }
+    unlink(path.c_str());
+}
+
 TEST(StorageTest, BigTest) {
 	/*
 	Specify min key number in storage after insertion of 100000 key-value pairs
@@ -62,7 +1005,7 @@ TEST(StorageTest, BigTest) {
 	*/
 	constexpr long min_value = 93750;
 
-    MapBasedGlobalLockImpl storage(100000);
+    MapBasedGlobalLockImpl<> storage(100000);
 
     std::stringstream ss;
 
@@ -116,7 +1059,7 @@ TEST(StorageTest, MaxTest) {
 		[Sum 2 * (NumberOfDigits(k) + 3) where k from N to 1100] <= 1000
         */
 	constexpr long min_value = 1030;
-    MapBasedGlobalLockImpl storage(1000);
+    MapBasedGlobalLockImpl<> storage(1000);
 
     std::stringstream ss;
 